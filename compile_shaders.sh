@@ -17,4 +17,5 @@ ${COMPILER} -fshader-stage=fragment -g shaders/skyboxFrag.glsl -o shaders/spv/sk
 ${COMPILER} -fshader-stage=vertex -g shaders/debugVert.glsl -o shaders/spv/debugVert.spv
 ${COMPILER} -fshader-stage=fragment -g shaders/debugFrag.glsl -o shaders/spv/debugFrag.spv
 ${COMPILER} -fshader-stage=vertex -g shaders/fishVert.glsl -o shaders/spv/fishVert.spv
+${COMPILER} -fshader-stage=vertex -g shaders/fishVertDQ.glsl -o shaders/spv/fishVertDQ.spv
 ${COMPILER} -fshader-stage=fragment -g shaders/fishFrag.glsl -o shaders/spv/fishFrag.spv
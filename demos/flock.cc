@@ -5,6 +5,7 @@
 #include <array>
 #include <random>
 #include <climits>
+#include <cstring>
 
 //demo specific information
 struct InstanceData
@@ -90,7 +91,8 @@ struct SkyBoxPipeData
 
 struct FishPipeData
 {
-	Mesh mesh;
+	std::vector<MeshPrimitive> primitives;//draw ranges into vertex and index buffers
+	mat4x4 positionDequantisation;
 	Animation animation;
 	Texture fishTexture;
 	ImageResource depthImage;
@@ -102,17 +104,45 @@ struct FishPipeData
 	VkViewport viewport;
 	Buffer vertexBuffer;
 	Buffer indexBuffer;
-	Buffer ubo;
-	Buffer jointMatrices;
+	uint32_t uboOffset;//dynamic offsets into the frame ring for the frame being recorded
+	uint32_t jointsOffset;
 };
 
 static constexpr int SWAPCHAIN_IMAGE_COUNT = 2;
+//model and view projection matrices shared by fish, debug and skybox pipelines
+static constexpr VkDeviceSize TRANSFORM_UBO_SIZE = sizeof(mat4x4) * 2;
+//per frame partition of the ring holding uniforms and skinning palettes
+static constexpr VkDeviceSize FRAME_RING_SIZE = 256 * 1024;
+//fragment stage view direction takes the first 16 bytes of push constants
+static constexpr uint32_t FISH_DEQUANTISATION_PUSH_OFFSET = 16;
+//swim cycles at different phases and rates updated in one batch, each fish picks one by instance index
+static constexpr uint32_t FISH_ANIMATION_VARIANTS = 16;
+
+//vertex stage push constants of the fish pipeline
+struct FishVertexConstants
+{
+	mat4x4 positionDequantisation;
+	uint32_t paletteJointCount;
+	uint32_t animationVariantCount;
+};
+
+//palette of a single animation variant, variants are stored back to back
+static std::size_t get_fish_palette_size(std::size_t jointCount, bool dualQuatSkinning)
+{
+	if(dualQuatSkinning)
+	{
+		return sizeof(DualQuatSkinningSpace) + sizeof(DualQuat) * jointCount;
+	}
+	return sizeof(mat4x4) * jointCount;
+}
+
 struct FlockContext
 {
 	VulkanGlobalContext vkCtx;
 	SwapChain swapChain;
 	WindowInfo windowInfo;
 
+	FrameRingBuffer frameRing;
 	FishPipeData fishPipeData;
 	ComputePipeData computePipeData;
 	DebugPipeData debugPipeData;
@@ -122,6 +152,24 @@ struct FlockContext
 	VkCommandPool commandPool;
 	std::array<VkFramebuffer, SWAPCHAIN_IMAGE_COUNT> frameBuffers;
 	std::array<VkCommandBuffer, SWAPCHAIN_IMAGE_COUNT> commandBuffers;
+
+	//decodes run on the job system while device and pipelines get created
+	TextureLoader textureLoader;
+	TextureHandle fishTexture;
+	std::array<TextureHandle, 6> skyboxFaces;
+
+	//--dual-quat skins fish with 32 byte dual quaternions per joint instead of 64 byte matrices
+	bool dualQuatSkinning = false;
+};
+
+static constexpr std::array<const char*, 6> SKYBOX_FACES = 
+{
+	"resources/negx.png",
+	"resources/posx.png",
+	"resources/negy.png",
+	"resources/posy.png",
+	"resources/negz.png",
+	"resources/posz.png",
 };
 
 static std::vector<BoidTransform> generate_boids(uint32_t numberOfBoids)
@@ -306,19 +354,21 @@ static void update_fish_descriptor_set(FlockContext* ctx)
 	auto& vkCtx = ctx->vkCtx;
 
 	//creating descriptor pool to allocate descriptor sets from
-	VkDescriptorPoolSize descriptorPoolSizes[3] = {};
-	descriptorPoolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	VkDescriptorPoolSize descriptorPoolSizes[4] = {};
+	descriptorPoolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
 	descriptorPoolSizes[0].descriptorCount = 1;
-	descriptorPoolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-	descriptorPoolSizes[1].descriptorCount = 2;
-	descriptorPoolSizes[2].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	descriptorPoolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+	descriptorPoolSizes[1].descriptorCount = 1;
+	descriptorPoolSizes[2].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
 	descriptorPoolSizes[2].descriptorCount = 1;
+	descriptorPoolSizes[3].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	descriptorPoolSizes[3].descriptorCount = 1;
 
 	VkDescriptorPoolCreateInfo descriptorPoolCreateInfo = {};
 	descriptorPoolCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
 	descriptorPoolCreateInfo.pNext = nullptr;
 	descriptorPoolCreateInfo.maxSets = 3;
-	descriptorPoolCreateInfo.poolSizeCount = 3;
+	descriptorPoolCreateInfo.poolSizeCount = 4;
 	descriptorPoolCreateInfo.pPoolSizes = descriptorPoolSizes;
 
 	VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
@@ -334,29 +384,24 @@ static void update_fish_descriptor_set(FlockContext* ctx)
 	VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
 	VK_CALL(vkAllocateDescriptorSets(vkCtx.logicalDevice, &descrSetAllocInfo, &descriptorSet));
 	
-	//create ubos large enough to store data for each swapchain image to avoid ubo update synchronization
-	Buffer ubo = create_buffer(vkCtx,
-		VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT|VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-		ctx->swapChain.imageCount * sizeof(mat4x4) * 2
-	);
-
-	Buffer jointMatrices = create_buffer(vkCtx,
-		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
-		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT|VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-		ctx->swapChain.imageCount * sizeof(mat4x4) * ctx->fishPipeData.animation.bindPose.size()
-	); 
+	//ubo and joint palette are written into the frame ring every frame, descriptors address them with dynamic offsets
+	VK_CHECK(create_frame_ring_buffer(vkCtx,
+		VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT|VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+		FRAME_RING_SIZE,
+		ctx->swapChain.imageCount,
+		&ctx->frameRing
+	));
 	
 	//write data to descriptor set
 	VkDescriptorBufferInfo descriptorBufferInfoMVP = {};
-	descriptorBufferInfoMVP.buffer = ubo.buffer;
+	descriptorBufferInfoMVP.buffer = ctx->frameRing.buffer.buffer;
 	descriptorBufferInfoMVP.offset = 0;
-	descriptorBufferInfoMVP.range = ubo.bufferSize;
+	descriptorBufferInfoMVP.range = TRANSFORM_UBO_SIZE;
 
 	VkDescriptorBufferInfo descriptorBufferInfoJoints = {};
-	descriptorBufferInfoJoints.buffer = jointMatrices.buffer;
+	descriptorBufferInfoJoints.buffer = ctx->frameRing.buffer.buffer;
 	descriptorBufferInfoJoints.offset = 0;
-	descriptorBufferInfoJoints.range = jointMatrices.bufferSize;
+	descriptorBufferInfoJoints.range = FISH_ANIMATION_VARIANTS * get_fish_palette_size(ctx->fishPipeData.animation.bindPose.size(), ctx->dualQuatSkinning);
 
 	VkDescriptorBufferInfo descriptorBufferInfoInstances = {};
 	descriptorBufferInfoInstances.buffer = ctx->computePipeData.instanceTransformsDeviceBuffer.buffer;
@@ -376,7 +421,7 @@ static void update_fish_descriptor_set(FlockContext* ctx)
 	writeDescrSets[0].dstBinding = 0;
 	writeDescrSets[0].dstArrayElement = 0;
 	writeDescrSets[0].descriptorCount = 1;
-	writeDescrSets[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	writeDescrSets[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
 	writeDescrSets[0].pImageInfo = nullptr;
 	writeDescrSets[0].pBufferInfo = &descriptorBufferInfoMVP;
 	writeDescrSets[0].pTexelBufferView = nullptr;
@@ -387,7 +432,7 @@ static void update_fish_descriptor_set(FlockContext* ctx)
 	writeDescrSets[1].dstBinding = 1;
 	writeDescrSets[1].dstArrayElement = 0;
 	writeDescrSets[1].descriptorCount = 1;
-	writeDescrSets[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	writeDescrSets[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
 	writeDescrSets[1].pImageInfo = nullptr;
 	writeDescrSets[1].pBufferInfo = &descriptorBufferInfoJoints;
 	writeDescrSets[1].pTexelBufferView = nullptr;
@@ -418,8 +463,6 @@ static void update_fish_descriptor_set(FlockContext* ctx)
 
 	ctx->fishPipeData.descrPool = descriptorPool;
 	ctx->fishPipeData.descrSet = descriptorSet;
-	ctx->fishPipeData.ubo = ubo;
-	ctx->fishPipeData.jointMatrices = jointMatrices;
 }
 
 static void build_fish_pipeline(FlockContext* ctx)
@@ -427,17 +470,25 @@ static void build_fish_pipeline(FlockContext* ctx)
 	auto& vkCtx = ctx->vkCtx;
 	auto& windowInfo = ctx->windowInfo;
 	auto& swapChain = ctx->swapChain;
-	Mesh mesh = {};
+	//warm starts map cooked geometry and skip gltf parsing
+	CookedMesh mesh = {};
 	Animation animation = {};
-	animation.playbackRate = 4.f;
-	if(!load_GLTF("resources/fish.gltf", &mesh, &animation))
+	if(!load_GLTF_cached("resources/fish.gltf", "resources/cooked", &mesh) || !read_cooked_animation(mesh, &animation))
 	{
+		close_cooked_mesh(&mesh);
 		return;
 	}
 
+	if(ctx->dualQuatSkinning && !supports_dual_quat_skinning(animation))
+	{
+		magma::log::warn("Fish skeleton has several roots or scales joints below the root, falling back to linear blend skinning");
+		ctx->dualQuatSkinning = false;
+	}
+
 	TextureInfo fishTexture = {};
-	if(!load_texture("resources/fish.png", &fishTexture, false))
+	if(!wait_for_texture(&ctx->textureLoader, ctx->fishTexture, &fishTexture))
 	{
+		close_cooked_mesh(&mesh);
 		return;
 	}
 
@@ -447,14 +498,14 @@ static void build_fish_pipeline(FlockContext* ctx)
 	VkDescriptorSetLayoutBinding layoutBindings[4] = {};
 	//mvp
 	layoutBindings[0].binding = 0;
-	layoutBindings[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	layoutBindings[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
 	layoutBindings[0].descriptorCount = 1;
 	layoutBindings[0].stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
 	layoutBindings[0].pImmutableSamplers = nullptr;
 	
 	//ssbo for joint matrices
 	layoutBindings[1].binding = 1;
-	layoutBindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	layoutBindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
 	layoutBindings[1].descriptorCount = 1;
 	layoutBindings[1].stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
 	layoutBindings[1].pImmutableSamplers = nullptr;
@@ -483,46 +534,28 @@ static void build_fish_pipeline(FlockContext* ctx)
 	VK_CALL(vkCreateDescriptorSetLayout(vkCtx.logicalDevice, &descriptorSetLayoutInfo, nullptr, &descriptorSetLayout));
 
 	//for now store only camera direction vector
-	VkPushConstantRange pushConstantRange = {};
-	pushConstantRange.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
-	pushConstantRange.offset = 0;
-	pushConstantRange.size = sizeof(Vec3);
+	VkPushConstantRange pushConstantRanges[2] = {};
+	pushConstantRanges[0].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+	pushConstantRanges[0].offset = 0;
+	pushConstantRanges[0].size = sizeof(Vec3);
+	//position dequantisation of compact vertices and palette layout
+	pushConstantRanges[1].stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+	pushConstantRanges[1].offset = FISH_DEQUANTISATION_PUSH_OFFSET;
+	pushConstantRanges[1].size = sizeof(FishVertexConstants);
 
 	VkPipelineShaderStageCreateInfo shaderStageCreateInfos[2] = {};
-	shaderStageCreateInfos[0] = fill_shader_stage_ci(vkCtx.logicalDevice, "shaders/spv/fishVert.spv", VK_SHADER_STAGE_VERTEX_BIT);
+	shaderStageCreateInfos[0] = fill_shader_stage_ci(vkCtx.logicalDevice,
+		ctx->dualQuatSkinning ? "shaders/spv/fishVertDQ.spv" : "shaders/spv/fishVert.spv", VK_SHADER_STAGE_VERTEX_BIT
+	);
 	shaderStageCreateInfos[1] = fill_shader_stage_ci(vkCtx.logicalDevice, "shaders/spv/fishFrag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
 
-	VkVertexInputBindingDescription bindingDescription = {};
-	bindingDescription.binding = 0;
-	bindingDescription.stride = sizeof(Vertex);
-	bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
-	
-	VkVertexInputAttributeDescription attribDescriptions[5] = {};
-	//positions
-	attribDescriptions[0].location = 0;
-	attribDescriptions[0].binding = 0;
-	attribDescriptions[0].format = VK_FORMAT_R32G32B32_SFLOAT;
-	attribDescriptions[0].offset = offsetof(Vertex, position);
-	//normals
-	attribDescriptions[1].location = 1;
-	attribDescriptions[1].binding = 0;
-	attribDescriptions[1].format = VK_FORMAT_R32G32B32_SFLOAT;
-	attribDescriptions[1].offset = offsetof(Vertex, normal);
-	//uvs
-	attribDescriptions[2].location = 2;
-	attribDescriptions[2].binding = 0;
-	attribDescriptions[2].format = VK_FORMAT_R32G32_SFLOAT;
-	attribDescriptions[2].offset = offsetof(Vertex, uv);
-
-	attribDescriptions[3].location = 3;
-	attribDescriptions[3].binding = 0;
-	attribDescriptions[3].format = VK_FORMAT_R32G32B32A32_SFLOAT;
-	attribDescriptions[3].offset = offsetof(Vertex, jointIds);
-	
-	attribDescriptions[4].location = 4;
-	attribDescriptions[4].binding = 0;
-	attribDescriptions[4].format = VK_FORMAT_R32G32B32A32_SFLOAT;
-	attribDescriptions[4].offset = offsetof(Vertex, weights);
+	//fish are drawn instanced many times over, so vertices are fetched in compact format
+	CompressedVertexBuffer compactVertices = {};
+	compress_vertices(mesh.vertices, mesh.vertexCount, VERTEX_FORMAT_COMPACT_SKINNED, &compactVertices);
+
+	VkVertexInputBindingDescription bindingDescription = get_vertex_input_binding(compactVertices.format, 0);
+	VkVertexInputAttributeDescription attribDescriptions[VERTEX_MAX_ATTRIBUTES] = {};
+	const uint32_t attribDescriptionCount = get_vertex_input_attributes(compactVertices.format, 0, attribDescriptions);
 
 	VkPipelineVertexInputStateCreateInfo vertexInputStateCreateInfo = {};
 	vertexInputStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
@@ -530,7 +563,7 @@ static void build_fish_pipeline(FlockContext* ctx)
 	vertexInputStateCreateInfo.flags = VK_FLAGS_NONE;
 	vertexInputStateCreateInfo.vertexBindingDescriptionCount = 1;
 	vertexInputStateCreateInfo.pVertexBindingDescriptions = &bindingDescription;
-	vertexInputStateCreateInfo.vertexAttributeDescriptionCount = 5;
+	vertexInputStateCreateInfo.vertexAttributeDescriptionCount = attribDescriptionCount;
 	vertexInputStateCreateInfo.pVertexAttributeDescriptions = attribDescriptions;
 
 
@@ -686,8 +719,8 @@ static void build_fish_pipeline(FlockContext* ctx)
 	pipelineLayoutCreateInfo.flags = VK_FLAGS_NONE;
 	pipelineLayoutCreateInfo.setLayoutCount = 1;
 	pipelineLayoutCreateInfo.pSetLayouts = &descriptorSetLayout;
-	pipelineLayoutCreateInfo.pushConstantRangeCount = 1;
-	pipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
+	pipelineLayoutCreateInfo.pushConstantRangeCount = 2;
+	pipelineLayoutCreateInfo.pPushConstantRanges = pushConstantRanges;
 
 	VkPipelineLayout pipeLayout = VK_NULL_HANDLE;
 	VK_CALL(vkCreatePipelineLayout(vkCtx.logicalDevice, &pipelineLayoutCreateInfo, nullptr, &pipeLayout));
@@ -714,67 +747,42 @@ static void build_fish_pipeline(FlockContext* ctx)
 	VkPipeline pipeline;
 	VK_CALL(vkCreateGraphicsPipelines(vkCtx.logicalDevice, VK_NULL_HANDLE, 1, &pipelineCreateInfo, nullptr, &pipeline));
 
-	//create texture image
-	//1. create staging buffer to copy texture contents to gpu local memory
-	Buffer stagingTextureBuffer = create_buffer(vkCtx,
-		VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT|VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-		fishTexture.numc * fishTexture.extent.width * fishTexture.extent.height
-	);
-
-	VK_CALL(copy_data_to_host_visible_buffer(vkCtx, 0, fishTexture.data, stagingTextureBuffer.bufferSize, &stagingTextureBuffer));
+	//texture, vertices and indices go to device local memory in one transfer batch
+	UploadQueue uploadQueue = {};
+	VK_CHECK(init_upload_queue(vkCtx, DEFAULT_STAGING_ARENA_SIZE, &uploadQueue));
 
-
-	//create image on device local memory to recieve texture data
-	ImageResource textureImage = create_image_resource(
-		vkCtx, fishTexture.extent,
-		fishTexture.format,
-		VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT
-	);
-	
-	//copy texture data to device local memory
-	VkCommandPool cmdPool = create_command_pool(vkCtx);
-	VK_CHECK(push_texture_to_device_local_image(cmdPool, vkCtx, stagingTextureBuffer, fishTexture.extent, &textureImage));
-	destroy_buffer(vkCtx.logicalDevice, &stagingTextureBuffer);
+	ImageResource textureImage = {};
+	VK_CHECK(upload_texture(&uploadQueue, vkCtx, fishTexture, TEXTURE_MIPS_SRGB, &textureImage));
+	release_texture(&ctx->textureLoader, ctx->fishTexture);
 
 	// //create sampler to sample the fish texture
-	VkSampler textureSampler = create_default_sampler(vkCtx.logicalDevice);
+	VkSampler textureSampler = create_default_sampler(vkCtx.logicalDevice, nullptr, textureImage.mipLevels);
 
 	Texture texture = {};
 	texture.imageInfo = textureImage;
 	texture.textureSampler = textureSampler;
 	texture.imageInfo.layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
 
-	//push vertices to device local memory
-	Buffer stagingVertexBuffer = create_buffer(vkCtx,
-		VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT|VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-		mesh.vertexBuffer.size() * sizeof(Vertex)
-	);
+	const VkDeviceSize vertexBufferSize = compactVertices.data.size();
 	Buffer deviceLocalVertexBuffer = create_buffer(vkCtx, 
 		VK_BUFFER_USAGE_VERTEX_BUFFER_BIT|VK_BUFFER_USAGE_TRANSFER_DST_BIT,
 		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-		stagingVertexBuffer.bufferSize);
-	VK_CALL(copy_data_to_host_visible_buffer(vkCtx, 0, mesh.vertexBuffer.data(), stagingVertexBuffer.bufferSize, &stagingVertexBuffer));
-	VK_CHECK(push_data_to_device_local_buffer(cmdPool, vkCtx, stagingVertexBuffer, &deviceLocalVertexBuffer));
-	
-	destroy_buffer(vkCtx.logicalDevice, &stagingVertexBuffer);
-
-	//push indices to device local memory
-	Buffer stagingIndexBuffer = create_buffer(vkCtx,
-		VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT|VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-		mesh.indexBuffer.size() * sizeof(unsigned int)
-	);
+		vertexBufferSize);
+	VK_CHECK(upload_to_buffer(&uploadQueue, vkCtx, compactVertices.data.data(), vertexBufferSize, deviceLocalVertexBuffer, 0,
+		VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT));
 
+	const VkDeviceSize indexBufferSize = mesh.indexCount * sizeof(unsigned int);
 	Buffer deviceLocalIndexBuffer = create_buffer(vkCtx, 
 		VK_BUFFER_USAGE_INDEX_BUFFER_BIT|VK_BUFFER_USAGE_TRANSFER_DST_BIT,
 		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-		stagingIndexBuffer.bufferSize);
-	VK_CALL(copy_data_to_host_visible_buffer(vkCtx, 0, mesh.indexBuffer.data(), stagingIndexBuffer.bufferSize, &stagingIndexBuffer));
-	VK_CHECK(push_data_to_device_local_buffer(cmdPool, vkCtx, stagingIndexBuffer, &deviceLocalIndexBuffer));
-	destroy_buffer(vkCtx.logicalDevice, &stagingIndexBuffer);
-	destroy_command_pool(vkCtx.logicalDevice, cmdPool);
+		indexBufferSize);
+	VK_CHECK(upload_to_buffer(&uploadQueue, vkCtx, mesh.indices, indexBufferSize, deviceLocalIndexBuffer, 0,
+		VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_INDEX_READ_BIT));
+
+	wait_for_upload(&uploadQueue, vkCtx, submit_uploads(&uploadQueue, vkCtx));
+	destroy_upload_queue(vkCtx, &uploadQueue);
+	std::vector<MeshPrimitive> primitives(mesh.primitives, mesh.primitives + mesh.primitiveCount);
+	close_cooked_mesh(&mesh);
 
 	for(auto&& shader : shaderStageCreateInfos)
 	{
@@ -782,7 +790,8 @@ static void build_fish_pipeline(FlockContext* ctx)
 	}
 
 	FishPipeData out = {};
-	ctx->fishPipeData.mesh = mesh;
+	ctx->fishPipeData.primitives = std::move(primitives);
+	ctx->fishPipeData.positionDequantisation = compactVertices.positionDequantisation;
 	ctx->fishPipeData.animation = animation;
 	ctx->fishPipeData.fishTexture = texture;
 	ctx->fishPipeData.pipeLayout = pipeLayout;
@@ -798,6 +807,89 @@ static void build_fish_pipeline(FlockContext* ctx)
 
 }
 
+//moves ownership of buffers the graphics queue holds to the compute queue and waits for it,
+//nothing to do when both queues are of the same family
+static void hand_over_to_compute_queue(const VulkanGlobalContext& vkCtx, VkCommandPool computePool, const Buffer* buffers, uint32_t bufferCount)
+{
+	if(vkCtx.queueFamIdx == vkCtx.computeQueueFamIdx)
+	{
+		return;
+	}
+
+	std::vector<VkBufferMemoryBarrier> barriers(bufferCount);
+	for(uint32_t i = 0; i < bufferCount; i++)
+	{
+		barriers[i].sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+		barriers[i].pNext = nullptr;
+		barriers[i].srcAccessMask = 0;
+		barriers[i].dstAccessMask = 0;
+		barriers[i].srcQueueFamilyIndex = vkCtx.queueFamIdx;
+		barriers[i].dstQueueFamilyIndex = vkCtx.computeQueueFamIdx;
+		barriers[i].buffer = buffers[i].buffer;
+		barriers[i].offset = 0;
+		barriers[i].size = buffers[i].bufferSize;
+	}
+
+	VkCommandPool graphicsPool = create_command_pool(vkCtx);
+	VkCommandBuffer releaseCmd = VK_NULL_HANDLE;
+	create_command_buffer(vkCtx.logicalDevice, graphicsPool, &releaseCmd);
+	VkCommandBuffer acquireCmd = VK_NULL_HANDLE;
+	create_command_buffer(vkCtx.logicalDevice, computePool, &acquireCmd);
+
+	VkCommandBufferBeginInfo beginInfo = {};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+	vkBeginCommandBuffer(releaseCmd, &beginInfo);
+	vkCmdPipelineBarrier(releaseCmd,
+		VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+		VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+		0,
+		0, nullptr,
+		bufferCount, barriers.data(),
+		0, nullptr
+	);
+	vkEndCommandBuffer(releaseCmd);
+
+	vkBeginCommandBuffer(acquireCmd, &beginInfo);
+	vkCmdPipelineBarrier(acquireCmd,
+		VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+		VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+		0,
+		0, nullptr,
+		bufferCount, barriers.data(),
+		0, nullptr
+	);
+	vkEndCommandBuffer(acquireCmd);
+
+	VkSemaphore releaseDone = create_semaphore(vkCtx.logicalDevice);
+	VkFence acquireDone = create_fence(vkCtx.logicalDevice);
+
+	VkSubmitInfo releaseSubmitInfo = {};
+	releaseSubmitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	releaseSubmitInfo.commandBufferCount = 1;
+	releaseSubmitInfo.pCommandBuffers = &releaseCmd;
+	releaseSubmitInfo.signalSemaphoreCount = 1;
+	releaseSubmitInfo.pSignalSemaphores = &releaseDone;
+	VK_CALL(vkQueueSubmit(vkCtx.graphicsQueue, 1, &releaseSubmitInfo, VK_NULL_HANDLE));
+
+	const VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+	VkSubmitInfo acquireSubmitInfo = {};
+	acquireSubmitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	acquireSubmitInfo.waitSemaphoreCount = 1;
+	acquireSubmitInfo.pWaitSemaphores = &releaseDone;
+	acquireSubmitInfo.pWaitDstStageMask = &waitStage;
+	acquireSubmitInfo.commandBufferCount = 1;
+	acquireSubmitInfo.pCommandBuffers = &acquireCmd;
+	VK_CALL(vkQueueSubmit(vkCtx.computeQueue, 1, &acquireSubmitInfo, acquireDone));
+	VK_CALL(vkWaitForFences(vkCtx.logicalDevice, 1, &acquireDone, VK_TRUE, UINT64_MAX));
+
+	vkDestroyFence(vkCtx.logicalDevice, acquireDone, nullptr);
+	vkDestroySemaphore(vkCtx.logicalDevice, releaseDone, nullptr);
+	vkFreeCommandBuffers(vkCtx.logicalDevice, computePool, 1, &acquireCmd);
+	vkDestroyCommandPool(vkCtx.logicalDevice, graphicsPool, nullptr);
+}
+
 static void build_compute_pipeline(FlockContext* ctx)
 {
 	auto&& vkCtx = ctx->vkCtx;
@@ -939,73 +1031,46 @@ static void build_compute_pipeline(FlockContext* ctx)
 	VkCommandPool commandPool = VK_NULL_HANDLE;
 	VK_CALL(vkCreateCommandPool(vkCtx.logicalDevice, &cmdPoolCreateInfo, nullptr, &commandPool));
 
-	Buffer boidsStateStagingBuffer = create_buffer(vkCtx, 
-		VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT|VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-		boidsGlobals.boidsCount * sizeof(BoidTransform));
-
-	VK_CALL(copy_data_to_host_visible_buffer(vkCtx, 0, boidTransforms.data(),
-		boidsGlobals.boidsCount * sizeof(BoidTransform), &boidsStateStagingBuffer)
-	);
-
 	Buffer boidsStateDeviceBuffer = create_buffer(vkCtx,
 		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
 		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
 		boidsGlobals.boidsCount * sizeof(BoidTransform));
 
-	VK_CHECK(push_data_to_device_local_buffer(commandPool, vkCtx, boidsStateStagingBuffer, &boidsStateDeviceBuffer, vkCtx.computeQueue));
-	destroy_buffer(vkCtx.logicalDevice, &boidsStateStagingBuffer);
-
-	Buffer stagingInstanceMatrices = create_buffer(vkCtx,
-		VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT|VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-		boidsGlobals.boidsCount * sizeof(mat4x4)
-	);
-	VK_CALL(copy_data_to_host_visible_buffer(vkCtx, 0, instanceTransforms.data(),
-		boidsGlobals.boidsCount * sizeof(mat4x4), &stagingInstanceMatrices)
-	);
-
 	Buffer instanceMatricesDeviceBuffer = create_buffer(vkCtx,
 		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
 		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
 		boidsGlobals.boidsCount * sizeof(mat4x4));
 
-	VK_CHECK(push_data_to_device_local_buffer(commandPool, vkCtx, stagingInstanceMatrices, &instanceMatricesDeviceBuffer, vkCtx.computeQueue));
-	destroy_buffer(vkCtx.logicalDevice, &stagingInstanceMatrices);
-
-	Buffer stagingSpherePointsBuffer = create_buffer(vkCtx, 
-		VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-		spherePoints.size() * sizeof(Vec4)
-	);
-	VK_CALL(copy_data_to_host_visible_buffer(vkCtx, 0, spherePoints.data(),
-		spherePoints.size() * sizeof(Vec4), &stagingSpherePointsBuffer
-	));
-
 	Buffer deviceSpherePointsBuffer = create_buffer(vkCtx,
 		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
 		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
 		spherePoints.size() * sizeof(Vec4)
 	);
-	VK_CHECK(push_data_to_device_local_buffer(commandPool, vkCtx, stagingSpherePointsBuffer, &deviceSpherePointsBuffer, vkCtx.computeQueue));
-	destroy_buffer(vkCtx.logicalDevice, &stagingSpherePointsBuffer);
-
-	Buffer stagingPlaneUniformBuffer = create_buffer(vkCtx, 
-		VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-		tankPlanes.size() * sizeof(Plane)
-	);
-	VK_CALL(copy_data_to_host_visible_buffer(vkCtx, 0, tankPlanes.data(),
-		stagingPlaneUniformBuffer.bufferSize, &stagingPlaneUniformBuffer
-	));
 
 	Buffer devicePlaneUniformBuffer = create_buffer(vkCtx,
 		VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
 		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-		stagingPlaneUniformBuffer.bufferSize
+		tankPlanes.size() * sizeof(Plane)
 	);
-	VK_CHECK(push_data_to_device_local_buffer(commandPool, vkCtx, stagingPlaneUniformBuffer, &devicePlaneUniformBuffer, vkCtx.computeQueue));
-	destroy_buffer(vkCtx.logicalDevice, &stagingPlaneUniformBuffer);
+
+	//initial simulation state goes out in a single batch, waited on once before the first dispatch
+	UploadQueue uploadQueue = {};
+	VK_CHECK(init_upload_queue(vkCtx, DEFAULT_STAGING_ARENA_SIZE, &uploadQueue));
+	const VkAccessFlags storageAccess = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+	VK_CHECK(upload_to_buffer(&uploadQueue, vkCtx, boidTransforms.data(), boidsStateDeviceBuffer.bufferSize, boidsStateDeviceBuffer, 0,
+		VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, storageAccess));
+	VK_CHECK(upload_to_buffer(&uploadQueue, vkCtx, instanceTransforms.data(), instanceMatricesDeviceBuffer.bufferSize, instanceMatricesDeviceBuffer, 0,
+		VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, storageAccess));
+	VK_CHECK(upload_to_buffer(&uploadQueue, vkCtx, spherePoints.data(), deviceSpherePointsBuffer.bufferSize, deviceSpherePointsBuffer, 0,
+		VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, storageAccess));
+	VK_CHECK(upload_to_buffer(&uploadQueue, vkCtx, tankPlanes.data(), devicePlaneUniformBuffer.bufferSize, devicePlaneUniformBuffer, 0,
+		VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_UNIFORM_READ_BIT));
+	wait_for_upload(&uploadQueue, vkCtx, submit_uploads(&uploadQueue, vkCtx));
+	destroy_upload_queue(vkCtx, &uploadQueue);
+
+	//uploads end up owned by the graphics family
+	const Buffer computeBuffers[] = {boidsStateDeviceBuffer, instanceMatricesDeviceBuffer, deviceSpherePointsBuffer, devicePlaneUniformBuffer};
+	hand_over_to_compute_queue(vkCtx, commandPool, computeBuffers, 4);
 
 	//debugBufferSize = each instance has 2 structures of debugInfo data to describe a single vector ( ),
 	// we have 3 vectors for each instance, hence (* 3)
@@ -1238,7 +1303,7 @@ static void build_debug_pipeline(FlockContext* ctx)
 
 	VkDescriptorSetLayoutBinding descrSetLayoutBinding = {};
 	descrSetLayoutBinding.binding = 0;
-	descrSetLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	descrSetLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
 	descrSetLayoutBinding.descriptorCount = 1;
 	descrSetLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
 	descrSetLayoutBinding.pImmutableSamplers = nullptr;
@@ -1276,7 +1341,7 @@ static void build_debug_pipeline(FlockContext* ctx)
 
 
 	VkDescriptorPoolSize descrPoolSize = {};
-	descrPoolSize.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	descrPoolSize.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
 	descrPoolSize.descriptorCount = 1; 
 
 	VkDescriptorPoolCreateInfo descrPoolCreateInfo = {};
@@ -1298,9 +1363,9 @@ static void build_debug_pipeline(FlockContext* ctx)
 	VK_CALL(vkAllocateDescriptorSets(vkCtx.logicalDevice, &descrAllocateInfo, &descrSet));
 
 	VkDescriptorBufferInfo uboBufferInfo = {};
-	uboBufferInfo.buffer = ctx->fishPipeData.ubo.buffer;
+	uboBufferInfo.buffer = ctx->frameRing.buffer.buffer;
 	uboBufferInfo.offset = 0;
-	uboBufferInfo.range = ctx->fishPipeData.ubo.bufferSize;
+	uboBufferInfo.range = TRANSFORM_UBO_SIZE;
 
 	VkWriteDescriptorSet uboWriteDescrSet = {};
 	uboWriteDescrSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
@@ -1308,7 +1373,7 @@ static void build_debug_pipeline(FlockContext* ctx)
 	uboWriteDescrSet.dstBinding = 0;
 	uboWriteDescrSet.dstArrayElement = 0;
 	uboWriteDescrSet.descriptorCount = 1;
-	uboWriteDescrSet.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	uboWriteDescrSet.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
 	uboWriteDescrSet.pImageInfo = nullptr;
 	uboWriteDescrSet.pBufferInfo = &uboBufferInfo;
 	uboWriteDescrSet.pTexelBufferView = nullptr;
@@ -1318,23 +1383,18 @@ static void build_debug_pipeline(FlockContext* ctx)
 
 	std::array<DebugInfo, 25> planes = generate_tank_borders();
 	
-	Buffer hostTankBuffer = create_buffer(vkCtx, 
-		VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-		planes.size() * sizeof(DebugInfo)
-	);
-	VK_CALL(copy_data_to_host_visible_buffer(vkCtx, 0, planes.data(), hostTankBuffer.bufferSize, &hostTankBuffer));
-	
 	Buffer deviceTankBuffer = create_buffer(vkCtx, 
 		VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
 		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-		hostTankBuffer.bufferSize
+		planes.size() * sizeof(DebugInfo)
 	);
 
-	VkCommandPool cmdPool = create_command_pool(vkCtx);
-	VK_CHECK(push_data_to_device_local_buffer(cmdPool, vkCtx, hostTankBuffer, &deviceTankBuffer));
-	destroy_buffer(vkCtx.logicalDevice, &hostTankBuffer);
-	vkDestroyCommandPool(vkCtx.logicalDevice, cmdPool, nullptr);
+	UploadQueue uploadQueue = {};
+	VK_CHECK(init_upload_queue(vkCtx, DEFAULT_STAGING_ARENA_SIZE, &uploadQueue));
+	VK_CHECK(upload_to_buffer(&uploadQueue, vkCtx, planes.data(), deviceTankBuffer.bufferSize, deviceTankBuffer, 0,
+		VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT));
+	wait_for_upload(&uploadQueue, vkCtx, submit_uploads(&uploadQueue, vkCtx));
+	destroy_upload_queue(vkCtx, &uploadQueue);
 	
 	for(auto&& shader : shaderStageCreateInfos)
 	{
@@ -1412,7 +1472,7 @@ static bool build_skybox_pipeline(FlockContext* ctx)
 
 	std::array<VkDescriptorSetLayoutBinding, 2> descrSetLayoutBinding = {};
 	descrSetLayoutBinding[0].binding = 0;
-	descrSetLayoutBinding[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	descrSetLayoutBinding[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
 	descrSetLayoutBinding[0].descriptorCount = 1;
 	descrSetLayoutBinding[0].stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
 	descrSetLayoutBinding[0].pImmutableSamplers = nullptr;
@@ -1497,105 +1557,107 @@ static bool build_skybox_pipeline(FlockContext* ctx)
 		3,7,4
 	};
 
-	//transfer cube geom to gpu
-	Buffer vertexBuffer = create_buffer(
-		vkCtx, 
-		VK_BUFFER_USAGE_TRANSFER_SRC_BIT, 
-		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT|VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-		cubeVertices.size() * sizeof(Vec3)
-	);
-
-	VK_CALL(copy_data_to_host_visible_buffer(vkCtx, 0, cubeVertices.data(), vertexBuffer.bufferSize, &vertexBuffer));
+	//cube geometry and the cubemap are staged through one arena, however big the faces are
+	UploadQueue uploadQueue = {};
+	VK_CHECK(init_upload_queue(vkCtx, DEFAULT_STAGING_ARENA_SIZE, &uploadQueue));
 
 	Buffer gpuVertexBuffer = create_buffer(
 		vkCtx,
 		VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
 		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-		vertexBuffer.bufferSize
-	);
-	auto cmdPool = create_command_pool(vkCtx);
-	VK_CHECK(push_data_to_device_local_buffer(cmdPool, vkCtx, vertexBuffer, &gpuVertexBuffer));
-	destroy_buffer(vkCtx.logicalDevice, &vertexBuffer);
-
-	//transfer cube geom indices to gpu
-	Buffer indexBuffer = create_buffer(
-		vkCtx, 
-		VK_BUFFER_USAGE_TRANSFER_SRC_BIT, 
-		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT|VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-		indices.size() * sizeof(std::uint32_t)
+		cubeVertices.size() * sizeof(Vec3)
 	);
-
-	VK_CALL(copy_data_to_host_visible_buffer(vkCtx, 0, indices.data(), indexBuffer.bufferSize, &indexBuffer));
-
 	Buffer gpuIndexBuffer = create_buffer(
 		vkCtx,
 		VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
 		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-		indexBuffer.bufferSize
+		indices.size() * sizeof(std::uint32_t)
 	);
 
-	VK_CHECK(push_data_to_device_local_buffer(cmdPool, vkCtx, indexBuffer, &gpuIndexBuffer));
-	destroy_buffer(vkCtx.logicalDevice, &indexBuffer);
-
-	VkSampler sampler = create_default_sampler(vkCtx.logicalDevice);
-
-	bool planesAreLoaded = true;
-	std::array<TextureInfo, 6> textures = {};
-	std::array<const char*, 6> planes = 
+	//every failure below drops what was created so far, uploads in flight are waited on first
+	auto destroy_partial_skybox = [&]()
 	{
-		"resources/negx.png",
-		"resources/posx.png",
-		"resources/negy.png",
-		"resources/posy.png",
-		"resources/negz.png",
-		"resources/posz.png",
+		destroy_upload_queue(vkCtx, &uploadQueue);
+		destroy_buffer(vkCtx.logicalDevice, &gpuIndexBuffer);
+		destroy_buffer(vkCtx.logicalDevice, &gpuVertexBuffer);
+		vkDestroyPipeline(vkCtx.logicalDevice, graphicsPipe, nullptr);
+		vkDestroyPipelineLayout(vkCtx.logicalDevice, pipeLayout, nullptr);
+		vkDestroyDescriptorSetLayout(vkCtx.logicalDevice, descrSetLayout, nullptr);
+		for(auto&& shader : shaderStageInfos)
+		{
+			vkDestroyShaderModule(vkCtx.logicalDevice, shader.module, nullptr);
+		}
+		for(uint32_t i = 0; i < ctx->skyboxFaces.size(); i++)
+		{
+			release_texture(&ctx->textureLoader, ctx->skyboxFaces[i]);
+		}
 	};
 
-	planesAreLoaded &= load_texture(planes[0], &textures[0]);
+	if(!upload_to_buffer(&uploadQueue, vkCtx, cubeVertices.data(), gpuVertexBuffer.bufferSize, gpuVertexBuffer, 0,
+			VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT)
+		|| !upload_to_buffer(&uploadQueue, vkCtx, indices.data(), gpuIndexBuffer.bufferSize, gpuIndexBuffer, 0,
+			VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_INDEX_READ_BIT))
+	{
+		destroy_partial_skybox();
+		return false;
+	}
 
-	const std::size_t planeStride = textures[0].extent.width * textures[0].extent.height * textures[0].numc;
-	const std::size_t cubemapSize = textures.size() * planeStride;
+	//faces were decoded in parallel since startup, each of them exactly once
+	std::array<TextureInfo, 6> textures = {};
+	for(uint32_t i = 0; i < textures.size(); i++)
+	{
+		if(!wait_for_texture(&ctx->textureLoader, ctx->skyboxFaces[i], &textures[i]))
+		{
+			destroy_partial_skybox();
+			return false;
+		}
+	}
 
-	std::vector<uint8_t> hostPtr = {};
-	hostPtr.resize(cubemapSize);
-	uint8_t* dstPtr = hostPtr.data();
-	
 	VkExtent3D planeExtent = textures[0].extent;
-	
-	for(uint32_t i = 0; i < planes.size(); i++)
+	for(uint32_t i = 0; i < textures.size(); i++)
 	{
-		planesAreLoaded &= load_texture(planes[i], &textures[i], false);
-		memcpy(dstPtr, textures[i].data, planeStride);
-		dstPtr += planeStride;
+		if(textures[i].extent.width != planeExtent.width || textures[i].extent.height != planeExtent.height)
+		{
+			magma::log::error("Skybox face {} doesn't match size of the first one", SKYBOX_FACES[i]);
+			destroy_partial_skybox();
+			return false;
+		}
 	}
 
-	if(!planesAreLoaded)
+	//mips of every face are filtered in linear space, faces are packed one after another
+	MipChain cubemapMips = {};
+	generate_mip_chain(textures.data(), textures.size(), MIP_FILTER_KAISER, MIP_COLOR_SRGB, &cubemapMips);
+	for(uint32_t i = 0; i < textures.size(); i++)
 	{
-		return false;
+		release_texture(&ctx->textureLoader, ctx->skyboxFaces[i]);
 	}
 
-	//creating big-ass staging buffer
-	Buffer stagingCubeMapBuffer = create_buffer(
-		vkCtx, 
-		VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-		VK_MEMORY_PROPERTY_HOST_COHERENT_BIT|VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
-		cubemapSize
-	);
-	VK_CALL(copy_data_to_host_visible_buffer(vkCtx, 0, hostPtr.data(), cubemapSize, &stagingCubeMapBuffer));
-
 	// createResourceImage
+	const uint32_t mipLevels = static_cast<uint32_t>(cubemapMips.levelOffsets.size());
 	ImageResource cubemapGpuImage = create_cubemap_image(
 		vkCtx,
-		textures[0].extent, textures[0].format,
-		VK_IMAGE_USAGE_SAMPLED_BIT|VK_IMAGE_USAGE_TRANSFER_DST_BIT
+		planeExtent, cubemapMips.format,
+		VK_IMAGE_USAGE_SAMPLED_BIT|VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+		VK_IMAGE_LAYOUT_UNDEFINED, mipLevels
 	);
-	VK_CHECK(push_cubemap_to_device_local_image(cmdPool, vkCtx, stagingCubeMapBuffer, planeExtent, planeStride, &cubemapGpuImage));
-	destroy_buffer(vkCtx.logicalDevice, &stagingCubeMapBuffer);
-	vkDestroyCommandPool(vkCtx.logicalDevice, cmdPool, nullptr);
+	std::vector<VkBufferImageCopy> cubemapRegions;
+	fill_mip_chain_regions(planeExtent, cubemapMips.levelOffsets.data(), cubemapMips.layerStride, cubemapGpuImage, &cubemapRegions);
+	if(!upload_to_image(&uploadQueue, vkCtx, cubemapMips.data.data(), cubemapMips.data.size(),
+		cubemapRegions.data(), static_cast<uint32_t>(cubemapRegions.size()), &cubemapGpuImage))
+	{
+		//faces were released already, releasing them again is a no-op
+		destroy_partial_skybox();
+		destroy_image_resource(vkCtx.logicalDevice, &cubemapGpuImage);
+		return false;
+	}
+	VkSampler sampler = create_default_sampler(vkCtx.logicalDevice, nullptr, mipLevels);
+
+	wait_for_upload(&uploadQueue, vkCtx, submit_uploads(&uploadQueue, vkCtx));
+	destroy_upload_queue(vkCtx, &uploadQueue);
 
 	//updating descriptor sets
 	std::array<VkDescriptorPoolSize, 2> descrPoolSizes = {};
-	descrPoolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	descrPoolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
 	descrPoolSizes[0].descriptorCount = 1;
 	descrPoolSizes[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
 	descrPoolSizes[1].descriptorCount = 1;
@@ -1619,8 +1681,8 @@ static bool build_skybox_pipeline(FlockContext* ctx)
 	VK_CALL(vkAllocateDescriptorSets(vkCtx.logicalDevice, &descrSetAllocInfo, &descrSet));
 	
 	VkDescriptorBufferInfo uboDescrBufferInfo = {};
-	uboDescrBufferInfo.buffer = ctx->fishPipeData.ubo.buffer;
-	uboDescrBufferInfo.range = ctx->fishPipeData.ubo.bufferSize;
+	uboDescrBufferInfo.buffer = ctx->frameRing.buffer.buffer;
+	uboDescrBufferInfo.range = TRANSFORM_UBO_SIZE;
 	
 	std::array<VkWriteDescriptorSet, 2> writeDescrSets = {};
 	writeDescrSets[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
@@ -1628,7 +1690,7 @@ static bool build_skybox_pipeline(FlockContext* ctx)
 	writeDescrSets[0].dstBinding = 0;
 	writeDescrSets[0].dstArrayElement = 0;
 	writeDescrSets[0].descriptorCount = 1;
-	writeDescrSets[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	writeDescrSets[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
 	writeDescrSets[0].pBufferInfo = &uboDescrBufferInfo;
 
 	VkDescriptorImageInfo descrImageInfo = {};
@@ -1758,8 +1820,7 @@ static void destroy_flock_context(FlockContext* ctx)
 	vkDestroyDescriptorPool(vkCtx.logicalDevice, ctx->fishPipeData.descrPool, nullptr);
 	destroy_buffer(vkCtx.logicalDevice, &ctx->fishPipeData.vertexBuffer);
 	destroy_buffer(vkCtx.logicalDevice, &ctx->fishPipeData.indexBuffer);
-	destroy_buffer(vkCtx.logicalDevice, &ctx->fishPipeData.ubo);
-	destroy_buffer(vkCtx.logicalDevice, &ctx->fishPipeData.jointMatrices);
+	destroy_frame_ring_buffer(vkCtx.logicalDevice, &ctx->frameRing);
 
 	vkDestroyPipelineLayout(vkCtx.logicalDevice, ctx->computePipeData.pipelineLayout, nullptr);
 	vkDestroyPipeline(vkCtx.logicalDevice, ctx->computePipeData.pipeline, nullptr);
@@ -1875,19 +1936,30 @@ static void record_graphics_command_buffer(FlockContext* ctx, const FPSCamera& c
 
 	vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
 		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, ctx->fishPipeData.fishPipeline);
-		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, ctx->fishPipeData.pipeLayout, 0, 1, &ctx->fishPipeData.descrSet, 0, nullptr);
+		const uint32_t fishDynamicOffsets[2] = {ctx->fishPipeData.uboOffset, ctx->fishPipeData.jointsOffset};
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, ctx->fishPipeData.pipeLayout, 0, 1, &ctx->fishPipeData.descrSet, 2, fishDynamicOffsets);
 		vkCmdSetViewport(commandBuffer, 0, 1, &ctx->fishPipeData.viewport);
 		vkCmdPushConstants(commandBuffer, ctx->fishPipeData.pipeLayout, VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(Vec3), &camera.direction);
+		FishVertexConstants fishConstants = {};
+		fishConstants.positionDequantisation = ctx->fishPipeData.positionDequantisation;
+		fishConstants.paletteJointCount = static_cast<uint32_t>(ctx->fishPipeData.animation.bindPose.size());
+		fishConstants.animationVariantCount = FISH_ANIMATION_VARIANTS;
+		vkCmdPushConstants(commandBuffer, ctx->fishPipeData.pipeLayout, VK_SHADER_STAGE_VERTEX_BIT,
+			FISH_DEQUANTISATION_PUSH_OFFSET, sizeof(FishVertexConstants), &fishConstants
+		);
 		
 		VkDeviceSize offset = 0;
 		vkCmdBindVertexBuffers(commandBuffer, 0, 1, &ctx->fishPipeData.vertexBuffer.buffer, &offset);
 		vkCmdBindIndexBuffer(commandBuffer, ctx->fishPipeData.indexBuffer.buffer, offset, VK_INDEX_TYPE_UINT32);
-		vkCmdDrawIndexed(commandBuffer, ctx->fishPipeData.mesh.indexBuffer.size(), boidsGlobals.boidsCount, 0, 0, 0); 
+		for(const MeshPrimitive& primitive : ctx->fishPipeData.primitives)
+		{
+			vkCmdDrawIndexed(commandBuffer, primitive.indexCount, boidsGlobals.boidsCount, primitive.firstIndex, primitive.vertexOffset, 0);
+		}
 		
 		//debug commands
 		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, ctx->debugPipeData.pipeline);
 		vkCmdSetLineWidth(commandBuffer, 5.f);
-		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, ctx->debugPipeData.pipelineLayout, 0, 1, &ctx->debugPipeData.descrSet, 0, nullptr);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, ctx->debugPipeData.pipelineLayout, 0, 1, &ctx->debugPipeData.descrSet, 1, &ctx->fishPipeData.uboOffset);
 		vkCmdBindVertexBuffers(commandBuffer, 0, 1, &ctx->computePipeData.debugBuffer.buffer, &offset);
 		vkCmdDraw(commandBuffer, ctx->computePipeData.debugVertexCount, boidsGlobals.boidsCount, 0, 0);
 		vkCmdBindVertexBuffers(commandBuffer, 0, 1, &ctx->debugPipeData.tankBuffer.buffer, &offset);
@@ -1896,7 +1968,7 @@ static void record_graphics_command_buffer(FlockContext* ctx, const FPSCamera& c
 		// skybox commands
 		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, ctx->skyboxPipeData.pipeline);
 		// vkCmdSetViewport(commandBuffer, 0, 1, &pipeState.viewport);
-		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, ctx->skyboxPipeData.pipeLayout, 0, 1, &ctx->skyboxPipeData.descrSet, 0, nullptr);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, ctx->skyboxPipeData.pipeLayout, 0, 1, &ctx->skyboxPipeData.descrSet, 1, &ctx->fishPipeData.uboOffset);
 		vkCmdBindVertexBuffers(commandBuffer, 0, 1, &ctx->skyboxPipeData.gpuVertexBuffer.buffer, &offset);
 		vkCmdBindIndexBuffer(commandBuffer, ctx->skyboxPipeData.gpuIndexBuffer.buffer, offset, VK_INDEX_TYPE_UINT32);
 		vkCmdDrawIndexed(commandBuffer, ctx->skyboxPipeData.indices.size(), 1, 0, 0, 0);
@@ -2050,12 +2122,30 @@ static void record_compute_command_buffer(FlockContext* ctx)
 int main(int argc, char** argv)
 {
 	
+	JobSystem jobSystem = {};
+	init_job_system(JOB_SYSTEM_DEFAULT_WORKERS, &jobSystem);
+
 	FlockContext ctx = {};
+	for(int i = 1; i < argc; i++)
+	{
+		if(strcmp(argv[i], "--dual-quat") == 0)
+		{
+			ctx.dualQuatSkinning = true;
+		}
+	}
+	init_texture_loader(&jobSystem, &ctx.textureLoader);
+	ctx.fishTexture = load_texture_async(&ctx.textureLoader, "resources/fish.png", false);
+	for(uint32_t i = 0; i < SKYBOX_FACES.size(); i++)
+	{
+		ctx.skyboxFaces[i] = load_texture_async(&ctx.textureLoader, SKYBOX_FACES[i], false);
+	}
+
 	init_flock_context(&ctx);
 	build_compute_pipeline(&ctx);
 	build_fish_pipeline(&ctx);
 	build_debug_pipeline(&ctx);
 	build_skybox_pipeline(&ctx);
+	destroy_texture_loader(&ctx.textureLoader);
 	create_frame_buffers(&ctx);
 	allocate_command_buffers(&ctx);
 
@@ -2070,9 +2160,18 @@ int main(int argc, char** argv)
 
 	HostTimer timer = {};
 	timer.start();
-	
-	std::vector<mat4x4> jointMats = {};
-	jointMats.resize(ctx.fishPipeData.animation.bindPose.size());
+
+	const Animation& fishAnimation = ctx.fishPipeData.animation;
+	std::vector<AnimationInstance> fishAnimations(FISH_ANIMATION_VARIANTS);
+	for(uint32_t i = 0; i < FISH_ANIMATION_VARIANTS; i++)
+	{
+		init_animation_instance(fishAnimation, 0, 3.f + 2.f * i / FISH_ANIMATION_VARIANTS, &fishAnimations[i]);
+		fishAnimations[i].currentAnimTime = fishAnimation.clips[0].duration * i / FISH_ANIMATION_VARIANTS;
+	}
+	const std::size_t jointCount = fishAnimation.bindPose.size();
+	const std::size_t paletteSize = get_fish_palette_size(jointCount, ctx.dualQuatSkinning);
+	//dual quaternions are converted from matrix palettes of the batch
+	std::vector<mat4x4> fishJointMatrices(ctx.dualQuatSkinning ? FISH_ANIMATION_VARIANTS * jointCount : 0);
 	int width = ctx.windowInfo.windowExtent.width;
 	int height = ctx.windowInfo.windowExtent.height;
 
@@ -2145,14 +2244,33 @@ int main(int argc, char** argv)
 			VK_NULL_HANDLE, &imageIndex
 		));
 
-		VkDeviceSize uboMVPBufferOffset = imageIndex * sizeof(Transform);
-		VK_CALL(copy_data_to_host_visible_buffer(ctx.vkCtx, uboMVPBufferOffset, &mvp, sizeof(Transform), &ctx.fishPipeData.ubo));
-
-		update_animation(ctx.fishPipeData.animation, deltaSec, jointMats);
-		
-		VkDeviceSize uboJointBufferOffset = imageIndex * sizeof(mat4x4) * jointMats.size();
-		VK_CALL(copy_data_to_host_visible_buffer(ctx.vkCtx, uboJointBufferOffset, jointMats.data(), sizeof(mat4x4) * jointMats.size(), &ctx.fishPipeData.jointMatrices));
+		//partition of the frame that last waited on this fence is free again
+		begin_ring_frame(&ctx.frameRing);
+		RingAllocation mvpAllocation = {};
+		RingAllocation paletteAllocation = {};
+		VK_CHECK(allocate_from_ring(&ctx.frameRing, sizeof(Transform), &mvpAllocation));
+		VK_CHECK(allocate_from_ring(&ctx.frameRing, FISH_ANIMATION_VARIANTS * paletteSize, &paletteAllocation));
+		memcpy(mvpAllocation.data, &mvp, sizeof(Transform));
+		ctx.fishPipeData.uboOffset = mvpAllocation.offset;
+		ctx.fishPipeData.jointsOffset = paletteAllocation.offset;
+
+		//every variant is updated in one batch, matrix palettes go straight into the ring
+		uint8_t* imageJointPalette = static_cast<uint8_t*>(paletteAllocation.data);
+		if(ctx.dualQuatSkinning)
+		{
+			update_animations_batch(&jobSystem, fishAnimations.data(), FISH_ANIMATION_VARIANTS, deltaSec, fishJointMatrices.data(), jointCount);
+			for(uint32_t i = 0; i < FISH_ANIMATION_VARIANTS; i++)
+			{
+				DualQuatSkinningSpace* skinningSpace = reinterpret_cast<DualQuatSkinningSpace*>(imageJointPalette + i * paletteSize);
+				convert_palette_to_dual_quats(fishAnimation, &fishJointMatrices[i * jointCount], skinningSpace, reinterpret_cast<DualQuat*>(skinningSpace + 1));
+			}
+		}
+		else
+		{
+			update_animations_batch(&jobSystem, fishAnimations.data(), FISH_ANIMATION_VARIANTS, deltaSec, reinterpret_cast<mat4x4*>(imageJointPalette), jointCount);
+		}
 
+		VK_CALL(flush_ring_frame(vkCtx, &ctx.frameRing));
 		record_graphics_command_buffer(&ctx, camera, imageIndex);
 		
 		VkSemaphore graphicsWaitSemaphores[2] = {computeFinishedSemaphore, imageAvailableSemaphores[syncIndex]};
@@ -2198,6 +2316,7 @@ int main(int argc, char** argv)
 	vkDestroyFence(vkCtx.logicalDevice, computeFinishedFence, nullptr);
 	vkDestroySemaphore(vkCtx.logicalDevice, computeMayStartSemaphore, nullptr);
 	vkDestroySemaphore(vkCtx.logicalDevice, computeFinishedSemaphore, nullptr);
+	destroy_job_system(&jobSystem);
 	
 	destroy_flock_context(&ctx);
 	
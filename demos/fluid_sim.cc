@@ -270,23 +270,24 @@ static bool initialise_fluid_textures(FluidContext* ctx)
 	hostBuffer.resize(ctx->window.windowExtent.width * ctx->window.windowExtent.height * numc * sizeof(float));
 	std::memset(hostBuffer.data(), 0, hostBuffer.size());
 
-	Buffer stagingBuffer = create_buffer(
-		ctx->vkCtx,
-		VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-		hostBuffer.size()
-	);
-
-	copy_data_to_host_visible_buffer(ctx->vkCtx, 0, hostBuffer.data(), hostBuffer.size(), &stagingBuffer);
-
-	auto tmpCmdPool = create_command_pool(ctx->vkCtx);
+	//every texture reads the same zeroes, staged through a fixed size arena
+	VkBufferImageCopy region = {};
+	region.bufferOffset = 0;
+	region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	region.imageSubresource.mipLevel = 0;
+	region.imageSubresource.baseArrayLayer = 0;
+	region.imageSubresource.layerCount = 1;
+	region.imageOffset = {0, 0, 0};
+	region.imageExtent = textureSize;
+
+	UploadQueue uploadQueue = {};
+	VK_CHECK(init_upload_queue(ctx->vkCtx, DEFAULT_STAGING_ARENA_SIZE, &uploadQueue));
 	for(auto&& texture : ctx->simTextures)
 	{
-		push_texture_to_device_local_image(tmpCmdPool, ctx->vkCtx, stagingBuffer, textureSize, &texture);
+		VK_CHECK(upload_to_image(&uploadQueue, ctx->vkCtx, hostBuffer.data(), hostBuffer.size(), &region, 1, &texture));
 	}
-	vkDestroyCommandPool(ctx->vkCtx.logicalDevice, tmpCmdPool, nullptr);
-
-	destroy_buffer(ctx->vkCtx.logicalDevice, &stagingBuffer);
+	wait_for_upload(&uploadQueue, ctx->vkCtx, submit_uploads(&uploadQueue, ctx->vkCtx));
+	destroy_upload_queue(ctx->vkCtx, &uploadQueue);
 		
 	bool status = false;
 		
@@ -302,17 +303,16 @@ static bool initialise_fluid_textures(FluidContext* ctx)
 		VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT
 	);
 
-	Buffer stagingTextureBuffer = create_buffer(
-		ctx->vkCtx,
-		VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-		textureByteSize 
-	);
-
-	copy_data_to_host_visible_buffer(ctx->vkCtx, 0, girlTexture.data, textureByteSize, &stagingTextureBuffer);
+	//picture has to be on the device before it is blitted into the first color texture
+	VkBufferImageCopy girlRegion = region;
+	girlRegion.imageExtent = girlTexture.extent;
+	UploadQueue pictureUploadQueue = {};
+	VK_CHECK(init_upload_queue(ctx->vkCtx, DEFAULT_STAGING_ARENA_SIZE, &pictureUploadQueue));
+	VK_CHECK(upload_to_image(&pictureUploadQueue, ctx->vkCtx, girlTexture.data, textureByteSize, &girlRegion, 1, &deviceGirlTexture));
+	wait_for_upload(&pictureUploadQueue, ctx->vkCtx, submit_uploads(&pictureUploadQueue, ctx->vkCtx));
+	destroy_upload_queue(ctx->vkCtx, &pictureUploadQueue);
 		
 	auto tmpBlitPool = create_command_pool(ctx->vkCtx);
-	push_texture_to_device_local_image(tmpBlitPool, ctx->vkCtx, stagingTextureBuffer, girlTexture.extent, &deviceGirlTexture);
 	auto cmdBuffer = begin_tmp_commands(ctx->vkCtx, tmpBlitPool);
 
 	VkImageSubresourceLayers layers = {};
@@ -392,7 +392,6 @@ static bool initialise_fluid_textures(FluidContext* ctx)
 	);
 
 	end_tmp_commands(ctx->vkCtx, tmpBlitPool, cmdBuffer);
-	destroy_buffer(ctx->vkCtx.logicalDevice, &stagingTextureBuffer);
 	destroy_image_resource(ctx->vkCtx.logicalDevice, &deviceGirlTexture);
 #endif
 	return status;
@@ -463,47 +462,27 @@ static void init_vertex_and_index_buffers(FluidContext* ctx)
 	};
 	const std::size_t vertexBufferSize = cubeVerts.size() * sizeof(Vec3);
 	const std::size_t indexBufferSize = indicies.size() * sizeof(std::uint32_t);
-	auto stagingVertexBuffer = create_buffer(
-		ctx->vkCtx,
-		VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-		vertexBufferSize
-	);
-	copy_data_to_host_visible_buffer(ctx->vkCtx, 0, cubeVerts.data(), vertexBufferSize, &stagingVertexBuffer);
-	
 	ctx->deviceVertexBuffer = create_buffer(
 		ctx->vkCtx,
 		VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
 		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
 		vertexBufferSize
 	);
-
-	VkCommandPoolCreateInfo commandPoolCI = {};
-	commandPoolCI.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
-	commandPoolCI.pNext = nullptr;
-	commandPoolCI.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
-	commandPoolCI.queueFamilyIndex = ctx->vkCtx.queueFamIdx;
-	VkCommandPool cmdPool = VK_NULL_HANDLE;
-	vkCreateCommandPool(ctx->vkCtx.logicalDevice, &commandPoolCI, nullptr, &cmdPool);
-	push_data_to_device_local_buffer(cmdPool, ctx->vkCtx, stagingVertexBuffer, &ctx->deviceVertexBuffer, ctx->vkCtx.graphicsQueue);
-	auto stagingIndexBuffer = create_buffer(
-		ctx->vkCtx,
-		VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-		indexBufferSize
-	);
-	copy_data_to_host_visible_buffer(ctx->vkCtx, 0, indicies.data(), indexBufferSize, &stagingIndexBuffer);
-	
 	ctx->deviceIndexBuffer = create_buffer(
 		ctx->vkCtx,
 		VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
 		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
 		indexBufferSize
 	);
-	push_data_to_device_local_buffer(cmdPool, ctx->vkCtx, stagingIndexBuffer, &ctx->deviceIndexBuffer, ctx->vkCtx.graphicsQueue);
-	destroy_buffer(ctx->vkCtx.logicalDevice, &stagingVertexBuffer);
-	destroy_buffer(ctx->vkCtx.logicalDevice, &stagingIndexBuffer);
-	destroy_command_pool(ctx->vkCtx.logicalDevice, cmdPool);
+
+	UploadQueue uploadQueue = {};
+	VK_CHECK(init_upload_queue(ctx->vkCtx, DEFAULT_STAGING_ARENA_SIZE, &uploadQueue));
+	VK_CHECK(upload_to_buffer(&uploadQueue, ctx->vkCtx, cubeVerts.data(), vertexBufferSize, ctx->deviceVertexBuffer, 0,
+		VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT));
+	VK_CHECK(upload_to_buffer(&uploadQueue, ctx->vkCtx, indicies.data(), indexBufferSize, ctx->deviceIndexBuffer, 0,
+		VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_INDEX_READ_BIT));
+	wait_for_upload(&uploadQueue, ctx->vkCtx, submit_uploads(&uploadQueue, ctx->vkCtx));
+	destroy_upload_queue(ctx->vkCtx, &uploadQueue);
 }
 
 static VkPipeline create_advect_pipeline(FluidContext* ctx,
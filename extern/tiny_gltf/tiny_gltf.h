@@ -1379,6 +1379,17 @@ class TinyGLTF {
     return store_original_json_for_extras_and_extensions_;
   }
 
+  ///
+  /// Leave Buffer::data of the embedded GLB binary chunk empty instead of
+  /// copying it. The chunk has to be read from the memory passed to
+  /// LoadBinaryFromMemory, which must outlive its use.
+  ///
+  void SetSkipBinaryChunkCopy(const bool enabled) {
+    skip_binary_chunk_copy_ = enabled;
+  }
+
+  bool GetSkipBinaryChunkCopy() const { return skip_binary_chunk_copy_; }
+
  private:
   ///
   /// Loads glTF asset from string(memory).
@@ -1398,6 +1409,8 @@ class TinyGLTF {
 
   bool store_original_json_for_extras_and_extensions_ = false;
 
+  bool skip_binary_chunk_copy_ = false;
+
   FsCallbacks fs = {
 #ifndef TINYGLTF_NO_FS
       &tinygltf::FileExists, &tinygltf::ExpandFilePath,
@@ -3953,7 +3966,8 @@ static bool ParseBuffer(Buffer *buffer, std::string *err, const json &o,
                         FsCallbacks *fs, const std::string &basedir,
                         bool is_binary = false,
                         const unsigned char *bin_data = nullptr,
-                        size_t bin_size = 0) {
+                        size_t bin_size = 0,
+                        bool copy_bin_data = true) {
   size_t byteLength;
   if (!ParseUnsignedProperty(&byteLength, err, o, "byteLength", true,
                              "Buffer")) {
@@ -4026,8 +4040,11 @@ static bool ParseBuffer(Buffer *buffer, std::string *err, const json &o,
       }
 
       // Read buffer data
-      buffer->data.resize(static_cast<size_t>(byteLength));
-      memcpy(&(buffer->data.at(0)), bin_data, static_cast<size_t>(byteLength));
+      if (copy_bin_data && byteLength > 0) {
+        buffer->data.resize(static_cast<size_t>(byteLength));
+        memcpy(&(buffer->data.at(0)), bin_data,
+               static_cast<size_t>(byteLength));
+      }
     }
 
   } else {
@@ -5578,7 +5595,8 @@ bool TinyGLTF::LoadFromString(Model *model, std::string *err, std::string *warn,
       Buffer buffer;
       if (!ParseBuffer(&buffer, err, o,
                        store_original_json_for_extras_and_extensions_, &fs,
-                       base_dir, is_binary_, bin_data_, bin_size_)) {
+                       base_dir, is_binary_, bin_data_, bin_size_,
+                       !skip_binary_chunk_copy_)) {
         return false;
       }
 
@@ -5862,9 +5880,14 @@ bool TinyGLTF::LoadFromString(Model *model, std::string *err, std::string *warn,
           }
           return false;
         }
+        // embedded binary chunk may have been left in the caller's memory
+        const unsigned char *bufferData =
+            (buffer.data.empty() && buffer.uri.empty() && is_binary_)
+                ? bin_data_
+                : buffer.data.data();
         bool ret = LoadImageData(
             &image, idx, err, warn, image.width, image.height,
-            &buffer.data[bufferView.byteOffset],
+            bufferData + bufferView.byteOffset,
             static_cast<int>(bufferView.byteLength), load_image_user_data_);
         if (!ret) {
           return false;
@@ -1,15 +1,25 @@
 #version 450
 
-layout(location = 0) in vec3 inVertexCoord;
-layout(location = 1) in vec3 inNormal;
+#include "vertex_decode.h.glsl"
+
+//CompactSkinnedVertex
+layout(location = 0) in vec4 inQuantisedPosition;
+layout(location = 1) in vec2 inOctahedralNormal;
 layout(location = 2) in vec2 inUV;
-layout(location = 3) in vec4 jointIds;
+layout(location = 3) in uvec4 jointIds;
 layout(location = 4) in vec4 weights;
 
 layout(location = 5) out vec3 outNormal;
 layout(location = 6) out vec2 outUV;
 
 
+//offset past view direction of the fragment stage
+layout(push_constant) uniform VertexConstants {
+	layout(offset = 16) mat4 positionDequantisation;
+	uint paletteJointCount;
+	uint animationVariantCount;
+};
+
 layout(set = 0, binding = 0) uniform UBO {
 	mat4 model;
 	mat4 viewProjection;
@@ -25,16 +35,20 @@ layout(std430, set = 0, binding = 3) readonly buffer InstanceInfos {
 
 void main()
 {
+	vec3 vertexCoord = decodePosition(inQuantisedPosition, positionDequantisation);
+	vec3 vertexNormal = decodeOctahedralNormal(inOctahedralNormal);
 
+	//palettes of animation variants are stored back to back
+	uint paletteBase = (uint(gl_InstanceIndex) % animationVariantCount) * paletteJointCount;
 	mat4 SkinMat = 
-		weights.x * jointMats[int(jointIds.x)] +
-		weights.y * jointMats[int(jointIds.y)] +
-		weights.z * jointMats[int(jointIds.z)] +
-		weights.w * jointMats[int(jointIds.w)];
+		weights.x * jointMats[paletteBase + jointIds.x] +
+		weights.y * jointMats[paletteBase + jointIds.y] +
+		weights.z * jointMats[paletteBase + jointIds.z] +
+		weights.w * jointMats[paletteBase + jointIds.w];
 
 	outUV = inUV;
-	outNormal =  normalize(inverse(transpose(mat3(ubo.model * instanceTransforms[gl_InstanceIndex]))) * inNormal);
+	outNormal =  normalize(inverse(transpose(mat3(ubo.model * instanceTransforms[gl_InstanceIndex]))) * vertexNormal);
 	gl_Position =  ubo.viewProjection * ubo.model * instanceTransforms[gl_InstanceIndex] *
-		SkinMat * vec4(inVertexCoord, 1.0);
+		SkinMat * vec4(vertexCoord, 1.0);
 
 }
\ No newline at end of file
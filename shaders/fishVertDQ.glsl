@@ -0,0 +1,96 @@
+#version 450
+
+#include "vertex_decode.h.glsl"
+
+//CompactSkinnedVertex
+layout(location = 0) in vec4 inQuantisedPosition;
+layout(location = 1) in vec2 inOctahedralNormal;
+layout(location = 2) in vec2 inUV;
+layout(location = 3) in uvec4 jointIds;
+layout(location = 4) in vec4 weights;
+
+layout(location = 5) out vec3 outNormal;
+layout(location = 6) out vec2 outUV;
+
+
+//offset past view direction of the fragment stage
+layout(push_constant) uniform VertexConstants {
+	layout(offset = 16) mat4 positionDequantisation;
+	uint paletteJointCount;
+	uint animationVariantCount;
+};
+
+layout(set = 0, binding = 0) uniform UBO {
+	mat4 model;
+	mat4 viewProjection;
+}ubo;
+
+struct DualQuat
+{
+	vec4 real;
+	vec4 dual;
+};
+
+//joints skin in skeleton root space, pre and post transforms carry the root scale.
+//Each animation variant stores both transforms followed by its dual quaternions, 2 vec4 each
+layout(std430, set = 0, binding = 1) readonly buffer JointDualQuats {
+	vec4 skinningPalettes[];
+};
+
+mat4 loadPaletteMatrix(uint base)
+{
+	return mat4(skinningPalettes[base], skinningPalettes[base + 1], skinningPalettes[base + 2], skinningPalettes[base + 3]);
+}
+
+DualQuat loadJointDualQuat(uint paletteBase, uint jointId)
+{
+	uint base = paletteBase + 8 + 2 * jointId;
+	return DualQuat(skinningPalettes[base], skinningPalettes[base + 1]);
+}
+
+layout(std430, set = 0, binding = 3) readonly buffer InstanceInfos {
+	mat4 instanceTransforms[];
+};
+
+vec3 rotateByQuat(vec4 quat, vec3 vec)
+{
+	return vec + 2.0 * cross(quat.xyz, cross(quat.xyz, vec) + quat.w * vec);
+}
+
+void main()
+{
+	vec3 vertexCoord = decodePosition(inQuantisedPosition, positionDequantisation);
+	vec3 vertexNormal = decodeOctahedralNormal(inOctahedralNormal);
+
+	uint paletteBase = (uint(gl_InstanceIndex) % animationVariantCount) * (8 + 2 * paletteJointCount);
+	mat4 skinningPreTransform = loadPaletteMatrix(paletteBase);
+	mat4 skinningPostTransform = loadPaletteMatrix(paletteBase + 4);
+	DualQuat dq0 = loadJointDualQuat(paletteBase, jointIds.x);
+	DualQuat dq1 = loadJointDualQuat(paletteBase, jointIds.y);
+	DualQuat dq2 = loadJointDualQuat(paletteBase, jointIds.z);
+	DualQuat dq3 = loadJointDualQuat(paletteBase, jointIds.w);
+
+	//q and -q are the same rotation, blend along the shortest path
+	float w1 = dot(dq0.real, dq1.real) < 0.0 ? -weights.y : weights.y;
+	float w2 = dot(dq0.real, dq2.real) < 0.0 ? -weights.z : weights.z;
+	float w3 = dot(dq0.real, dq3.real) < 0.0 ? -weights.w : weights.w;
+
+	vec4 real = weights.x * dq0.real + w1 * dq1.real + w2 * dq2.real + w3 * dq3.real;
+	vec4 dual = weights.x * dq0.dual + w1 * dq1.dual + w2 * dq2.dual + w3 * dq3.dual;
+
+	float invLength = 1.0 / length(real);
+	real *= invLength;
+	dual *= invLength;
+
+	vec3 translation = 2.0 * (real.w * dual.xyz - dual.w * real.xyz + cross(real.xyz, dual.xyz));
+	vec3 rootSpacePosition = (skinningPreTransform * vec4(vertexCoord, 1.0)).xyz;
+	vec3 rootSpaceNormal = inverse(transpose(mat3(skinningPreTransform))) * vertexNormal;
+	vec3 skinnedPosition = rotateByQuat(real, rootSpacePosition) + translation;
+	vec3 skinnedNormal = rotateByQuat(real, rootSpaceNormal);
+
+	mat4 modelTransform = ubo.model * instanceTransforms[gl_InstanceIndex] * skinningPostTransform;
+	outUV = inUV;
+	outNormal =  normalize(inverse(transpose(mat3(modelTransform))) * skinnedNormal);
+	gl_Position =  ubo.viewProjection * modelTransform * vec4(skinnedPosition, 1.0);
+
+}
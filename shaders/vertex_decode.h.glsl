@@ -0,0 +1,15 @@
+//decoding of compact vertex formats, see source/vertex_compression.h
+
+//unorm16 positions within mesh bounds
+vec3 decodePosition(vec4 quantisedPosition, mat4 dequantisation)
+{
+	return (dequantisation * vec4(quantisedPosition.xyz, 1.0)).xyz;
+}
+
+vec3 decodeOctahedralNormal(vec2 encoded)
+{
+	vec3 normal = vec3(encoded, 1.0 - abs(encoded.x) - abs(encoded.y));
+	float fold = max(-normal.z, 0.0);
+	normal.xy += mix(vec2(fold), vec2(-fold), greaterThanEqual(normal.xy, vec2(0.0)));
+	return normalize(normal);
+}
@@ -1,7 +1,9 @@
 #include "animation.h"
+#include "animation_compression.h"
 
 #include <cassert>
 #include <algorithm>
+#include <thread>
 
 static mat4x4 generate_mat_from_transform(const JointTransform& input)
 {
@@ -22,108 +24,648 @@ static mat4x4 generate_mat_from_transform(const JointTransform& input)
 	return out;
 }
 
-void generate_global_joint_transforms(const Animation& animation, KeyFrame* keyFrame)
+void build_joint_order(Animation* animation)
 {
-	assert(keyFrame);
-	assert(!keyFrame->currentJointLocalTransforms.empty());
+	assert(animation);
 
-	for(uint32_t i = 0; i < keyFrame->currentJointLocalTransforms.size(); i++)
+	const uint32_t jointCount = static_cast<uint32_t>(animation->bindPose.size());
+	std::vector<uint32_t> depths(jointCount, 0);
+	for(uint32_t i = 0; i < jointCount; i++)
 	{
-		mat4x4 globalJointTransform = generate_mat_from_transform(keyFrame->currentJointLocalTransforms[i]);
-		int parentId = animation.bindPose[i].parentId;
+		int parentId = animation->bindPose[i].parentId;
 		while(parentId != -1)
 		{
-			globalJointTransform *= generate_mat_from_transform(keyFrame->currentJointLocalTransforms[parentId]);
-			parentId = animation.bindPose[parentId].parentId;
+			depths[i]++;
+			parentId = animation->bindPose[parentId].parentId;
 		}
+	}
+
+	animation->jointOrder.resize(jointCount);
+	for(uint32_t i = 0; i < jointCount; i++)
+	{
+		animation->jointOrder[i] = i;
+	}
+	std::stable_sort(animation->jointOrder.begin(), animation->jointOrder.end(),
+		[&depths](uint32_t left, uint32_t right) {return depths[left] < depths[right];}
+	);
+}
+
+void generate_global_joint_transforms(const Animation& animation, const JointTransform* localTransforms, mat4x4* globalTransforms)
+{
+	assert(localTransforms);
+	assert(globalTransforms);
+	assert(animation.jointOrder.size() == animation.bindPose.size());
+
+	//parents are visited first, so each joint needs a single multiplication
+	for(uint32_t jointId : animation.jointOrder)
+	{
+		mat4x4 localJointTransform = generate_mat_from_transform(localTransforms[jointId]);
+		int parentId = animation.bindPose[jointId].parentId;
+		globalTransforms[jointId] = parentId == -1 ? localJointTransform : localJointTransform * globalTransforms[parentId];
+	}
+}
+
+//returns index of the last key whose time is less or equal to the requested time
+static uint32_t find_track_key(const AnimationTrack& track, float time, uint32_t cursor)
+{
+	const std::vector<float>& timeCodes = track.timeCodes;
+	const uint32_t keyCount = static_cast<uint32_t>(timeCodes.size());
+
+	//playback wrapped around or jumped backwards, fall back to binary search
+	if(cursor >= keyCount || timeCodes[cursor] > time)
+	{
+		auto upper = std::upper_bound(timeCodes.begin(), timeCodes.end(), time);
+		return upper == timeCodes.begin() ? 0 : static_cast<uint32_t>(upper - timeCodes.begin()) - 1;
+	}
 
-		keyFrame->currentJointGlobalTransforms[i] = globalJointTransform;
+	while(cursor + 1 < keyCount && timeCodes[cursor + 1] <= time)
+	{
+		cursor++;
 	}
+	return cursor;
 }
 
-void update_animation(Animation& animation, float frameTime, std::vector<mat4x4>& jointMatrices)
+static void sample_track(const AnimationTrack& track, float time, uint32_t* cursor, JointTransform* out)
 {
-	animation.currentAnimTime += frameTime * animation.playbackRate;
-	animation.currentAnimTime = fmod(animation.currentAnimTime, animation.keyFrames[animation.keyFrames.size() - 1].frameTime);
+	assert(!track.timeCodes.empty());
+
+	const uint32_t key = find_track_key(track, time, *cursor);
+	*cursor = key;
 
-	//perform binary search to find keyFrame that is less or equal to required frametime
-	int leftBorder = 0;
-	int rightBorder = animation.keyFrames.size() - 1;
-	
-	while(leftBorder < rightBorder)
+	const uint32_t lastKey = static_cast<uint32_t>(track.timeCodes.size()) - 1;
+	const uint32_t nextKey = key < lastKey ? key + 1 : key;
+	float amount = 0.f;
+	if(nextKey != key && track.interpolation == INTERPOLATION_LINEAR && time > track.timeCodes[key])
 	{
-		int split = (leftBorder + rightBorder) / 2;
+		amount = (time - track.timeCodes[key]) / (track.timeCodes[nextKey] - track.timeCodes[key]);
+	}
+
+	if(track.channel == CHANNEL_ROTATE_BIT)
+	{
+		const Quat* quats = reinterpret_cast<const Quat*>(track.values.data());
+		out->rotation = amount > 0.f ? sLerp(quats[key], quats[nextKey], amount) : quats[key];
+	}
+	else
+	{
+		const Vec3* vectors = reinterpret_cast<const Vec3*>(track.values.data());
+		Vec3 value = amount > 0.f ? lerp(vectors[key], vectors[nextKey], amount) : vectors[key];
+		if(track.channel == CHANNEL_TRANSLATE_BIT)
+		{
+			out->translation = value;
+		}
+		else
+		{
+			out->scale = value;
+		}
+	}
+	out->channelBits |= track.channel;
+}
 
-		if(animation.keyFrames[split].frameTime > animation.currentAnimTime)
+static void reset_local_transforms(const Animation& animation, bool isAdditive, JointTransform* localTransforms)
+{
+	for(uint32_t i = 0; i < animation.bindPose.size(); i++)
+	{
+		//channels without tracks of additive clips contribute nothing
+		if(isAdditive)
 		{
-			rightBorder = split;
+			localTransforms[i].rotation = identityQuat();
+			localTransforms[i].translation = Vec3{0.f, 0.f, 0.f};
+			localTransforms[i].scale = Vec3{1.f, 1.f, 1.f};
+			localTransforms[i].channelBits = CHANNEL_ROTATE_BIT|CHANNEL_SCALE_BIT|CHANNEL_TRANSLATE_BIT;
 		}
 		else
 		{
-			leftBorder = split + 1;
+			localTransforms[i] = animation.bindPose[i].restTransform;
 		}
 	}
+}
+
+void sample_animation(const Animation& animation, uint32_t clipId, float time, uint32_t* trackCursors, JointTransform* localTransforms)
+{
+	assert(clipId < animation.clips.size());
+	assert(trackCursors);
+	assert(localTransforms);
+
+	const AnimationClip& clip = animation.clips[clipId];
+	reset_local_transforms(animation, clip.isAdditive, localTransforms);
+
+	for(uint32_t i = 0; i < clip.tracks.size(); i++)
+	{
+		const AnimationTrack& track = clip.tracks[i];
+		sample_track(track, time, &trackCursors[i], &localTransforms[track.jointId]);
+	}
+}
+
+void sample_compressed_clip(const Animation& animation, uint32_t clipId, float time, CompressedAnimationScratch* scratch, JointTransform* localTransforms)
+{
+	assert(clipId < animation.compressedClips.size());
+	assert(localTransforms);
 
-	const int keyFrameIndex = leftBorder - 1;
-	const int keyFrameIndexNext = keyFrameIndex + 1;
-	const float epsilon = 0.001f;
+	const CompressedAnimation& compressed = animation.compressedClips[clipId];
+	reset_local_transforms(animation, compressed.isAdditive, localTransforms);
+	sample_compressed_animation(compressed, time, scratch, localTransforms);
+}
+
+void make_additive_clip(Animation* animation, uint32_t clipId, uint32_t referenceClipId, float referenceTime)
+{
+	assert(animation);
+	assert(clipId < animation->clips.size());
+	assert(referenceClipId < animation->clips.size());
+	assert(!animation->clips[referenceClipId].isAdditive);
+	//compression drops raw tracks, clips are made additive before it
+	assert(animation->compressedClips.empty());
 
-	auto generateJointMatrices = [&](const std::vector<mat4x4>& currentJointGlobalTransforms)
+	std::vector<uint32_t> cursors(animation->clips[referenceClipId].tracks.size(), 0);
+	std::vector<JointTransform> referencePose(animation->bindPose.size());
+	sample_animation(*animation, referenceClipId, referenceTime, cursors.data(), referencePose.data());
+
+	AnimationClip& clip = animation->clips[clipId];
+	for(AnimationTrack& track : clip.tracks)
 	{
-		for(uint32_t i = 0; i < jointMatrices.size(); i++)
+		const JointTransform& reference = referencePose[track.jointId];
+		const std::size_t keyCount = track.timeCodes.size();
+		if(track.channel == CHANNEL_ROTATE_BIT)
 		{
-			jointMatrices[i] = animation.bindPose[i].invBindTransform * currentJointGlobalTransforms[i];
+			Quat* rotations = reinterpret_cast<Quat*>(track.values.data());
+			const Quat inverseReference = conjugate(reference.rotation);
+			for(std::size_t key = 0; key < keyCount; key++)
+			{
+				rotations[key] = inverseReference * rotations[key];
+			}
 		}
-	};
+		else
+		{
+			Vec3* vectors = reinterpret_cast<Vec3*>(track.values.data());
+			for(std::size_t key = 0; key < keyCount; key++)
+			{
+				if(track.channel == CHANNEL_TRANSLATE_BIT)
+				{
+					vectors[key] -= reference.translation;
+				}
+				else
+				{
+					for(uint32_t i = 0; i < 3; i++)
+					{
+						vectors[key][i] = reference.scale[i] != 0.f ? vectors[key][i] / reference.scale[i] : 1.f;
+					}
+				}
+			}
+		}
+	}
+	clip.isAdditive = true;
+}
+
+void init_animation_instance(const Animation& animation, uint32_t clipId, float playbackRate, AnimationInstance* instance)
+{
+	assert(instance);
+	assert(clipId < animation.clips.size());
+
+	const std::size_t jointsSize = animation.bindPose.size();
+	instance->animation = &animation;
+	instance->clipId = clipId;
+	instance->playbackRate = playbackRate;
+	instance->currentAnimTime = 0.f;
+	instance->updateInterval = 1;
+	instance->updatesSinceEvaluation = 0;
+	instance->extrapolatePalette = false;
+	instance->scratch.trackCursors.assign(animation.clips[clipId].tracks.size(), 0);
+	instance->scratch.localTransforms.resize(jointsSize);
+	instance->scratch.globalTransforms.resize(jointsSize);
+	instance->scratch.palette.resize(jointsSize);
+	instance->scratch.paletteVelocity.resize(jointsSize);
+	instance->scratch.paletteTime = 0.f;
+	instance->scratch.hasPalette = false;
+	instance->scratch.compressedClipId = ~0u;
+	if(!animation.compressedClips.empty())
+	{
+		assert(animation.compressedClips.size() == animation.clips.size());
+		init_compressed_animation_scratch(animation.compressedClips[clipId], &instance->scratch.compressed);
+		instance->scratch.compressedClipId = clipId;
+	}
+}
+
+//advances playback, returns false when the instance skips evaluation this update
+static bool advance_animation_instance(AnimationInstance* instance, float frameTime)
+{
+	const AnimationClip& clip = instance->animation->clips[instance->clipId];
+	instance->currentAnimTime += frameTime * instance->playbackRate;
+	if(clip.duration > 0.f)
+	{
+		instance->currentAnimTime = fmod(instance->currentAnimTime, clip.duration);
+	}
 
+	if(instance->updateInterval > 1 && instance->scratch.hasPalette && ++instance->updatesSinceEvaluation < instance->updateInterval)
+	{
+		return false;
+	}
+	instance->updatesSinceEvaluation = 0;
+	return true;
+}
 
-	//if keyframe time approximately matches with the current time 
-	if(std::abs(animation.keyFrames[keyFrameIndex].frameTime - animation.currentAnimTime) < epsilon)
+//samples compressed clip when the animation has them, raw tracks otherwise
+static void evaluate_joint_matrices(const Animation& animation, uint32_t clipId, float time, AnimationScratch* scratch, mat4x4* jointMatrices)
+{
+	if(!animation.compressedClips.empty())
 	{
-		return generateJointMatrices(animation.keyFrames[keyFrameIndex].currentJointGlobalTransforms);
+		//palette cache shares its scratch between clips, instances set it up once
+		if(scratch->compressedClipId != clipId)
+		{
+			init_compressed_animation_scratch(animation.compressedClips[clipId], &scratch->compressed);
+			scratch->compressedClipId = clipId;
+		}
+		sample_compressed_clip(animation, clipId, time, &scratch->compressed, scratch->localTransforms.data());
+	}
+	else
+	{
+		sample_animation(animation, clipId, time, scratch->trackCursors.data(), scratch->localTransforms.data());
+	}
+	generate_global_joint_transforms(animation, scratch->localTransforms.data(), scratch->globalTransforms.data());
+
+	for(uint32_t i = 0; i < animation.bindPose.size(); i++)
+	{
+		jointMatrices[i] = animation.bindPose[i].invBindTransform * scratch->globalTransforms[i];
+	}
+}
+
+//keeps freshly evaluated matrices around for the updates reduced rate instances skip
+static void store_palette(AnimationInstance* instance, const mat4x4* jointMatrices)
+{
+	AnimationScratch& scratch = instance->scratch;
+	if(instance->updateInterval <= 1)
+	{
+		scratch.hasPalette = false;
+		return;
+	}
+
+	const std::size_t jointsSize = scratch.palette.size();
+	//clip wrapped around since the last evaluation, extrapolating across the seam would overshoot
+	const bool wrapped = (instance->currentAnimTime < scratch.paletteTime) == (instance->playbackRate > 0.f);
+	if(instance->extrapolatePalette && scratch.hasPalette && !wrapped)
+	{
+		const float invInterval = 1.f / instance->updateInterval;
+		for(std::size_t i = 0; i < jointsSize; i++)
+		{
+			for(uint32_t j = 0; j < 16; j++)
+			{
+				scratch.paletteVelocity[i].p[j] = (jointMatrices[i].p[j] - scratch.palette[i].p[j]) * invInterval;
+			}
+		}
+	}
+	else
+	{
+		std::fill(scratch.paletteVelocity.begin(), scratch.paletteVelocity.end(), mat4x4{});
+	}
+
+	std::copy(jointMatrices, jointMatrices + jointsSize, scratch.palette.begin());
+	scratch.paletteTime = instance->currentAnimTime;
+	scratch.hasPalette = true;
+}
+
+static void replay_palette(const AnimationInstance& instance, mat4x4* jointMatrices)
+{
+	const AnimationScratch& scratch = instance.scratch;
+	const std::size_t jointsSize = scratch.palette.size();
+	if(!instance.extrapolatePalette)
+	{
+		std::copy(scratch.palette.begin(), scratch.palette.end(), jointMatrices);
+		return;
+	}
+
+	const float updates = static_cast<float>(instance.updatesSinceEvaluation);
+	for(std::size_t i = 0; i < jointsSize; i++)
+	{
+		for(uint32_t j = 0; j < 16; j++)
+		{
+			jointMatrices[i].p[j] = scratch.palette[i].p[j] + scratch.paletteVelocity[i].p[j] * updates;
+		}
 	}
+}
+
+void update_animation(AnimationInstance* instance, float frameTime, mat4x4* jointMatrices)
+{
+	assert(instance);
+	assert(instance->animation);
+	assert(jointMatrices);
 
-	float duration = animation.keyFrames[keyFrameIndexNext].frameTime - animation.keyFrames[keyFrameIndex].frameTime;
-	float amount = (animation.currentAnimTime - animation.keyFrames[keyFrameIndex].frameTime) / duration;
+	const Animation& animation = *instance->animation;
+	AnimationScratch& scratch = instance->scratch;
 	const std::size_t jointsSize = animation.bindPose.size();
+	assert(scratch.trackCursors.size() == animation.clips[instance->clipId].tracks.size());
+	assert(scratch.localTransforms.size() == jointsSize);
+	assert(scratch.globalTransforms.size() == jointsSize);
+	assert(scratch.palette.size() == jointsSize);
+
+	if(!advance_animation_instance(instance, frameTime))
+	{
+		replay_palette(*instance, jointMatrices);
+		return;
+	}
+
+	evaluate_joint_matrices(animation, instance->clipId, instance->currentAnimTime, &scratch, jointMatrices);
+	store_palette(instance, jointMatrices);
+}
+
+void update_animation_dual_quat(AnimationInstance* instance, float frameTime, DualQuatSkinningSpace* skinningSpace, DualQuat* jointDualQuats)
+{
+	assert(instance);
+
+	//global transforms aren't needed past evaluation, so they hold matrix palette before conversion
+	AnimationScratch& scratch = instance->scratch;
+	update_animation(instance, frameTime, scratch.globalTransforms.data());
+	convert_palette_to_dual_quats(*instance->animation, scratch.globalTransforms.data(), skinningSpace, jointDualQuats);
+}
 
-	KeyFrame interpolatedFrame = {};
-	interpolatedFrame.currentJointLocalTransforms.resize(jointsSize);
-	interpolatedFrame.currentJointGlobalTransforms.resize(jointsSize);
+static bool is_unit_scale(const Vec3& scale)
+{
+	static constexpr float SCALE_TOLERANCE = 1e-3f;
+	return std::abs(scale.x - 1.f) <= SCALE_TOLERANCE && std::abs(scale.y - 1.f) <= SCALE_TOLERANCE && std::abs(scale.z - 1.f) <= SCALE_TOLERANCE;
+}
 
-	for(uint32_t i = 0; i < jointsSize; i++)
+bool supports_dual_quat_skinning(const Animation& animation)
+{
+	uint32_t rootCount = 0;
+	for(const Joint& joint : animation.bindPose)
+	{
+		if(joint.parentId == -1)
+		{
+			rootCount++;
+		}
+		else if((joint.restTransform.channelBits & CHANNEL_SCALE_BIT) && !is_unit_scale(joint.restTransform.scale))
+		{
+			return false;
+		}
+	}
+	if(rootCount != 1)
 	{
-		JointTransform interpolatedTransform = {};
-		auto&& firstJointTransform = animation.keyFrames[keyFrameIndex].currentJointLocalTransforms[i];
-		auto&& secontJointTransform = animation.keyFrames[keyFrameIndexNext].currentJointLocalTransforms[i];
+		return false;
+	}
 
-		auto channelBits = firstJointTransform.channelBits;
-		if(channelBits & CHANNEL_ROTATE_BIT)
+	for(const AnimationClip& clip : animation.clips)
+	{
+		for(const AnimationTrack& track : clip.tracks)
 		{
-			Quat first = firstJointTransform.rotation;
-			Quat second = secontJointTransform.rotation;
-			interpolatedTransform.rotation = sLerp(first, second, amount);
-			interpolatedTransform.channelBits |= CHANNEL_ROTATE_BIT;
+			if(track.channel != CHANNEL_SCALE_BIT || animation.bindPose[track.jointId].parentId == -1)
+			{
+				continue;
+			}
+			const Vec3* scales = reinterpret_cast<const Vec3*>(track.values.data());
+			for(std::size_t key = 0; key < track.timeCodes.size(); key++)
+			{
+				if(!is_unit_scale(scales[key]))
+				{
+					return false;
+				}
+			}
 		}
-		if(channelBits & CHANNEL_SCALE_BIT)
+	}
+	//compressed scale tracks stay within their range, so checking both ends covers every key
+	for(const CompressedAnimation& compressed : animation.compressedClips)
+	{
+		for(const CompressedTrack& track : compressed.tracks)
 		{
-			Vec3 first = firstJointTransform.scale;
-			Vec3 second = secontJointTransform.scale;
-			interpolatedTransform.scale = lerp(first, second, amount);
-			interpolatedTransform.channelBits |= CHANNEL_SCALE_BIT;
+			if(track.channel != CHANNEL_SCALE_BIT || animation.bindPose[track.jointId].parentId == -1)
+			{
+				continue;
+			}
+			if(!is_unit_scale(track.rangeMin) || !is_unit_scale(track.rangeMin + track.rangeExtent))
+			{
+				return false;
+			}
 		}
-		if(channelBits & CHANNEL_TRANSLATE_BIT)
+	}
+	return true;
+}
+
+void convert_palette_to_dual_quats(const Animation& animation, const mat4x4* jointMatrices, DualQuatSkinningSpace* skinningSpace, DualQuat* jointDualQuats)
+{
+	assert(jointMatrices);
+	assert(skinningSpace);
+	assert(jointDualQuats);
+	assert(!animation.jointOrder.empty());
+	assert(animation.jointOrder.size() == 1 || animation.bindPose[animation.jointOrder[1]].parentId != -1);
+
+	//first joint in order is a root, its bind and current global transforms bracket the rigid part
+	const uint32_t rootId = animation.jointOrder[0];
+	const mat4x4& invRootBind = animation.bindPose[rootId].invBindTransform;
+	const mat4x4 rootBind = inverse(invRootBind);
+	skinningSpace->preTransform = invRootBind;
+	skinningSpace->postTransform = rootBind * jointMatrices[rootId];
+	const mat4x4 invPostTransform = inverse(skinningSpace->postTransform);
+
+	for(uint32_t i = 0; i < animation.bindPose.size(); i++)
+	{
+		const mat4x4 rigid = rootBind * jointMatrices[i] * invPostTransform;
+		//normalising basis rows strips whatever scale is left below the root
+		mat4x4 rotation = loadIdentity();
+		for(uint32_t row = 0; row < 3; row++)
 		{
-			Vec3 first = firstJointTransform.translation;
-			Vec3 second = secontJointTransform.translation;
-			interpolatedTransform.translation = lerp(first, second, amount);
-			interpolatedTransform.channelBits |= CHANNEL_TRANSLATE_BIT;
+			const Vec3 basis = Vec3{rigid.p[row * 4], rigid.p[row * 4 + 1], rigid.p[row * 4 + 2]};
+			const float length = lengthVec3(basis);
+			const float invLength = length > 0.f ? 1.f / length : 0.f;
+			for(uint32_t col = 0; col < 3; col++)
+			{
+				rotation.p[row * 4 + col] = basis[col] * invLength;
+			}
 		}
 
-		interpolatedFrame.currentJointLocalTransforms[i] = interpolatedTransform;
+		const Quat real = rotationMatToQuat(rotation);
+		const Quat translation = Quat{rigid.p[12], rigid.p[13], rigid.p[14], 0.f};
+		jointDualQuats[i].real = real;
+		jointDualQuats[i].dual = translation * real * 0.5f;
+	}
+}
+
+void update_animation_cached(PaletteCache* cache, AnimationInstance* instance, float frameTime, mat4x4* jointMatrices)
+{
+	assert(cache);
+	assert(instance);
+	assert(cache->animation == instance->animation);
+	assert(jointMatrices);
+
+	if(!advance_animation_instance(instance, frameTime))
+	{
+		replay_palette(*instance, jointMatrices);
+		return;
+	}
+
+	const mat4x4* palette = get_cached_palette(cache, instance->clipId, instance->currentAnimTime, &instance->scratch);
+	if(palette)
+	{
+		std::copy(palette, palette + instance->scratch.palette.size(), jointMatrices);
 	}
+	else
+	{
+		evaluate_joint_matrices(*instance->animation, instance->clipId, instance->currentAnimTime, &instance->scratch, jointMatrices);
+	}
+	store_palette(instance, jointMatrices);
+}
 
-	generate_global_joint_transforms(animation, &interpolatedFrame);
-	generateJointMatrices(interpolatedFrame.currentJointGlobalTransforms);
-	
-}
\ No newline at end of file
+uint32_t select_animation_update_interval(float distance, float fullRateDistance)
+{
+	uint32_t interval = 1;
+	while(interval < 8 && distance > fullRateDistance * interval)
+	{
+		interval *= 2;
+	}
+	return interval;
+}
+
+void update_animations_batch(JobSystem* jobSystem, AnimationInstance* instances, uint32_t instanceCount, float frameTime,
+	mat4x4* jointPalette, std::size_t paletteStride, PaletteCache* cache)
+{
+	assert(jobSystem);
+	assert(instances || instanceCount == 0);
+	assert(jointPalette || instanceCount == 0);
+
+	//few instances per job keeps the pool balanced while amortising submission cost
+	const uint32_t workerCount = get_worker_count(*jobSystem) + 1;
+	const uint32_t grainSize = std::max(1u, instanceCount / (workerCount * 4));
+
+	parallel_for(jobSystem, instanceCount, grainSize, [=](uint32_t begin, uint32_t end) {
+		for(uint32_t i = begin; i < end; i++)
+		{
+			assert(instances[i].animation->bindPose.size() <= paletteStride);
+			if(cache)
+			{
+				update_animation_cached(cache, &instances[i], frameTime, jointPalette + i * paletteStride);
+			}
+			else
+			{
+				update_animation(&instances[i], frameTime, jointPalette + i * paletteStride);
+			}
+		}
+	});
+}
+
+void init_palette_cache(const Animation& animation, float timeQuantum, uint32_t maxPalettes, PaletteCache* cache)
+{
+	assert(cache);
+	assert(timeQuantum > 0.f);
+	assert(maxPalettes > 0);
+
+	//at most half full, so probe sequences stay short
+	uint32_t entryCount = 1;
+	while(entryCount < maxPalettes * 2)
+	{
+		entryCount *= 2;
+	}
+
+	cache->animation = &animation;
+	cache->timeQuantum = timeQuantum;
+	cache->frameId = 0;
+	cache->usedPalettes = 0;
+	cache->maxPalettes = maxPalettes;
+	cache->entries = std::vector<PaletteCacheEntry>(entryCount);
+	cache->palettes.resize(animation.bindPose.size() * maxPalettes);
+	cache->hits = 0;
+	cache->misses = 0;
+}
+
+void begin_palette_cache_frame(PaletteCache* cache)
+{
+	assert(cache);
+	//frame ids start at 1, so zero initialised entries are never valid
+	cache->frameId++;
+	cache->usedPalettes = 0;
+	cache->hits = 0;
+	cache->misses = 0;
+}
+
+//another thread claimed the entry this frame and is about to publish what it waits for
+static void wait_for_palette_entry(const std::atomic<uint32_t>& publishedFrameId, uint32_t frameId)
+{
+	while(publishedFrameId.load(std::memory_order_acquire) != frameId)
+	{
+		std::this_thread::yield();
+	}
+}
+
+const mat4x4* get_cached_palette(PaletteCache* cache, uint32_t clipId, float time, AnimationScratch* scratch)
+{
+	assert(cache);
+	assert(scratch);
+	assert(cache->frameId > 0);
+	assert(clipId < cache->animation->clips.size());
+
+	//rounding up may step past the last key, which a looping clip doesn't reach
+	const float duration = cache->animation->clips[clipId].duration;
+	const uint32_t timeStep = static_cast<uint32_t>(time / cache->timeQuantum + 0.5f);
+	const float sampleTime = duration > 0.f ? std::min(timeStep * cache->timeQuantum, duration) : 0.f;
+	const std::size_t jointsSize = cache->animation->bindPose.size();
+	const uint32_t frameId = cache->frameId;
+	const uint32_t mask = static_cast<uint32_t>(cache->entries.size()) - 1;
+
+	//every lookup that doesn't end with a palette is a miss, including ones of a full cache
+	uint32_t slot = ((clipId * 0x9E3779B1u) ^ (timeStep * 0x85EBCA77u)) & mask;
+	for(uint32_t probeCount = 0; probeCount <= mask;)
+	{
+		PaletteCacheEntry& entry = cache->entries[slot];
+		uint32_t entryFrameId = entry.frameId.load(std::memory_order_acquire);
+		if(entryFrameId != frameId)
+		{
+			if(cache->usedPalettes.load(std::memory_order_relaxed) >= cache->maxPalettes)
+			{
+				break;
+			}
+			if(!entry.frameId.compare_exchange_strong(entryFrameId, frameId, std::memory_order_acq_rel))
+			{
+				//lost the slot to another thread, look at what it put there
+				continue;
+			}
+
+			cache->misses.fetch_add(1, std::memory_order_relaxed);
+			const uint32_t paletteId = cache->usedPalettes.fetch_add(1, std::memory_order_relaxed);
+			entry.clipId = clipId;
+			entry.timeStep = timeStep;
+			entry.paletteId = paletteId < cache->maxPalettes ? paletteId : PALETTE_CACHE_FULL;
+			entry.keyFrameId.store(frameId, std::memory_order_release);
+			if(entry.paletteId == PALETTE_CACHE_FULL)
+			{
+				entry.readyFrameId.store(frameId, std::memory_order_release);
+				return nullptr;
+			}
+
+			mat4x4* palette = &cache->palettes[entry.paletteId * jointsSize];
+			evaluate_joint_matrices(*cache->animation, clipId, sampleTime, scratch, palette);
+			entry.readyFrameId.store(frameId, std::memory_order_release);
+			return palette;
+		}
+
+		wait_for_palette_entry(entry.keyFrameId, frameId);
+		if(entry.clipId == clipId && entry.timeStep == timeStep)
+		{
+			wait_for_palette_entry(entry.readyFrameId, frameId);
+			if(entry.paletteId == PALETTE_CACHE_FULL)
+			{
+				cache->misses.fetch_add(1, std::memory_order_relaxed);
+				return nullptr;
+			}
+			cache->hits.fetch_add(1, std::memory_order_relaxed);
+			return &cache->palettes[entry.paletteId * jointsSize];
+		}
+		slot = (slot + 1) & mask;
+		probeCount++;
+	}
+
+	cache->misses.fetch_add(1, std::memory_order_relaxed);
+	return nullptr;
+}
+
+std::size_t get_animation_memory_footprint(const Animation& animation)
+{
+	std::size_t bytes = (sizeof(Joint) + sizeof(uint32_t)) * animation.bindPose.size();
+	for(const AnimationClip& clip : animation.clips)
+	{
+		bytes += sizeof(AnimationClip);
+		for(const AnimationTrack& track : clip.tracks)
+		{
+			bytes += sizeof(AnimationTrack);
+			bytes += sizeof(float) * (track.timeCodes.size() + track.values.size());
+		}
+	}
+	for(const CompressedAnimation& compressed : animation.compressedClips)
+	{
+		bytes += sizeof(CompressedAnimation) + get_compressed_animation_memory_footprint(compressed);
+	}
+	return bytes;
+}
@@ -2,14 +2,11 @@
 #define MAGMA_ANIMATION_H
 
 #include "maths.h"
+#include "job_system.h"
 
+#include <atomic>
 #include <vector>
-
-struct Joint
-{
-	mat4x4 invBindTransform;
-	int parentId = -1;
-};
+#include <string>
 
 enum AnimChannel
 {
@@ -19,6 +16,12 @@ enum AnimChannel
 };
 typedef uint32_t AnimChannelBits;
 
+enum AnimInterpolation
+{
+	INTERPOLATION_LINEAR,
+	INTERPOLATION_STEP
+};
+
 struct JointTransform
 {
 	Quat rotation;
@@ -27,30 +30,201 @@ struct JointTransform
 	AnimChannelBits channelBits;
 };
 
-struct AnimationSampler
+//rigid transform in 32 bytes, rotation by real part followed by translation encoded in dual part
+struct DualQuat
+{
+	Quat real;
+	Quat dual;
+};
+
+//dual quaternions skin in the space of the skeleton root, so that scale of the root joint
+//stays out of the palette: skinned = vertex * preTransform * jointDualQuat * postTransform.
+//Scale below the root can't be represented, see supports_dual_quat_skinning
+struct DualQuatSkinningSpace
+{
+	mat4x4 preTransform;
+	mat4x4 postTransform;
+};
+
+struct Joint
+{
+	mat4x4 invBindTransform;
+	JointTransform restTransform;//local transform used for channels without a track
+	int parentId = -1;
+};
+
+//keys of a single animated channel of a single joint
+struct AnimationTrack
 {
 	uint32_t jointId;
 	AnimChannel channel;
+	AnimInterpolation interpolation;
 	std::vector<float> timeCodes;
-	std::vector<uint8_t> outputs;
+	std::vector<float> values;//4 floats per key for rotations, 3 for translations and scales
+};
+
+struct CompressedTrack
+{
+	uint32_t jointId;
+	AnimChannel channel;
+	AnimInterpolation interpolation;
+	uint32_t firstKey;//key index into CompressedAnimation::keys, which has 4 words per key
+	uint32_t keyCount;
+	Vec3 rangeMin;//dequantisation range of translations and scales
+	Vec3 rangeExtent;
+};
+
+//rotations are stored as smallest three quaternions in 48 bits,
+//translations and scales as 16 bit values within per track range,
+//key times are 16 bit fractions of the clip duration
+struct CompressedAnimation
+{
+	float duration;
+	bool isAdditive;
+	std::vector<CompressedTrack> tracks;
+	std::vector<uint16_t> keys;//time code followed by 3 packed values, a key and the next one are 16 contiguous bytes
+	uint32_t rotationTrackCount;
+	uint32_t vectorTrackCount;
+	//both ranges start with tracks of more than one key, constant ones after them are never searched
+	uint32_t animatedRotationCount;
+	uint32_t animatedVectorCount;
+};
+
+//structure of arrays working memory for decoding all animated tracks of a clip at once,
+//lanes are padded to groups of 4 decoded together
+struct CompressedAnimationScratch
+{
+	std::vector<uint32_t> trackCursors;
+	std::vector<uint16_t> keyPairs;//8 words per lane, keys around sample time as stored, rotation lanes first
+	std::vector<float> vectorMins;//3 planes
+	std::vector<float> vectorExtents;//3 planes, per quantisation step
+	std::vector<float> constantValues;//decoded tracks of a single key, 4 floats per rotation then 3 per vector
 };
 
-struct KeyFrame
+struct AnimationClip
 {
-	float frameTime;
-	std::vector<JointTransform> currentJointLocalTransforms;//from samplers
-	std::vector<mat4x4> currentJointGlobalTransforms;
+	std::string name;
+	float duration;
+	bool isAdditive;//tracks hold deltas from a reference pose, see make_additive_clip
+	std::vector<AnimationTrack> tracks;
 };
 
 struct Animation
 {
+	std::vector<Joint> bindPose;
+	std::vector<uint32_t> jointOrder;//parents always precede their children
+	std::vector<AnimationClip> clips;
+	std::vector<CompressedAnimation> compressedClips;//empty, or one per clip and sampled instead of its tracks, which are usually dropped
+};
+
+//per instance working memory, sized once by init_animation_instance
+//so that update_animation never touches the heap
+struct AnimationScratch
+{
+	std::vector<uint32_t> trackCursors;//last sampled key of each track
+	std::vector<JointTransform> localTransforms;
+	std::vector<mat4x4> globalTransforms;
+	std::vector<mat4x4> palette;//last evaluated skinning matrices, replayed between reduced rate updates
+	std::vector<mat4x4> paletteVelocity;//palette change per update between the last two evaluations
+	CompressedAnimationScratch compressed;
+	uint32_t compressedClipId;//clip compressed scratch was set up for
+	float paletteTime;
+	bool hasPalette;
+};
+
+struct AnimationInstance
+{
+	const Animation* animation;
+	uint32_t clipId;
 	float playbackRate;
 	float currentAnimTime;
-	std::vector<Joint> bindPose;
-	std::vector<KeyFrame> keyFrames;
+	uint32_t updateInterval;//evaluate every n-th update, see select_animation_update_interval
+	uint32_t updatesSinceEvaluation;
+	bool extrapolatePalette;//skipped updates extrapolate the last two palettes instead of repeating the last one
+	AnimationScratch scratch;
 };
 
-void update_animation(Animation& animation, float time, std::vector<mat4x4>& jointMatrices);
-void generate_global_joint_transforms(const Animation& animation, KeyFrame* keyFrame);
+//slots are claimed by swapping in the current frame id, key and palette are
+//published afterwards, so lookups of other threads wait for them in turn
+struct PaletteCacheEntry
+{
+	std::atomic<uint32_t> frameId = {0};//entries of older frames are free
+	std::atomic<uint32_t> keyFrameId = {0};//clipId and timeStep are valid for this frame
+	std::atomic<uint32_t> readyFrameId = {0};//palette is evaluated for this frame
+	uint32_t clipId;
+	uint32_t timeStep;
+	uint32_t paletteId;//PALETTE_CACHE_FULL when the frame ran out of palettes
+};
+
+static constexpr uint32_t PALETTE_CACHE_FULL = ~0u;
+
+//skinning palettes of the current frame keyed by clip and quantised time,
+//instances playing the same clip in lockstep share a single evaluation.
+//Lookups may run on several threads at once, begin_palette_cache_frame may not
+struct PaletteCache
+{
+	const Animation* animation;
+	float timeQuantum;
+	uint32_t frameId;
+	std::atomic<uint32_t> usedPalettes = {0};
+	uint32_t maxPalettes;
+	std::vector<PaletteCacheEntry> entries;//open addressing, power of two sized
+	std::vector<mat4x4> palettes;
+	std::atomic<uint32_t> hits = {0};
+	std::atomic<uint32_t> misses = {0};
+};
+
+void init_animation_instance(const Animation& animation, uint32_t clipId, float playbackRate, AnimationInstance* instance);
+
+//jointMatrices must hold at least animation.bindPose.size() matrices
+void update_animation(AnimationInstance* instance, float frameTime, mat4x4* jointMatrices);
+
+//same as update_animation, but writes dual quaternion palette for dual quaternion skinning
+void update_animation_dual_quat(AnimationInstance* instance, float frameTime, DualQuatSkinningSpace* skinningSpace, DualQuat* jointDualQuats);
+
+//true for a single root skeleton whose joints below the root keep unit scale in rest pose and every clip,
+//check once at load time before picking dual quaternion skinning
+bool supports_dual_quat_skinning(const Animation& animation);
+
+void convert_palette_to_dual_quats(const Animation& animation, const mat4x4* jointMatrices, DualQuatSkinningSpace* skinningSpace, DualQuat* jointDualQuats);
+
+//same as update_animation, but the pose is taken from the cache at quantised time
+void update_animation_cached(PaletteCache* cache, AnimationInstance* instance, float frameTime, mat4x4* jointMatrices);
+
+//1 up to fullRateDistance, then halves the rate with every doubling of distance down to 1/8
+uint32_t select_animation_update_interval(float distance, float fullRateDistance);
+
+//instances are split between job system workers, instance i writes its matrices
+//to jointPalette + i * paletteStride, so the palette may be a persistently mapped buffer.
+//With a cache, which every instance has to share the animation of, workers look up poses in it
+void update_animations_batch(JobSystem* jobSystem, AnimationInstance* instances, uint32_t instanceCount, float frameTime,
+	mat4x4* jointPalette, std::size_t paletteStride, PaletteCache* cache = nullptr);
+
+//samples every track of a clip at given time into joint local transforms, 
+//trackCursors are advanced so forward playback finds its keys in O(1)
+void sample_animation(const Animation& animation, uint32_t clipId, float time, uint32_t* trackCursors, JointTransform* localTransforms);
+
+//same as sample_animation for animations with compressed clips, scratch has to be set up for clipId
+void sample_compressed_clip(const Animation& animation, uint32_t clipId, float time, CompressedAnimationScratch* scratch, JointTransform* localTransforms);
+
+//fills jointOrder from parent ids, has to be called once bindPose is built
+void build_joint_order(Animation* animation);
+
+void generate_global_joint_transforms(const Animation& animation, const JointTransform* localTransforms, mat4x4* globalTransforms);
+
+//rewrites clip keys as deltas from the pose of reference clip at reference time
+void make_additive_clip(Animation* animation, uint32_t clipId, uint32_t referenceClipId, float referenceTime = 0.f);
+
+//timeQuantum is the time step poses are snapped to, maxPalettes bounds unique poses per frame
+void init_palette_cache(const Animation& animation, float timeQuantum, uint32_t maxPalettes, PaletteCache* cache);
+
+//invalidates palettes of the previous frame, has to be called once per frame before lookups
+void begin_palette_cache_frame(PaletteCache* cache);
+
+//misses evaluate the pose with scratch of an instance playing clipId.
+//Returns nullptr when the cache ran out of palettes for this frame
+const mat4x4* get_cached_palette(PaletteCache* cache, uint32_t clipId, float time, AnimationScratch* scratch);
+
+std::size_t get_animation_memory_footprint(const Animation& animation);
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,730 @@
+#include "animation_compression.h"
+
+#include <cassert>
+#include <cstring>
+#include <algorithm>
+
+//x64 always has SSE2, NEON builds take the scalar paths
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MAGMA_ANIMATION_COMPRESSION_SSE2
+#include <emmintrin.h>
+#endif
+
+static constexpr float SMALLEST_THREE_RANGE = 0.70710678f;//1/sqrt(2)
+static constexpr float SMALLEST_THREE_STEPS = 32767.f;//15 bits per component
+static constexpr float SMALLEST_THREE_SCALE = 2.f * SMALLEST_THREE_RANGE / SMALLEST_THREE_STEPS;
+static constexpr float RANGE_STEPS = 65535.f;
+static constexpr uint32_t KEY_WORDS = 4;//time code and 3 packed values
+static constexpr uint32_t LANE_WORDS = 2 * KEY_WORDS;
+static constexpr uint32_t LANE_GROUP = 4;
+//simd and scalar decoding round differently, key reduction leaves them this much of the tolerance
+static constexpr float ROUNDING_MARGIN = 0.999f;
+
+static uint16_t quantise_unorm16(float value)
+{
+	return static_cast<uint16_t>(clamp(value, 0.f, 1.f) * RANGE_STEPS + 0.5f);
+}
+
+static uint32_t get_lane_count(uint32_t trackCount)
+{
+	return (trackCount + LANE_GROUP - 1) / LANE_GROUP * LANE_GROUP;
+}
+
+//sample time in time code units, the compressor measures error at the same times the decoder samples
+static float get_key_time(float time, float duration)
+{
+	return duration > 0.f ? clamp(time / duration, 0.f, 1.f) * RANGE_STEPS : 0.f;
+}
+
+//largest component index goes into the lowest bits of the first two words
+static void pack_smallest_three(Quat quat, uint16_t* out)
+{
+	Quat q = quat * (1.f / lengthQuat(quat));
+	uint32_t largest = 0;
+	for(uint32_t i = 1; i < 4; i++)
+	{
+		if(std::abs(q.xyzw[i]) > std::abs(q.xyzw[largest]))
+		{
+			largest = i;
+		}
+	}
+	//q and -q are the same rotation, keep dropped component positive
+	if(q.xyzw[largest] < 0.f)
+	{
+		q = q * -1.f;
+	}
+
+	uint32_t quantised[3] = {};
+	for(uint32_t i = 0, j = 0; i < 4; i++)
+	{
+		if(i == largest)
+		{
+			continue;
+		}
+		float normalised = (q.xyzw[i] + SMALLEST_THREE_RANGE) / (2.f * SMALLEST_THREE_RANGE);
+		quantised[j++] = static_cast<uint32_t>(clamp(normalised, 0.f, 1.f) * SMALLEST_THREE_STEPS + 0.5f);
+	}
+
+	out[0] = static_cast<uint16_t>((quantised[0] << 1) | (largest >> 1));
+	out[1] = static_cast<uint16_t>((quantised[1] << 1) | (largest & 1));
+	out[2] = static_cast<uint16_t>(quantised[2] << 1);
+}
+
+//scalar decoding shared by the compressor and the fallback path, the sse2 path does the same arithmetic
+static Quat unpack_smallest_three(const uint16_t* packed)
+{
+	const uint32_t largest = ((packed[0] & 1u) << 1) | (packed[1] & 1u);
+	const float c0 = static_cast<float>(packed[0] >> 1) * SMALLEST_THREE_SCALE - SMALLEST_THREE_RANGE;
+	const float c1 = static_cast<float>(packed[1] >> 1) * SMALLEST_THREE_SCALE - SMALLEST_THREE_RANGE;
+	const float c2 = static_cast<float>(packed[2] >> 1) * SMALLEST_THREE_SCALE - SMALLEST_THREE_RANGE;
+	const float dropped = sqrtf(std::max(0.f, 1.f - c0 * c0 - c1 * c1 - c2 * c2));
+
+	Quat out = {};
+	out.x = largest == 0 ? dropped : c0;
+	out.y = largest == 0 ? c0 : (largest == 1 ? dropped : c1);
+	out.z = largest <= 1 ? c1 : (largest == 2 ? dropped : c2);
+	out.w = largest == 3 ? dropped : c2;
+	return out;
+}
+
+static float get_key_amount(float keyTime, const uint16_t* first, const uint16_t* second)
+{
+	const float span = std::max(static_cast<float>(second[0]) - first[0], 1.f);
+	return clamp((keyTime - first[0]) / span, 0.f, 1.f);
+}
+
+//nlerp along the shortest arc
+static Quat decode_rotation(const uint16_t* first, const uint16_t* second, float amount)
+{
+	const Quat q0 = unpack_smallest_three(first + 1);
+	const Quat q1 = unpack_smallest_three(second + 1);
+	const float dot = q0.x * q1.x + q0.y * q1.y + q0.z * q1.z + q0.w * q1.w;
+	const float secondWeight = dot < 0.f ? -amount : amount;
+	const float firstWeight = 1.f - amount;
+
+	Quat out = {};
+	for(uint32_t i = 0; i < 4; i++)
+	{
+		out.xyzw[i] = q0.xyzw[i] * firstWeight + q1.xyzw[i] * secondWeight;
+	}
+	const float invLength = 1.f / sqrtf(out.x * out.x + out.y * out.y + out.z * out.z + out.w * out.w);
+	return out * invLength;
+}
+
+static Vec3 decode_vector(const uint16_t* first, const uint16_t* second, float amount, const float* mins, const float* extents)
+{
+	Vec3 out = {};
+	for(uint32_t i = 0; i < 3; i++)
+	{
+		const float quantised = first[i + 1] + (static_cast<float>(second[i + 1]) - first[i + 1]) * amount;
+		out[i] = mins[i] + quantised * extents[i];
+	}
+	return out;
+}
+
+//angle between rotations from the chord of their unit quaternions, acos of their dot product
+//loses most precision for the small angles tolerances are about
+static float rotation_error(const Quat& first, const Quat& second)
+{
+	const Quat a = first * (1.f / lengthQuat(first));
+	Quat b = second * (1.f / lengthQuat(second));
+	if(dotVec4(a.xyzw, b.xyzw) < 0.f)
+	{
+		b = b * -1.f;
+	}
+	float chordSquared = 0.f;
+	for(uint32_t i = 0; i < 4; i++)
+	{
+		chordSquared += (a.xyzw[i] - b.xyzw[i]) * (a.xyzw[i] - b.xyzw[i]);
+	}
+	return 4.f * asinf(std::min(1.f, 0.5f * sqrtf(chordSquared)));
+}
+
+static float vector_error(const Vec3& first, const Vec3& second)
+{
+	return lengthVec3(first - second);
+}
+
+//track quantised the way it's stored, key reduction measures error of what the decoder reconstructs
+struct QuantisedTrack
+{
+	std::vector<uint16_t> keys;
+	float mins[3];
+	float extents[3];//per quantisation step
+};
+
+static void quantise_track(const AnimationTrack& track, float duration, QuantisedTrack* out)
+{
+	const uint32_t keyCount = static_cast<uint32_t>(track.timeCodes.size());
+	const float timeScale = duration > 0.f ? 1.f / duration : 0.f;
+	out->keys.resize(KEY_WORDS * keyCount);
+
+	//range covers every source key, so quantisation is known before keys get dropped
+	const bool isRotation = track.channel == CHANNEL_ROTATE_BIT;
+	const Vec3* vectors = reinterpret_cast<const Vec3*>(track.values.data());
+	Vec3 rangeMin = isRotation ? Vec3{} : vectors[0];
+	Vec3 rangeMax = rangeMin;
+	for(uint32_t key = 0; key < keyCount && !isRotation; key++)
+	{
+		for(uint32_t i = 0; i < 3; i++)
+		{
+			rangeMin[i] = std::min(rangeMin[i], vectors[key][i]);
+			rangeMax[i] = std::max(rangeMax[i], vectors[key][i]);
+		}
+	}
+	for(uint32_t i = 0; i < 3; i++)
+	{
+		out->mins[i] = rangeMin[i];
+		out->extents[i] = (rangeMax[i] - rangeMin[i]) / RANGE_STEPS;
+	}
+
+	for(uint32_t key = 0; key < keyCount; key++)
+	{
+		uint16_t* packed = &out->keys[KEY_WORDS * key];
+		packed[0] = quantise_unorm16(track.timeCodes[key] * timeScale);
+		if(isRotation)
+		{
+			pack_smallest_three(reinterpret_cast<const Quat*>(track.values.data())[key], packed + 1);
+			continue;
+		}
+		for(uint32_t i = 0; i < 3; i++)
+		{
+			const float extent = rangeMax[i] - rangeMin[i];
+			packed[i + 1] = quantise_unorm16(extent > 0.f ? (vectors[key][i] - rangeMin[i]) / extent : 0.f);
+		}
+	}
+}
+
+//error of the source key at keyTime when only firstKey and secondKey are kept around it
+static float key_error(const AnimationTrack& track, const QuantisedTrack& quantised, const float* expected,
+	uint32_t firstKey, uint32_t secondKey, float keyTime)
+{
+	//step interpolation holds the first key until the second one
+	const uint16_t* first = &quantised.keys[KEY_WORDS * firstKey];
+	const uint16_t* second = track.interpolation == INTERPOLATION_LINEAR ? &quantised.keys[KEY_WORDS * secondKey] : first;
+	const float amount = get_key_amount(keyTime, first, second);
+
+	if(track.channel == CHANNEL_ROTATE_BIT)
+	{
+		return rotation_error(decode_rotation(first, second, amount), *reinterpret_cast<const Quat*>(expected));
+	}
+	const Vec3 decoded = decode_vector(first, second, amount, quantised.mins, quantised.extents);
+	return vector_error(decoded, *reinterpret_cast<const Vec3*>(expected));
+}
+
+//greedy error bounded key reduction, a key is dropped while the decoded curve between
+//the kept neighbours reproduces every skipped key within tolerance
+static void reduce_keys(const AnimationTrack& track, const QuantisedTrack& quantised, float duration, float tolerance,
+	std::vector<uint32_t>* keptKeys)
+{
+	const uint32_t componentCount = track.channel == CHANNEL_ROTATE_BIT ? 4 : 3;
+	const uint32_t keyCount = static_cast<uint32_t>(track.timeCodes.size());
+	keptKeys->clear();
+	keptKeys->push_back(0);
+
+	auto keyFits = [&](uint32_t key, uint32_t first, uint32_t last)
+	{
+		const float keyTime = get_key_time(track.timeCodes[key], duration);
+		return key_error(track, quantised, &track.values[key * componentCount], first, last, keyTime) <= tolerance;
+	};
+	auto spanFits = [&](uint32_t first, uint32_t last)
+	{
+		for(uint32_t key = first + 1; key < last; key++)
+		{
+			if(!keyFits(key, first, last))
+			{
+				return false;
+			}
+		}
+		return true;
+	};
+
+	//constant tracks collapse into a single key
+	bool isConstant = true;
+	for(uint32_t key = 1; key < keyCount && isConstant; key++)
+	{
+		isConstant = keyFits(key, 0, 0);
+	}
+	if(isConstant)
+	{
+		return;
+	}
+
+	uint32_t anchor = 0;
+	for(uint32_t candidate = 2; candidate < keyCount; candidate++)
+	{
+		if(!spanFits(anchor, candidate))
+		{
+			anchor = candidate - 1;
+			keptKeys->push_back(anchor);
+		}
+	}
+	keptKeys->push_back(keyCount - 1);
+}
+
+void compress_animation(const Animation& animation, uint32_t clipId, const AnimationCompressionSettings& settings, CompressedAnimation* out, AnimationCompressionStats* stats)
+{
+	assert(clipId < animation.clips.size());
+	assert(out);
+
+	const AnimationClip& clip = animation.clips[clipId];
+	*out = {};
+	out->duration = clip.duration;
+	out->isAdditive = clip.isAdditive;
+
+	std::size_t rawBytes = 0;
+	QuantisedTrack quantised = {};
+	std::vector<uint32_t> keptKeys = {};
+	std::vector<CompressedTrack> tracks = {};
+	std::vector<std::vector<uint16_t>> trackKeys = {};
+	for(const AnimationTrack& track : clip.tracks)
+	{
+		rawBytes += sizeof(AnimationTrack) + sizeof(float) * (track.timeCodes.size() + track.values.size());
+
+		float tolerance = settings.scaleTolerance;
+		if(track.channel == CHANNEL_ROTATE_BIT)
+		{
+			tolerance = settings.rotationTolerance;
+		}
+		else if(track.channel == CHANNEL_TRANSLATE_BIT)
+		{
+			tolerance = settings.translationTolerance;
+		}
+		quantise_track(track, clip.duration, &quantised);
+		reduce_keys(track, quantised, clip.duration, tolerance * ROUNDING_MARGIN, &keptKeys);
+
+		CompressedTrack compressedTrack = {};
+		compressedTrack.jointId = track.jointId;
+		compressedTrack.channel = track.channel;
+		compressedTrack.interpolation = track.interpolation;
+		compressedTrack.keyCount = static_cast<uint32_t>(keptKeys.size());
+		for(uint32_t i = 0; i < 3; i++)
+		{
+			compressedTrack.rangeMin[i] = quantised.mins[i];
+			compressedTrack.rangeExtent[i] = quantised.extents[i] * RANGE_STEPS;
+		}
+		tracks.push_back(compressedTrack);
+
+		trackKeys.emplace_back();
+		for(uint32_t key : keptKeys)
+		{
+			const uint16_t* packed = &quantised.keys[KEY_WORDS * key];
+			trackKeys.back().insert(trackKeys.back().end(), packed, packed + KEY_WORDS);
+		}
+	}
+
+	//rotation tracks go first so decoding runs over two contiguous lane ranges,
+	//constant tracks go last in both so their keys are gathered once per clip
+	std::vector<uint32_t> order(tracks.size());
+	for(uint32_t i = 0; i < order.size(); i++)
+	{
+		order[i] = i;
+	}
+	auto getRank = [&](uint32_t track) {
+		return (tracks[track].channel == CHANNEL_ROTATE_BIT ? 0 : 2) + (tracks[track].keyCount > 1 ? 0 : 1);
+	};
+	std::stable_sort(order.begin(), order.end(), [&](uint32_t left, uint32_t right) {return getRank(left) < getRank(right);});
+	for(uint32_t track : order)
+	{
+		CompressedTrack& compressedTrack = tracks[track];
+		compressedTrack.firstKey = static_cast<uint32_t>(out->keys.size() / KEY_WORDS);
+		out->keys.insert(out->keys.end(), trackKeys[track].begin(), trackKeys[track].end());
+		out->tracks.push_back(compressedTrack);
+
+		const bool isAnimated = compressedTrack.keyCount > 1;
+		if(compressedTrack.channel == CHANNEL_ROTATE_BIT)
+		{
+			out->rotationTrackCount++;
+			out->animatedRotationCount += isAnimated ? 1 : 0;
+		}
+		else
+		{
+			out->vectorTrackCount++;
+			out->animatedVectorCount += isAnimated ? 1 : 0;
+		}
+	}
+
+	if(!stats)
+	{
+		return;
+	}
+
+	//measure real error by decoding the clip at every source key time
+	*stats = {};
+	stats->rawBytes = rawBytes;
+	stats->compressedBytes = get_compressed_animation_memory_footprint(*out);
+
+	CompressedAnimationScratch scratch = {};
+	init_compressed_animation_scratch(*out, &scratch);
+	std::vector<JointTransform> decoded(animation.bindPose.size());
+	for(const AnimationTrack& track : clip.tracks)
+	{
+		const uint32_t componentCount = track.channel == CHANNEL_ROTATE_BIT ? 4 : 3;
+		for(uint32_t key = 0; key < track.timeCodes.size(); key++)
+		{
+			sample_compressed_animation(*out, track.timeCodes[key], &scratch, decoded.data());
+			const JointTransform& transform = decoded[track.jointId];
+			const float* expected = &track.values[key * componentCount];
+			if(track.channel == CHANNEL_ROTATE_BIT)
+			{
+				stats->maxRotationError = std::max(stats->maxRotationError, rotation_error(transform.rotation, *reinterpret_cast<const Quat*>(expected)));
+			}
+			else if(track.channel == CHANNEL_TRANSLATE_BIT)
+			{
+				stats->maxTranslationError = std::max(stats->maxTranslationError, vector_error(transform.translation, *reinterpret_cast<const Vec3*>(expected)));
+			}
+			else
+			{
+				stats->maxScaleError = std::max(stats->maxScaleError, vector_error(transform.scale, *reinterpret_cast<const Vec3*>(expected)));
+			}
+		}
+	}
+}
+
+void compress_animation_clips(Animation* animation, const AnimationCompressionSettings& settings, AnimationCompressionStats* stats)
+{
+	assert(animation);
+
+	animation->compressedClips.resize(animation->clips.size());
+	for(uint32_t clipId = 0; clipId < animation->clips.size(); clipId++)
+	{
+		compress_animation(*animation, clipId, settings, &animation->compressedClips[clipId], stats ? &stats[clipId] : nullptr);
+	}
+
+	if(settings.keepRawTracks)
+	{
+		return;
+	}
+	for(AnimationClip& clip : animation->clips)
+	{
+		std::vector<AnimationTrack>().swap(clip.tracks);
+	}
+}
+
+static uint32_t find_compressed_key(const uint16_t* keys, uint32_t keyCount, uint32_t keyTick, uint32_t cursor)
+{
+	if(cursor >= keyCount || keys[KEY_WORDS * cursor] > keyTick)
+	{
+		uint32_t first = 0;
+		uint32_t count = keyCount;
+		while(count > 0)
+		{
+			const uint32_t half = count / 2;
+			if(keys[KEY_WORDS * (first + half)] <= keyTick)
+			{
+				first += half + 1;
+				count -= half + 1;
+			}
+			else
+			{
+				count = half;
+			}
+		}
+		return first == 0 ? 0 : first - 1;
+	}
+
+	while(cursor + 1 < keyCount && keys[KEY_WORDS * (cursor + 1)] <= keyTick)
+	{
+		cursor++;
+	}
+	return cursor;
+}
+
+//the only per track pass, copies keys around sample time as they are stored, 16 bytes per lane.
+//Clamped and step tracks get their key twice, which decodes to it whatever the amount
+static void gather_key_pairs(const CompressedAnimation& animation, uint32_t firstTrack, uint32_t trackCount,
+	uint32_t keyTick, uint32_t* cursors, uint16_t* keyPairs)
+{
+	for(uint32_t lane = 0; lane < trackCount; lane++)
+	{
+		const CompressedTrack& track = animation.tracks[firstTrack + lane];
+		const uint16_t* keys = &animation.keys[KEY_WORDS * track.firstKey];
+		const uint32_t key = find_compressed_key(keys, track.keyCount, keyTick, cursors[lane]);
+		cursors[lane] = key;
+
+		const uint16_t* first = keys + KEY_WORDS * key;
+		uint16_t* pair = keyPairs + LANE_WORDS * lane;
+		if(key + 1 < track.keyCount && track.interpolation == INTERPOLATION_LINEAR)
+		{
+			memcpy(pair, first, LANE_WORDS * sizeof(uint16_t));
+		}
+		else
+		{
+			memcpy(pair, first, KEY_WORDS * sizeof(uint16_t));
+			memcpy(pair + KEY_WORDS, first, KEY_WORDS * sizeof(uint16_t));
+		}
+	}
+}
+
+void init_compressed_animation_scratch(const CompressedAnimation& animation, CompressedAnimationScratch* scratch)
+{
+	assert(scratch);
+
+	//only animated tracks get lanes, constant ones are decoded here once
+	const uint32_t rotationLanes = get_lane_count(animation.animatedRotationCount);
+	const uint32_t vectorLanes = get_lane_count(animation.animatedVectorCount);
+	scratch->trackCursors.assign(animation.tracks.size(), 0);
+	scratch->keyPairs.assign(LANE_WORDS * (rotationLanes + vectorLanes), 0);
+	scratch->vectorMins.assign(3 * vectorLanes, 0.f);
+	scratch->vectorExtents.assign(3 * vectorLanes, 0.f);
+
+	//padding rotation lanes decode to identity rather than dividing by a zero length
+	uint16_t identity[KEY_WORDS] = {};
+	pack_smallest_three(identityQuat(), identity + 1);
+	for(uint32_t lane = animation.animatedRotationCount; lane < rotationLanes; lane++)
+	{
+		memcpy(&scratch->keyPairs[LANE_WORDS * lane], identity, sizeof(identity));
+		memcpy(&scratch->keyPairs[LANE_WORDS * lane + KEY_WORDS], identity, sizeof(identity));
+	}
+
+	const uint32_t rotationCount = animation.rotationTrackCount;
+	for(uint32_t lane = 0; lane < animation.animatedVectorCount; lane++)
+	{
+		const CompressedTrack& track = animation.tracks[rotationCount + lane];
+		for(uint32_t i = 0; i < 3; i++)
+		{
+			scratch->vectorMins[i * vectorLanes + lane] = track.rangeMin[i];
+			scratch->vectorExtents[i * vectorLanes + lane] = track.rangeExtent[i] / RANGE_STEPS;
+		}
+	}
+
+	scratch->constantValues.clear();
+	for(uint32_t i = animation.animatedRotationCount; i < rotationCount; i++)
+	{
+		const uint16_t* key = &animation.keys[KEY_WORDS * animation.tracks[i].firstKey];
+		const Quat rotation = decode_rotation(key, key, 0.f);
+		scratch->constantValues.insert(scratch->constantValues.end(), rotation.xyzw.data, rotation.xyzw.data + 4);
+	}
+	for(uint32_t i = rotationCount + animation.animatedVectorCount; i < animation.tracks.size(); i++)
+	{
+		const CompressedTrack& track = animation.tracks[i];
+		const uint16_t* key = &animation.keys[KEY_WORDS * track.firstKey];
+		float extents[3] = {};
+		for(uint32_t j = 0; j < 3; j++)
+		{
+			extents[j] = track.rangeExtent[j] / RANGE_STEPS;
+		}
+		const Vec3 value = decode_vector(key, key, 0.f, track.rangeMin.data, extents);
+		scratch->constantValues.insert(scratch->constantValues.end(), value.data, value.data + 3);
+	}
+}
+
+static void store_vector(const CompressedTrack& track, const Vec3& value, JointTransform* localTransforms)
+{
+	JointTransform& transform = localTransforms[track.jointId];
+	if(track.channel == CHANNEL_TRANSLATE_BIT)
+	{
+		transform.translation = value;
+	}
+	else
+	{
+		transform.scale = value;
+	}
+	transform.channelBits |= track.channel;
+}
+
+#ifdef MAGMA_ANIMATION_COMPRESSION_SSE2
+static __m128 select_ps(__m128 mask, __m128 first, __m128 second)
+{
+	return _mm_or_ps(_mm_and_ps(mask, first), _mm_andnot_ps(mask, second));
+}
+
+//8 words of 4 lanes into 8 planes of 32 bit lanes: time code and 3 values of the first key, then of the second
+static void transpose_key_pairs(const uint16_t* keyPairs, __m128i* planes)
+{
+	const __m128i lane0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(keyPairs));
+	const __m128i lane1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(keyPairs + LANE_WORDS));
+	const __m128i lane2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(keyPairs + 2 * LANE_WORDS));
+	const __m128i lane3 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(keyPairs + 3 * LANE_WORDS));
+	const __m128i first01 = _mm_unpacklo_epi16(lane0, lane1);
+	const __m128i first23 = _mm_unpacklo_epi16(lane2, lane3);
+	const __m128i second01 = _mm_unpackhi_epi16(lane0, lane1);
+	const __m128i second23 = _mm_unpackhi_epi16(lane2, lane3);
+	const __m128i words[4] = {
+		_mm_unpacklo_epi32(first01, first23),
+		_mm_unpackhi_epi32(first01, first23),
+		_mm_unpacklo_epi32(second01, second23),
+		_mm_unpackhi_epi32(second01, second23)
+	};
+	const __m128i zero = _mm_setzero_si128();
+	for(uint32_t i = 0; i < 4; i++)
+	{
+		planes[2 * i] = _mm_unpacklo_epi16(words[i], zero);
+		planes[2 * i + 1] = _mm_unpackhi_epi16(words[i], zero);
+	}
+}
+
+static __m128 get_key_amounts(__m128 keyTime, __m128i firstTime, __m128i secondTime)
+{
+	const __m128 first = _mm_cvtepi32_ps(firstTime);
+	const __m128 span = _mm_max_ps(_mm_sub_ps(_mm_cvtepi32_ps(secondTime), first), _mm_set1_ps(1.f));
+	const __m128 amount = _mm_div_ps(_mm_sub_ps(keyTime, first), span);
+	return _mm_min_ps(_mm_max_ps(amount, _mm_setzero_ps()), _mm_set1_ps(1.f));
+}
+
+static void unpack_smallest_three(const __m128i* packed, __m128* quat)
+{
+	const __m128i one = _mm_set1_epi32(1);
+	const __m128i largest = _mm_or_si128(_mm_slli_epi32(_mm_and_si128(packed[0], one), 1), _mm_and_si128(packed[1], one));
+	const __m128 scale = _mm_set1_ps(SMALLEST_THREE_SCALE);
+	const __m128 range = _mm_set1_ps(SMALLEST_THREE_RANGE);
+	__m128 c[3];
+	for(uint32_t i = 0; i < 3; i++)
+	{
+		c[i] = _mm_sub_ps(_mm_mul_ps(_mm_cvtepi32_ps(_mm_srli_epi32(packed[i], 1)), scale), range);
+	}
+	const __m128 squares = _mm_add_ps(_mm_add_ps(_mm_mul_ps(c[0], c[0]), _mm_mul_ps(c[1], c[1])), _mm_mul_ps(c[2], c[2]));
+	const __m128 dropped = _mm_sqrt_ps(_mm_max_ps(_mm_setzero_ps(), _mm_sub_ps(_mm_set1_ps(1.f), squares)));
+
+	const __m128 isX = _mm_castsi128_ps(_mm_cmpeq_epi32(largest, _mm_setzero_si128()));
+	const __m128 isY = _mm_castsi128_ps(_mm_cmpeq_epi32(largest, one));
+	const __m128 isZ = _mm_castsi128_ps(_mm_cmpeq_epi32(largest, _mm_set1_epi32(2)));
+	const __m128 isW = _mm_castsi128_ps(_mm_cmpeq_epi32(largest, _mm_set1_epi32(3)));
+	quat[0] = select_ps(isX, dropped, c[0]);
+	quat[1] = select_ps(isX, c[0], select_ps(isY, dropped, c[1]));
+	quat[2] = select_ps(_mm_or_ps(isX, isY), c[1], select_ps(isZ, dropped, c[2]));
+	quat[3] = select_ps(isW, dropped, c[2]);
+}
+
+//4 rotation lanes: dequantise both keys, nlerp and store quaternions to their joints
+static void decode_rotation_group(const CompressedAnimation& animation, uint32_t firstLane, __m128 keyTime,
+	const uint16_t* keyPairs, JointTransform* localTransforms)
+{
+	__m128i planes[8];
+	transpose_key_pairs(keyPairs + LANE_WORDS * firstLane, planes);
+	const __m128 amount = get_key_amounts(keyTime, planes[0], planes[4]);
+
+	__m128 first[4];
+	__m128 second[4];
+	unpack_smallest_three(planes + 1, first);
+	unpack_smallest_three(planes + 5, second);
+
+	const __m128 dot = _mm_add_ps(_mm_add_ps(_mm_mul_ps(first[0], second[0]), _mm_mul_ps(first[1], second[1])),
+		_mm_add_ps(_mm_mul_ps(first[2], second[2]), _mm_mul_ps(first[3], second[3])));
+	const __m128 secondWeight = select_ps(_mm_cmplt_ps(dot, _mm_setzero_ps()), _mm_sub_ps(_mm_setzero_ps(), amount), amount);
+	const __m128 firstWeight = _mm_sub_ps(_mm_set1_ps(1.f), amount);
+	__m128 quat[4];
+	for(uint32_t i = 0; i < 4; i++)
+	{
+		quat[i] = _mm_add_ps(_mm_mul_ps(first[i], firstWeight), _mm_mul_ps(second[i], secondWeight));
+	}
+	const __m128 lengthSquared = _mm_add_ps(_mm_add_ps(_mm_mul_ps(quat[0], quat[0]), _mm_mul_ps(quat[1], quat[1])),
+		_mm_add_ps(_mm_mul_ps(quat[2], quat[2]), _mm_mul_ps(quat[3], quat[3])));
+	//estimate refined by a newton step is within float precision, and cheaper than sqrt and divide
+	const __m128 estimate = _mm_rsqrt_ps(lengthSquared);
+	const __m128 refinement = _mm_sub_ps(_mm_set1_ps(3.f), _mm_mul_ps(lengthSquared, _mm_mul_ps(estimate, estimate)));
+	const __m128 invLength = _mm_mul_ps(_mm_mul_ps(_mm_set1_ps(0.5f), estimate), refinement);
+	for(uint32_t i = 0; i < 4; i++)
+	{
+		quat[i] = _mm_mul_ps(quat[i], invLength);
+	}
+
+	//planes back to one quaternion per lane
+	_MM_TRANSPOSE4_PS(quat[0], quat[1], quat[2], quat[3]);
+	const uint32_t laneCount = std::min(LANE_GROUP, animation.animatedRotationCount - firstLane);
+	for(uint32_t lane = 0; lane < laneCount; lane++)
+	{
+		JointTransform& transform = localTransforms[animation.tracks[firstLane + lane].jointId];
+		_mm_storeu_ps(transform.rotation.xyzw.data, quat[lane]);
+		transform.channelBits |= CHANNEL_ROTATE_BIT;
+	}
+}
+
+//4 translation or scale lanes: lerp quantised values and dequantise them within their track range
+static void decode_vector_group(const CompressedAnimation& animation, uint32_t firstLane, __m128 keyTime,
+	const CompressedAnimationScratch& scratch, JointTransform* localTransforms)
+{
+	const uint32_t rotationLanes = get_lane_count(animation.animatedRotationCount);
+	const uint32_t vectorLanes = get_lane_count(animation.animatedVectorCount);
+	__m128i planes[8];
+	transpose_key_pairs(&scratch.keyPairs[LANE_WORDS * (rotationLanes + firstLane)], planes);
+	const __m128 amount = get_key_amounts(keyTime, planes[0], planes[4]);
+
+	alignas(16) float vectors[3][LANE_GROUP];
+	for(uint32_t i = 0; i < 3; i++)
+	{
+		const __m128 first = _mm_cvtepi32_ps(planes[i + 1]);
+		const __m128 second = _mm_cvtepi32_ps(planes[i + 5]);
+		const __m128 quantised = _mm_add_ps(first, _mm_mul_ps(_mm_sub_ps(second, first), amount));
+		const __m128 mins = _mm_loadu_ps(&scratch.vectorMins[i * vectorLanes + firstLane]);
+		const __m128 extents = _mm_loadu_ps(&scratch.vectorExtents[i * vectorLanes + firstLane]);
+		_mm_store_ps(vectors[i], _mm_add_ps(mins, _mm_mul_ps(quantised, extents)));
+	}
+
+	const uint32_t laneCount = std::min(LANE_GROUP, animation.animatedVectorCount - firstLane);
+	for(uint32_t lane = 0; lane < laneCount; lane++)
+	{
+		const CompressedTrack& track = animation.tracks[animation.rotationTrackCount + firstLane + lane];
+		store_vector(track, Vec3{vectors[0][lane], vectors[1][lane], vectors[2][lane]}, localTransforms);
+	}
+}
+#endif
+
+void sample_compressed_animation(const CompressedAnimation& animation, float time, CompressedAnimationScratch* scratch, JointTransform* localTransforms)
+{
+	assert(scratch);
+	assert(localTransforms);
+	assert(scratch->trackCursors.size() == animation.tracks.size());
+
+	const uint32_t rotationCount = animation.rotationTrackCount;
+	const uint32_t animatedRotationCount = animation.animatedRotationCount;
+	const uint32_t animatedVectorCount = animation.animatedVectorCount;
+	const uint32_t rotationLanes = get_lane_count(animatedRotationCount);
+	const float keyTime = get_key_time(time, animation.duration);
+	//time codes are integers, so comparing them against the truncated time finds the same keys
+	const uint32_t keyTick = static_cast<uint32_t>(keyTime);
+
+	uint16_t* keyPairs = scratch->keyPairs.data();
+	gather_key_pairs(animation, 0, animatedRotationCount, keyTick, scratch->trackCursors.data(), keyPairs);
+	gather_key_pairs(animation, rotationCount, animatedVectorCount, keyTick, scratch->trackCursors.data() + rotationCount,
+		keyPairs + LANE_WORDS * rotationLanes);
+
+#ifdef MAGMA_ANIMATION_COMPRESSION_SSE2
+	const __m128 keyTimes = _mm_set1_ps(keyTime);
+	for(uint32_t lane = 0; lane < animatedRotationCount; lane += LANE_GROUP)
+	{
+		decode_rotation_group(animation, lane, keyTimes, keyPairs, localTransforms);
+	}
+	for(uint32_t lane = 0; lane < animatedVectorCount; lane += LANE_GROUP)
+	{
+		decode_vector_group(animation, lane, keyTimes, *scratch, localTransforms);
+	}
+#else
+	for(uint32_t lane = 0; lane < animatedRotationCount; lane++)
+	{
+		const uint16_t* first = keyPairs + LANE_WORDS * lane;
+		const uint16_t* second = first + KEY_WORDS;
+		JointTransform& transform = localTransforms[animation.tracks[lane].jointId];
+		transform.rotation = decode_rotation(first, second, get_key_amount(keyTime, first, second));
+		transform.channelBits |= CHANNEL_ROTATE_BIT;
+	}
+
+	const uint32_t vectorLanes = get_lane_count(animatedVectorCount);
+	for(uint32_t lane = 0; lane < animatedVectorCount; lane++)
+	{
+		const uint16_t* first = keyPairs + LANE_WORDS * (rotationLanes + lane);
+		const uint16_t* second = first + KEY_WORDS;
+		const float mins[3] = {scratch->vectorMins[lane], scratch->vectorMins[vectorLanes + lane], scratch->vectorMins[2 * vectorLanes + lane]};
+		const float extents[3] = {scratch->vectorExtents[lane], scratch->vectorExtents[vectorLanes + lane], scratch->vectorExtents[2 * vectorLanes + lane]};
+		const Vec3 value = decode_vector(first, second, get_key_amount(keyTime, first, second), mins, extents);
+		store_vector(animation.tracks[rotationCount + lane], value, localTransforms);
+	}
+#endif
+
+	const float* constantValues = scratch->constantValues.data();
+	for(uint32_t i = animatedRotationCount; i < rotationCount; i++, constantValues += 4)
+	{
+		JointTransform& transform = localTransforms[animation.tracks[i].jointId];
+		memcpy(transform.rotation.xyzw.data, constantValues, 4 * sizeof(float));
+		transform.channelBits |= CHANNEL_ROTATE_BIT;
+	}
+	for(uint32_t i = rotationCount + animatedVectorCount; i < animation.tracks.size(); i++, constantValues += 3)
+	{
+		store_vector(animation.tracks[i], Vec3{constantValues[0], constantValues[1], constantValues[2]}, localTransforms);
+	}
+}
+
+std::size_t get_compressed_animation_memory_footprint(const CompressedAnimation& animation)
+{
+	return sizeof(CompressedTrack) * animation.tracks.size() + sizeof(uint16_t) * animation.keys.size();
+}
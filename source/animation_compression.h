@@ -0,0 +1,40 @@
+#ifndef MAGMA_ANIMATION_COMPRESSION_H
+#define MAGMA_ANIMATION_COMPRESSION_H
+
+#include "animation.h"
+
+#include <vector>
+
+//max allowed deviation of decoded clips from every source key, quantisation included
+struct AnimationCompressionSettings
+{
+	float rotationTolerance = 0.001f;//radians
+	float translationTolerance = 0.0005f;
+	float scaleTolerance = 0.0005f;
+	bool keepRawTracks = false;//for tooling that inspects or recompresses clips, runtime only needs compressed ones
+};
+
+struct AnimationCompressionStats
+{
+	std::size_t rawBytes;
+	std::size_t compressedBytes;
+	float maxRotationError;
+	float maxTranslationError;
+	float maxScaleError;
+};
+
+void compress_animation(const Animation& animation, uint32_t clipId, const AnimationCompressionSettings& settings, CompressedAnimation* out, AnimationCompressionStats* stats = nullptr);
+
+//fills compressedClips, so instances initialised afterwards sample them instead of raw tracks.
+//Raw tracks are freed unless settings keep them, clip names and durations stay.
+//stats, when given, has to hold one entry per clip
+void compress_animation_clips(Animation* animation, const AnimationCompressionSettings& settings, AnimationCompressionStats* stats = nullptr);
+
+void init_compressed_animation_scratch(const CompressedAnimation& animation, CompressedAnimationScratch* scratch);
+
+//unlike sample_animation rest pose is not written, localTransforms must already hold it
+void sample_compressed_animation(const CompressedAnimation& animation, float time, CompressedAnimationScratch* scratch, JointTransform* localTransforms);
+
+std::size_t get_compressed_animation_memory_footprint(const CompressedAnimation& animation);
+
+#endif
@@ -0,0 +1,341 @@
+#include "blend_tree.h"
+#include "animation_compression.h"
+
+#include <cassert>
+#include <algorithm>
+
+static void resize_local_pose(uint32_t jointCount, LocalPose* pose)
+{
+	pose->rotations.resize(4 * jointCount);
+	pose->translations.resize(3 * jointCount);
+	pose->scales.resize(3 * jointCount);
+}
+
+static void store_local_pose(const JointTransform* transforms, uint32_t jointCount, LocalPose* pose)
+{
+	for(uint32_t lane = 0; lane < jointCount; lane++)
+	{
+		const JointTransform& transform = transforms[lane];
+		for(uint32_t i = 0; i < 4; i++)
+		{
+			pose->rotations[i * jointCount + lane] = transform.rotation.xyzw[i];
+		}
+		for(uint32_t i = 0; i < 3; i++)
+		{
+			pose->translations[i * jointCount + lane] = transform.translation[i];
+			pose->scales[i * jointCount + lane] = transform.scale[i];
+		}
+	}
+}
+
+static void load_local_pose(const LocalPose& pose, uint32_t jointCount, JointTransform* transforms)
+{
+	for(uint32_t lane = 0; lane < jointCount; lane++)
+	{
+		JointTransform& transform = transforms[lane];
+		for(uint32_t i = 0; i < 4; i++)
+		{
+			transform.rotation.xyzw[i] = pose.rotations[i * jointCount + lane];
+		}
+		for(uint32_t i = 0; i < 3; i++)
+		{
+			transform.translation[i] = pose.translations[i * jointCount + lane];
+			transform.scale[i] = pose.scales[i * jointCount + lane];
+		}
+		transform.channelBits = CHANNEL_ROTATE_BIT|CHANNEL_SCALE_BIT|CHANNEL_TRANSLATE_BIT;
+	}
+}
+
+//lanes are independent and branch free, so the loops below vectorise across joints
+
+void blend_poses_lerp(const LocalPose& from, const LocalPose& to, float weight, const float* jointMask, uint32_t jointCount, LocalPose* out)
+{
+	assert(out);
+
+	const float* fromRotations = from.rotations.data();
+	const float* toRotations = to.rotations.data();
+	float* outRotations = out->rotations.data();
+	for(uint32_t lane = 0; lane < jointCount; lane++)
+	{
+		const float amount = jointMask ? weight * jointMask[lane] : weight;
+		const float x0 = fromRotations[lane];
+		const float y0 = fromRotations[jointCount + lane];
+		const float z0 = fromRotations[2 * jointCount + lane];
+		const float w0 = fromRotations[3 * jointCount + lane];
+		const float x1 = toRotations[lane];
+		const float y1 = toRotations[jointCount + lane];
+		const float z1 = toRotations[2 * jointCount + lane];
+		const float w1 = toRotations[3 * jointCount + lane];
+
+		//nlerp along the shortest arc
+		const float dot = x0 * x1 + y0 * y1 + z0 * z1 + w0 * w1;
+		const float toWeight = dot < 0.f ? -amount : amount;
+		const float fromWeight = 1.f - amount;
+		const float x = x0 * fromWeight + x1 * toWeight;
+		const float y = y0 * fromWeight + y1 * toWeight;
+		const float z = z0 * fromWeight + z1 * toWeight;
+		const float w = w0 * fromWeight + w1 * toWeight;
+		const float invLength = 1.f / sqrtf(x * x + y * y + z * z + w * w);
+
+		outRotations[lane] = x * invLength;
+		outRotations[jointCount + lane] = y * invLength;
+		outRotations[2 * jointCount + lane] = z * invLength;
+		outRotations[3 * jointCount + lane] = w * invLength;
+	}
+
+	for(uint32_t i = 0; i < 3; i++)
+	{
+		const float* fromTranslations = &from.translations[i * jointCount];
+		const float* toTranslations = &to.translations[i * jointCount];
+		const float* fromScales = &from.scales[i * jointCount];
+		const float* toScales = &to.scales[i * jointCount];
+		float* outTranslations = &out->translations[i * jointCount];
+		float* outScales = &out->scales[i * jointCount];
+		for(uint32_t lane = 0; lane < jointCount; lane++)
+		{
+			const float amount = jointMask ? weight * jointMask[lane] : weight;
+			outTranslations[lane] = fromTranslations[lane] + (toTranslations[lane] - fromTranslations[lane]) * amount;
+			outScales[lane] = fromScales[lane] + (toScales[lane] - fromScales[lane]) * amount;
+		}
+	}
+}
+
+void blend_poses_additive(const LocalPose& base, const LocalPose& additive, float weight, const float* jointMask, uint32_t jointCount, LocalPose* out)
+{
+	assert(out);
+
+	const float* baseRotations = base.rotations.data();
+	const float* deltaRotations = additive.rotations.data();
+	float* outRotations = out->rotations.data();
+	for(uint32_t lane = 0; lane < jointCount; lane++)
+	{
+		const float amount = jointMask ? weight * jointMask[lane] : weight;
+		const float bx = baseRotations[lane];
+		const float by = baseRotations[jointCount + lane];
+		const float bz = baseRotations[2 * jointCount + lane];
+		const float bw = baseRotations[3 * jointCount + lane];
+
+		//scale delta rotation by nlerp from identity
+		const float deltaWeight = deltaRotations[3 * jointCount + lane] < 0.f ? -amount : amount;
+		float dx = deltaRotations[lane] * deltaWeight;
+		float dy = deltaRotations[jointCount + lane] * deltaWeight;
+		float dz = deltaRotations[2 * jointCount + lane] * deltaWeight;
+		float dw = (1.f - amount) + deltaRotations[3 * jointCount + lane] * deltaWeight;
+		const float invLength = 1.f / sqrtf(dx * dx + dy * dy + dz * dz + dw * dw);
+		dx *= invLength;
+		dy *= invLength;
+		dz *= invLength;
+		dw *= invLength;
+
+		//base * delta, same as the Quat Hamilton product
+		outRotations[lane] = bx * dw + dx * bw + (by * dz - bz * dy);
+		outRotations[jointCount + lane] = by * dw + dy * bw + (bz * dx - bx * dz);
+		outRotations[2 * jointCount + lane] = bz * dw + dz * bw + (bx * dy - by * dx);
+		outRotations[3 * jointCount + lane] = bw * dw - (bx * dx + by * dy + bz * dz);
+	}
+
+	for(uint32_t i = 0; i < 3; i++)
+	{
+		const float* baseTranslations = &base.translations[i * jointCount];
+		const float* deltaTranslations = &additive.translations[i * jointCount];
+		const float* baseScales = &base.scales[i * jointCount];
+		const float* deltaScales = &additive.scales[i * jointCount];
+		float* outTranslations = &out->translations[i * jointCount];
+		float* outScales = &out->scales[i * jointCount];
+		for(uint32_t lane = 0; lane < jointCount; lane++)
+		{
+			const float amount = jointMask ? weight * jointMask[lane] : weight;
+			outTranslations[lane] = baseTranslations[lane] + deltaTranslations[lane] * amount;
+			outScales[lane] = baseScales[lane] * (1.f + (deltaScales[lane] - 1.f) * amount);
+		}
+	}
+}
+
+uint32_t add_clip_node(BlendTree* tree, uint32_t clipId, float playbackRate)
+{
+	assert(tree);
+
+	BlendNode node = {};
+	node.type = BLEND_NODE_CLIP;
+	node.clipId = clipId;
+	node.playbackRate = playbackRate;
+	node.weight = 1.f;
+	node.targetWeight = 1.f;
+	tree->nodes.push_back(node);
+	return static_cast<uint32_t>(tree->nodes.size()) - 1;
+}
+
+static uint32_t add_blend_node(BlendTree* tree, BlendNodeType type, uint32_t first, uint32_t second, float weight, int maskId)
+{
+	assert(tree);
+	assert(first < tree->nodes.size() && second < tree->nodes.size());
+	assert(maskId < static_cast<int>(tree->jointMasks.size()));
+
+	BlendNode node = {};
+	node.type = type;
+	node.inputs[0] = first;
+	node.inputs[1] = second;
+	node.weight = weight;
+	node.targetWeight = weight;
+	node.maskId = maskId;
+	tree->nodes.push_back(node);
+	return static_cast<uint32_t>(tree->nodes.size()) - 1;
+}
+
+uint32_t add_lerp_node(BlendTree* tree, uint32_t from, uint32_t to, float weight, int maskId)
+{
+	return add_blend_node(tree, BLEND_NODE_LERP, from, to, weight, maskId);
+}
+
+uint32_t add_additive_node(BlendTree* tree, uint32_t base, uint32_t additive, float weight, int maskId)
+{
+	return add_blend_node(tree, BLEND_NODE_ADDITIVE, base, additive, weight, maskId);
+}
+
+int add_joint_mask(BlendTree* tree, const std::vector<float>& jointWeights)
+{
+	assert(tree);
+	tree->jointMasks.push_back(jointWeights);
+	return static_cast<int>(tree->jointMasks.size()) - 1;
+}
+
+void fade_blend_node(BlendTree* tree, uint32_t nodeId, float targetWeight, float duration)
+{
+	assert(tree);
+	assert(nodeId < tree->nodes.size());
+
+	BlendNode& node = tree->nodes[nodeId];
+	node.targetWeight = targetWeight;
+	if(duration > 0.f)
+	{
+		node.weightSpeed = std::abs(targetWeight - node.weight) / duration;
+	}
+	else
+	{
+		node.weight = targetWeight;
+		node.weightSpeed = 0.f;
+	}
+}
+
+void init_blend_tree_scratch(const Animation& animation, const BlendTree& tree, BlendTreeScratch* scratch)
+{
+	assert(scratch);
+
+	const uint32_t jointCount = static_cast<uint32_t>(animation.bindPose.size());
+	scratch->nodePoses.resize(tree.nodes.size());
+	scratch->trackCursors.resize(tree.nodes.size());
+	scratch->compressed.resize(tree.nodes.size());
+	for(uint32_t i = 0; i < tree.nodes.size(); i++)
+	{
+		resize_local_pose(jointCount, &scratch->nodePoses[i]);
+		if(tree.nodes[i].type != BLEND_NODE_CLIP)
+		{
+			continue;
+		}
+		const uint32_t clipId = tree.nodes[i].clipId;
+		assert(clipId < animation.clips.size());
+		scratch->trackCursors[i].assign(animation.clips[clipId].tracks.size(), 0);
+		if(!animation.compressedClips.empty())
+		{
+			assert(animation.compressedClips.size() == animation.clips.size());
+			init_compressed_animation_scratch(animation.compressedClips[clipId], &scratch->compressed[i]);
+		}
+	}
+	scratch->localTransforms.resize(jointCount);
+	scratch->globalTransforms.resize(jointCount);
+}
+
+void update_blend_tree(const Animation& animation, BlendTree* tree, BlendTreeScratch* scratch, float frameTime, mat4x4* jointMatrices)
+{
+	assert(tree);
+	assert(scratch);
+	assert(jointMatrices);
+	assert(!tree->nodes.empty());
+	assert(scratch->nodePoses.size() == tree->nodes.size());
+
+	const uint32_t jointCount = static_cast<uint32_t>(animation.bindPose.size());
+	for(uint32_t i = 0; i < tree->nodes.size(); i++)
+	{
+		BlendNode& node = tree->nodes[i];
+		if(node.weightSpeed > 0.f)
+		{
+			const float step = node.weightSpeed * frameTime;
+			if(std::abs(node.targetWeight - node.weight) <= step)
+			{
+				node.weight = node.targetWeight;
+				node.weightSpeed = 0.f;
+			}
+			else
+			{
+				node.weight += node.targetWeight > node.weight ? step : -step;
+			}
+		}
+
+		const float* jointMask = node.maskId >= 0 ? tree->jointMasks[node.maskId].data() : nullptr;
+		switch(node.type)
+		{
+			case BLEND_NODE_CLIP:
+			{
+				const AnimationClip& clip = animation.clips[node.clipId];
+				node.currentTime += frameTime * node.playbackRate;
+				if(clip.duration > 0.f)
+				{
+					node.currentTime = fmod(node.currentTime, clip.duration);
+				}
+				//compressed clips replace raw tracks, which are usually dropped
+				if(!animation.compressedClips.empty())
+				{
+					sample_compressed_clip(animation, node.clipId, node.currentTime, &scratch->compressed[i], scratch->localTransforms.data());
+				}
+				else
+				{
+					sample_animation(animation, node.clipId, node.currentTime, scratch->trackCursors[i].data(), scratch->localTransforms.data());
+				}
+				store_local_pose(scratch->localTransforms.data(), jointCount, &scratch->nodePoses[i]);
+				break;
+			}
+			case BLEND_NODE_LERP:
+			{
+				assert(node.inputs[0] < i && node.inputs[1] < i);
+				blend_poses_lerp(scratch->nodePoses[node.inputs[0]], scratch->nodePoses[node.inputs[1]],
+					node.weight, jointMask, jointCount, &scratch->nodePoses[i]);
+				break;
+			}
+			case BLEND_NODE_ADDITIVE:
+			{
+				assert(node.inputs[0] < i && node.inputs[1] < i);
+				blend_poses_additive(scratch->nodePoses[node.inputs[0]], scratch->nodePoses[node.inputs[1]],
+					node.weight, jointMask, jointCount, &scratch->nodePoses[i]);
+				break;
+			}
+		}
+	}
+
+	load_local_pose(scratch->nodePoses.back(), jointCount, scratch->localTransforms.data());
+	generate_global_joint_transforms(animation, scratch->localTransforms.data(), scratch->globalTransforms.data());
+
+	for(uint32_t i = 0; i < jointCount; i++)
+	{
+		jointMatrices[i] = animation.bindPose[i].invBindTransform * scratch->globalTransforms[i];
+	}
+}
+
+void update_blend_trees_batch(JobSystem* jobSystem, const Animation& animation, BlendTreeInstance* instances, uint32_t instanceCount,
+	float frameTime, mat4x4* jointPalette, std::size_t paletteStride)
+{
+	assert(jobSystem);
+	assert(instances || instanceCount == 0);
+	assert(jointPalette || instanceCount == 0);
+	assert(animation.bindPose.size() <= paletteStride);
+
+	//blending a tree costs several clip samples, so chunks are finer than for single clip instances
+	const uint32_t workerCount = get_worker_count(*jobSystem) + 1;
+	const uint32_t grainSize = std::max(1u, instanceCount / (workerCount * 8));
+
+	parallel_for(jobSystem, instanceCount, grainSize, [&](uint32_t begin, uint32_t end) {
+		for(uint32_t i = begin; i < end; i++)
+		{
+			update_blend_tree(animation, &instances[i].tree, &instances[i].scratch, frameTime, jointPalette + i * paletteStride);
+		}
+	});
+}
@@ -0,0 +1,87 @@
+#ifndef MAGMA_BLEND_TREE_H
+#define MAGMA_BLEND_TREE_H
+
+#include "animation.h"
+
+#include <vector>
+
+//structure of arrays local pose, one lane per joint
+struct LocalPose
+{
+	std::vector<float> rotations;//4 planes: x, y, z, w
+	std::vector<float> translations;//3 planes
+	std::vector<float> scales;//3 planes
+};
+
+enum BlendNodeType
+{
+	BLEND_NODE_CLIP,    //samples a clip
+	BLEND_NODE_LERP,    //cross-fades from inputs[0] to inputs[1] by weight
+	BLEND_NODE_ADDITIVE //applies additive clip pose of inputs[1] on top of inputs[0] scaled by weight
+};
+
+struct BlendNode
+{
+	BlendNodeType type;
+	uint32_t clipId;
+	float playbackRate;
+	float currentTime;
+	uint32_t inputs[2];
+	float weight;
+	float targetWeight;
+	float weightSpeed;//weight change per second while fading towards targetWeight
+	int maskId = -1;//per joint weight multipliers, -1 affects every joint
+};
+
+//nodes are stored in evaluation order, inputs always precede the node
+//that consumes them and the last node is the root.
+//a tree holds playback state, so each character owns its own copy
+struct BlendTree
+{
+	std::vector<BlendNode> nodes;
+	std::vector<std::vector<float>> jointMasks;
+};
+
+struct BlendTreeScratch
+{
+	std::vector<LocalPose> nodePoses;
+	std::vector<std::vector<uint32_t>> trackCursors;//per node, empty for blend nodes
+	std::vector<CompressedAnimationScratch> compressed;//per node, set up for clip nodes of animations with compressed clips
+	std::vector<JointTransform> localTransforms;
+	std::vector<mat4x4> globalTransforms;
+};
+
+//character playing its own copy of a blend tree
+struct BlendTreeInstance
+{
+	BlendTree tree;
+	BlendTreeScratch scratch;
+};
+
+uint32_t add_clip_node(BlendTree* tree, uint32_t clipId, float playbackRate = 1.f);
+
+uint32_t add_lerp_node(BlendTree* tree, uint32_t from, uint32_t to, float weight, int maskId = -1);
+
+uint32_t add_additive_node(BlendTree* tree, uint32_t base, uint32_t additive, float weight, int maskId = -1);
+
+int add_joint_mask(BlendTree* tree, const std::vector<float>& jointWeights);
+
+//fades node weight to targetWeight within given seconds
+void fade_blend_node(BlendTree* tree, uint32_t nodeId, float targetWeight, float duration);
+
+void init_blend_tree_scratch(const Animation& animation, const BlendTree& tree, BlendTreeScratch* scratch);
+
+//advances clip times and fades, blends every node and writes skinning matrices.
+//doesn't allocate, so independent trees may be evaluated on different threads
+void update_blend_tree(const Animation& animation, BlendTree* tree, BlendTreeScratch* scratch, float frameTime, mat4x4* jointMatrices);
+
+//instances are split between job system workers like update_animations_batch does,
+//instance i writes its matrices to jointPalette + i * paletteStride
+void update_blend_trees_batch(JobSystem* jobSystem, const Animation& animation, BlendTreeInstance* instances, uint32_t instanceCount,
+	float frameTime, mat4x4* jointPalette, std::size_t paletteStride);
+
+void blend_poses_lerp(const LocalPose& from, const LocalPose& to, float weight, const float* jointMask, uint32_t jointCount, LocalPose* out);
+
+void blend_poses_additive(const LocalPose& base, const LocalPose& additive, float weight, const float* jointMask, uint32_t jointCount, LocalPose* out);
+
+#endif
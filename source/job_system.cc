@@ -0,0 +1,217 @@
+#include "job_system.h"
+
+#include <algorithm>
+#include <cassert>
+
+static thread_local uint32_t currentWorkerQueue = ~0u;
+
+static uint32_t get_submission_queue(JobSystem* jobSystem)
+{
+	if(currentWorkerQueue != ~0u)
+	{
+		return currentWorkerQueue;
+	}
+	//external threads spread their jobs across all queues
+	return jobSystem->nextQueue.fetch_add(1, std::memory_order_relaxed) % jobSystem->queues.size();
+}
+
+//enough for a frame of range jobs, the queue doubles when it runs out
+static constexpr uint32_t INITIAL_QUEUE_CAPACITY = 256;
+
+static void push_job(JobQueue* queue, QueuedJob* job)
+{
+	const uint32_t capacity = static_cast<uint32_t>(queue->jobs.size());
+	if(queue->count == capacity)
+	{
+		std::vector<QueuedJob> grown(std::max(INITIAL_QUEUE_CAPACITY, capacity * 2));
+		for(uint32_t i = 0; i < queue->count; i++)
+		{
+			grown[i] = std::move(queue->jobs[(queue->first + i) & (capacity - 1)]);
+		}
+		queue->jobs.swap(grown);
+		queue->first = 0;
+	}
+
+	const uint32_t mask = static_cast<uint32_t>(queue->jobs.size()) - 1;
+	queue->jobs[(queue->first + queue->count) & mask] = std::move(*job);
+	queue->count++;
+}
+
+static bool try_pop_job(JobSystem* jobSystem, uint32_t ownQueue, QueuedJob* out)
+{
+	const uint32_t queueCount = static_cast<uint32_t>(jobSystem->queues.size());
+	for(uint32_t i = 0; i < queueCount; i++)
+	{
+		JobQueue& queue = *jobSystem->queues[(ownQueue + i) % queueCount];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		if(queue.count == 0)
+		{
+			continue;
+		}
+
+		//newest own job is the hottest in cache, oldest foreign job is the largest chunk of work left
+		const uint32_t mask = static_cast<uint32_t>(queue.jobs.size()) - 1;
+		if(i == 0)
+		{
+			*out = std::move(queue.jobs[(queue.first + queue.count - 1) & mask]);
+		}
+		else
+		{
+			*out = std::move(queue.jobs[queue.first]);
+			queue.first = (queue.first + 1) & mask;
+		}
+		queue.count--;
+		jobSystem->queuedJobs.fetch_sub(1, std::memory_order_relaxed);
+		return true;
+	}
+	return false;
+}
+
+static void run_job(JobSystem* jobSystem, QueuedJob* queuedJob)
+{
+	//captures are released before the counter, whoever waits on it may free what they point to
+	queuedJob->job();
+	queuedJob->job.reset();
+	if(queuedJob->counter->remaining.fetch_sub(1, std::memory_order_acq_rel) == 1)
+	{
+		//threads waiting for the counter sleep on the same condition as idle workers
+		{
+			std::lock_guard<std::mutex> lock(jobSystem->sleepMutex);
+		}
+		jobSystem->sleepCondition.notify_all();
+	}
+}
+
+static void worker_loop(JobSystem* jobSystem, uint32_t queueIndex)
+{
+	currentWorkerQueue = queueIndex;
+	while(jobSystem->isRunning.load(std::memory_order_acquire))
+	{
+		QueuedJob job = {};
+		if(try_pop_job(jobSystem, queueIndex, &job))
+		{
+			run_job(jobSystem, &job);
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(jobSystem->sleepMutex);
+		jobSystem->sleepCondition.wait(lock, [jobSystem]() {
+			return !jobSystem->isRunning.load(std::memory_order_acquire) || jobSystem->queuedJobs.load(std::memory_order_acquire) > 0;
+		});
+	}
+}
+
+void init_job_system(uint32_t workerCount, JobSystem* jobSystem)
+{
+	assert(jobSystem);
+	assert(!jobSystem->isRunning);
+
+	if(workerCount == JOB_SYSTEM_DEFAULT_WORKERS)
+	{
+		const uint32_t hardwareThreads = std::thread::hardware_concurrency();
+		workerCount = hardwareThreads > 1 ? hardwareThreads - 1 : 0;
+	}
+
+	//one queue per worker plus one for threads outside of the pool
+	jobSystem->queues.clear();
+	for(uint32_t i = 0; i < workerCount + 1; i++)
+	{
+		jobSystem->queues.push_back(std::make_unique<JobQueue>());
+		jobSystem->queues.back()->jobs.resize(INITIAL_QUEUE_CAPACITY);
+	}
+
+	jobSystem->isRunning = true;
+	for(uint32_t i = 0; i < workerCount; i++)
+	{
+		jobSystem->workers.emplace_back(worker_loop, jobSystem, i);
+	}
+}
+
+void destroy_job_system(JobSystem* jobSystem)
+{
+	assert(jobSystem);
+
+	{
+		std::lock_guard<std::mutex> lock(jobSystem->sleepMutex);
+		jobSystem->isRunning = false;
+	}
+	jobSystem->sleepCondition.notify_all();
+
+	for(std::thread& worker : jobSystem->workers)
+	{
+		worker.join();
+	}
+	jobSystem->workers.clear();
+	jobSystem->queues.clear();
+}
+
+uint32_t get_worker_count(const JobSystem& jobSystem)
+{
+	return static_cast<uint32_t>(jobSystem.workers.size());
+}
+
+void submit_job(JobSystem* jobSystem, Job job, JobCounter* counter)
+{
+	assert(jobSystem);
+	assert(counter);
+	assert(!jobSystem->queues.empty());
+
+	counter->remaining.fetch_add(1, std::memory_order_relaxed);
+	QueuedJob queuedJob = {std::move(job), counter};
+
+	JobQueue& queue = *jobSystem->queues[get_submission_queue(jobSystem)];
+	{
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		push_job(&queue, &queuedJob);
+	}
+	jobSystem->queuedJobs.fetch_add(1, std::memory_order_release);
+
+	//taking the lock orders the wake up after a worker that is about to sleep checked for jobs
+	{
+		std::lock_guard<std::mutex> lock(jobSystem->sleepMutex);
+	}
+	jobSystem->sleepCondition.notify_one();
+}
+
+void wait_for_counter(JobSystem* jobSystem, JobCounter* counter)
+{
+	assert(jobSystem);
+	assert(counter);
+
+	const uint32_t ownQueue = currentWorkerQueue != ~0u ? currentWorkerQueue : static_cast<uint32_t>(jobSystem->queues.size()) - 1;
+	while(counter->remaining.load(std::memory_order_acquire) > 0)
+	{
+		QueuedJob job = {};
+		if(try_pop_job(jobSystem, ownQueue, &job))
+		{
+			run_job(jobSystem, &job);
+			continue;
+		}
+
+		//remaining jobs of the counter run elsewhere, sleep until they finish or new work shows up
+		std::unique_lock<std::mutex> lock(jobSystem->sleepMutex);
+		jobSystem->sleepCondition.wait(lock, [jobSystem, counter]() {
+			return counter->remaining.load(std::memory_order_acquire) == 0 || jobSystem->queuedJobs.load(std::memory_order_acquire) > 0;
+		});
+	}
+}
+
+bool is_counter_complete(const JobCounter& counter)
+{
+	return counter.remaining.load(std::memory_order_acquire) == 0;
+}
+
+void parallel_for(JobSystem* jobSystem, uint32_t count, uint32_t grainSize, JobRangeFunction function, void* args)
+{
+	assert(jobSystem);
+	assert(function);
+	assert(grainSize > 0);
+
+	JobCounter counter = {};
+	for(uint32_t begin = 0; begin < count; begin += grainSize)
+	{
+		const uint32_t end = std::min(count, begin + grainSize);
+		submit_job(jobSystem, [function, args, begin, end]() {function(args, begin, end);}, &counter);
+	}
+	wait_for_counter(jobSystem, &counter);
+}
@@ -0,0 +1,167 @@
+#ifndef MAGMA_JOB_SYSTEM_H
+#define MAGMA_JOB_SYSTEM_H
+
+#include <atomic>
+#include <cassert>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+static constexpr std::size_t JOB_STORAGE_SIZE = 48;
+
+//callable stored inline, so submitting a job never touches the heap.
+//Captures have to fit into JOB_STORAGE_SIZE, larger state is captured by pointer
+struct Job
+{
+	alignas(std::max_align_t) unsigned char storage[JOB_STORAGE_SIZE];
+	void (*invoke)(void* callable) = nullptr;
+	void (*relocate)(void* callable, void* destination) = nullptr;//moves into destination when not null, then destroys the source
+
+	Job() = default;
+
+	template<typename Function, typename = std::enable_if_t<!std::is_same<std::decay_t<Function>, Job>::value>>
+	Job(Function&& function)
+	{
+		typedef std::decay_t<Function> Callable;
+		static_assert(sizeof(Callable) <= JOB_STORAGE_SIZE, "job captures too much, capture a pointer to the state instead");
+		static_assert(alignof(Callable) <= alignof(std::max_align_t), "job capture is overaligned");
+
+		new(storage) Callable(std::forward<Function>(function));
+		invoke = [](void* callable) {(*static_cast<Callable*>(callable))();};
+		relocate = [](void* callable, void* destination) {
+			Callable* source = static_cast<Callable*>(callable);
+			if(destination)
+			{
+				new(destination) Callable(std::move(*source));
+			}
+			source->~Callable();
+		};
+	}
+
+	Job(Job&& other) noexcept
+	{
+		take(&other);
+	}
+
+	Job& operator=(Job&& other) noexcept
+	{
+		if(this != &other)
+		{
+			reset();
+			take(&other);
+		}
+		return *this;
+	}
+
+	Job(const Job&) = delete;
+	Job& operator=(const Job&) = delete;
+
+	~Job()
+	{
+		reset();
+	}
+
+	void operator()()
+	{
+		assert(invoke);
+		invoke(storage);
+	}
+
+	void reset()
+	{
+		if(relocate)
+		{
+			relocate(storage, nullptr);
+		}
+		invoke = nullptr;
+		relocate = nullptr;
+	}
+
+	void take(Job* other)
+	{
+		if(other->relocate)
+		{
+			other->relocate(other->storage, storage);
+		}
+		invoke = other->invoke;
+		relocate = other->relocate;
+		other->invoke = nullptr;
+		other->relocate = nullptr;
+	}
+};
+
+//tracks completion of a group of jobs
+struct JobCounter
+{
+	std::atomic<uint32_t> remaining = {0};
+};
+
+struct QueuedJob
+{
+	Job job;
+	JobCounter* counter;
+};
+
+//ring buffer that only ever grows, so steady state submission doesn't allocate
+struct JobQueue
+{
+	std::mutex mutex;
+	std::vector<QueuedJob> jobs;//power of two sized
+	uint32_t first = 0;
+	uint32_t count = 0;
+};
+
+//work stealing pool: each worker pops its own queue from the back
+//and steals from the front of other queues once it runs dry
+struct JobSystem
+{
+	std::vector<std::thread> workers;
+	std::vector<std::unique_ptr<JobQueue>> queues;
+	std::mutex sleepMutex;
+	std::condition_variable sleepCondition;//workers wait for jobs, waiting threads for jobs or their counter
+	std::atomic<uint32_t> queuedJobs = {0};
+	std::atomic<uint32_t> nextQueue = {0};
+	std::atomic<bool> isRunning = {false};
+};
+
+static constexpr uint32_t JOB_SYSTEM_DEFAULT_WORKERS = ~0u;//hardware concurrency - 1
+
+//body of a parallel_for range, args is passed through untouched
+typedef void (*JobRangeFunction)(void* args, uint32_t begin, uint32_t end);
+
+//with zero workers jobs run on the thread that waits for them
+void init_job_system(uint32_t workerCount, JobSystem* jobSystem);
+
+void destroy_job_system(JobSystem* jobSystem);
+
+uint32_t get_worker_count(const JobSystem& jobSystem);
+
+void submit_job(JobSystem* jobSystem, Job job, JobCounter* counter);
+
+//calling thread executes queued jobs until counter drops to zero and sleeps while there are none
+void wait_for_counter(JobSystem* jobSystem, JobCounter* counter);
+
+//polls without running any jobs, true once every job of the counter finished
+bool is_counter_complete(const JobCounter& counter);
+
+//splits [0, count) into ranges of grainSize and blocks until all of them are done
+void parallel_for(JobSystem* jobSystem, uint32_t count, uint32_t grainSize, JobRangeFunction function, void* args);
+
+//body is referenced by every range job rather than copied into it, so any callable works without allocating
+template<typename Body>
+void parallel_for(JobSystem* jobSystem, uint32_t count, uint32_t grainSize, const Body& body)
+{
+	JobRangeFunction function = [](void* args, uint32_t begin, uint32_t end) {
+		(*static_cast<const Body*>(args))(begin, end);
+	};
+	parallel_for(jobSystem, count, grainSize, function, const_cast<void*>(static_cast<const void*>(&body)));
+}
+
+#endif
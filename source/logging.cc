@@ -20,6 +20,11 @@ namespace log
 		severityMask |= mask;
 	}
 
+	bool is_enabled(SeverityMask mask)
+	{
+		return (severityMask & mask) != 0;
+	}
+
 	void init_logging()
 	{
 		const char* filter = std::getenv("MAGMA_LOGGING");
@@ -24,6 +24,9 @@ namespace log
 	
 	void set_severity_mask(SeverityFlags mask);
 
+	//lets callers skip gathering data only a filtered out message would print
+	bool is_enabled(SeverityMask mask);
+
 	void dump(const std::string& info, SeverityMask mask);
 	
 	template<typename... Args> void info(Args... args)
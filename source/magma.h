@@ -5,15 +5,29 @@
 #include "input.h"
 #include "camera.h"
 #include "logging.h"
+#include "job_system.h"
 #include "animation.h"
+#include "animation_compression.h"
+#include "blend_tree.h"
 #include "host_timer.h"
 #include "mesh_loaders.h"
+#include "mesh_cache.h"
+#include "mesh_lod.h"
+#include "mipmaps.h"
+#include "texture_compression.h"
+#include "texture_cache.h"
+#include "texture_streaming.h"
+#include "texture_loader.h"
+#include "vertex_compression.h"
 
 #include "vk_types.h"
 #include "vk_dbg.h"
 #include "vk_boilerplate.h"
 #include "vk_shader.h"
 #include "vk_resource.h"
+#include "vk_allocator.h"
+#include "vk_ring_buffer.h"
+#include "vk_upload.h"
 #include "vk_swapchain.h"
 #include "vk_pipeline.h"
 #include "vk_commands.h"
@@ -1003,4 +1003,49 @@ inline mat4x4 quatToRotationMat(const Quat& quat)
 	return out;
 }
 
+//expects orthonormal rotation part, scale has to be removed beforehand
+inline Quat rotationMatToQuat(const mat4x4& mat)
+{
+	//mat is laid out for row vectors, so p[row * 4 + col] is element [col][row] of the column major rotation
+	const float m00 = mat.p[0], m01 = mat.p[4], m02 = mat.p[8];
+	const float m10 = mat.p[1], m11 = mat.p[5], m12 = mat.p[9];
+	const float m20 = mat.p[2], m21 = mat.p[6], m22 = mat.p[10];
+
+	Quat out = {};
+	const float trace = m00 + m11 + m22;
+	if(trace > 0.f)
+	{
+		const float s = 0.5f / sqrt(trace + 1.f);
+		out.w = 0.25f / s;
+		out.x = (m21 - m12) * s;
+		out.y = (m02 - m20) * s;
+		out.z = (m10 - m01) * s;
+	}
+	else if(m00 > m11 && m00 > m22)
+	{
+		const float s = 2.f * sqrt(1.f + m00 - m11 - m22);
+		out.w = (m21 - m12) / s;
+		out.x = 0.25f * s;
+		out.y = (m01 + m10) / s;
+		out.z = (m02 + m20) / s;
+	}
+	else if(m11 > m22)
+	{
+		const float s = 2.f * sqrt(1.f + m11 - m00 - m22);
+		out.w = (m02 - m20) / s;
+		out.x = (m01 + m10) / s;
+		out.y = 0.25f * s;
+		out.z = (m12 + m21) / s;
+	}
+	else
+	{
+		const float s = 2.f * sqrt(1.f + m22 - m00 - m11);
+		out.w = (m10 - m01) / s;
+		out.x = (m02 + m20) / s;
+		out.y = (m12 + m21) / s;
+		out.z = 0.25f * s;
+	}
+	return out;
+}
+
 #endif
\ No newline at end of file
@@ -0,0 +1,577 @@
+#include "mesh_cache.h"
+
+#include "logging.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <type_traits>
+
+static constexpr uint32_t COOKED_MESH_MAGIC = 0x434d474d;//'MGMC'
+static constexpr uint32_t COOKED_MESH_VERSION = 2;
+static constexpr uint64_t COOKED_SECTION_ALIGNMENT = 16;
+
+enum CookedSectionId
+{
+	SECTION_VERTICES,
+	SECTION_INDICES,
+	SECTION_PRIMITIVES,
+	SECTION_PRIMITIVE_BOUNDS,
+	SECTION_JOINTS,
+	SECTION_JOINT_ORDER,
+	SECTION_CLIPS,
+	SECTION_TRACKS,
+	SECTION_KEYS,
+	SECTION_NAMES,
+	SECTION_COUNT
+};
+
+struct CookedSection
+{
+	uint64_t offset;//from the beginning of the file
+	uint64_t size;
+};
+
+struct CookedMeshHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint64_t sourceHash;
+	uint64_t checksum;//of everything past the header
+	uint32_t vertexSize;
+	uint32_t sectionCount;
+	MeshBounds bounds;
+	CookedSection sections[SECTION_COUNT];
+};
+
+struct CookedClip
+{
+	uint32_t nameOffset;
+	uint32_t nameLength;
+	float duration;
+	uint32_t isAdditive;
+	uint32_t firstTrack;
+	uint32_t trackCount;
+};
+
+struct CookedTrack
+{
+	uint32_t jointId;
+	uint32_t channel;
+	uint32_t interpolation;
+	uint32_t keyCount;
+	uint32_t timeOffset;//in floats into key section
+	uint32_t valueOffset;
+};
+
+static_assert(std::is_trivially_copyable<Vertex>::value, "vertices are copied straight from the file");
+static_assert(std::is_trivially_copyable<Joint>::value, "joints are copied straight from the file");
+static_assert(std::is_trivially_copyable<MeshPrimitive>::value, "draw ranges are read straight from the file");
+
+//not cryptographic, only meant to tell stale or damaged files apart
+static uint64_t hash_bytes(const uint8_t* data, std::size_t size, uint64_t seed)
+{
+	constexpr uint64_t prime = 0x9e3779b97f4a7c15ull;
+	uint64_t hash = seed ^ (size * prime);
+	std::size_t i = 0;
+	for(; i + 8 <= size; i += 8)
+	{
+		uint64_t word;
+		memcpy(&word, data + i, 8);
+		word *= prime;
+		word ^= word >> 29;
+		hash = (hash ^ word) * prime;
+		hash ^= hash >> 32;
+	}
+
+	uint64_t tail = 0;
+	memcpy(&tail, data + i, size - i);
+	hash = (hash ^ tail) * prime;
+	hash ^= hash >> 29;
+	return hash;
+}
+
+bool hash_file(const char* path, uint64_t seed, uint64_t* hash)
+{
+	MappedFile file = {};
+	if(!map_file(path, &file))
+	{
+		return false;
+	}
+	*hash = hash_bytes(file.data, file.size, seed);
+	unmap_file(&file);
+	return true;
+}
+
+//collects external uris of a text gltf without parsing the whole document
+static void find_external_uris(const uint8_t* json, std::size_t size, std::vector<std::string>* uris)
+{
+	const char* text = reinterpret_cast<const char*>(json);
+	const char key[] = "\"uri\"";
+	const std::size_t keyLength = sizeof(key) - 1;
+	for(std::size_t i = 0; i + keyLength < size; i++)
+	{
+		if(memcmp(text + i, key, keyLength) != 0)
+		{
+			continue;
+		}
+
+		std::size_t begin = i + keyLength;
+		while(begin < size && text[begin] != '"')
+		{
+			begin++;
+		}
+		std::size_t end = begin + 1;
+		while(end < size && text[end] != '"')
+		{
+			end++;
+		}
+		if(end >= size)
+		{
+			return;
+		}
+
+		std::string uri(text + begin + 1, end - begin - 1);
+		if(uri.compare(0, 5, "data:") != 0)
+		{
+			uris->push_back(std::move(uri));
+		}
+		i = end;
+	}
+}
+
+bool hash_mesh_source(const char* path, uint64_t* sourceHash)
+{
+	assert(path);
+	assert(sourceHash);
+
+	MappedFile file = {};
+	if(!map_file(path, &file))
+	{
+		return false;
+	}
+
+	uint64_t hash = hash_bytes(file.data, file.size, COOKED_MESH_VERSION);
+	std::vector<std::string> uris;
+	const bool isBinary = file.size >= 4 && memcmp(file.data, "glTF", 4) == 0;
+	if(!isBinary)
+	{
+		find_external_uris(file.data, file.size, &uris);
+	}
+	unmap_file(&file);
+
+	const std::string source = path;
+	const std::size_t separator = source.find_last_of("/\\");
+	const std::string baseDir = separator == std::string::npos ? std::string() : source.substr(0, separator + 1);
+	for(const std::string& uri : uris)
+	{
+		//missing images shouldn't prevent geometry from being cached
+		uint64_t uriHash = 0;
+		if(hash_file((baseDir + uri).c_str(), hash, &uriHash))
+		{
+			hash = uriHash;
+		}
+	}
+
+	*sourceHash = hash;
+	return true;
+}
+
+MeshBounds compute_mesh_bounds(const Vertex* vertices, uint32_t vertexCount)
+{
+	MeshBounds bounds = {};
+	if(!vertexCount)
+	{
+		return bounds;
+	}
+
+	bounds.min = vertices[0].position;
+	bounds.max = vertices[0].position;
+	for(uint32_t i = 1; i < vertexCount; i++)
+	{
+		for(uint32_t c = 0; c < 3; c++)
+		{
+			bounds.min.data[c] = std::min(bounds.min.data[c], vertices[i].position.data[c]);
+			bounds.max.data[c] = std::max(bounds.max.data[c], vertices[i].position.data[c]);
+		}
+	}
+
+	bounds.center = (bounds.min + bounds.max) * 0.5f;
+	float radiusSq = 0.f;
+	for(uint32_t i = 0; i < vertexCount; i++)
+	{
+		const Vec3 offset = vertices[i].position - bounds.center;
+		radiusSq = std::max(radiusSq, dotVec3(offset, offset));
+	}
+	bounds.radius = sqrtf(radiusSq);
+	return bounds;
+}
+
+static CookedSection append_section(std::vector<uint8_t>* file, const void* data, std::size_t size)
+{
+	const std::size_t offset = (file->size() + COOKED_SECTION_ALIGNMENT - 1) & ~(COOKED_SECTION_ALIGNMENT - 1);
+	file->resize(offset + size);
+	if(size)
+	{
+		memcpy(file->data() + offset, data, size);
+	}
+	return {offset, size};
+}
+
+template<typename T>
+static CookedSection append_section(std::vector<uint8_t>* file, const std::vector<T>& items)
+{
+	return append_section(file, items.data(), items.size() * sizeof(T));
+}
+
+bool cook_mesh(const char* cookedPath, uint64_t sourceHash, const Scene& scene, const Animation* animation)
+{
+	assert(cookedPath);
+
+	CookedMeshHeader header = {};
+	header.magic = COOKED_MESH_MAGIC;
+	header.version = COOKED_MESH_VERSION;
+	header.sourceHash = sourceHash;
+	header.vertexSize = sizeof(Vertex);
+	header.sectionCount = SECTION_COUNT;
+	header.bounds = compute_mesh_bounds(scene.vertexBuffer.data(), scene.vertexBuffer.size());
+
+	std::vector<MeshBounds> primitiveBounds(scene.primitives.size());
+	for(std::size_t i = 0; i < scene.primitives.size(); i++)
+	{
+		const MeshPrimitive& primitive = scene.primitives[i];
+		assert(std::size_t(primitive.vertexOffset) + primitive.vertexCount <= scene.vertexBuffer.size());
+		assert(std::size_t(primitive.firstIndex) + primitive.indexCount <= scene.indexBuffer.size());
+		primitiveBounds[i] = compute_mesh_bounds(scene.vertexBuffer.data() + primitive.vertexOffset, primitive.vertexCount);
+	}
+
+	std::vector<CookedClip> clips;
+	std::vector<CookedTrack> tracks;
+	std::vector<float> keys;
+	std::vector<char> names;
+	if(animation)
+	{
+		for(const AnimationClip& clip : animation->clips)
+		{
+			CookedClip cookedClip = {};
+			cookedClip.nameOffset = names.size();
+			cookedClip.nameLength = clip.name.size();
+			cookedClip.duration = clip.duration;
+			cookedClip.isAdditive = clip.isAdditive;
+			cookedClip.firstTrack = tracks.size();
+			cookedClip.trackCount = clip.tracks.size();
+			clips.push_back(cookedClip);
+			names.insert(names.end(), clip.name.begin(), clip.name.end());
+
+			for(const AnimationTrack& track : clip.tracks)
+			{
+				CookedTrack cookedTrack = {};
+				cookedTrack.jointId = track.jointId;
+				cookedTrack.channel = track.channel;
+				cookedTrack.interpolation = track.interpolation;
+				cookedTrack.keyCount = track.timeCodes.size();
+				cookedTrack.timeOffset = keys.size();
+				keys.insert(keys.end(), track.timeCodes.begin(), track.timeCodes.end());
+				cookedTrack.valueOffset = keys.size();
+				keys.insert(keys.end(), track.values.begin(), track.values.end());
+				tracks.push_back(cookedTrack);
+			}
+		}
+	}
+
+	std::vector<uint8_t> file(sizeof(CookedMeshHeader));
+	header.sections[SECTION_VERTICES] = append_section(&file, scene.vertexBuffer);
+	header.sections[SECTION_INDICES] = append_section(&file, scene.indexBuffer);
+	header.sections[SECTION_PRIMITIVES] = append_section(&file, scene.primitives);
+	header.sections[SECTION_PRIMITIVE_BOUNDS] = append_section(&file, primitiveBounds);
+	//empty sections still get a valid offset
+	header.sections[SECTION_JOINTS] = append_section(&file, animation ? animation->bindPose : std::vector<Joint>());
+	header.sections[SECTION_JOINT_ORDER] = append_section(&file, animation ? animation->jointOrder : std::vector<uint32_t>());
+	header.sections[SECTION_CLIPS] = append_section(&file, clips);
+	header.sections[SECTION_TRACKS] = append_section(&file, tracks);
+	header.sections[SECTION_KEYS] = append_section(&file, keys);
+	header.sections[SECTION_NAMES] = append_section(&file, names);
+	header.checksum = hash_bytes(file.data() + sizeof(header), file.size() - sizeof(header), sourceHash);
+	memcpy(file.data(), &header, sizeof(header));
+
+	//readers never see partially written file
+	const std::string tempPath = std::string(cookedPath) + ".tmp";
+	FILE* out = fopen(tempPath.c_str(), "wb");
+	if(!out)
+	{
+		magma::log::error("Failed to open {} for writing", tempPath);
+		return false;
+	}
+	const bool written = fwrite(file.data(), 1, file.size(), out) == file.size();
+	if(fclose(out) != 0 || !written)
+	{
+		magma::log::error("Failed to write cooked mesh {}", tempPath);
+		remove(tempPath.c_str());
+		return false;
+	}
+
+	remove(cookedPath);
+	if(rename(tempPath.c_str(), cookedPath) != 0)
+	{
+		magma::log::error("Failed to move cooked mesh to {}", cookedPath);
+		remove(tempPath.c_str());
+		return false;
+	}
+	return true;
+}
+
+static const uint8_t* get_section_data(const CookedMesh& mesh, CookedSectionId sectionId, std::size_t* size)
+{
+	const CookedMeshHeader* header = reinterpret_cast<const CookedMeshHeader*>(mesh.file.data);
+	*size = header->sections[sectionId].size;
+	return mesh.file.data + header->sections[sectionId].offset;
+}
+
+bool open_cooked_mesh(const char* cookedPath, uint64_t sourceHash, CookedMesh* out)
+{
+	assert(cookedPath);
+	assert(out);
+	*out = {};
+
+	MappedFile file = {};
+	if(!map_file(cookedPath, &file))
+	{
+		return false;
+	}
+
+	CookedMeshHeader header = {};
+	bool isValid = file.size >= sizeof(header);
+	if(isValid)
+	{
+		memcpy(&header, file.data, sizeof(header));
+		isValid = header.magic == COOKED_MESH_MAGIC && header.version == COOKED_MESH_VERSION
+			&& header.vertexSize == sizeof(Vertex) && header.sectionCount == SECTION_COUNT
+			&& header.sourceHash == sourceHash;
+	}
+
+	for(uint32_t i = 0; isValid && i < SECTION_COUNT; i++)
+	{
+		const CookedSection& section = header.sections[i];
+		isValid = section.offset % COOKED_SECTION_ALIGNMENT == 0 && section.offset >= sizeof(header)
+			&& section.offset <= file.size && section.size <= file.size - section.offset;
+	}
+
+	if(isValid)
+	{
+		isValid = hash_bytes(file.data + sizeof(header), file.size - sizeof(header), sourceHash) == header.checksum;
+	}
+
+	const CookedSection* sections = header.sections;
+	if(isValid)
+	{
+		isValid = sections[SECTION_VERTICES].size % sizeof(Vertex) == 0
+			&& sections[SECTION_INDICES].size % sizeof(unsigned int) == 0
+			&& sections[SECTION_PRIMITIVES].size % sizeof(MeshPrimitive) == 0
+			&& sections[SECTION_PRIMITIVE_BOUNDS].size == sections[SECTION_PRIMITIVES].size / sizeof(MeshPrimitive) * sizeof(MeshBounds);
+	}
+
+	//every draw range has to stay inside the buffers
+	const std::size_t vertexCount = sections[SECTION_VERTICES].size / sizeof(Vertex);
+	const std::size_t indexCount = sections[SECTION_INDICES].size / sizeof(unsigned int);
+	const std::size_t primitiveCount = isValid ? sections[SECTION_PRIMITIVES].size / sizeof(MeshPrimitive) : 0;
+	for(std::size_t i = 0; i < primitiveCount && isValid; i++)
+	{
+		MeshPrimitive primitive = {};
+		memcpy(&primitive, file.data + sections[SECTION_PRIMITIVES].offset + i * sizeof(MeshPrimitive), sizeof(primitive));
+		isValid = std::size_t(primitive.vertexOffset) + primitive.vertexCount <= vertexCount
+			&& std::size_t(primitive.firstIndex) + primitive.indexCount <= indexCount;
+	}
+
+	if(!isValid)
+	{
+		magma::log::warn("Cooked mesh {} is stale or damaged", cookedPath);
+		unmap_file(&file);
+		return false;
+	}
+
+	out->file = file;
+	out->vertices = reinterpret_cast<const Vertex*>(file.data + sections[SECTION_VERTICES].offset);
+	out->vertexCount = sections[SECTION_VERTICES].size / sizeof(Vertex);
+	out->indices = reinterpret_cast<const unsigned int*>(file.data + sections[SECTION_INDICES].offset);
+	out->indexCount = sections[SECTION_INDICES].size / sizeof(unsigned int);
+	out->primitives = reinterpret_cast<const MeshPrimitive*>(file.data + sections[SECTION_PRIMITIVES].offset);
+	out->primitiveBounds = reinterpret_cast<const MeshBounds*>(file.data + sections[SECTION_PRIMITIVE_BOUNDS].offset);
+	out->primitiveCount = sections[SECTION_PRIMITIVES].size / sizeof(MeshPrimitive);
+	out->bounds = header.bounds;
+	out->hasAnimation = sections[SECTION_JOINTS].size != 0;
+	return true;
+}
+
+void close_cooked_mesh(CookedMesh* mesh)
+{
+	assert(mesh);
+	unmap_file(&mesh->file);
+	*mesh = {};
+}
+
+bool read_cooked_animation(const CookedMesh& mesh, Animation* animation)
+{
+	assert(animation);
+	assert(mesh.file.data);
+	*animation = {};
+	if(!mesh.hasAnimation)
+	{
+		return false;
+	}
+
+	std::size_t jointsSize, orderSize, clipsSize, tracksSize, keysSize, namesSize;
+	const uint8_t* joints = get_section_data(mesh, SECTION_JOINTS, &jointsSize);
+	const uint8_t* order = get_section_data(mesh, SECTION_JOINT_ORDER, &orderSize);
+	const CookedClip* clips = reinterpret_cast<const CookedClip*>(get_section_data(mesh, SECTION_CLIPS, &clipsSize));
+	const CookedTrack* tracks = reinterpret_cast<const CookedTrack*>(get_section_data(mesh, SECTION_TRACKS, &tracksSize));
+	const float* keys = reinterpret_cast<const float*>(get_section_data(mesh, SECTION_KEYS, &keysSize));
+	const char* names = reinterpret_cast<const char*>(get_section_data(mesh, SECTION_NAMES, &namesSize));
+	const std::size_t trackCount = tracksSize / sizeof(CookedTrack);
+	const std::size_t keyCount = keysSize / sizeof(float);
+
+	animation->bindPose.resize(jointsSize / sizeof(Joint));
+	memcpy(animation->bindPose.data(), joints, animation->bindPose.size() * sizeof(Joint));
+	animation->jointOrder.resize(orderSize / sizeof(uint32_t));
+	memcpy(animation->jointOrder.data(), order, animation->jointOrder.size() * sizeof(uint32_t));
+
+	animation->clips.resize(clipsSize / sizeof(CookedClip));
+	for(std::size_t i = 0; i < animation->clips.size(); i++)
+	{
+		const CookedClip& cookedClip = clips[i];
+		if(std::size_t(cookedClip.nameOffset) + cookedClip.nameLength > namesSize
+			|| std::size_t(cookedClip.firstTrack) + cookedClip.trackCount > trackCount)
+		{
+			magma::log::error("Cooked mesh clip {} is out of bounds", i);
+			*animation = {};
+			return false;
+		}
+
+		AnimationClip& clip = animation->clips[i];
+		clip.name.assign(names + cookedClip.nameOffset, cookedClip.nameLength);
+		clip.duration = cookedClip.duration;
+		clip.isAdditive = cookedClip.isAdditive;
+		clip.tracks.resize(cookedClip.trackCount);
+		for(uint32_t t = 0; t < cookedClip.trackCount; t++)
+		{
+			const CookedTrack& cookedTrack = tracks[cookedClip.firstTrack + t];
+			const uint32_t valueWidth = cookedTrack.channel == CHANNEL_ROTATE_BIT ? 4 : 3;
+			const std::size_t valueCount = std::size_t(cookedTrack.keyCount) * valueWidth;
+			if(std::size_t(cookedTrack.timeOffset) + cookedTrack.keyCount > keyCount
+				|| std::size_t(cookedTrack.valueOffset) + valueCount > keyCount)
+			{
+				magma::log::error("Cooked mesh track {} of clip {} is out of bounds", t, i);
+				*animation = {};
+				return false;
+			}
+
+			AnimationTrack& track = clip.tracks[t];
+			track.jointId = cookedTrack.jointId;
+			track.channel = static_cast<AnimChannel>(cookedTrack.channel);
+			track.interpolation = static_cast<AnimInterpolation>(cookedTrack.interpolation);
+			track.timeCodes.assign(keys + cookedTrack.timeOffset, keys + cookedTrack.timeOffset + cookedTrack.keyCount);
+			track.values.assign(keys + cookedTrack.valueOffset, keys + cookedTrack.valueOffset + valueCount);
+		}
+	}
+	return true;
+}
+
+static std::string get_cooked_path(const char* cacheDir, uint64_t hash, const char* extension)
+{
+	char fileName[32];
+	snprintf(fileName, sizeof(fileName), "/%016llx.%s", static_cast<unsigned long long>(hash), extension);
+	return std::string(cacheDir) + fileName;
+}
+
+//every source path keeps a small file naming its current entry, entries it named before
+//are stale once source or settings change, and get deleted instead of piling up
+static void replace_cooked_entry(const char* path, const char* cacheDir, uint64_t sourceHash)
+{
+	const uint64_t pathHash = hash_bytes(reinterpret_cast<const uint8_t*>(path), strlen(path), COOKED_MESH_VERSION);
+	const std::string referencePath = get_cooked_path(cacheDir, pathHash, "ref");
+
+	uint64_t previousHash = sourceHash;
+	FILE* reference = fopen(referencePath.c_str(), "rb");
+	if(reference)
+	{
+		if(fread(&previousHash, sizeof(previousHash), 1, reference) != 1)
+		{
+			previousHash = sourceHash;
+		}
+		fclose(reference);
+	}
+	if(reference && previousHash == sourceHash)
+	{
+		return;
+	}
+	if(previousHash != sourceHash)
+	{
+		const std::string stalePath = get_cooked_path(cacheDir, previousHash, "mesh");
+		if(std::remove(stalePath.c_str()) == 0)
+		{
+			magma::log::info("Removed stale cooked entry {} of {}", stalePath, path);
+		}
+	}
+
+	reference = fopen(referencePath.c_str(), "wb");
+	if(!reference)
+	{
+		magma::log::warn("Failed to open {} for writing", referencePath);
+		return;
+	}
+	const bool written = fwrite(&sourceHash, sizeof(sourceHash), 1, reference) == 1;
+	if(fclose(reference) != 0 || !written)
+	{
+		magma::log::warn("Failed to write cooked entry reference {}", referencePath);
+	}
+}
+
+bool load_GLTF_cached(const char* path, const char* cacheDir, CookedMesh* out, JobSystem* jobSystem, const MeshOptimizeSettings& settings)
+{
+	assert(path);
+	assert(cacheDir);
+	assert(out);
+
+	uint64_t sourceHash = 0;
+	if(!hash_mesh_source(path, &sourceHash))
+	{
+		return false;
+	}
+	//cooked geometry depends on optimisation stages as much as on the source
+	sourceHash = hash_bytes(reinterpret_cast<const uint8_t*>(&settings), sizeof(settings), sourceHash);
+
+	const std::string cookedPath = get_cooked_path(cacheDir, sourceHash, "mesh");
+	//probe first so that a cold cache doesn't log failed mapping
+	FILE* cachedFile = fopen(cookedPath.c_str(), "rb");
+	if(cachedFile)
+	{
+		fclose(cachedFile);
+	}
+	if(cachedFile && open_cooked_mesh(cookedPath.c_str(), sourceHash, out))
+	{
+		replace_cooked_entry(path, cacheDir, sourceHash);
+		return true;
+	}
+
+	Scene scene = {};
+	Animation animation = {};
+	if(!load_GLTF_scene(path, &scene, jobSystem, &animation, settings))
+	{
+		return false;
+	}
+	if(scene.primitives.empty())
+	{
+		magma::log::error("Gltf model {} doesn't contain any triangles!", path);
+		return false;
+	}
+
+	const Animation* cookedAnimation = animation.bindPose.empty() ? nullptr : &animation;
+	if(!create_directory(cacheDir) || !cook_mesh(cookedPath.c_str(), sourceHash, scene, cookedAnimation))
+	{
+		return false;
+	}
+	magma::log::info("Cooked {} into {}", path, cookedPath);
+	replace_cooked_entry(path, cacheDir, sourceHash);
+	return open_cooked_mesh(cookedPath.c_str(), sourceHash, out);
+}
@@ -0,0 +1,54 @@
+#ifndef MAGMA_MESH_CACHE_H
+#define MAGMA_MESH_CACHE_H
+
+#include "mesh_loaders.h"
+#include "platform/platform.h"
+
+struct MeshBounds
+{
+	Vec3 min;
+	Vec3 max;
+	Vec3 center;
+	float radius;
+};
+
+//read only view of a mapped cooked mesh file, pointers stay valid until close_cooked_mesh
+struct CookedMesh
+{
+	MappedFile file;
+	const Vertex* vertices;
+	uint32_t vertexCount;
+	const unsigned int* indices;
+	uint32_t indexCount;
+	const MeshPrimitive* primitives;
+	const MeshBounds* primitiveBounds;
+	uint32_t primitiveCount;
+	MeshBounds bounds;
+	bool hasAnimation;
+};
+
+//hash of file contents, meant to tell stale cooked files apart
+bool hash_file(const char* path, uint64_t seed, uint64_t* hash);
+
+//hash of the source file and every external buffer it references
+bool hash_mesh_source(const char* path, uint64_t* sourceHash);
+
+//writes optimised geometry of every scene primitive with its draw range and bounds, plus optional animation.
+//Node transforms aren't baked, primitives keep the space of their source mesh
+bool cook_mesh(const char* cookedPath, uint64_t sourceHash, const Scene& scene, const Animation* animation);
+
+//fails on version, checksum or source hash mismatch
+bool open_cooked_mesh(const char* cookedPath, uint64_t sourceHash, CookedMesh* out);
+
+void close_cooked_mesh(CookedMesh* mesh);
+
+bool read_cooked_animation(const CookedMesh& mesh, Animation* animation);
+
+//returns cooked entry of a gltf file from cacheDir, cooking it first when the entry is missing or stale.
+//Settings are part of the entry key, so the same file cooked with other settings gets its own entry
+bool load_GLTF_cached(const char* path, const char* cacheDir, CookedMesh* out, JobSystem* jobSystem = nullptr,
+	const MeshOptimizeSettings& settings = MESH_OPTIMIZE_DEFAULT);
+
+MeshBounds compute_mesh_bounds(const Vertex* vertices, uint32_t vertexCount);
+
+#endif
@@ -15,8 +15,14 @@
 #include <meshoptimizer.h>
 
 #include <algorithm>
+#include <functional>
+#include <unordered_map>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 
 #include "logging.h"
+#include "platform/platform.h"
 
 bool load_texture(const char* path, TextureInfo* out, bool flipImage)
 {
@@ -25,7 +31,8 @@ bool load_texture(const char* path, TextureInfo* out, bool flipImage)
 	int numChannels;
 	assert(out);
 
-	stbi_set_flip_vertically_on_load(flipImage);
+	//per thread flag, textures get decoded on job system workers
+	stbi_set_flip_vertically_on_load_thread(flipImage);
 	uint8_t* data = stbi_load(path, &twidth, &theight, &numChannels, 4);
 	
 	if(!data) 
@@ -41,320 +48,975 @@ bool load_texture(const char* path, TextureInfo* out, bool flipImage)
 	return true;
 }
 
+void free_texture(TextureInfo* texture)
+{
+	assert(texture);
+	stbi_image_free(texture->data);
+	texture->data = nullptr;
+}
+
+static constexpr uint32_t POST_TRANSFORM_CACHE_SIZE = 16;
+
+static MeshCacheStats analyze_mesh(const unsigned int* indices, uint32_t indexCount, uint32_t vertexCount)
+{
+	const meshopt_VertexCacheStatistics cacheStats = meshopt_analyzeVertexCache(indices, indexCount, vertexCount, POST_TRANSFORM_CACHE_SIZE, 0, 0);
+	const meshopt_VertexFetchStatistics fetchStats = meshopt_analyzeVertexFetch(indices, indexCount, vertexCount, sizeof(Vertex));
+	return {cacheStats.acmr, cacheStats.atvr, fetchStats.overfetch};
+}
+
+uint32_t optimize_mesh(const MeshOptimizeSettings& settings, Vertex* vertices, uint32_t vertexCount,
+	unsigned int* indices, uint32_t indexCount, MeshOptimizeStats* stats)
+{
+	assert(vertices);
+	assert(indices);
+	assert(indexCount % 3 == 0);
+
+	MeshOptimizeStats currentStats = {};
+	if(stats)
+	{
+		currentStats.input = analyze_mesh(indices, indexCount, vertexCount);
+	}
+
+	currentStats.vertexCache = currentStats.input;
+	if(settings.stages & OPTIMIZE_VERTEX_CACHE)
+	{
+		meshopt_optimizeVertexCache(indices, indices, indexCount, vertexCount);
+		if(stats)
+		{
+			currentStats.vertexCache = analyze_mesh(indices, indexCount, vertexCount);
+		}
+	}
+
+	currentStats.overdraw = currentStats.vertexCache;
+	if(settings.stages & OPTIMIZE_OVERDRAW)
+	{
+		meshopt_optimizeOverdraw(indices, indices, indexCount, &vertices[0].position.x, vertexCount, sizeof(Vertex), settings.overdrawThreshold);
+		if(stats)
+		{
+			currentStats.overdraw = analyze_mesh(indices, indexCount, vertexCount);
+		}
+	}
+
+	uint32_t usedVertexCount = vertexCount;
+	currentStats.vertexFetch = currentStats.overdraw;
+	if(settings.stages & OPTIMIZE_VERTEX_FETCH)
+	{
+		usedVertexCount = meshopt_optimizeVertexFetch(vertices, indices, indexCount, vertices, vertexCount, sizeof(Vertex));
+		if(stats)
+		{
+			currentStats.vertexFetch = analyze_mesh(indices, indexCount, usedVertexCount);
+		}
+	}
+
+	if(stats)
+	{
+		*stats = currentStats;
+	}
+	return usedVertexCount;
+}
+
 struct RemappedData
 {
 	std::vector<Vertex> remappedVertices;
 	std::vector<unsigned int> remappedIndices;
 };
 
-static RemappedData mesh_optimize(const Vertex* vertices, uint32_t vcount, uint32_t indexCount, const unsigned int* indices = nullptr)
+static RemappedData mesh_optimize(const MeshOptimizeSettings& settings, const Vertex* vertices, uint32_t vcount, uint32_t indexCount, const unsigned int* indices = nullptr)
 {
 	RemappedData data = {};
 	
 	std::vector<unsigned int> remapTable = {};
-	remapTable.resize(indexCount);//total nums of indices
+	remapTable.resize(vcount);//one entry per source vertex
 	std::size_t newVertCount = meshopt_generateVertexRemap(remapTable.data(), 
 		indices, indexCount,
 		vertices, vcount, sizeof(Vertex)
 	);
 	
-	std::vector<Vertex> vertexBuffer = {};
-	vertexBuffer.resize(newVertCount);
-	meshopt_remapVertexBuffer(vertexBuffer.data(), vertices, vcount, sizeof(Vertex), remapTable.data());
-	std::vector<unsigned int> indexBuffer = {};
-	indexBuffer.resize(indexCount);
-	meshopt_remapIndexBuffer(indexBuffer.data(), indices, indexCount, remapTable.data());
-
-	return RemappedData {
-		vertexBuffer,
-		indexBuffer
-	};
+	data.remappedVertices.resize(newVertCount);
+	meshopt_remapVertexBuffer(data.remappedVertices.data(), vertices, vcount, sizeof(Vertex), remapTable.data());
+	data.remappedIndices.resize(indexCount);
+	meshopt_remapIndexBuffer(data.remappedIndices.data(), indices, indexCount, remapTable.data());
+
+	//analysing the mesh costs more than some stages, so stats are only gathered to be logged
+	const bool logStats = magma::log::is_enabled(magma::log::MASK_DEBUG);
+	MeshOptimizeStats stats = {};
+	const uint32_t usedVertCount = optimize_mesh(settings,
+		data.remappedVertices.data(), data.remappedVertices.size(),
+		data.remappedIndices.data(), indexCount, logStats ? &stats : nullptr
+	);
+	data.remappedVertices.resize(usedVertCount);
+	if(logStats)
+	{
+		magma::log::debug("Mesh optimised: acmr {:.3f} -> {:.3f}, atvr {:.3f} -> {:.3f}, overfetch {:.3f} -> {:.3f}",
+			stats.input.acmr, stats.vertexFetch.acmr, stats.input.atvr, stats.vertexFetch.atvr,
+			stats.input.overfetch, stats.vertexFetch.overfetch
+		);
+	}
+
+	return data;
 }
 
-bool load_GLTF(const char* path, Mesh* geom, Animation* animation)
+//view into accessor elements, points straight into buffer memory which is either
+//owned by tinygltf or the binary chunk of a mapped glb file
+struct AccessorView
 {
-	assert(geom);
+	const uint8_t* data;
+	std::size_t count;
+	std::size_t stride;
+	int componentType;
+	int type;
+	bool normalized;
+};
 
-	tinygltf::Model gltfModel = {};
-	tinygltf::TinyGLTF loader = {};
-	
-	std::string err = {};
-	std::string warn = {};
-	const std::string path_string = {path};
+//parsed json of a gltf file together with the binary chunk of a mapped glb
+struct GLTFSource
+{
+	tinygltf::Model model;
+	const uint8_t* binaryChunk;
+	std::size_t binaryChunkSize;
+};
 
-	bool loadStatus = loader.LoadASCIIFromFile(&gltfModel, &err, &warn, path_string);
-	if(!loadStatus)
+static const uint8_t* get_gltf_buffer_data(const GLTFSource& source, int bufferId, std::size_t* bufferSize)
+{
+	const tinygltf::Buffer& buffer = source.model.buffers[bufferId];
+	//glb binary chunk isn't copied out of the mapped file
+	if(buffer.data.empty() && buffer.uri.empty() && source.binaryChunk)
 	{
-		magma::log::error("Failed to load gltf model! reason {}", err);
+		*bufferSize = source.binaryChunkSize;
+		return source.binaryChunk;
+	}
+	*bufferSize = buffer.data.size();
+	return buffer.data.data();
+}
+
+static bool get_accessor_view(const GLTFSource& source, int accessorId, AccessorView* out)
+{
+	assert(out);
+	const tinygltf::Model& gltfModel = source.model;
+	if(accessorId < 0 || accessorId >= static_cast<int>(gltfModel.accessors.size()))
+	{
+		magma::log::error("Invalid gltf accessor {}", accessorId);
 		return false;
 	}
-	
-	//find first node, containing actual mesh data
-	auto meshNode = std::find_if(gltfModel.nodes.begin(), gltfModel.nodes.end(),
-		[](tinygltf::Node& node) {return node.mesh >= 0;}
-	);
 
-	uint32_t meshId = static_cast<uint32_t>(meshNode->mesh);
-
-	auto& mesh = gltfModel.meshes[meshId];
-	auto& attributesMap = mesh.primitives[0].attributes;
-
-	int accessorPositionPos = attributesMap["POSITION"];
-	int accessorNormalPos = attributesMap["NORMAL"];
-	int accessorUVPos = attributesMap["TEXCOORD_0"];
-	int accessorJointIdPos = attributesMap["JOINTS_0"];
-	int accessorWeightPos = attributesMap["WEIGHTS_0"];
-	int accessorIndexPos = mesh.primitives[0].indices;
-
-	auto& posAccessor = gltfModel.accessors[accessorPositionPos];
-	auto& normalAccessor = gltfModel.accessors[accessorNormalPos];
-	auto& uvAccessor = gltfModel.accessors[accessorUVPos];
-	auto& jointIdAccessor = gltfModel.accessors[accessorJointIdPos];
-	auto& weightAccessor = gltfModel.accessors[accessorWeightPos];
-	auto& indexAccessor = gltfModel.accessors[accessorIndexPos];
-
-	int posBufferViewId = posAccessor.bufferView;
-	int normalBufferViewId = normalAccessor.bufferView;
-	int uvBufferViewId = uvAccessor.bufferView;
-	int jointBufferViewId = jointIdAccessor.bufferView;
-	int weightBufferViewId = weightAccessor.bufferView;
-	int indexBufferViewId = indexAccessor.bufferView;
-
-	const std::size_t numberOfPositions = posAccessor.count;
-	const std::size_t numberOfNormals = normalAccessor.count;
-	const std::size_t numberOfUVs = uvAccessor.count;
-	const std::size_t numberOfJointIds = jointIdAccessor.count;
-	const std::size_t numberOfWeights = weightAccessor.count;
-	const std::size_t numberOfIndices = indexAccessor.count;
-
-	auto& posBufferView = gltfModel.bufferViews[posBufferViewId];
-	auto& normalBufferView = gltfModel.bufferViews[normalBufferViewId];
-	auto& uvBufferView = gltfModel.bufferViews[uvBufferViewId];
-	auto& jointIdBufferView = gltfModel.bufferViews[jointBufferViewId];
-	auto& weightBufferView = gltfModel.bufferViews[weightBufferViewId];
-	auto& indexBufferView = gltfModel.bufferViews[indexBufferViewId];
-
-	const std::size_t posByteOffset = posBufferView.byteOffset;
-	const std::size_t normalByteOffset = normalBufferView.byteOffset;
-	const std::size_t uvByteOffset = uvBufferView.byteOffset;
-	const std::size_t jointIdByteOffset = jointIdBufferView.byteOffset;
-	const std::size_t weightByteOffset = weightBufferView.byteOffset;
-	const std::size_t indexByteOffset = indexBufferView.byteOffset;
-
-	const int posBufferId = posBufferView.buffer;
-	const int norBufferId = normalBufferView.buffer;
-	const int uvBufferId = uvBufferView.buffer;
-	const int jointBufferId = jointIdBufferView.buffer;
-	const int weightBufferId = weightBufferView.buffer;
-	const int indexBufferId = indexBufferView.buffer;
-	
-	auto& posBuffer = gltfModel.buffers[posBufferId];
-	auto& normalBuffer = gltfModel.buffers[norBufferId];
-	auto& uvBuffer = gltfModel.buffers[uvBufferId];
-	auto& jointIdBuffer = gltfModel.buffers[jointBufferId];
-	auto& weightBuffer = gltfModel.buffers[weightBufferId];
+	const tinygltf::Accessor& accessor = gltfModel.accessors[accessorId];
+	if(accessor.sparse.isSparse || accessor.bufferView < 0)
+	{
+		magma::log::error("Sparse and buffer less gltf accessors are not supported!");
+		return false;
+	}
 
-	auto& indexBuffer = gltfModel.buffers[indexBufferId];
-	
-	const uint8_t* posBufferData = posBuffer.data.data() + posByteOffset;
-	const uint8_t* normalBufferData = normalBuffer.data.data() + normalByteOffset;
-	const uint8_t* uvBufferData = uvBuffer.data.data() + uvByteOffset;
-	const uint8_t* jointIdData = jointIdBuffer.data.data() + jointIdByteOffset;
-	const uint8_t* weightData = weightBuffer.data.data() + weightByteOffset; 
-	const uint8_t* indexBufferData = indexBuffer.data.data() + indexByteOffset;
-	
-	const Vec3* positions = (Vec3*)posBufferData;
-	const Vec3* normals = (Vec3*)normalBufferData;
-	const Vec2* uvs = (Vec2*)uvBufferData;
-	const uint16_t* jointIds = (uint16_t*)jointIdData;
-	const Vec4* weights = (Vec4*)weightData;
-	const uint16_t* rawIndices = (uint16_t*)indexBufferData;
+	const tinygltf::BufferView& bufferView = gltfModel.bufferViews[accessor.bufferView];
+	const std::size_t elementSize = tinygltf::GetComponentSizeInBytes(accessor.componentType) * tinygltf::GetNumComponentsInType(accessor.type);
+	const std::size_t stride = bufferView.byteStride ? bufferView.byteStride : elementSize;
+	const std::size_t offset = bufferView.byteOffset + accessor.byteOffset;
 
-	std::vector<Vertex> vertices = {};
-	vertices.resize(numberOfPositions);
+	std::size_t bufferSize = 0;
+	const uint8_t* bufferData = get_gltf_buffer_data(source, bufferView.buffer, &bufferSize);
+	if(accessor.count > 0 && offset + stride * (accessor.count - 1) + elementSize > bufferSize)
+	{
+		magma::log::error("Gltf accessor {} reads past the end of its buffer!", accessorId);
+		return false;
+	}
 
-	for(std::size_t i = 0; i < numberOfPositions; i++)
+	out->data = bufferData + offset;
+	out->count = accessor.count;
+	out->stride = stride;
+	out->componentType = accessor.componentType;
+	out->type = accessor.type;
+	out->normalized = accessor.normalized;
+	return true;
+}
+
+//copies tightly packed float elements of an accessor
+static bool read_float_accessor(const AccessorView& view, uint32_t componentCount, std::vector<float>* out)
+{
+	assert(out);
+	if(view.componentType != TINYGLTF_COMPONENT_TYPE_FLOAT)
 	{
-		Vertex vertex = {};
-		vertex.position = positions[i];
-		vertex.normal   = normals[i];
-		vertex.uv       = uvs[i];
-		
-		vertex.jointIds.x = static_cast<float>(jointIds[i*4]);
-		vertex.jointIds.y = static_cast<float>(jointIds[i*4 + 1]);
-		vertex.jointIds.z = static_cast<float>(jointIds[i*4 + 2]);
-		vertex.jointIds.w = static_cast<float>(jointIds[i*4 + 3]);
-		
-		vertex.weights  = weights[i];
-		vertices[i] = vertex;
-		magma::log::debug("pos {} vert {} uv {}",positions[i],normals[i],uvs[i]);
+		magma::log::error("Only float accessors are supported for animation data!");
+		return false;
 	}
-	
-	std::vector<unsigned int> indices = {};
-	indices.resize(numberOfIndices);
-	for(std::size_t i = 0; i < numberOfIndices; i++)
+
+	const std::size_t elementSize = sizeof(float) * componentCount;
+	out->resize(view.count * componentCount);
+	for(std::size_t i = 0; i < view.count; i++)
 	{
-		indices[i] = rawIndices[i];
+		memcpy(out->data() + i * componentCount, view.data + i * view.stride, elementSize);
 	}
+	return true;
+}
 
-	RemappedData remap = mesh_optimize(vertices.data(), vertices.size(), numberOfIndices, indices.data());
-	geom->vertexBuffer = remap.remappedVertices;
-	geom->indexBuffer = remap.remappedIndices;
+template<typename T>
+static float read_component(const uint8_t* data, bool normalized, float maxValue)
+{
+	T value = {};
+	memcpy(&value, data, sizeof(T));
+	//signed normalised values clamp at -1, since the range is one step wider than positive one
+	return normalized ? std::max(static_cast<float>(value) / maxValue, -1.f) : static_cast<float>(value);
+}
 
+//converts up to componentCount components of an element to floats, normalised
+//integers map to [0, 1] or [-1, 1], missing components are left untouched
+static void read_accessor_floats(const AccessorView& view, std::size_t index, uint32_t componentCount, float* out)
+{
+	const uint8_t* element = view.data + index * view.stride;
+	const uint32_t count = std::min<uint32_t>(componentCount, tinygltf::GetNumComponentsInType(view.type));
+	const std::size_t componentSize = tinygltf::GetComponentSizeInBytes(view.componentType);
+	for(uint32_t i = 0; i < count; i++)
+	{
+		const uint8_t* component = element + i * componentSize;
+		switch(view.componentType)
+		{
+			case TINYGLTF_COMPONENT_TYPE_FLOAT:          memcpy(&out[i], component, sizeof(float)); break;
+			case TINYGLTF_COMPONENT_TYPE_BYTE:           out[i] = read_component<int8_t>(component, view.normalized, 127.f); break;
+			case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE:  out[i] = read_component<uint8_t>(component, view.normalized, 255.f); break;
+			case TINYGLTF_COMPONENT_TYPE_SHORT:          out[i] = read_component<int16_t>(component, view.normalized, 32767.f); break;
+			case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT: out[i] = read_component<uint16_t>(component, view.normalized, 65535.f); break;
+			case TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT:   out[i] = read_component<uint32_t>(component, false, 1.f); break;
+			default: out[i] = 0.f; break;
+		}
+	}
+}
 
-	//anim data
-	if(animation)
+static uint32_t read_accessor_index(const AccessorView& view, std::size_t index)
+{
+	const uint8_t* element = view.data + index * view.stride;
+	switch(view.componentType)
 	{
-		int skinId = meshNode->skin;
-		assert(skinId >= 0);
-		auto& skin = gltfModel.skins[skinId];
-		int matAccessorId = skin.inverseBindMatrices;
-		auto& invBindMatAccessor = gltfModel.accessors[matAccessorId];
-		int matCount = invBindMatAccessor.count;
-		assert(matCount==skin.joints.size());
-		int invBindBuffViewId = invBindMatAccessor.bufferView;
-		auto& invBindBuffView = gltfModel.bufferViews[invBindBuffViewId];
-		const std::size_t matBufferOffset = invBindBuffView.byteOffset;
-		auto& invBindMatBuffer = gltfModel.buffers[invBindBuffView.buffer];
-		const uint8_t* invBindMatBufferRaw = invBindMatBuffer.data.data() + matBufferOffset;
-		const mat4x4* bindMatBuffer = (mat4x4*)invBindMatBufferRaw; 
-
-		auto& joints = animation->bindPose;
-		auto& gltfJointsOrder = skin.joints;
-
-		//gltf joint id --> bindmatrix array id 
-		std::unordered_map<int, int> jointsRemapper;
-		for(uint32_t i = 0; i < skin.joints.size(); i++)
-		{
-			jointsRemapper[skin.joints[i]] = i;
+		case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE:
+			return *element;
+		case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT:
+		{
+			uint16_t value = 0;
+			memcpy(&value, element, sizeof(uint16_t));
+			return value;
 		}
-	
+		default:
+		{
+			uint32_t value = 0;
+			memcpy(&value, element, sizeof(uint32_t));
+			return value;
+		}
+	}
+}
+
+//attribute streams are converted in chunks of this many elements
+static constexpr uint32_t IMPORT_CHUNK_SIZE = 16 * 1024;
+
+//runs body over [0, count) on the job system when there is one
+static void run_import_chunks(JobSystem* jobSystem, std::size_t count, const std::function<void(uint32_t begin, uint32_t end)>& body)
+{
+	if(jobSystem && count > IMPORT_CHUNK_SIZE)
+	{
+		parallel_for(jobSystem, static_cast<uint32_t>(count), IMPORT_CHUNK_SIZE, body);
+	}
+	else
+	{
+		body(0, static_cast<uint32_t>(count));
+	}
+}
+
+//appends vertices and triangle list indices of a primitive, indices are relative to its first vertex.
+//returns attributes present as VertexLayout bits or 0 on failure
+static uint32_t append_gltf_primitive(const GLTFSource& source, const tinygltf::Primitive& primitive, JobSystem* jobSystem, std::vector<Vertex>* vertices, std::vector<unsigned int>* indices)
+{
+	assert(vertices);
+	assert(indices);
+
+	auto find_attribute = [&primitive](const char* name) {
+		auto attribute = primitive.attributes.find(name);
+		return attribute != primitive.attributes.end() ? attribute->second : -1;
+	};
+
+	AccessorView positions = {};
+	if(!get_accessor_view(source, find_attribute("POSITION"), &positions))
+	{
+		return 0;
+	}
 
-		joints.resize(skin.joints.size());
-		for(uint32_t i = 0; i < matCount; i++)
+	const std::size_t vertexCount = positions.count;
+	uint32_t layout = LAYOUT_POSITIONS;
+	struct
+	{
+		const char* name;
+		VertexLayout bit;
+		AccessorView view;
+	} attributes[] = {
+		{"NORMAL", LAYOUT_NORMALS, {}},
+		{"TEXCOORD_0", LAYOUT_UVS, {}},
+		{"JOINTS_0", LAYOUT_JOINTS, {}},
+		{"WEIGHTS_0", LAYOUT_WEIGHTS, {}}
+	};
+	for(auto& attribute : attributes)
+	{
+		const int accessorId = find_attribute(attribute.name);
+		if(accessorId < 0 || !get_accessor_view(source, accessorId, &attribute.view))
+		{
+			continue;
+		}
+		if(attribute.view.count != vertexCount)
+		{
+			magma::log::warn("Ignoring gltf attribute {} whose count differs from vertex count", attribute.name);
+			continue;
+		}
+		layout |= attribute.bit;
+	}
+	const AccessorView& normals = attributes[0].view;
+	const AccessorView& uvs = attributes[1].view;
+	const AccessorView& jointIds = attributes[2].view;
+	const AccessorView& weights = attributes[3].view;
+
+	const std::size_t firstVertex = vertices->size();
+	vertices->resize(firstVertex + vertexCount);
+	Vertex* primitiveVertices = vertices->data() + firstVertex;
+	run_import_chunks(jobSystem, vertexCount, [&](uint32_t begin, uint32_t end) {
+		for(uint32_t i = begin; i < end; i++)
 		{
-			int jointId = skin.joints[i];
-			joints[i].invBindTransform = bindMatBuffer[i];
-			for(int childs : gltfModel.nodes[jointId].children)
+			Vertex& vertex = primitiveVertices[i];
+			vertex = {};
+			vertex.weights = Vec4{1.f, 0.f, 0.f, 0.f};
+			read_accessor_floats(positions, i, 3, vertex.position.data);
+			if(layout & LAYOUT_NORMALS)
+				read_accessor_floats(normals, i, 3, vertex.normal.data);
+			if(layout & LAYOUT_UVS)
+				read_accessor_floats(uvs, i, 2, vertex.uv.data);
+			if(layout & LAYOUT_JOINTS)
+				read_accessor_floats(jointIds, i, 4, vertex.jointIds.data);
+			if(layout & LAYOUT_WEIGHTS)
+				read_accessor_floats(weights, i, 4, vertex.weights.data);
+		}
+	});
+
+	std::vector<uint32_t> rawIndices = {};
+	if(primitive.indices >= 0)
+	{
+		AccessorView indexView = {};
+		if(!get_accessor_view(source, primitive.indices, &indexView))
+		{
+			vertices->resize(firstVertex);
+			return 0;
+		}
+		rawIndices.resize(indexView.count);
+		run_import_chunks(jobSystem, indexView.count, [&](uint32_t begin, uint32_t end) {
+			for(uint32_t i = begin; i < end; i++)
 			{
-				joints[jointsRemapper[childs]].parentId = i;
+				rawIndices[i] = read_accessor_index(indexView, i);
 			}
+		});
+	}
+	else
+	{
+		rawIndices.resize(vertexCount);
+		for(uint32_t i = 0; i < vertexCount; i++)
+		{
+			rawIndices[i] = i;
 		}
+	}
 
-		//build global transforms
-		auto& gltfAnimation = gltfModel.animations[0];
-		const std::size_t gltfSamplersCount = gltfAnimation.channels.size();
+	const std::size_t firstIndex = indices->size();
+	switch(primitive.mode)
+	{
+		case TINYGLTF_MODE_TRIANGLES:
+			indices->insert(indices->end(), rawIndices.begin(), rawIndices.end() - rawIndices.size() % 3);
+			break;
+		case TINYGLTF_MODE_TRIANGLE_STRIP:
+			for(std::size_t i = 2; i < rawIndices.size(); i++)
+			{
+				//every other strip triangle is flipped to keep the winding
+				const bool isOdd = i % 2 == 1;
+				indices->push_back(rawIndices[i - 2]);
+				indices->push_back(rawIndices[isOdd ? i : i - 1]);
+				indices->push_back(rawIndices[isOdd ? i - 1 : i]);
+			}
+			break;
+		case TINYGLTF_MODE_TRIANGLE_FAN:
+			for(std::size_t i = 2; i < rawIndices.size(); i++)
+			{
+				indices->push_back(rawIndices[0]);
+				indices->push_back(rawIndices[i - 1]);
+				indices->push_back(rawIndices[i]);
+			}
+			break;
+		default:
+			magma::log::warn("Skipping gltf primitive with unsupported mode {}", primitive.mode);
+			vertices->resize(firstVertex);
+			return 0;
+	}
 
-		std::vector<AnimationSampler> samplers = {};
-		samplers.resize(gltfSamplersCount);
+	for(std::size_t i = firstIndex; i < indices->size(); i++)
+	{
+		if((*indices)[i] >= vertexCount)
+		{
+			magma::log::error("Gltf primitive index {} is out of vertex range", (*indices)[i]);
+			vertices->resize(firstVertex);
+			indices->resize(firstIndex);
+			return 0;
+		}
+	}
+	return layout;
+}
 
-		for(uint32_t i = 0; i < gltfSamplersCount; i++)
+//maps the file and parses its json, file has to stay mapped while the source is in use
+static bool parse_gltf_file(const char* path, MappedFile* file, GLTFSource* source)
+{
+	if(!map_file(path, file))
+	{
+		return false;
+	}
+
+	tinygltf::TinyGLTF loader = {};
+	//binary chunk is read in place from the mapping, so json is the only thing parsed upfront
+	loader.SetSkipBinaryChunkCopy(true);
+
+	std::string err = {};
+	std::string warn = {};
+	const std::string baseDir = tinygltf::GetBaseDir(path);
+	const bool isBinary = file->size >= 4 && memcmp(file->data, "glTF", 4) == 0;
+
+	bool loadStatus = false;
+	source->binaryChunk = nullptr;
+	source->binaryChunkSize = 0;
+	if(isBinary)
+	{
+		loadStatus = loader.LoadBinaryFromMemory(&source->model, &err, &warn, file->data, static_cast<unsigned int>(file->size), baseDir);
+		//json chunk is followed by an optional binary chunk, both have 8 byte headers
+		uint32_t jsonChunkSize = 0;
+		memcpy(&jsonChunkSize, file->data + 12, sizeof(uint32_t));
+		const std::size_t binaryChunkOffset = 20 + std::size_t(jsonChunkSize);
+		if(binaryChunkOffset + 8 <= file->size)
 		{
-			auto& gltfChannel = gltfAnimation.channels[i];
-			auto& gltfSampler = gltfAnimation.samplers[gltfChannel.sampler]; 
+			uint32_t chunkSize = 0;
+			memcpy(&chunkSize, file->data + binaryChunkOffset, sizeof(uint32_t));
+			source->binaryChunk = file->data + binaryChunkOffset + 8;
+			source->binaryChunkSize = std::min<std::size_t>(chunkSize, file->size - binaryChunkOffset - 8);
+		}
+	}
+	else
+	{
+		loadStatus = loader.LoadASCIIFromString(&source->model, &err, &warn, reinterpret_cast<const char*>(file->data), static_cast<unsigned int>(file->size), baseDir);
+	}
 
-			auto& sampler = samplers[i];
-			sampler.jointId = gltfChannel.target_node;
+	if(!loadStatus)
+	{
+		magma::log::error("Failed to load gltf model! reason {}", err);
+		unmap_file(file);
+		return false;
+	}
+	return true;
+}
 
-			auto& gltfInputAccessor = gltfModel.accessors[gltfSampler.input];
-			auto& gltfOutputAccessor = gltfModel.accessors[gltfSampler.output];
+static bool import_gltf_model(const GLTFSource& source, JobSystem* jobSystem, const MeshOptimizeSettings& settings, Mesh* geom, Animation* animation);
 
-			auto& gltfInputBufferView = gltfModel.bufferViews[gltfInputAccessor.bufferView];
-			auto& gltfOutputBufferView = gltfModel.bufferViews[gltfOutputAccessor.bufferView];
+bool load_GLTF(const char* path, Mesh* geom, Animation* animation, JobSystem* jobSystem, const MeshOptimizeSettings& settings)
+{
+	assert(path);
+	assert(geom);
 
-			auto& gltfInputBuffer = gltfModel.buffers[gltfInputBufferView.buffer];
-			auto& gltfOutputBuffer = gltfModel.buffers[gltfOutputBufferView.buffer];
+	MappedFile file = {};
+	GLTFSource source = {};
+	if(!parse_gltf_file(path, &file, &source))
+	{
+		return false;
+	}
 
-			const std::size_t inputCount = gltfInputAccessor.count;
-			const std::size_t outputCount = gltfOutputAccessor.count;
-			const std::size_t inputByteOffset = gltfInputBufferView.byteOffset;
-			const std::size_t inputByteLength = gltfInputBufferView.byteLength;
-			const std::size_t outputByteOffset =  gltfOutputBufferView.byteOffset;
-			const std::size_t outputByteLength = gltfOutputBufferView.byteLength;
+	const bool importStatus = import_gltf_model(source, jobSystem, settings, geom, animation);
+	unmap_file(&file);
+	return importStatus;
+}
+
+//imports joints of the skin and every clip animating them
+static bool import_gltf_skin(const GLTFSource& source, int skinId, Animation* animation)
+{
+	const tinygltf::Model& gltfModel = source.model;
+	assert(skinId >= 0 && skinId < static_cast<int>(gltfModel.skins.size()));
+	auto& skin = gltfModel.skins[skinId];
+	//inverse bind matrices are optional, joints without them bind at identity
+	const bool hasInvBindMatrices = skin.inverseBindMatrices >= 0;
+	AccessorView invBindMatrices = {};
+	if(hasInvBindMatrices && !get_accessor_view(source, skin.inverseBindMatrices, &invBindMatrices))
+	{
+		return false;
+	}
+	if(hasInvBindMatrices && invBindMatrices.count != skin.joints.size())
+	{
+		magma::log::warn("Gltf skin {} has {} inverse bind matrices for {} joints", skinId, invBindMatrices.count, skin.joints.size());
+		return false;
+	}
 
-			const uint8_t* rawInputData = gltfInputBuffer.data.data() + inputByteOffset;
-			const uint8_t* rawOutputData = gltfOutputBuffer.data.data() + outputByteOffset;
+	auto& joints = animation->bindPose;
+	auto& gltfJointsOrder = skin.joints;
 
-			sampler.timeCodes.resize(inputCount);
-			sampler.outputs.resize(outputByteLength);
+	//gltf joint id --> bindmatrix array id 
+	std::unordered_map<int, int> jointsRemapper;
+	for(uint32_t i = 0; i < skin.joints.size(); i++)
+	{
+		jointsRemapper[skin.joints[i]] = i;
+	}
 
-			memcpy(sampler.timeCodes.data(), rawInputData, inputByteLength);
-			memcpy(sampler.outputs.data(), rawOutputData, outputByteLength);
 
-			const char* channelType = gltfChannel.target_path.c_str(); 
+	joints.resize(skin.joints.size());
+	for(uint32_t i = 0; i < joints.size(); i++)
+	{
+		int jointId = skin.joints[i];
+		if(hasInvBindMatrices)
+		{
+			read_accessor_floats(invBindMatrices, i, 16, joints[i].invBindTransform.p);
+		}
+		else
+		{
+			joints[i].invBindTransform = loadIdentity();
+		}
+		for(int childs : gltfModel.nodes[jointId].children)
+		{
+			auto childJoint = jointsRemapper.find(childs);
+			if(childJoint != jointsRemapper.end())
+			{
+				joints[childJoint->second].parentId = i;
+			}
+		}
+	}
+
+	for(uint32_t i = 0; i < joints.size(); i++)
+	{
+		const tinygltf::Node& jointNode = gltfModel.nodes[skin.joints[i]];
+		JointTransform& restTransform = joints[i].restTransform;
+		restTransform.rotation = identityQuat();
+		restTransform.translation = Vec3{0.f, 0.f, 0.f};
+		restTransform.scale = Vec3{1.f, 1.f, 1.f};
+		restTransform.channelBits = CHANNEL_ROTATE_BIT|CHANNEL_SCALE_BIT|CHANNEL_TRANSLATE_BIT;
+
+		if(jointNode.rotation.size() == 4)
+		{
+			restTransform.rotation = Quat{
+				static_cast<float>(jointNode.rotation[0]), static_cast<float>(jointNode.rotation[1]),
+				static_cast<float>(jointNode.rotation[2]), static_cast<float>(jointNode.rotation[3])
+			};
+		}
+		if(jointNode.translation.size() == 3)
+		{
+			restTransform.translation = Vec3{
+				static_cast<float>(jointNode.translation[0]), static_cast<float>(jointNode.translation[1]),
+				static_cast<float>(jointNode.translation[2])
+			};
+		}
+		if(jointNode.scale.size() == 3)
+		{
+			restTransform.scale = Vec3{
+				static_cast<float>(jointNode.scale[0]), static_cast<float>(jointNode.scale[1]),
+				static_cast<float>(jointNode.scale[2])
+			};
+		}
+	}
+
+	build_joint_order(animation);
+
+	//every channel becomes its own track, keys are never resampled to a shared timeline
+	auto& clips = animation->clips;
+	clips.clear();
+	clips.resize(gltfModel.animations.size());
+	for(uint32_t clipId = 0; clipId < clips.size(); clipId++)
+	{
+		auto& gltfAnimation = gltfModel.animations[clipId];
+		AnimationClip& clip = clips[clipId];
+		clip.name = gltfAnimation.name;
+		clip.duration = 0.f;
+		clip.isAdditive = false;
+		clip.tracks.reserve(gltfAnimation.channels.size());
+
+		for(const auto& gltfChannel : gltfAnimation.channels)
+		{
+			auto& gltfSampler = gltfAnimation.samplers[gltfChannel.sampler]; 
+
+			auto jointIt = jointsRemapper.find(gltfChannel.target_node);
+			if(jointIt == jointsRemapper.end())
+			{
+				magma::log::warn("Skipping animation channel targeting non joint node {}", gltfChannel.target_node);
+				continue;
+			}
 
+			AnimationTrack track = {};
+			track.jointId = jointIt->second;
+		
+			const char* channelType = gltfChannel.target_path.c_str(); 
+			uint32_t componentCount = 3;
 			if(strcmp(channelType, "rotation") == 0)
 			{
-				sampler.channel = CHANNEL_ROTATE_BIT;
+				track.channel = CHANNEL_ROTATE_BIT;
+				componentCount = 4;
 			}
 			else if(strcmp(channelType, "translation") == 0)
 			{
-				sampler.channel = CHANNEL_TRANSLATE_BIT;
+				track.channel = CHANNEL_TRANSLATE_BIT;
 			}
 			else if(strcmp(channelType, "scale") == 0)
 			{
-				sampler.channel = CHANNEL_SCALE_BIT;
+				track.channel = CHANNEL_SCALE_BIT;
 			}
 			else
 			{
-				assert(!"WTF");
+				magma::log::warn("Skipping unsupported animation channel {}", gltfChannel.target_path);
+				continue;
+			}
+
+			const bool isCubicSpline = gltfSampler.interpolation == "CUBICSPLINE";
+			track.interpolation = gltfSampler.interpolation == "STEP" ? INTERPOLATION_STEP : INTERPOLATION_LINEAR;
+
+			AccessorView timeCodes = {};
+			AccessorView values = {};
+			if(!get_accessor_view(source, gltfSampler.input, &timeCodes) ||
+				!get_accessor_view(source, gltfSampler.output, &values) ||
+				!read_float_accessor(timeCodes, 1, &track.timeCodes) ||
+				!read_float_accessor(values, componentCount, &track.values))
+			{
+				continue;
+			}
+
+			//cubic spline keys are stored as (in tangent, value, out tangent) triplets,
+			//keep only the values and interpolate them linearly
+			if(isCubicSpline)
+			{
+				const std::size_t keyCount = track.timeCodes.size();
+				if(track.values.size() < 3 * keyCount * componentCount)
+				{
+					magma::log::warn("Skipping cubic spline animation channel targeting node {} with {} values for {} keys",
+						gltfChannel.target_node, track.values.size(), keyCount);
+					continue;
+				}
+				for(std::size_t key = 0; key < keyCount; key++)
+				{
+					std::copy_n(track.values.begin() + (3 * key + 1) * componentCount, componentCount,
+						track.values.begin() + key * componentCount);
+				}
+				track.values.resize(keyCount * componentCount);
+			}
+
+			if(track.timeCodes.empty() || track.values.size() != track.timeCodes.size() * componentCount)
+			{
+				magma::log::warn("Skipping malformed animation channel targeting node {}", gltfChannel.target_node);
+				continue;
 			}
 
-			samplers[i] = sampler;
+			clip.duration = std::max(clip.duration, track.timeCodes.back());
+			clip.tracks.push_back(std::move(track));
 		}
+	}
+	return true;
+}
 
-		auto& keyFrames = animation->keyFrames;
-		keyFrames.resize(samplers[0].timeCodes.size());
+static bool import_gltf_model(const GLTFSource& source, JobSystem* jobSystem, const MeshOptimizeSettings& settings, Mesh* geom, Animation* animation)
+{
+	const tinygltf::Model& gltfModel = source.model;
+	//find first node, containing actual mesh data
+	auto meshNode = std::find_if(gltfModel.nodes.begin(), gltfModel.nodes.end(),
+		[](const tinygltf::Node& node) {return node.mesh >= 0;}
+	);
+	if(meshNode == gltfModel.nodes.end())
+	{
+		magma::log::error("Gltf model doesn't contain any mesh!");
+		return false;
+	}
+
+	//every primitive of the mesh is merged into a single draw
+	std::vector<Vertex> vertices = {};
+	std::vector<unsigned int> indices = {};
+	for(const tinygltf::Primitive& primitive : gltfModel.meshes[meshNode->mesh].primitives)
+	{
+		const std::size_t firstVertex = vertices.size();
+		const std::size_t firstIndex = indices.size();
+		if(!append_gltf_primitive(source, primitive, jobSystem, &vertices, &indices))
+		{
+			continue;
+		}
+		for(std::size_t i = firstIndex; i < indices.size(); i++)
+		{
+			indices[i] += static_cast<unsigned int>(firstVertex);
+		}
+	}
+	if(indices.empty())
+	{
+		magma::log::error("Gltf mesh doesn't contain any triangles!");
+		return false;
+	}
+
+	RemappedData remap = mesh_optimize(settings, vertices.data(), vertices.size(), indices.size(), indices.data());
+	geom->vertexBuffer = remap.remappedVertices;
+	geom->indexBuffer = remap.remappedIndices;
 
 
-		for(uint32_t i = 0; i < keyFrames.size(); i++)
+	//anim data, meshes without skin leave the animation empty
+	if(animation)
+	{
+		*animation = {};
+		const int skinId = meshNode->skin;
+		if(skinId < 0 || skinId >= static_cast<int>(gltfModel.skins.size()))
 		{
-			keyFrames[i].currentJointLocalTransforms.resize(joints.size());
-			auto& jointTransforms = keyFrames[i].currentJointLocalTransforms;
+			magma::log::warn("Gltf mesh {} has no skin, skipping animation import", gltfModel.meshes[meshNode->mesh].name);
+		}
+		else if(!import_gltf_skin(source, skinId, animation))
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static mat4x4 get_gltf_node_transform(const tinygltf::Node& node)
+{
+	//column major gltf matrix for column vectors has the same layout as ours for row vectors
+	if(node.matrix.size() == 16)
+	{
+		mat4x4 out = {};
+		for(uint32_t i = 0; i < 16; i++)
+		{
+			out.p[i] = static_cast<float>(node.matrix[i]);
+		}
+		return out;
+	}
+
+	mat4x4 out = loadIdentity();
+	if(node.scale.size() == 3)
+	{
+		out *= loadScale(Vec3{
+			static_cast<float>(node.scale[0]), static_cast<float>(node.scale[1]), static_cast<float>(node.scale[2])
+		});
+	}
+	if(node.rotation.size() == 4)
+	{
+		out *= quatToRotationMat(Quat{
+			static_cast<float>(node.rotation[0]), static_cast<float>(node.rotation[1]),
+			static_cast<float>(node.rotation[2]), static_cast<float>(node.rotation[3])
+		});
+	}
+	if(node.translation.size() == 3)
+	{
+		out *= loadTranslation(Vec3{
+			static_cast<float>(node.translation[0]), static_cast<float>(node.translation[1]), static_cast<float>(node.translation[2])
+		});
+	}
+	return out;
+}
+
+//converted and optimised primitive waiting to be merged into the scene arena
+struct PrimitiveImport
+{
+	std::vector<Vertex> vertices;
+	std::vector<unsigned int> indices;
+	uint32_t layout;
+};
+
+bool load_GLTF_scene(const char* path, Scene* scene, JobSystem* jobSystem, Animation* animation, const MeshOptimizeSettings& settings)
+{
+	assert(path);
+	assert(scene);
+
+	MappedFile file = {};
+	GLTFSource source = {};
+	if(!parse_gltf_file(path, &file, &source))
+	{
+		return false;
+	}
+	const tinygltf::Model& gltfModel = source.model;
+	*scene = {};
 
-			for(const auto& sampler : samplers)
+	//primitives are converted and optimised independently, then merged in order
+	std::vector<const tinygltf::Primitive*> gltfPrimitives = {};
+	for(const tinygltf::Mesh& gltfMesh : gltfModel.meshes)
+	{
+		for(const tinygltf::Primitive& gltfPrimitive : gltfMesh.primitives)
+		{
+			gltfPrimitives.push_back(&gltfPrimitive);
+		}
+	}
+
+	std::vector<PrimitiveImport> imports(gltfPrimitives.size());
+	auto import_primitive = [&](uint32_t primitiveId) {
+		PrimitiveImport& primitiveImport = imports[primitiveId];
+		std::vector<Vertex> vertices = {};
+		std::vector<unsigned int> indices = {};
+		primitiveImport.layout = append_gltf_primitive(source, *gltfPrimitives[primitiveId], jobSystem, &vertices, &indices);
+		if(!primitiveImport.layout || indices.empty())
+		{
+			primitiveImport.layout = 0;
+			return;
+		}
+
+		RemappedData remap = mesh_optimize(settings, vertices.data(), vertices.size(), indices.size(), indices.data());
+		primitiveImport.vertices = std::move(remap.remappedVertices);
+		primitiveImport.indices = std::move(remap.remappedIndices);
+	};
+
+	if(jobSystem)
+	{
+		JobCounter counter = {};
+		for(uint32_t i = 0; i < gltfPrimitives.size(); i++)
+		{
+			submit_job(jobSystem, [&import_primitive, i]() {import_primitive(i);}, &counter);
+		}
+		wait_for_counter(jobSystem, &counter);
+	}
+	else
+	{
+		for(uint32_t i = 0; i < gltfPrimitives.size(); i++)
+		{
+			import_primitive(i);
+		}
+	}
+
+	std::size_t vertexCount = 0;
+	std::size_t indexCount = 0;
+	for(const PrimitiveImport& primitiveImport : imports)
+	{
+		vertexCount += primitiveImport.vertices.size();
+		indexCount += primitiveImport.indices.size();
+	}
+	scene->vertexBuffer.reserve(vertexCount);
+	scene->indexBuffer.reserve(indexCount);
+
+	uint32_t primitiveId = 0;
+	for(const tinygltf::Mesh& gltfMesh : gltfModel.meshes)
+	{
+		SceneMesh mesh = {};
+		mesh.name = gltfMesh.name;
+		mesh.firstPrimitive = static_cast<uint32_t>(scene->primitives.size());
+
+		for(const tinygltf::Primitive& gltfPrimitive : gltfMesh.primitives)
+		{
+			const PrimitiveImport& primitiveImport = imports[primitiveId++];
+			if(!primitiveImport.layout)
 			{
-				uint32_t jointId = jointsRemapper[sampler.jointId];
-				keyFrames[i].frameTime = sampler.timeCodes[i];
+				continue;
+			}
 
-				if(sampler.channel & CHANNEL_ROTATE_BIT)
-				{
-					Quat* quats = (Quat*)sampler.outputs.data();
-					jointTransforms[jointId].rotation = quats[i];
-					jointTransforms[jointId].channelBits |= CHANNEL_ROTATE_BIT;
-				}
-				else if(sampler.channel & CHANNEL_TRANSLATE_BIT)
-				{
-					Vec3* translations = (Vec3*)sampler.outputs.data();
-					jointTransforms[jointId].translation = translations[i];
-					jointTransforms[jointId].channelBits |= CHANNEL_TRANSLATE_BIT;
-				}
-				else if(sampler.channel & CHANNEL_SCALE_BIT)
-				{
-					Vec3* scales = (Vec3*)sampler.outputs.data();
-					jointTransforms[jointId].scale = scales[i];
-					jointTransforms[jointId].channelBits |= CHANNEL_SCALE_BIT;
-				}
-				else
+			MeshPrimitive primitive = {};
+			primitive.firstIndex = static_cast<uint32_t>(scene->indexBuffer.size());
+			primitive.indexCount = static_cast<uint32_t>(primitiveImport.indices.size());
+			primitive.vertexOffset = static_cast<uint32_t>(scene->vertexBuffer.size());
+			primitive.vertexCount = static_cast<uint32_t>(primitiveImport.vertices.size());
+			primitive.layout = primitiveImport.layout;
+			primitive.materialId = gltfPrimitive.material;
+			scene->primitives.push_back(primitive);
+
+			scene->vertexBuffer.insert(scene->vertexBuffer.end(), primitiveImport.vertices.begin(), primitiveImport.vertices.end());
+			scene->indexBuffer.insert(scene->indexBuffer.end(), primitiveImport.indices.begin(), primitiveImport.indices.end());
+		}
+
+		mesh.primitiveCount = static_cast<uint32_t>(scene->primitives.size()) - mesh.firstPrimitive;
+		scene->meshes.push_back(mesh);
+	}
+
+	//flatten node hierarchy of the default scene depth first, so parents precede children
+	std::vector<std::pair<int, int>> pendingNodes = {};//gltf node id, parent id in the scene
+	if(!gltfModel.scenes.empty())
+	{
+		const int sceneId = gltfModel.defaultScene >= 0 ? gltfModel.defaultScene : 0;
+		const std::vector<int>& roots = gltfModel.scenes[sceneId].nodes;
+		for(auto root = roots.rbegin(); root != roots.rend(); root++)
+		{
+			pendingNodes.push_back({*root, -1});
+		}
+	}
+	else
+	{
+		//without scenes every node that isn't somebody's child is a root
+		std::vector<bool> isChild(gltfModel.nodes.size(), false);
+		for(const tinygltf::Node& node : gltfModel.nodes)
+		{
+			for(int child : node.children)
+			{
+				if(child < 0 || child >= static_cast<int>(gltfModel.nodes.size()))
 				{
-					assert(!"WTF");
+					magma::log::error("Node {} of {} references invalid child {}", node.name, path, child);
+					unmap_file(&file);
+					*scene = {};
+					return false;
 				}
+				isChild[child] = true;
 			}
 		}
+		for(int i = static_cast<int>(gltfModel.nodes.size()) - 1; i >= 0; i--)
+		{
+			if(!isChild[i])
+			{
+				pendingNodes.push_back({i, -1});
+			}
+		}
+	}
 
-		//compute global Transforms
-		for(auto& keyFrame : keyFrames)
+	std::vector<bool> isVisited(gltfModel.nodes.size(), false);
+	while(!pendingNodes.empty())
+	{
+		const auto pending = pendingNodes.back();
+		pendingNodes.pop_back();
+		if(pending.first < 0 || pending.first >= static_cast<int>(gltfModel.nodes.size()) || isVisited[pending.first])
 		{
-			keyFrame.currentJointGlobalTransforms.resize(joints.size());
-			generate_global_joint_transforms(*animation, &keyFrame);
+			magma::log::warn("Skipping invalid or cyclic gltf node {}", pending.first);
+			continue;
 		}
+		isVisited[pending.first] = true;
+
+		const tinygltf::Node& gltfNode = gltfModel.nodes[pending.first];
+		SceneNode node = {};
+		node.name = gltfNode.name;
+		node.parentId = pending.second;
+		node.meshId = gltfNode.mesh;
+		node.skinId = gltfNode.skin;
+		node.localTransform = get_gltf_node_transform(gltfNode);
+		node.globalTransform = node.parentId == -1 ? node.localTransform : node.localTransform * scene->nodes[node.parentId].globalTransform;
+
+		const int nodeId = static_cast<int>(scene->nodes.size());
+		scene->nodes.push_back(node);
+		for(auto child = gltfNode.children.rbegin(); child != gltfNode.children.rend(); child++)
+		{
+			pendingNodes.push_back({*child, nodeId});
+		}
+	}
 
-	}//animation
+	//skin of the first skinned mesh node, unskinned scenes leave the animation empty
+	if(animation)
+	{
+		*animation = {};
+		auto skinnedNode = std::find_if(gltfModel.nodes.begin(), gltfModel.nodes.end(), [&](const tinygltf::Node& node) {
+			return node.mesh >= 0 && node.skin >= 0 && node.skin < static_cast<int>(gltfModel.skins.size());
+		});
+		if(skinnedNode != gltfModel.nodes.end() && !import_gltf_skin(source, skinnedNode->skin, animation))
+		{
+			magma::log::error("Failed to import skin of {}", path);
+			unmap_file(&file);
+			*scene = {};
+			*animation = {};
+			return false;
+		}
+	}
 
+	unmap_file(&file);
+	magma::log::info("Imported {} meshes, {} primitives and {} nodes from {}", scene->meshes.size(), scene->primitives.size(), scene->nodes.size(), path);
 	return true;
 }
 
-bool load_OBJ(const char* path, Mesh* geom)
+void load_GLTF_scenes(const char* const* paths, uint32_t count, JobSystem* jobSystem, Scene* scenes, bool* results, const MeshOptimizeSettings& settings)
+{
+	assert(paths || count == 0);
+	assert(jobSystem);
+	assert(scenes || count == 0);
+
+	//every file is a job of its own, which splits further into primitive and chunk jobs
+	JobCounter counter = {};
+	for(uint32_t i = 0; i < count; i++)
+	{
+		submit_job(jobSystem, [=]() {
+			const bool status = load_GLTF_scene(paths[i], &scenes[i], jobSystem, nullptr, settings);
+			if(results)
+			{
+				results[i] = status;
+			}
+		}, &counter);
+	}
+	wait_for_counter(jobSystem, &counter);
+}
+
+bool load_OBJ(const char* path, Mesh* geom, const MeshOptimizeSettings& settings)
 {
 	assert(path);
 	assert(geom);
@@ -374,40 +1036,285 @@ bool load_OBJ(const char* path, Mesh* geom)
 		return false;
 	}
 
-	//assume triangle mesh here
-	std::vector<Vertex> vertices = {};
-	assert(mesh->face_vertices[0] == 3);
-	const uint32_t vertexCount = mesh->face_vertices[0];
-	vertices.resize(mesh->face_count * mesh->face_vertices[0]);
+	auto fetch_vertex = [&mesh](const fastObjIndex& index)
+	{
+		Vertex vertex = {};
+		vertex.position.x = mesh->positions[3 * index.p + 0];
+		vertex.position.y = mesh->positions[3 * index.p + 1];
+		vertex.position.z = mesh->positions[3 * index.p + 2];
+
+		vertex.normal.x = mesh->normals[3 * index.n + 0];
+		vertex.normal.y = mesh->normals[3 * index.n + 1];
+		vertex.normal.z = mesh->normals[3 * index.n + 2];
+
+		vertex.uv.u = mesh->texcoords[2 * index.t + 0];
+		vertex.uv.v = mesh->texcoords[2 * index.t + 1];
+		return vertex;
+	};
 
-	//loop through each face
+	//polygons are fan triangulated, which holds for convex ones
+	std::vector<Vertex> vertices = {};
+	uint32_t faceOffset = 0;
 	for(uint32_t i = 0; i < mesh->face_count; i++)
 	{
-		//loop through each vertex in a face
-		for(uint32_t j = 0; j < vertexCount; j++)
+		const uint32_t faceVertexCount = mesh->face_vertices[i];
+		for(uint32_t j = 1; j + 1 < faceVertexCount; j++)
 		{
-			const uint32_t vi = mesh->indices[3 * i + j].p;
-			const uint32_t vn = mesh->indices[3 * i + j].n;
-			const uint32_t vt = mesh->indices[3 * i + j].t;
+			vertices.push_back(fetch_vertex(mesh->indices[faceOffset]));
+			vertices.push_back(fetch_vertex(mesh->indices[faceOffset + j]));
+			vertices.push_back(fetch_vertex(mesh->indices[faceOffset + j + 1]));
+		}
+		faceOffset += faceVertexCount;
+	}
+
+	RemappedData data = mesh_optimize(settings, vertices.data(), vertices.size(), vertices.size());
+	geom->vertexBuffer = data.remappedVertices;
+	geom->indexBuffer = data.remappedIndices;
+
+	return true;
+}
 
-			const std::size_t out_index = i * vertexCount + j;
+//corner of an obj face, absent attributes are INVALID_OBJ_INDEX
+struct ObjVertexKey
+{
+	uint32_t position;
+	uint32_t texcoord;
+	uint32_t normal;
 
-			vertices[out_index].position.x = mesh->positions[3 * vi + 0];
-			vertices[out_index].position.y = mesh->positions[3 * vi + 1];
-			vertices[out_index].position.z = mesh->positions[3 * vi + 2];
-			
-			vertices[out_index].normal.x = mesh->normals[3 * vn + 0];
-			vertices[out_index].normal.y = mesh->normals[3 * vn + 1];
-			vertices[out_index].normal.z = mesh->normals[3 * vn + 2];
+	bool operator==(const ObjVertexKey& other) const
+	{
+		return position == other.position && texcoord == other.texcoord && normal == other.normal;
+	}
+};
 
-			vertices[out_index].uv.u = mesh->texcoords[2 * vt + 0];
-			vertices[out_index].uv.v = mesh->texcoords[2 * vt + 1];
+struct ObjVertexKeyHash
+{
+	std::size_t operator()(const ObjVertexKey& key) const
+	{
+		uint64_t hash = key.position;
+		hash = hash * 0x9e3779b97f4a7c15ull ^ key.texcoord;
+		hash = hash * 0x9e3779b97f4a7c15ull ^ key.normal;
+		return static_cast<std::size_t>(hash ^ (hash >> 32));
+	}
+};
+
+static constexpr uint32_t INVALID_OBJ_INDEX = ~0u;
+
+struct ObjStreamState
+{
+	std::vector<Vec3> positions;
+	std::vector<Vec3> normals;
+	std::vector<Vec2> texcoords;
+	std::unordered_map<ObjVertexKey, uint32_t, ObjVertexKeyHash> vertexLookup;
+	std::vector<uint32_t> polygon;
+	uint64_t skippedFaces;//fewer than 3 corners, points and lines aren't drawn
+	Mesh* mesh;
+};
+
+//obj indices are one based, negative ones count back from the latest element
+static bool resolve_obj_index(long index, std::size_t count, uint32_t* out)
+{
+	const long resolved = index > 0 ? index - 1 : static_cast<long>(count) + index;
+	if(index == 0 || resolved < 0 || static_cast<std::size_t>(resolved) >= count)
+	{
+		return false;
+	}
+	*out = static_cast<uint32_t>(resolved);
+	return true;
+}
+
+static void parse_obj_floats(const char* cursor, float* out, uint32_t count)
+{
+	for(uint32_t i = 0; i < count; i++)
+	{
+		char* next = nullptr;
+		out[i] = strtof(cursor, &next);
+		cursor = next;
+	}
+}
+
+//line has to be null terminated
+static bool parse_obj_line(const char* line, ObjStreamState* state)
+{
+	while(*line == ' ' || *line == '\t')
+	{
+		line++;
+	}
+
+	if(line[0] == 'v' && (line[1] == ' ' || line[1] == '\t'))
+	{
+		Vec3 position = {};
+		parse_obj_floats(line + 2, position.data, 3);
+		state->positions.push_back(position);
+	}
+	else if(line[0] == 'v' && line[1] == 'n')
+	{
+		Vec3 normal = {};
+		parse_obj_floats(line + 2, normal.data, 3);
+		state->normals.push_back(normal);
+	}
+	else if(line[0] == 'v' && line[1] == 't')
+	{
+		Vec2 texcoord = {};
+		parse_obj_floats(line + 2, texcoord.data, 2);
+		state->texcoords.push_back(texcoord);
+	}
+	else if(line[0] == 'f' && (line[1] == ' ' || line[1] == '\t'))
+	{
+		state->polygon.clear();
+		const char* cursor = line + 2;
+		while(true)
+		{
+			char* next = nullptr;
+			const long position = strtol(cursor, &next, 10);
+			if(next == cursor)
+			{
+				break;
+			}
+			cursor = next;
+
+			ObjVertexKey key = {INVALID_OBJ_INDEX, INVALID_OBJ_INDEX, INVALID_OBJ_INDEX};
+			if(!resolve_obj_index(position, state->positions.size(), &key.position))
+			{
+				return false;
+			}
+			//v, v/t, v//n and v/t/n corners
+			if(*cursor == '/')
+			{
+				cursor++;
+				if(*cursor != '/')
+				{
+					const long texcoord = strtol(cursor, &next, 10);
+					if(next == cursor || !resolve_obj_index(texcoord, state->texcoords.size(), &key.texcoord))
+					{
+						return false;
+					}
+					cursor = next;
+				}
+				if(*cursor == '/')
+				{
+					cursor++;
+					const long normal = strtol(cursor, &next, 10);
+					if(next == cursor || !resolve_obj_index(normal, state->normals.size(), &key.normal))
+					{
+						return false;
+					}
+					cursor = next;
+				}
+			}
+
+			auto inserted = state->vertexLookup.emplace(key, static_cast<uint32_t>(state->mesh->vertexBuffer.size()));
+			if(inserted.second)
+			{
+				Vertex vertex = {};
+				vertex.position = state->positions[key.position];
+				vertex.normal = key.normal != INVALID_OBJ_INDEX ? state->normals[key.normal] : Vec3{0.f, 0.f, 0.f};
+				vertex.uv = key.texcoord != INVALID_OBJ_INDEX ? state->texcoords[key.texcoord] : Vec2{0.f, 0.f};
+				state->mesh->vertexBuffer.push_back(vertex);
+			}
+			state->polygon.push_back(inserted.first->second);
+		}
+
+		//corners already added stay unreferenced and get dropped by optimisation
+		if(state->polygon.size() < 3)
+		{
+			state->skippedFaces++;
+			return true;
+		}
+		//fan triangulation, holds for convex polygons
+		for(std::size_t i = 1; i + 1 < state->polygon.size(); i++)
+		{
+			state->mesh->indexBuffer.push_back(state->polygon[0]);
+			state->mesh->indexBuffer.push_back(state->polygon[i]);
+			state->mesh->indexBuffer.push_back(state->polygon[i + 1]);
 		}
 	}
+	//groups, materials, smoothing groups and comments are ignored
+	return true;
+}
 
-	RemappedData data = mesh_optimize(vertices.data(), vertices.size(), 3 * mesh->face_count);
-	geom->vertexBuffer = data.remappedVertices;
-	geom->indexBuffer = data.remappedIndices;
+bool load_OBJ_streamed(const char* path, Mesh* geom, std::size_t chunkSize, const MeshOptimizeSettings& settings)
+{
+	assert(path);
+	assert(geom);
+	assert(chunkSize > 0);
+
+	FILE* file = fopen(path, "rb");
+	if(!file)
+	{
+		magma::log::error("Failed to open obj file {}", path);
+		return false;
+	}
+
+	ObjStreamState state = {};
+	state.mesh = geom;
+	geom->vertexBuffer.clear();
+	geom->indexBuffer.clear();
+
+	//one spare byte to null terminate the last line of the file
+	std::vector<char> chunk(chunkSize + 1);
+	std::size_t carried = 0;
+	uint64_t lineNumber = 0;
+	bool succeeded = true;
+	while(succeeded)
+	{
+		//line doesn't fit into the chunk
+		if(carried == chunk.size() - 1)
+		{
+			chunk.resize(chunk.size() * 2);
+		}
+
+		const std::size_t readBytes = fread(chunk.data() + carried, 1, chunk.size() - 1 - carried, file);
+		const bool endOfFile = readBytes == 0;
+		char* lineStart = chunk.data();
+		char* const end = chunk.data() + carried + readBytes;
+		if(endOfFile)
+		{
+			*end = '\0';
+			lineNumber += carried ? 1 : 0;
+			succeeded = ferror(file) == 0 && (carried == 0 || parse_obj_line(lineStart, &state));
+			break;
+		}
+
+		while(succeeded)
+		{
+			char* newline = static_cast<char*>(memchr(lineStart, '\n', end - lineStart));
+			if(!newline)
+			{
+				break;
+			}
+			*newline = '\0';
+			lineNumber++;
+			succeeded = parse_obj_line(lineStart, &state);
+			lineStart = newline + 1;
+		}
+
+		carried = end - lineStart;
+		memmove(chunk.data(), lineStart, carried);
+	}
+	fclose(file);
+
+	if(!succeeded || geom->indexBuffer.empty())
+	{
+		magma::log::error("Failed to parse obj file {} at line {}", path, lineNumber);
+		geom->vertexBuffer.clear();
+		geom->indexBuffer.clear();
+		return false;
+	}
 
+	if(state.skippedFaces)
+	{
+		magma::log::warn("Skipped {} faces with fewer than 3 corners in obj file {}", state.skippedFaces, path);
+	}
+
+	//attribute arrays and the lookup are gone before optimisation runs in place
+	state = {};
+	const uint32_t usedVertexCount = optimize_mesh(settings,
+		geom->vertexBuffer.data(), geom->vertexBuffer.size(),
+		geom->indexBuffer.data(), geom->indexBuffer.size()
+	);
+	geom->vertexBuffer.resize(usedVertexCount);
+	magma::log::info("Streamed {} vertices and {} triangles from {}",
+		geom->vertexBuffer.size(), geom->indexBuffer.size() / 3, path);
 	return true;
 }
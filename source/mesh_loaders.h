@@ -2,9 +2,11 @@
 #define MAGMA_MESH_LOADERS
 
 #include <vector>
+#include <string>
 
 #include "maths.h"
 #include "animation.h"
+#include "job_system.h"
 #include "vk_types.h"
 
 enum VertexLayout
@@ -31,6 +33,82 @@ struct Mesh
 	std::vector<unsigned int> indexBuffer;
 };
 
+//part of the scene arena drawn with a single indexed draw,
+//indices are relative to vertexOffset
+struct MeshPrimitive
+{
+	uint32_t firstIndex;
+	uint32_t indexCount;
+	uint32_t vertexOffset;
+	uint32_t vertexCount;
+	uint32_t layout;//VertexLayout bits of attributes present in source data
+	int materialId;
+};
+
+struct SceneMesh
+{
+	std::string name;
+	uint32_t firstPrimitive;
+	uint32_t primitiveCount;
+};
+
+struct SceneNode
+{
+	std::string name;
+	int parentId = -1;
+	int meshId = -1;
+	int skinId = -1;
+	mat4x4 localTransform;
+	mat4x4 globalTransform;
+};
+
+//every mesh of the scene merged into one vertex and index buffer
+struct Scene
+{
+	std::vector<Vertex> vertexBuffer;
+	std::vector<unsigned int> indexBuffer;
+	std::vector<MeshPrimitive> primitives;
+	std::vector<SceneMesh> meshes;
+	std::vector<SceneNode> nodes;//parents always precede their children
+};
+
+enum MeshOptimizeStage
+{
+	OPTIMIZE_VERTEX_CACHE = 0b001,//reorders triangles for post transform cache reuse
+	OPTIMIZE_OVERDRAW     = 0b010,//reorders clusters of cache optimised triangles front to back
+	OPTIMIZE_VERTEX_FETCH = 0b100 //reorders vertices in order of first use
+};
+typedef uint32_t MeshOptimizeStages;
+
+//stages run after vertex deduplication of every loaded mesh
+struct MeshOptimizeSettings
+{
+	MeshOptimizeStages stages;
+	float overdrawThreshold;//how much overdraw stage may degrade acmr, 1.05 is 5%
+};
+
+static constexpr MeshOptimizeSettings MESH_OPTIMIZE_DEFAULT = {
+	OPTIMIZE_VERTEX_CACHE|OPTIMIZE_OVERDRAW|OPTIMIZE_VERTEX_FETCH,
+	1.05f
+};
+
+//simulated 16 entry fifo post transform cache and 64 byte fetch cache lines
+struct MeshCacheStats
+{
+	float acmr;//transformed vertices per triangle
+	float atvr;//transformed vertices per referenced vertex
+	float overfetch;//fetched bytes per referenced vertex byte
+};
+
+//skipped stages repeat stats of the previous one
+struct MeshOptimizeStats
+{
+	MeshCacheStats input;
+	MeshCacheStats vertexCache;
+	MeshCacheStats overdraw;
+	MeshCacheStats vertexFetch;
+};
+
 struct TextureInfo
 {
 	VkFormat format;
@@ -39,10 +117,37 @@ struct TextureInfo
 	uint8_t* data;
 };
 
+//safe to call from several threads at once
 bool load_texture(const char* path, TextureInfo* out, bool flipImage = true);
 
-bool load_OBJ(const char* path, Mesh* geom);
+void free_texture(TextureInfo* texture);
+
+bool load_OBJ(const char* path, Mesh* geom, const MeshOptimizeSettings& settings = MESH_OPTIMIZE_DEFAULT);
+
+static constexpr std::size_t OBJ_STREAM_CHUNK_SIZE = 4 * 1024 * 1024;
+
+//parses the file chunk by chunk and indexes vertices as it goes, so peak memory stays close
+//to the final mesh plus obj attribute arrays. Polygons get fan triangulated
+bool load_OBJ_streamed(const char* path, Mesh* geom, std::size_t chunkSize = OBJ_STREAM_CHUNK_SIZE,
+	const MeshOptimizeSettings& settings = MESH_OPTIMIZE_DEFAULT);
+
+//optimises triangles of a single draw, indices are relative to vertices.
+//returns number of referenced vertices, the vertex fetch stage moves them to the front
+uint32_t optimize_mesh(const MeshOptimizeSettings& settings, Vertex* vertices, uint32_t vertexCount,
+	unsigned int* indices, uint32_t indexCount, MeshOptimizeStats* stats = nullptr);
+
+//job system is optional, with one attribute conversion and mesh optimisation run in parallel.
+//Loaders optimise meshes with the settings they are given, so concurrent loads may use different ones
+bool load_GLTF(const char* path, Mesh* geom, Animation* animation = nullptr, JobSystem* jobSystem = nullptr,
+	const MeshOptimizeSettings& settings = MESH_OPTIMIZE_DEFAULT);
+
+//imports every node, mesh and primitive of the default scene.
+//animation, when given, gets the skin of the first skinned mesh node and stays empty without one
+bool load_GLTF_scene(const char* path, Scene* scene, JobSystem* jobSystem = nullptr, Animation* animation = nullptr,
+	const MeshOptimizeSettings& settings = MESH_OPTIMIZE_DEFAULT);
 
-bool load_GLTF(const char* path, Mesh* geom, Animation* animation = nullptr);
+//imports files concurrently, results are optional per file load statuses
+void load_GLTF_scenes(const char* const* paths, uint32_t count, JobSystem* jobSystem, Scene* scenes, bool* results = nullptr,
+	const MeshOptimizeSettings& settings = MESH_OPTIMIZE_DEFAULT);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,651 @@
+#include "mesh_lod.h"
+#include "logging.h"
+
+#include <meshoptimizer.h>
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+static constexpr uint32_t INVALID_VERTEX = ~0u;
+
+//border and seam edges outweigh surface planes, keeps outlines in place
+static constexpr float EDGE_QUADRIC_WEIGHT = 10.f;
+
+//levels that lose less than this fraction of indices end the chain
+static constexpr float MIN_LOD_REDUCTION = 0.1f;
+
+enum VertexKind
+{
+	VERTEX_MANIFOLD,//surrounded by triangles from all sides
+	VERTEX_BORDER,  //on a single open edge loop
+	VERTEX_SEAM,    //two vertices on the same position with different attributes, e.g. uv or skin seams
+	VERTEX_LOCKED   //anything else, never moves
+};
+
+//rows are collapsed vertex kinds, columns are kinds of vertex it collapses onto
+static constexpr bool CAN_COLLAPSE[4][4] = {
+	{true,  true,  true,  true },
+	{false, true,  false, false},
+	{false, false, true,  false},
+	{false, false, false, false}
+};
+
+struct Quadric
+{
+	float a00, a11, a22;
+	float a10, a21, a20;
+	float b0, b1, b2;
+	float c;
+	float weight;
+};
+
+//outgoing edges of every vertex, with triangles they come from
+struct EdgeAdjacency
+{
+	std::vector<uint32_t> offsets;
+	std::vector<uint32_t> targets;
+	std::vector<uint32_t> triangles;
+};
+
+struct Collapse
+{
+	uint32_t source;
+	uint32_t target;
+	float error;
+};
+
+static void add_quadric(Quadric& self, const Quadric& other)
+{
+	self.a00 += other.a00;
+	self.a11 += other.a11;
+	self.a22 += other.a22;
+	self.a10 += other.a10;
+	self.a21 += other.a21;
+	self.a20 += other.a20;
+	self.b0 += other.b0;
+	self.b1 += other.b1;
+	self.b2 += other.b2;
+	self.c += other.c;
+	self.weight += other.weight;
+}
+
+static Quadric plane_quadric(const Vec3& normal, float distance, float weight)
+{
+	Quadric out = {};
+	out.a00 = weight * normal.x * normal.x;
+	out.a11 = weight * normal.y * normal.y;
+	out.a22 = weight * normal.z * normal.z;
+	out.a10 = weight * normal.y * normal.x;
+	out.a21 = weight * normal.z * normal.y;
+	out.a20 = weight * normal.z * normal.x;
+	out.b0 = weight * distance * normal.x;
+	out.b1 = weight * distance * normal.y;
+	out.b2 = weight * distance * normal.z;
+	out.c = weight * distance * distance;
+	out.weight = weight;
+	return out;
+}
+
+//squared distance to accumulated planes, averaged by their weights
+static float quadric_error(const Quadric& quadric, const Vec3& point)
+{
+	const Vec3 transformed = {
+		quadric.a00 * point.x + quadric.a10 * point.y + quadric.a20 * point.z,
+		quadric.a10 * point.x + quadric.a11 * point.y + quadric.a21 * point.z,
+		quadric.a20 * point.x + quadric.a21 * point.y + quadric.a22 * point.z
+	};
+	const Vec3 linear = {quadric.b0, quadric.b1, quadric.b2};
+	const float error = dotVec3(point, transformed) + 2.f * dotVec3(linear, point) + quadric.c;
+	return quadric.weight > 0.f ? std::abs(error) / quadric.weight : 0.f;
+}
+
+//half of L1 distance between joint influences, 0 for equal and 1 for disjoint skinning
+static float skin_weight_distance(const Vertex& first, const Vertex& second)
+{
+	float distance = 0.f;
+	for(uint32_t i = 0; i < 4; i++)
+	{
+		if(first.weights.data[i] == 0.f)
+		{
+			continue;
+		}
+		float shared = 0.f;
+		for(uint32_t j = 0; j < 4; j++)
+		{
+			shared += second.jointIds.data[j] == first.jointIds.data[i] ? second.weights.data[j] : 0.f;
+		}
+		distance += std::abs(first.weights.data[i] - shared);
+	}
+	for(uint32_t j = 0; j < 4; j++)
+	{
+		bool shared = false;
+		for(uint32_t i = 0; i < 4; i++)
+		{
+			shared |= first.weights.data[i] != 0.f && first.jointIds.data[i] == second.jointIds.data[j];
+		}
+		distance += shared ? 0.f : second.weights.data[j];
+	}
+	return distance * 0.5f;
+}
+
+static void build_edge_adjacency(const unsigned int* indices, uint32_t indexCount, uint32_t vertexCount, EdgeAdjacency* out)
+{
+	out->offsets.assign(vertexCount + 1, 0);
+	out->targets.resize(indexCount);
+	out->triangles.resize(indexCount);
+	for(uint32_t i = 0; i < indexCount; i++)
+	{
+		out->offsets[indices[i] + 1]++;
+	}
+	for(uint32_t i = 0; i < vertexCount; i++)
+	{
+		out->offsets[i + 1] += out->offsets[i];
+	}
+
+	std::vector<uint32_t> cursors(out->offsets.begin(), out->offsets.end() - 1);
+	for(uint32_t i = 0; i < indexCount; i += 3)
+	{
+		for(uint32_t e = 0; e < 3; e++)
+		{
+			const uint32_t from = indices[i + e];
+			const uint32_t to = indices[i + (e + 1) % 3];
+			out->targets[cursors[from]] = to;
+			out->triangles[cursors[from]] = i / 3;
+			cursors[from]++;
+		}
+	}
+}
+
+static bool has_edge(const EdgeAdjacency& adjacency, uint32_t from, uint32_t to)
+{
+	for(uint32_t i = adjacency.offsets[from]; i < adjacency.offsets[from + 1]; i++)
+	{
+		if(adjacency.targets[i] == to)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+static bool is_vertex_used(const EdgeAdjacency& adjacency, uint32_t vertex)
+{
+	return adjacency.offsets[vertex] != adjacency.offsets[vertex + 1];
+}
+
+//partners receive the other seam vertex on the same position
+static void classify_vertices(const EdgeAdjacency& adjacency, const uint32_t* positionRemap, const uint32_t* wedges,
+	uint32_t vertexCount, uint8_t* kinds, uint32_t* partners)
+{
+	std::vector<uint32_t> openOut(vertexCount, 0);
+	std::vector<uint32_t> openIn(vertexCount, 0);
+	std::vector<uint32_t> openOutTarget(vertexCount, INVALID_VERTEX);
+	std::vector<uint32_t> openInSource(vertexCount, INVALID_VERTEX);
+	for(uint32_t from = 0; from < vertexCount; from++)
+	{
+		for(uint32_t i = adjacency.offsets[from]; i < adjacency.offsets[from + 1]; i++)
+		{
+			const uint32_t to = adjacency.targets[i];
+			if(!has_edge(adjacency, to, from))
+			{
+				openOut[from]++;
+				openOutTarget[from] = to;
+				openIn[to]++;
+				openInSource[to] = from;
+			}
+		}
+	}
+
+	for(uint32_t v = 0; v < vertexCount; v++)
+	{
+		kinds[v] = VERTEX_LOCKED;
+		partners[v] = INVALID_VERTEX;
+		if(!is_vertex_used(adjacency, v))
+		{
+			continue;
+		}
+
+		uint32_t wedgeCount = 0;
+		uint32_t other = INVALID_VERTEX;
+		for(uint32_t w = wedges[v]; w != v; w = wedges[w])
+		{
+			if(is_vertex_used(adjacency, w))
+			{
+				wedgeCount++;
+				other = w;
+			}
+		}
+
+		if(wedgeCount == 0)
+		{
+			if(openOut[v] == 0 && openIn[v] == 0)
+			{
+				kinds[v] = VERTEX_MANIFOLD;
+			}
+			else if(openOut[v] == 1 && openIn[v] == 1)
+			{
+				kinds[v] = VERTEX_BORDER;
+			}
+		}
+		else if(wedgeCount == 1)
+		{
+			//both sides of the seam have to run along the same pair of positions in opposite directions
+			const bool singleOpenLoops = openOut[v] == 1 && openIn[v] == 1 && openOut[other] == 1 && openIn[other] == 1;
+			if(singleOpenLoops &&
+				positionRemap[openOutTarget[v]] == positionRemap[openInSource[other]] &&
+				positionRemap[openInSource[v]] == positionRemap[openOutTarget[other]])
+			{
+				kinds[v] = VERTEX_SEAM;
+				partners[v] = other;
+			}
+		}
+	}
+}
+
+static bool can_collapse(const EdgeAdjacency& adjacency, const uint8_t* kinds, const uint32_t* partners,
+	uint32_t source, uint32_t target, bool openEdge)
+{
+	if(!CAN_COLLAPSE[kinds[source]][kinds[target]])
+	{
+		return false;
+	}
+	//border and seam vertices only slide along their own edge loop
+	if(kinds[source] != VERTEX_MANIFOLD && !openEdge)
+	{
+		return false;
+	}
+	if(kinds[source] == VERTEX_SEAM)
+	{
+		const uint32_t sourcePartner = partners[source];
+		const uint32_t targetPartner = partners[target];
+		return has_edge(adjacency, sourcePartner, targetPartner) || has_edge(adjacency, targetPartner, sourcePartner);
+	}
+	return true;
+}
+
+uint32_t simplify_mesh(const Vertex* vertices, uint32_t vertexCount, const unsigned int* indices, uint32_t indexCount,
+	uint32_t targetIndexCount, float targetError, float skinWeightImportance, unsigned int* out, float* error)
+{
+	assert(vertices && indices && out);
+	assert(indexCount % 3 == 0);
+
+	//positions are normalised so that errors are relative to mesh extent
+	Vec3 boundsMin = vertexCount ? vertices[0].position : Vec3{0.f, 0.f, 0.f};
+	Vec3 boundsMax = boundsMin;
+	for(uint32_t i = 1; i < vertexCount; i++)
+	{
+		for(uint32_t c = 0; c < 3; c++)
+		{
+			boundsMin.data[c] = std::min(boundsMin.data[c], vertices[i].position.data[c]);
+			boundsMax.data[c] = std::max(boundsMax.data[c], vertices[i].position.data[c]);
+		}
+	}
+	const Vec3 size = boundsMax - boundsMin;
+	const float extent = std::max(size.x, std::max(size.y, size.z));
+	const float scale = extent > 0.f ? 1.f / extent : 1.f;
+
+	std::vector<Vec3> positions(vertexCount);
+	for(uint32_t i = 0; i < vertexCount; i++)
+	{
+		positions[i] = (vertices[i].position - boundsMin) * scale;
+	}
+
+	//vertices on the same position form a circular list of wedges
+	std::vector<uint32_t> sortedVertices(vertexCount);
+	for(uint32_t v = 0; v < vertexCount; v++)
+	{
+		sortedVertices[v] = v;
+	}
+	std::sort(sortedVertices.begin(), sortedVertices.end(), [&positions](uint32_t left, uint32_t right)
+	{
+		const Vec3& a = positions[left];
+		const Vec3& b = positions[right];
+		return a.x != b.x ? a.x < b.x : (a.y != b.y ? a.y < b.y : a.z < b.z);
+	});
+	std::vector<uint32_t> positionRemap(vertexCount);
+	uint32_t positionCount = 0;
+	for(uint32_t i = 0; i < vertexCount; i++)
+	{
+		const Vec3& position = positions[sortedVertices[i]];
+		const bool samePosition = i > 0 && positions[sortedVertices[i - 1]].x == position.x &&
+			positions[sortedVertices[i - 1]].y == position.y && positions[sortedVertices[i - 1]].z == position.z;
+		positionCount += samePosition ? 0 : 1;
+		positionRemap[sortedVertices[i]] = positionCount - 1;
+	}
+	std::vector<uint32_t> wedges(vertexCount);
+	std::vector<uint32_t> firstWedge(positionCount, INVALID_VERTEX);
+	for(uint32_t v = 0; v < vertexCount; v++)
+	{
+		const uint32_t position = positionRemap[v];
+		wedges[v] = v;
+		if(firstWedge[position] == INVALID_VERTEX)
+		{
+			firstWedge[position] = v;
+			continue;
+		}
+		wedges[v] = wedges[firstWedge[position]];
+		wedges[firstWedge[position]] = v;
+	}
+
+	std::vector<unsigned int> result(indices, indices + indexCount);
+	uint32_t resultCount = indexCount;
+
+	EdgeAdjacency adjacency;
+	build_edge_adjacency(result.data(), resultCount, vertexCount, &adjacency);
+	std::vector<uint8_t> kinds(vertexCount);
+	std::vector<uint32_t> partners(vertexCount);
+	classify_vertices(adjacency, positionRemap.data(), wedges.data(), vertexCount, kinds.data(), partners.data());
+
+	std::vector<Quadric> quadrics(positionCount, Quadric{});
+	for(uint32_t i = 0; i < resultCount; i += 3)
+	{
+		const Vec3 corners[3] = {positions[result[i]], positions[result[i + 1]], positions[result[i + 2]]};
+		Vec3 normal = cross(corners[1] - corners[0], corners[2] - corners[0]);
+		const float area = lengthVec3(normal);
+		if(area == 0.f)
+		{
+			continue;
+		}
+		normal = normal / area;
+		const Quadric face = plane_quadric(normal, -dotVec3(normal, corners[0]), area);
+		for(uint32_t e = 0; e < 3; e++)
+		{
+			add_quadric(quadrics[positionRemap[result[i + e]]], face);
+		}
+
+		//open edges get a plane perpendicular to the triangle through them
+		for(uint32_t e = 0; e < 3; e++)
+		{
+			const uint32_t from = result[i + e];
+			const uint32_t to = result[i + (e + 1) % 3];
+			if(has_edge(adjacency, to, from))
+			{
+				continue;
+			}
+			const Vec3 edge = corners[(e + 1) % 3] - corners[e];
+			const float length = lengthVec3(edge);
+			if(length == 0.f)
+			{
+				continue;
+			}
+			const Vec3 edgeNormal = normaliseVec3(cross(edge, normal));
+			const Quadric border = plane_quadric(edgeNormal, -dotVec3(edgeNormal, corners[e]), length * length * EDGE_QUADRIC_WEIGHT);
+			add_quadric(quadrics[positionRemap[from]], border);
+			add_quadric(quadrics[positionRemap[to]], border);
+		}
+	}
+
+	const float errorLimit = targetError * targetError;
+	float resultError = 0.f;
+	std::vector<Collapse> collapses;
+	std::vector<uint32_t> collapseRemap(vertexCount);
+	std::vector<uint8_t> positionLocked(positionCount);
+
+	auto get_collapse_error = [&](uint32_t source, uint32_t target)
+	{
+		float skinDistance = skin_weight_distance(vertices[source], vertices[target]);
+		if(kinds[source] == VERTEX_SEAM)
+		{
+			skinDistance = std::max(skinDistance, skin_weight_distance(vertices[partners[source]], vertices[partners[target]]));
+		}
+		return quadric_error(quadrics[positionRemap[source]], positions[target]) +
+			skinWeightImportance * skinDistance * skinDistance;
+	};
+
+	while(resultCount > targetIndexCount)
+	{
+		collapses.clear();
+		for(uint32_t i = 0; i < resultCount; i += 3)
+		{
+			for(uint32_t e = 0; e < 3; e++)
+			{
+				const uint32_t first = result[i + e];
+				const uint32_t second = result[i + (e + 1) % 3];
+				const bool openEdge = !has_edge(adjacency, second, first);
+				//inner edges are seen from both triangles, pick one
+				if(!openEdge && first > second)
+				{
+					continue;
+				}
+
+				Collapse collapse = {INVALID_VERTEX, INVALID_VERTEX, INFINITY};
+				if(can_collapse(adjacency, kinds.data(), partners.data(), first, second, openEdge))
+				{
+					collapse = {first, second, get_collapse_error(first, second)};
+				}
+				if(can_collapse(adjacency, kinds.data(), partners.data(), second, first, openEdge))
+				{
+					const float reverseError = get_collapse_error(second, first);
+					collapse = reverseError < collapse.error ? Collapse{second, first, reverseError} : collapse;
+				}
+				if(collapse.source != INVALID_VERTEX)
+				{
+					collapses.push_back(collapse);
+				}
+			}
+		}
+
+		std::sort(collapses.begin(), collapses.end(), [](const Collapse& left, const Collapse& right)
+		{
+			return left.error < right.error;
+		});
+
+		for(uint32_t v = 0; v < vertexCount; v++)
+		{
+			collapseRemap[v] = v;
+		}
+		std::fill(positionLocked.begin(), positionLocked.end(), 0);
+
+		uint32_t triangleCount = resultCount / 3;
+		uint32_t collapseCount = 0;
+		for(const Collapse& collapse : collapses)
+		{
+			if(collapse.error > errorLimit || triangleCount <= targetIndexCount / 3)
+			{
+				break;
+			}
+			const uint32_t sourcePosition = positionRemap[collapse.source];
+			const uint32_t targetPosition = positionRemap[collapse.target];
+			if(positionLocked[sourcePosition] || positionLocked[targetPosition])
+			{
+				continue;
+			}
+
+			//triangles around the source position either degenerate or must keep their facing
+			uint32_t removedTriangles = 0;
+			bool flips = false;
+			uint32_t wedge = collapse.source;
+			do
+			{
+				for(uint32_t i = adjacency.offsets[wedge]; i < adjacency.offsets[wedge + 1] && !flips; i++)
+				{
+					const uint32_t* corners = &result[adjacency.triangles[i] * 3];
+					Vec3 points[3];
+					bool degenerates = false;
+					for(uint32_t c = 0; c < 3; c++)
+					{
+						points[c] = positions[corners[c]];
+						degenerates |= positionRemap[corners[c]] == targetPosition;
+					}
+					if(degenerates)
+					{
+						removedTriangles++;
+						continue;
+					}
+					const Vec3 before = cross(points[1] - points[0], points[2] - points[0]);
+					for(uint32_t c = 0; c < 3; c++)
+					{
+						points[c] = positionRemap[corners[c]] == sourcePosition ? positions[collapse.target] : points[c];
+					}
+					const Vec3 after = cross(points[1] - points[0], points[2] - points[0]);
+					flips = dotVec3(before, after) <= 0.f;
+				}
+				wedge = wedges[wedge];
+			}
+			while(wedge != collapse.source && !flips);
+
+			if(flips)
+			{
+				continue;
+			}
+
+			collapseRemap[collapse.source] = collapse.target;
+			if(kinds[collapse.source] == VERTEX_SEAM)
+			{
+				collapseRemap[partners[collapse.source]] = partners[collapse.target];
+			}
+			add_quadric(quadrics[targetPosition], quadrics[sourcePosition]);
+
+			//whole one ring is locked, flip checks of later collapses in this pass rely on it
+			wedge = collapse.source;
+			do
+			{
+				for(uint32_t i = adjacency.offsets[wedge]; i < adjacency.offsets[wedge + 1]; i++)
+				{
+					const uint32_t* corners = &result[adjacency.triangles[i] * 3];
+					for(uint32_t c = 0; c < 3; c++)
+					{
+						positionLocked[positionRemap[corners[c]]] = 1;
+					}
+				}
+				wedge = wedges[wedge];
+			}
+			while(wedge != collapse.source);
+
+			triangleCount -= std::min(removedTriangles, triangleCount);
+			resultError = std::max(resultError, collapse.error);
+			collapseCount++;
+		}
+
+		if(collapseCount == 0)
+		{
+			break;
+		}
+
+		uint32_t writeCount = 0;
+		for(uint32_t i = 0; i < resultCount; i += 3)
+		{
+			const uint32_t a = collapseRemap[result[i + 0]];
+			const uint32_t b = collapseRemap[result[i + 1]];
+			const uint32_t c = collapseRemap[result[i + 2]];
+			if(positionRemap[a] == positionRemap[b] || positionRemap[b] == positionRemap[c] || positionRemap[c] == positionRemap[a])
+			{
+				continue;
+			}
+			result[writeCount + 0] = a;
+			result[writeCount + 1] = b;
+			result[writeCount + 2] = c;
+			writeCount += 3;
+		}
+		resultCount = writeCount;
+
+		build_edge_adjacency(result.data(), resultCount, vertexCount, &adjacency);
+		classify_vertices(adjacency, positionRemap.data(), wedges.data(), vertexCount, kinds.data(), partners.data());
+	}
+
+	std::copy(result.begin(), result.begin() + resultCount, out);
+	if(error)
+	{
+		*error = std::sqrt(resultError);
+	}
+	return resultCount;
+}
+
+uint32_t generate_mesh_lods(const Vertex* vertices, uint32_t vertexCount, const unsigned int* indices, uint32_t indexCount,
+	const MeshLodSettings& settings, MeshLodChain* out)
+{
+	assert(vertices && indices && out);
+	assert(settings.maxLodCount >= 1);
+	assert(settings.reductionRatio > 0.f && settings.reductionRatio < 1.f);
+
+	Vec3 boundsMin = vertexCount ? vertices[0].position : Vec3{0.f, 0.f, 0.f};
+	Vec3 boundsMax = boundsMin;
+	for(uint32_t i = 1; i < vertexCount; i++)
+	{
+		for(uint32_t c = 0; c < 3; c++)
+		{
+			boundsMin.data[c] = std::min(boundsMin.data[c], vertices[i].position.data[c]);
+			boundsMax.data[c] = std::max(boundsMax.data[c], vertices[i].position.data[c]);
+		}
+	}
+	const Vec3 size = boundsMax - boundsMin;
+	const float extent = std::max(size.x, std::max(size.y, size.z));
+
+	MeshLod lod = {static_cast<uint32_t>(out->indexBuffer.size()), indexCount, 0.f};
+	out->indexBuffer.insert(out->indexBuffer.end(), indices, indices + indexCount);
+	out->lods.push_back(lod);
+	uint32_t lodCount = 1;
+
+	std::vector<unsigned int> source(indices, indices + indexCount);
+	std::vector<unsigned int> simplified(indexCount);
+	while(lodCount < settings.maxLodCount)
+	{
+		const uint32_t sourceCount = static_cast<uint32_t>(source.size());
+		const uint32_t targetCount = static_cast<uint32_t>(sourceCount / 3 * settings.reductionRatio) * 3;
+		float levelError = 0.f;
+		const uint32_t count = simplify_mesh(vertices, vertexCount, source.data(), sourceCount, targetCount,
+			settings.maxError, settings.skinWeightImportance, simplified.data(), &levelError);
+		if(count == 0 || count > sourceCount * (1.f - MIN_LOD_REDUCTION))
+		{
+			break;
+		}
+
+		//collapses scatter triangle order
+		meshopt_optimizeVertexCache(simplified.data(), simplified.data(), count, vertexCount);
+
+		//each level simplifies the previous one, so errors add up
+		lod.firstIndex = static_cast<uint32_t>(out->indexBuffer.size());
+		lod.indexCount = count;
+		lod.error += levelError * extent;
+		out->indexBuffer.insert(out->indexBuffer.end(), simplified.begin(), simplified.begin() + count);
+		out->lods.push_back(lod);
+		lodCount++;
+
+		source.assign(simplified.begin(), simplified.begin() + count);
+	}
+
+	magma::log::debug("Generated {} lods, {} to {} triangles, max error {}",
+		lodCount, indexCount / 3, lod.indexCount / 3, lod.error);
+	return lodCount;
+}
+
+void generate_scene_lods(const Scene& scene, const MeshLodSettings& settings, SceneLods* out)
+{
+	assert(out);
+	out->primitiveLods.reserve(out->primitiveLods.size() + scene.primitives.size());
+	for(const MeshPrimitive& primitive : scene.primitives)
+	{
+		MeshLodRange range = {};
+		range.firstLod = static_cast<uint32_t>(out->chain.lods.size());
+		range.lodCount = generate_mesh_lods(&scene.vertexBuffer[primitive.vertexOffset], primitive.vertexCount,
+			&scene.indexBuffer[primitive.firstIndex], primitive.indexCount, settings, &out->chain);
+		out->primitiveLods.push_back(range);
+	}
+}
+
+float get_lod_projection_scale(float fovYDegrees, float viewportHeight)
+{
+	return viewportHeight / (2.f * std::tan(toRad(fovYDegrees) * 0.5f));
+}
+
+uint32_t select_mesh_lod(const MeshLod* lods, uint32_t lodCount, float meshScale, float distance,
+	float projectionScale, float maxPixelError)
+{
+	assert(lods && lodCount);
+	//camera inside the bounds always gets full detail
+	if(distance <= 0.f)
+	{
+		return 0;
+	}
+
+	for(uint32_t i = lodCount - 1; i > 0; i--)
+	{
+		const float pixelError = lods[i].error * meshScale * projectionScale / distance;
+		if(pixelError <= maxPixelError)
+		{
+			return i;
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,64 @@
+#ifndef MAGMA_MESH_LOD_H
+#define MAGMA_MESH_LOD_H
+
+#include "mesh_loaders.h"
+
+#include <vector>
+
+struct MeshLodSettings
+{
+	uint32_t maxLodCount = 4;//including full detail level
+	float reductionRatio = 0.5f;//target index count of a level relative to the previous one
+	float maxError = 0.02f;//per level, relative to mesh extent. Chain ends once a level barely reduces within it
+	float skinWeightImportance = 1.f;//cost of moving a vertex onto one with fully different skin weights, in squared mesh extents
+};
+
+//range of the shared lod index buffer
+struct MeshLod
+{
+	uint32_t firstIndex;
+	uint32_t indexCount;
+	float error;//max deviation from full detail surface, in mesh units
+};
+
+//levels go from full detail to coarsest, all of them index the same vertices
+struct MeshLodChain
+{
+	std::vector<unsigned int> indexBuffer;
+	std::vector<MeshLod> lods;
+};
+
+struct MeshLodRange
+{
+	uint32_t firstLod;
+	uint32_t lodCount;
+};
+
+//one range per scene primitive, indices are relative to primitive vertexOffset as in the scene
+struct SceneLods
+{
+	MeshLodChain chain;
+	std::vector<MeshLodRange> primitiveLods;
+};
+
+//quadric edge collapse of triangles down to targetIndexCount or until error exceeds targetError (relative to mesh extent).
+//vertices sharing position with different attributes form seams that only collapse along themselves, same goes for borders.
+//returns resulting index count, error receives relative error of the result
+uint32_t simplify_mesh(const Vertex* vertices, uint32_t vertexCount, const unsigned int* indices, uint32_t indexCount,
+	uint32_t targetIndexCount, float targetError, float skinWeightImportance, unsigned int* out, float* error = nullptr);
+
+//appends levels to out, returns number of appended levels
+uint32_t generate_mesh_lods(const Vertex* vertices, uint32_t vertexCount, const unsigned int* indices, uint32_t indexCount,
+	const MeshLodSettings& settings, MeshLodChain* out);
+
+void generate_scene_lods(const Scene& scene, const MeshLodSettings& settings, SceneLods* out);
+
+//pixels per unit of error at distance 1
+float get_lod_projection_scale(float fovYDegrees, float viewportHeight);
+
+//coarsest level with projected error below maxPixelError. meshScale brings lod errors to world units,
+//distance is from the camera to the closest point of object bounds
+uint32_t select_mesh_lod(const MeshLod* lods, uint32_t lodCount, float meshScale, float distance,
+	float projectionScale, float maxPixelError);
+
+#endif
@@ -0,0 +1,271 @@
+#include "mipmaps.h"
+#include "vk_resource.h"
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+
+static constexpr uint32_t MIP_CHANNELS = 4;
+static constexpr uint32_t SRGB_ENCODE_TABLE_SIZE = 1 << 14;//keeps darkest encoded steps within a fraction of a unit
+static constexpr uint32_t MAX_FILTER_TAPS = 8;
+static constexpr float KAISER_ALPHA = 4.f;
+static constexpr uint32_t TRANSPOSE_TILE_SIZE = 16;
+
+struct SrgbTables
+{
+	std::array<float, 256> decode;
+	std::array<uint8_t, SRGB_ENCODE_TABLE_SIZE> encode;
+};
+
+//separable kernel, taps cover source pixels [2x + firstTap, 2x + firstTap + tapCount)
+struct FilterKernel
+{
+	float weights[MAX_FILTER_TAPS];
+	int32_t firstTap;
+	uint32_t tapCount;
+};
+
+static float srgb_to_linear(float value)
+{
+	return value <= 0.04045f ? value / 12.92f : std::pow((value + 0.055f) / 1.055f, 2.4f);
+}
+
+static float linear_to_srgb(float value)
+{
+	return value <= 0.0031308f ? value * 12.92f : 1.055f * std::pow(value, 1.f / 2.4f) - 0.055f;
+}
+
+static const SrgbTables& get_srgb_tables()
+{
+	static const SrgbTables tables = []()
+	{
+		SrgbTables out = {};
+		for(uint32_t i = 0; i < out.decode.size(); i++)
+		{
+			out.decode[i] = srgb_to_linear(i / 255.f);
+		}
+		for(uint32_t i = 0; i < out.encode.size(); i++)
+		{
+			const float linear = i / float(SRGB_ENCODE_TABLE_SIZE - 1);
+			out.encode[i] = static_cast<uint8_t>(linear_to_srgb(linear) * 255.f + 0.5f);
+		}
+		return out;
+	}();
+	return tables;
+}
+
+//zeroth order modified bessel function of the first kind
+static float bessel_i0(float x)
+{
+	float sum = 1.f;
+	float term = 1.f;
+	const float halfSq = x * x * 0.25f;
+	for(uint32_t k = 1; k < 16; k++)
+	{
+		term *= halfSq / float(k * k);
+		sum += term;
+	}
+	return sum;
+}
+
+static FilterKernel build_filter_kernel(MipFilter filter)
+{
+	FilterKernel kernel = {};
+	if(filter == MIP_FILTER_BOX)
+	{
+		kernel.weights[0] = 0.5f;
+		kernel.weights[1] = 0.5f;
+		kernel.firstTap = 0;
+		kernel.tapCount = 2;
+		return kernel;
+	}
+
+	//destination pixel center lands between source pixels 2x and 2x + 1
+	kernel.firstTap = -3;
+	kernel.tapCount = MAX_FILTER_TAPS;
+	const float halfWidth = MAX_FILTER_TAPS * 0.5f;
+	float weightSum = 0.f;
+	for(uint32_t i = 0; i < kernel.tapCount; i++)
+	{
+		const float distance = kernel.firstTap + float(i) - 0.5f;//in source pixels
+		const float t = distance * 0.5f;//in destination pixels
+		const float sinc = t == 0.f ? 1.f : std::sin(float(M_PI) * t) / (float(M_PI) * t);
+		const float window = distance / halfWidth;
+		const float kaiser = bessel_i0(KAISER_ALPHA * std::sqrt(std::max(1.f - window * window, 0.f))) / bessel_i0(KAISER_ALPHA);
+		kernel.weights[i] = sinc * kaiser;
+		weightSum += kernel.weights[i];
+	}
+	for(uint32_t i = 0; i < kernel.tapCount; i++)
+	{
+		kernel.weights[i] /= weightSum;
+	}
+	return kernel;
+}
+
+static uint32_t get_mip_dimension(uint32_t baseDimension, uint32_t level)
+{
+	return std::max(baseDimension >> level, 1u);
+}
+
+static void decode_level(const uint8_t* pixels, std::size_t pixelCount, MipColorSpace colorSpace, float* out)
+{
+	const SrgbTables& tables = get_srgb_tables();
+	for(std::size_t i = 0; i < pixelCount * MIP_CHANNELS; i += MIP_CHANNELS)
+	{
+		for(uint32_t c = 0; c < 3; c++)
+		{
+			out[i + c] = colorSpace == MIP_COLOR_SRGB ? tables.decode[pixels[i + c]] : pixels[i + c] / 255.f;
+		}
+		out[i + 3] = pixels[i + 3] / 255.f;
+	}
+}
+
+static void encode_level(const float* pixels, std::size_t pixelCount, MipColorSpace colorSpace, uint8_t* out)
+{
+	const SrgbTables& tables = get_srgb_tables();
+	for(std::size_t i = 0; i < pixelCount * MIP_CHANNELS; i += MIP_CHANNELS)
+	{
+		for(uint32_t c = 0; c < MIP_CHANNELS; c++)
+		{
+			//kaiser lobes may overshoot
+			const float value = std::min(std::max(pixels[i + c], 0.f), 1.f);
+			if(colorSpace == MIP_COLOR_SRGB && c < 3)
+			{
+				out[i + c] = tables.encode[static_cast<uint32_t>(value * (SRGB_ENCODE_TABLE_SIZE - 1) + 0.5f)];
+			}
+			else
+			{
+				out[i + c] = static_cast<uint8_t>(value * 255.f + 0.5f);
+			}
+		}
+	}
+}
+
+//halves height, accumulates whole rows so the inner loop runs over contiguous floats
+static void filter_columns(const float* src, uint32_t width, uint32_t srcHeight, uint32_t dstHeight,
+	const FilterKernel& kernel, float* dst)
+{
+	const std::size_t rowFloats = std::size_t(width) * MIP_CHANNELS;
+	for(uint32_t y = 0; y < dstHeight; y++)
+	{
+		float* dstRow = dst + y * rowFloats;
+		std::fill(dstRow, dstRow + rowFloats, 0.f);
+		for(uint32_t tap = 0; tap < kernel.tapCount; tap++)
+		{
+			const int32_t sy = std::min(std::max(int32_t(y * 2) + kernel.firstTap + int32_t(tap), 0), int32_t(srcHeight) - 1);
+			const float* srcRow = src + sy * rowFloats;
+			const float weight = kernel.weights[tap];
+			for(std::size_t i = 0; i < rowFloats; i += MIP_CHANNELS)
+			{
+				float sum[MIP_CHANNELS];
+				std::memcpy(sum, dstRow + i, sizeof(sum));
+				for(uint32_t c = 0; c < MIP_CHANNELS; c++)
+				{
+					sum[c] += srcRow[i + c] * weight;
+				}
+				std::memcpy(dstRow + i, sum, sizeof(sum));
+			}
+		}
+	}
+}
+
+//swaps rows and columns of rgba pixels in square tiles, so both sides stay within cache
+static void transpose_pixels(const float* src, uint32_t width, uint32_t height, float* dst)
+{
+	for(uint32_t tileY = 0; tileY < height; tileY += TRANSPOSE_TILE_SIZE)
+	{
+		for(uint32_t tileX = 0; tileX < width; tileX += TRANSPOSE_TILE_SIZE)
+		{
+			const uint32_t endY = std::min(tileY + TRANSPOSE_TILE_SIZE, height);
+			const uint32_t endX = std::min(tileX + TRANSPOSE_TILE_SIZE, width);
+			for(uint32_t y = tileY; y < endY; y++)
+			{
+				for(uint32_t x = tileX; x < endX; x++)
+				{
+					std::memcpy(dst + (std::size_t(x) * height + y) * MIP_CHANNELS, src + (std::size_t(y) * width + x) * MIP_CHANNELS,
+						MIP_CHANNELS * sizeof(float));
+				}
+			}
+		}
+	}
+}
+
+//halves width of every row. Rows are transposed to columns first, so the taps run through
+//filter_columns over contiguous floats instead of being gathered and clamped pixel by pixel.
+//transposed holds srcWidth * height pixels, transposedFiltered dstWidth * height
+static void filter_rows(const float* src, uint32_t srcWidth, uint32_t height, uint32_t dstWidth,
+	const FilterKernel& kernel, float* transposed, float* transposedFiltered, float* dst)
+{
+	transpose_pixels(src, srcWidth, height, transposed);
+	filter_columns(transposed, height, srcWidth, dstWidth, kernel, transposedFiltered);
+	transpose_pixels(transposedFiltered, height, dstWidth, dst);
+}
+
+void generate_mip_chain(const TextureInfo* layers, uint32_t layerCount, MipFilter filter, MipColorSpace colorSpace, MipChain* out)
+{
+	assert(layers && layerCount && out);
+	const VkExtent3D extent = layers[0].extent;
+	const uint32_t levelCount = get_mip_level_count(extent);
+
+	out->extent = extent;
+	out->format = layers[0].format;
+	out->layerCount = layerCount;
+	out->levelOffsets.resize(levelCount);
+
+	VkDeviceSize layerSize = 0;
+	for(uint32_t level = 0; level < levelCount; level++)
+	{
+		out->levelOffsets[level] = layerSize;
+		layerSize += VkDeviceSize(get_mip_dimension(extent.width, level)) * get_mip_dimension(extent.height, level) * MIP_CHANNELS;
+	}
+	out->layerStride = layerSize;
+	out->data.resize(layerSize * layerCount);
+
+	const FilterKernel kernel = build_filter_kernel(filter);
+	const std::size_t basePixelCount = std::size_t(extent.width) * extent.height;
+	std::vector<float> level(basePixelCount * MIP_CHANNELS);
+	std::vector<float> nextLevel(basePixelCount * MIP_CHANNELS);
+	std::vector<float> columnsFiltered(basePixelCount * MIP_CHANNELS / 2);
+	std::vector<float> transposed(basePixelCount * MIP_CHANNELS);//rows of 1 pixel high levels are transposed unfiltered
+	std::vector<float> transposedFiltered(basePixelCount * MIP_CHANNELS / 2);
+
+	for(uint32_t layer = 0; layer < layerCount; layer++)
+	{
+		assert(layers[layer].data && layers[layer].numc == MIP_CHANNELS);
+		assert(layers[layer].extent.width == extent.width && layers[layer].extent.height == extent.height);
+		uint8_t* layerData = out->data.data() + layer * layerSize;
+		std::memcpy(layerData, layers[layer].data, basePixelCount * MIP_CHANNELS);
+
+		//every level is filtered from the previous one in linear float, quantised only on the way out
+		decode_level(layers[layer].data, basePixelCount, colorSpace, level.data());
+		for(uint32_t mip = 1; mip < levelCount; mip++)
+		{
+			const uint32_t srcWidth = get_mip_dimension(extent.width, mip - 1);
+			const uint32_t srcHeight = get_mip_dimension(extent.height, mip - 1);
+			const uint32_t dstWidth = get_mip_dimension(extent.width, mip);
+			const uint32_t dstHeight = get_mip_dimension(extent.height, mip);
+
+			//1 pixel wide side is left as is, filter is normalised so it's a no op otherwise.
+			//Columns go first, so rows are transposed at half the size
+			const float* columns = level.data();
+			if(dstHeight != srcHeight)
+			{
+				filter_columns(level.data(), srcWidth, srcHeight, dstHeight, kernel, columnsFiltered.data());
+				columns = columnsFiltered.data();
+			}
+			if(dstWidth != srcWidth)
+			{
+				filter_rows(columns, srcWidth, dstHeight, dstWidth, kernel, transposed.data(), transposedFiltered.data(), nextLevel.data());
+			}
+			else
+			{
+				std::copy(columns, columns + std::size_t(dstWidth) * dstHeight * MIP_CHANNELS, nextLevel.begin());
+			}
+
+			encode_level(nextLevel.data(), std::size_t(dstWidth) * dstHeight, colorSpace, layerData + out->levelOffsets[mip]);
+			std::swap(level, nextLevel);
+		}
+	}
+}
@@ -0,0 +1,35 @@
+#ifndef MAGMA_MIPMAPS_H
+#define MAGMA_MIPMAPS_H
+
+#include "mesh_loaders.h"
+
+#include <vector>
+
+enum MipFilter
+{
+	MIP_FILTER_BOX,   //2x2 average, cheap and soft
+	MIP_FILTER_KAISER //8 tap windowed sinc, keeps detail without aliasing
+};
+
+enum MipColorSpace
+{
+	MIP_COLOR_SRGB,  //rgb is decoded to linear before filtering, alpha stays linear
+	MIP_COLOR_LINEAR //normal maps, masks and other non color data
+};
+
+//rgba8 levels of every layer packed one after another, layer after layer.
+//Layout matches push_mip_chain_to_device_local_image
+struct MipChain
+{
+	std::vector<uint8_t> data;
+	std::vector<VkDeviceSize> levelOffsets;//relative to the start of a layer
+	VkDeviceSize layerStride;
+	VkExtent3D extent;//of level 0
+	VkFormat format;
+	uint32_t layerCount;
+};
+
+//full chain down to 1x1. Layers (e.g. cubemap faces) must share extent and format
+void generate_mip_chain(const TextureInfo* layers, uint32_t layerCount, MipFilter filter, MipColorSpace colorSpace, MipChain* out);
+
+#endif
@@ -0,0 +1,127 @@
+#include "platform.h"
+
+#include <logging.h>
+
+#include <cassert>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+bool map_file(const char* path, MappedFile* out)
+{
+	assert(path);
+	assert(out);
+	*out = {};
+
+#ifdef _WIN32
+	HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if(file == INVALID_HANDLE_VALUE)
+	{
+		magma::log::error("Failed to open file {}", path);
+		return false;
+	}
+
+	LARGE_INTEGER fileSize = {};
+	if(!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+	{
+		magma::log::error("Failed to query size of file {}", path);
+		CloseHandle(file);
+		return false;
+	}
+
+	HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	const void* data = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+	if(!data)
+	{
+		magma::log::error("Failed to map file {}", path);
+		if(mapping)
+		{
+			CloseHandle(mapping);
+		}
+		CloseHandle(file);
+		return false;
+	}
+
+	out->data = static_cast<const uint8_t*>(data);
+	out->size = static_cast<std::size_t>(fileSize.QuadPart);
+	out->fileHandle = file;
+	out->mappingHandle = mapping;
+#else
+	int file = open(path, O_RDONLY);
+	if(file == -1)
+	{
+		magma::log::error("Failed to open file {}", path);
+		return false;
+	}
+
+	struct stat fileStat = {};
+	if(fstat(file, &fileStat) != 0 || fileStat.st_size == 0)
+	{
+		magma::log::error("Failed to query size of file {}", path);
+		close(file);
+		return false;
+	}
+
+	void* data = mmap(nullptr, static_cast<std::size_t>(fileStat.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+	//mapping keeps its own reference to the file
+	close(file);
+	if(data == MAP_FAILED)
+	{
+		magma::log::error("Failed to map file {}", path);
+		return false;
+	}
+
+	out->data = static_cast<const uint8_t*>(data);
+	out->size = static_cast<std::size_t>(fileStat.st_size);
+#endif
+	return true;
+}
+
+void unmap_file(MappedFile* file)
+{
+	assert(file);
+	if(!file->data)
+	{
+		return;
+	}
+
+#ifdef _WIN32
+	UnmapViewOfFile(file->data);
+	CloseHandle(file->mappingHandle);
+	CloseHandle(file->fileHandle);
+#else
+	munmap(const_cast<uint8_t*>(file->data), file->size);
+#endif
+	*file = {};
+}
+
+bool create_directory(const char* path)
+{
+	assert(path);
+#ifdef _WIN32
+	if(CreateDirectoryA(path, nullptr) || GetLastError() == ERROR_ALREADY_EXISTS)
+	{
+		return true;
+	}
+#else
+	if(mkdir(path, 0755) == 0 || errno == EEXIST)
+	{
+		return true;
+	}
+#endif
+	magma::log::error("Failed to create directory {}", path);
+	return false;
+}
@@ -19,5 +19,21 @@ const char** get_required_surface_exts(uint32_t* surfaceExtCount);
 
 void destroy_platform_window(const VulkanGlobalContext& vkCtx, WindowInfo* info);
 
+//read only view of a whole file, pages are loaded by the os on first access
+struct MappedFile
+{
+	const uint8_t* data;
+	std::size_t size;
+	void* fileHandle;
+	void* mappingHandle;
+};
+
+bool map_file(const char* path, MappedFile* out);
+
+void unmap_file(MappedFile* file);
+
+//succeeds when directory already exists
+bool create_directory(const char* path);
+
 
 #endif
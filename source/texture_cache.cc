@@ -0,0 +1,452 @@
+#include "texture_cache.h"
+#include "mesh_cache.h"
+#include "vk_dbg.h"
+#include "vk_resource.h"
+#include "logging.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+static constexpr uint8_t KTX2_IDENTIFIER[12] = {0xab, 'K', 'T', 'X', ' ', '2', '0', 0xbb, '\r', '\n', 0x1a, '\n'};
+static constexpr uint32_t COOKED_TEXTURE_VERSION = 1;
+static constexpr const char* KTX2_WRITER_KEY = "KTXwriter";
+static constexpr const char* KTX2_WRITER = "magma";
+static constexpr const char* SOURCE_HASH_KEY = "magma.sourceHash";
+
+//data format descriptor values, khr_df.h
+static constexpr uint32_t KHR_DF_MODEL_BC1A = 128;
+static constexpr uint32_t KHR_DF_MODEL_BC3 = 130;
+static constexpr uint32_t KHR_DF_MODEL_BC5 = 132;
+static constexpr uint32_t KHR_DF_MODEL_BC7 = 134;
+static constexpr uint32_t KHR_DF_PRIMARIES_BT709 = 1;
+static constexpr uint32_t KHR_DF_TRANSFER_LINEAR = 1;
+static constexpr uint32_t KHR_DF_TRANSFER_SRGB = 2;
+static constexpr uint32_t KHR_DF_CHANNEL_COLOR = 0;
+static constexpr uint32_t KHR_DF_CHANNEL_RED = 0;
+static constexpr uint32_t KHR_DF_CHANNEL_GREEN = 1;
+static constexpr uint32_t KHR_DF_CHANNEL_ALPHA = 15;
+static constexpr uint32_t KHR_DF_SAMPLE_DATATYPE_LINEAR = 0x10;
+
+struct Ktx2Header
+{
+	uint8_t identifier[12];
+	uint32_t vkFormat;
+	uint32_t typeSize;
+	uint32_t pixelWidth;
+	uint32_t pixelHeight;
+	uint32_t pixelDepth;
+	uint32_t layerCount;
+	uint32_t faceCount;
+	uint32_t levelCount;
+	uint32_t supercompressionScheme;
+	uint32_t dfdByteOffset;
+	uint32_t dfdByteLength;
+	uint32_t kvdByteOffset;
+	uint32_t kvdByteLength;
+	uint64_t sgdByteOffset;
+	uint64_t sgdByteLength;
+};
+
+struct Ktx2Level
+{
+	uint64_t byteOffset;//from the beginning of the file
+	uint64_t byteLength;
+	uint64_t uncompressedByteLength;
+};
+
+static_assert(sizeof(Ktx2Header) == 80, "ktx2 header is read straight from the file");
+static_assert(sizeof(Ktx2Level) == 24, "ktx2 level index is read straight from the file");
+
+static std::size_t align_up(std::size_t value, std::size_t alignment)
+{
+	return (value + alignment - 1) / alignment * alignment;
+}
+
+static void append_words(std::vector<uint8_t>* file, const uint32_t* words, uint32_t count)
+{
+	const std::size_t offset = file->size();
+	file->resize(offset + count * sizeof(uint32_t));
+	memcpy(file->data() + offset, words, count * sizeof(uint32_t));
+}
+
+//basic descriptor block, one sample per 64 or 128 bits of the block
+static void append_data_format_descriptor(std::vector<uint8_t>* file, TextureBlockFormat format, MipColorSpace colorSpace)
+{
+	struct Sample
+	{
+		uint32_t bitOffset;
+		uint32_t bitLength;
+		uint32_t channel;
+	};
+	Sample samples[2] = {};
+	uint32_t sampleCount = 1;
+	uint32_t colorModel = 0;
+	switch(format)
+	{
+		case TEXTURE_BLOCK_BC1:
+			colorModel = KHR_DF_MODEL_BC1A;
+			samples[0] = {0, 64, KHR_DF_CHANNEL_COLOR};
+			break;
+		case TEXTURE_BLOCK_BC3:
+			colorModel = KHR_DF_MODEL_BC3;
+			samples[0] = {0, 64, KHR_DF_CHANNEL_ALPHA | (colorSpace == MIP_COLOR_SRGB ? KHR_DF_SAMPLE_DATATYPE_LINEAR : 0)};
+			samples[1] = {64, 64, KHR_DF_CHANNEL_COLOR};
+			sampleCount = 2;
+			break;
+		case TEXTURE_BLOCK_BC5:
+			colorModel = KHR_DF_MODEL_BC5;
+			samples[0] = {0, 64, KHR_DF_CHANNEL_RED};
+			samples[1] = {64, 64, KHR_DF_CHANNEL_GREEN};
+			sampleCount = 2;
+			break;
+		case TEXTURE_BLOCK_BC7:
+			colorModel = KHR_DF_MODEL_BC7;
+			samples[0] = {0, 128, KHR_DF_CHANNEL_COLOR};
+			break;
+	}
+
+	const uint32_t blockSize = 24 + 16 * sampleCount;
+	const uint32_t transfer = colorSpace == MIP_COLOR_SRGB ? KHR_DF_TRANSFER_SRGB : KHR_DF_TRANSFER_LINEAR;
+	const uint32_t header[7] = {
+		4 + blockSize,//total size
+		0,//khronos vendor, basic descriptor type
+		2 | (blockSize << 16),//version 1.3
+		colorModel | (KHR_DF_PRIMARIES_BT709 << 8) | (transfer << 16),
+		(TEXTURE_BLOCK_DIM - 1) | ((TEXTURE_BLOCK_DIM - 1) << 8),
+		get_block_byte_size(format),
+		0
+	};
+	append_words(file, header, 7);
+	for(uint32_t i = 0; i < sampleCount; i++)
+	{
+		const uint32_t sample[4] = {samples[i].bitOffset | ((samples[i].bitLength - 1) << 16) | (samples[i].channel << 24), 0, 0, UINT32_MAX};
+		append_words(file, sample, 4);
+	}
+}
+
+static void append_key_value(std::vector<uint8_t>* file, const char* key, const void* value, uint32_t valueSize)
+{
+	const uint32_t keySize = static_cast<uint32_t>(strlen(key)) + 1;
+	const uint32_t entrySize = keySize + valueSize;
+	const std::size_t offset = file->size();
+	file->resize(align_up(offset + sizeof(entrySize) + entrySize, 4));
+	memcpy(file->data() + offset, &entrySize, sizeof(entrySize));
+	memcpy(file->data() + offset + sizeof(entrySize), key, keySize);
+	memcpy(file->data() + offset + sizeof(entrySize) + keySize, value, valueSize);
+}
+
+static uint32_t get_level_dimension(uint32_t baseDimension, uint32_t level)
+{
+	return std::max(baseDimension >> level, 1u);
+}
+
+bool cook_texture(const char* cookedPath, uint64_t sourceHash, const MipChain& mips, TextureBlockFormat format,
+	MipColorSpace colorSpace, JobSystem* jobSystem)
+{
+	assert(cookedPath);
+	assert(mips.layerCount == 1 || mips.layerCount == 6);
+	assert(format != TEXTURE_BLOCK_BC5 || colorSpace == MIP_COLOR_LINEAR);
+	const uint32_t levelCount = static_cast<uint32_t>(mips.levelOffsets.size());
+	if(levelCount > MAX_COOKED_TEXTURE_LEVELS)
+	{
+		magma::log::error("Texture for {} has {} mip levels, at most {} can be cooked", cookedPath, levelCount, MAX_COOKED_TEXTURE_LEVELS);
+		return false;
+	}
+
+	Ktx2Header header = {};
+	memcpy(header.identifier, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER));
+	header.vkFormat = get_block_vk_format(format, colorSpace);
+	header.typeSize = 1;
+	header.pixelWidth = mips.extent.width;
+	header.pixelHeight = mips.extent.height;
+	header.faceCount = mips.layerCount;
+	header.levelCount = levelCount;
+
+	std::vector<uint8_t> file(sizeof(Ktx2Header) + levelCount * sizeof(Ktx2Level));
+	header.dfdByteOffset = static_cast<uint32_t>(file.size());
+	append_data_format_descriptor(&file, format, colorSpace);
+	header.dfdByteLength = static_cast<uint32_t>(file.size() - header.dfdByteOffset);
+
+	//keys are sorted
+	header.kvdByteOffset = static_cast<uint32_t>(file.size());
+	append_key_value(&file, KTX2_WRITER_KEY, KTX2_WRITER, static_cast<uint32_t>(strlen(KTX2_WRITER)) + 1);
+	append_key_value(&file, SOURCE_HASH_KEY, &sourceHash, sizeof(sourceHash));
+	header.kvdByteLength = static_cast<uint32_t>(file.size() - header.kvdByteOffset);
+
+	//smallest level goes first so that streaming readers get something to show early
+	const std::size_t blockSize = get_block_byte_size(format);
+	Ktx2Level levels[MAX_COOKED_TEXTURE_LEVELS] = {};
+	for(uint32_t level = levelCount; level-- > 0;)
+	{
+		const uint32_t width = get_level_dimension(mips.extent.width, level);
+		const uint32_t height = get_level_dimension(mips.extent.height, level);
+		const std::size_t faceSize = get_compressed_size(width, height, format);
+		const std::size_t levelOffset = align_up(file.size(), blockSize);
+		file.resize(levelOffset + faceSize * mips.layerCount);
+		for(uint32_t face = 0; face < mips.layerCount; face++)
+		{
+			const uint8_t* pixels = mips.data.data() + face * mips.layerStride + mips.levelOffsets[level];
+			compress_image(pixels, width, height, format, jobSystem, file.data() + levelOffset + face * faceSize);
+		}
+		levels[level] = {levelOffset, faceSize * mips.layerCount, faceSize * mips.layerCount};
+	}
+	memcpy(file.data(), &header, sizeof(header));
+	memcpy(file.data() + sizeof(header), levels, levelCount * sizeof(Ktx2Level));
+
+	//readers never see partially written file
+	const std::string tempPath = std::string(cookedPath) + ".tmp";
+	FILE* out = fopen(tempPath.c_str(), "wb");
+	if(!out)
+	{
+		magma::log::error("Failed to open {} for writing", tempPath);
+		return false;
+	}
+	const bool written = fwrite(file.data(), 1, file.size(), out) == file.size();
+	if(fclose(out) != 0 || !written)
+	{
+		magma::log::error("Failed to write cooked texture {}", tempPath);
+		remove(tempPath.c_str());
+		return false;
+	}
+
+	remove(cookedPath);
+	if(rename(tempPath.c_str(), cookedPath) != 0)
+	{
+		magma::log::error("Failed to move cooked texture to {}", cookedPath);
+		remove(tempPath.c_str());
+		return false;
+	}
+	return true;
+}
+
+static bool find_source_hash(const uint8_t* kvd, std::size_t size, uint64_t* sourceHash)
+{
+	const std::size_t keySize = strlen(SOURCE_HASH_KEY) + 1;
+	std::size_t offset = 0;
+	while(offset + sizeof(uint32_t) <= size)
+	{
+		uint32_t entrySize;
+		memcpy(&entrySize, kvd + offset, sizeof(entrySize));
+		offset += sizeof(entrySize);
+		if(entrySize > size - offset)
+		{
+			return false;
+		}
+		if(entrySize == keySize + sizeof(uint64_t) && memcmp(kvd + offset, SOURCE_HASH_KEY, keySize) == 0)
+		{
+			memcpy(sourceHash, kvd + offset + keySize, sizeof(uint64_t));
+			return true;
+		}
+		offset = align_up(offset + entrySize, 4);
+	}
+	return false;
+}
+
+bool open_cooked_texture(const char* cookedPath, uint64_t sourceHash, CookedTexture* out)
+{
+	assert(cookedPath);
+	assert(out);
+	*out = {};
+
+	MappedFile file = {};
+	if(!map_file(cookedPath, &file))
+	{
+		return false;
+	}
+
+	Ktx2Header header = {};
+	TextureBlockFormat blockFormat = {};
+	MipColorSpace colorSpace = {};
+	bool isValid = file.size >= sizeof(header);
+	if(isValid)
+	{
+		memcpy(&header, file.data, sizeof(header));
+		isValid = memcmp(header.identifier, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER)) == 0
+			&& get_texture_block_format(static_cast<VkFormat>(header.vkFormat), &blockFormat, &colorSpace)
+			&& header.pixelWidth && header.pixelHeight && !header.pixelDepth && !header.layerCount
+			&& (header.faceCount == 1 || header.faceCount == 6)
+			&& header.levelCount && header.levelCount <= MAX_COOKED_TEXTURE_LEVELS
+			&& header.supercompressionScheme == 0
+			&& file.size - sizeof(header) >= header.levelCount * sizeof(Ktx2Level)
+			&& header.kvdByteOffset <= file.size && header.kvdByteLength <= file.size - header.kvdByteOffset;
+	}
+
+	uint64_t cookedHash = 0;
+	if(isValid)
+	{
+		isValid = find_source_hash(file.data + header.kvdByteOffset, header.kvdByteLength, &cookedHash) && cookedHash == sourceHash;
+	}
+
+	Ktx2Level levels[MAX_COOKED_TEXTURE_LEVELS] = {};
+	if(isValid)
+	{
+		memcpy(levels, file.data + sizeof(header), header.levelCount * sizeof(Ktx2Level));
+	}
+	for(uint32_t level = 0; isValid && level < header.levelCount; level++)
+	{
+		const std::size_t expectedSize = header.faceCount * get_compressed_size(
+			get_level_dimension(header.pixelWidth, level), get_level_dimension(header.pixelHeight, level), blockFormat);
+		isValid = levels[level].byteLength == expectedSize && levels[level].byteOffset <= file.size
+			&& levels[level].byteLength <= file.size - levels[level].byteOffset;
+	}
+
+	if(!isValid)
+	{
+		magma::log::warn("Cooked texture {} is stale or damaged", cookedPath);
+		unmap_file(&file);
+		return false;
+	}
+
+	out->file = file;
+	out->format = static_cast<VkFormat>(header.vkFormat);
+	out->blockFormat = blockFormat;
+	out->colorSpace = colorSpace;
+	out->extent = {header.pixelWidth, header.pixelHeight, 1};
+	out->levelCount = header.levelCount;
+	out->faceCount = header.faceCount;
+	for(uint32_t level = 0; level < header.levelCount; level++)
+	{
+		out->levels[level] = file.data + levels[level].byteOffset;
+		out->levelSizes[level] = levels[level].byteLength;
+	}
+	return true;
+}
+
+void close_cooked_texture(CookedTexture* texture)
+{
+	assert(texture);
+	unmap_file(&texture->file);
+	*texture = {};
+}
+
+bool load_texture_cached(const char* path, const char* cacheDir, TextureBlockFormat format, MipColorSpace colorSpace,
+	CookedTexture* out, JobSystem* jobSystem, bool flipImage)
+{
+	assert(path);
+	assert(cacheDir);
+	assert(out);
+
+	//cooked blocks depend on the settings as much as on the source
+	const uint64_t settings = COOKED_TEXTURE_VERSION | (uint64_t(format) << 8) | (uint64_t(colorSpace) << 16) | (uint64_t(flipImage) << 24);
+	uint64_t sourceHash = 0;
+	if(!hash_file(path, settings, &sourceHash))
+	{
+		return false;
+	}
+
+	char fileName[32];
+	snprintf(fileName, sizeof(fileName), "/%016llx.ktx2", static_cast<unsigned long long>(sourceHash));
+	const std::string cookedPath = std::string(cacheDir) + fileName;
+	//probe first so that a cold cache doesn't log failed mapping
+	FILE* cachedFile = fopen(cookedPath.c_str(), "rb");
+	if(cachedFile)
+	{
+		fclose(cachedFile);
+	}
+	if(cachedFile && open_cooked_texture(cookedPath.c_str(), sourceHash, out))
+	{
+		return true;
+	}
+
+	TextureInfo texture = {};
+	if(!load_texture(path, &texture, flipImage))
+	{
+		return false;
+	}
+	MipChain mips = {};
+	generate_mip_chain(&texture, 1, MIP_FILTER_KAISER, colorSpace, &mips);
+	free_texture(&texture);
+
+	if(!create_directory(cacheDir) || !cook_texture(cookedPath.c_str(), sourceHash, mips, format, colorSpace, jobSystem))
+	{
+		return false;
+	}
+	magma::log::info("Cooked {} into {}", path, cookedPath);
+	return open_cooked_texture(cookedPath.c_str(), sourceHash, out);
+}
+
+bool upload_cooked_texture(UploadQueue* uploadQueue, const VulkanGlobalContext& vkCtx, const CookedTexture& texture, ImageResource* out)
+{
+	assert(uploadQueue && texture.file.data && out);
+	VkFormatProperties formatProps = {};
+	vkGetPhysicalDeviceFormatProperties(vkCtx.physicalDevice, texture.format, &formatProps);
+	const bool canSample = formatProps.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT;
+	VkFormat imageFormat = texture.format;
+	if(!canSample)
+	{
+		magma::log::warn("Device can't sample format {}, decoding texture on the cpu", uint32_t(texture.format));
+		imageFormat = texture.colorSpace == MIP_COLOR_SRGB ? VK_FORMAT_R8G8B8A8_SRGB : VK_FORMAT_R8G8B8A8_UNORM;
+	}
+
+	//compressed levels are staged straight from the mapped file, decoded ones keep the file's layout
+	//of faces of a level following each other, so one region per level covers every face
+	VkDeviceSize levelOffsets[MAX_COOKED_TEXTURE_LEVELS] = {};
+	VkDeviceSize levelSizes[MAX_COOKED_TEXTURE_LEVELS] = {};
+	std::vector<uint8_t> decoded;
+	const uint8_t* data = nullptr;
+	if(canSample)
+	{
+		data = *std::min_element(texture.levels, texture.levels + texture.levelCount);
+		for(uint32_t level = 0; level < texture.levelCount; level++)
+		{
+			levelOffsets[level] = static_cast<VkDeviceSize>(texture.levels[level] - data);
+			levelSizes[level] = texture.levelSizes[level];
+		}
+	}
+	else
+	{
+		VkDeviceSize offset = 0;
+		for(uint32_t level = 0; level < texture.levelCount; level++)
+		{
+			levelOffsets[level] = offset;
+			levelSizes[level] = VkDeviceSize(get_level_dimension(texture.extent.width, level)) *
+				get_level_dimension(texture.extent.height, level) * 4 * texture.faceCount;
+			offset += levelSizes[level];
+		}
+		decoded.resize(offset);
+		for(uint32_t level = 0; level < texture.levelCount; level++)
+		{
+			const uint32_t width = get_level_dimension(texture.extent.width, level);
+			const uint32_t height = get_level_dimension(texture.extent.height, level);
+			const std::size_t faceSize = texture.levelSizes[level] / texture.faceCount;
+			for(uint32_t face = 0; face < texture.faceCount; face++)
+			{
+				decompress_image(texture.levels[level] + face * faceSize, width, height, texture.blockFormat,
+					decoded.data() + levelOffsets[level] + face * std::size_t(width) * height * 4);
+			}
+		}
+		data = decoded.data();
+	}
+
+	VkBufferImageCopy regions[MAX_COOKED_TEXTURE_LEVELS] = {};
+	VkDeviceSize size = 0;
+	for(uint32_t level = 0; level < texture.levelCount; level++)
+	{
+		VkBufferImageCopy& region = regions[level];
+		region.bufferOffset = levelOffsets[level];
+		region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		region.imageSubresource.mipLevel = level;
+		region.imageSubresource.baseArrayLayer = 0;
+		region.imageSubresource.layerCount = texture.faceCount;
+		region.imageExtent = {get_level_dimension(texture.extent.width, level), get_level_dimension(texture.extent.height, level), 1};
+		size = std::max(size, levelOffsets[level] + levelSizes[level]);
+	}
+
+	const VkImageUsageFlags usageFlags = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+	*out = texture.faceCount == 6 ?
+		create_cubemap_image(vkCtx, texture.extent, imageFormat, usageFlags, VK_IMAGE_LAYOUT_UNDEFINED, texture.levelCount) :
+		create_image_resource(vkCtx, texture.extent, imageFormat, usageFlags, VK_IMAGE_LAYOUT_UNDEFINED, texture.levelCount);
+
+	if(!upload_to_image(uploadQueue, vkCtx, data, size, regions, texture.levelCount, out))
+	{
+		magma::log::error("Failed to upload cooked texture to device local image");
+		//regions staged before the failure may still be copied into the image
+		wait_for_upload(uploadQueue, vkCtx, submit_uploads(uploadQueue, vkCtx));
+		destroy_image_resource(vkCtx.logicalDevice, out);
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,44 @@
+#ifndef MAGMA_TEXTURE_CACHE_H
+#define MAGMA_TEXTURE_CACHE_H
+
+#include "texture_compression.h"
+#include "platform/platform.h"
+#include "vk_types.h"
+#include "vk_upload.h"
+
+static constexpr uint32_t MAX_COOKED_TEXTURE_LEVELS = 16;
+
+//read only view of a mapped ktx2 file, pointers stay valid until close_cooked_texture
+struct CookedTexture
+{
+	MappedFile file;
+	VkFormat format;
+	TextureBlockFormat blockFormat;
+	MipColorSpace colorSpace;
+	VkExtent3D extent;
+	uint32_t levelCount;
+	uint32_t faceCount;//6 for cubemaps
+	const uint8_t* levels[MAX_COOKED_TEXTURE_LEVELS];//faces of a level follow each other
+	std::size_t levelSizes[MAX_COOKED_TEXTURE_LEVELS];
+};
+
+//block compresses every level of every layer and writes them into a ktx2 file, 6 layers become cubemap faces.
+//sourceHash is kept in key/value data
+bool cook_texture(const char* cookedPath, uint64_t sourceHash, const MipChain& mips, TextureBlockFormat format,
+	MipColorSpace colorSpace, JobSystem* jobSystem = nullptr);
+
+//fails on malformed file, formats other than the ones cook_texture writes or source hash mismatch
+bool open_cooked_texture(const char* cookedPath, uint64_t sourceHash, CookedTexture* out);
+
+void close_cooked_texture(CookedTexture* texture);
+
+//returns cooked entry of an image from cacheDir, decoding, filtering mips and compressing it first when the entry is missing or stale
+bool load_texture_cached(const char* path, const char* cacheDir, TextureBlockFormat format, MipColorSpace colorSpace,
+	CookedTexture* out, JobSystem* jobSystem = nullptr, bool flipImage = true);
+
+//enqueues levels from the mapped file straight into the upload queue's staging, out->mipLevels is what the sampler should cover.
+//Devices that can't sample the format get levels decoded to rgba8 on the cpu.
+//The file may be closed once it returns, the image sampled once the token of the next submit_uploads completes
+bool upload_cooked_texture(UploadQueue* uploadQueue, const VulkanGlobalContext& vkCtx, const CookedTexture& texture, ImageResource* out);
+
+#endif
@@ -0,0 +1,845 @@
+#include "texture_compression.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+
+//x64 always has SSE2, NEON builds take the scalar paths
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MAGMA_TEXTURE_COMPRESSION_SSE2
+#include <emmintrin.h>
+#endif
+
+static constexpr uint32_t BLOCK_TEXELS = TEXTURE_BLOCK_DIM * TEXTURE_BLOCK_DIM;
+static constexpr uint32_t BLOCK_ROWS_PER_JOB = 4;
+static constexpr uint32_t AXIS_ITERATIONS = 8;
+
+//bc7 4 bit index interpolation weights, out of 64
+static constexpr uint32_t BC7_WEIGHTS[16] = {0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+
+uint32_t get_block_byte_size(TextureBlockFormat format)
+{
+	return format == TEXTURE_BLOCK_BC1 ? 8 : 16;
+}
+
+VkFormat get_block_vk_format(TextureBlockFormat format, MipColorSpace colorSpace)
+{
+	const bool srgb = colorSpace == MIP_COLOR_SRGB;
+	switch(format)
+	{
+		case TEXTURE_BLOCK_BC1: return srgb ? VK_FORMAT_BC1_RGB_SRGB_BLOCK : VK_FORMAT_BC1_RGB_UNORM_BLOCK;
+		case TEXTURE_BLOCK_BC3: return srgb ? VK_FORMAT_BC3_SRGB_BLOCK : VK_FORMAT_BC3_UNORM_BLOCK;
+		case TEXTURE_BLOCK_BC5: assert(!srgb); return VK_FORMAT_BC5_UNORM_BLOCK;
+		case TEXTURE_BLOCK_BC7: return srgb ? VK_FORMAT_BC7_SRGB_BLOCK : VK_FORMAT_BC7_UNORM_BLOCK;
+	}
+	return VK_FORMAT_UNDEFINED;
+}
+
+bool get_texture_block_format(VkFormat vkFormat, TextureBlockFormat* format, MipColorSpace* colorSpace)
+{
+	assert(format && colorSpace);
+	switch(vkFormat)
+	{
+		case VK_FORMAT_BC1_RGB_UNORM_BLOCK: *format = TEXTURE_BLOCK_BC1; *colorSpace = MIP_COLOR_LINEAR; return true;
+		case VK_FORMAT_BC1_RGB_SRGB_BLOCK: *format = TEXTURE_BLOCK_BC1; *colorSpace = MIP_COLOR_SRGB; return true;
+		case VK_FORMAT_BC3_UNORM_BLOCK: *format = TEXTURE_BLOCK_BC3; *colorSpace = MIP_COLOR_LINEAR; return true;
+		case VK_FORMAT_BC3_SRGB_BLOCK: *format = TEXTURE_BLOCK_BC3; *colorSpace = MIP_COLOR_SRGB; return true;
+		case VK_FORMAT_BC5_UNORM_BLOCK: *format = TEXTURE_BLOCK_BC5; *colorSpace = MIP_COLOR_LINEAR; return true;
+		case VK_FORMAT_BC7_UNORM_BLOCK: *format = TEXTURE_BLOCK_BC7; *colorSpace = MIP_COLOR_LINEAR; return true;
+		case VK_FORMAT_BC7_SRGB_BLOCK: *format = TEXTURE_BLOCK_BC7; *colorSpace = MIP_COLOR_SRGB; return true;
+		default: return false;
+	}
+}
+
+std::size_t get_compressed_size(uint32_t width, uint32_t height, TextureBlockFormat format)
+{
+	const std::size_t blocksWide = (width + TEXTURE_BLOCK_DIM - 1) / TEXTURE_BLOCK_DIM;
+	const std::size_t blocksHigh = (height + TEXTURE_BLOCK_DIM - 1) / TEXTURE_BLOCK_DIM;
+	return blocksWide * blocksHigh * get_block_byte_size(format);
+}
+
+//principal axis of the block in the first channelCount channels, endpoints are the extremes along it
+static void find_block_endpoints(const uint8_t* texels, uint32_t channelCount, float* low, float* high)
+{
+	float mean[4] = {};
+	float covariance[4][4] = {};
+#ifdef MAGMA_TEXTURE_COMPRESSION_SSE2
+	//one channel per lane, sums run in the same order as the scalar loops so results match bit for bit
+	const __m128 channelMask = _mm_castsi128_ps(_mm_set_epi32(channelCount > 3 ? -1 : 0, channelCount > 2 ? -1 : 0,
+		channelCount > 1 ? -1 : 0, -1));
+	const __m128i zero = _mm_setzero_si128();
+	__m128 texelValues[BLOCK_TEXELS];
+	__m128 sum = _mm_setzero_ps();
+	for(uint32_t i = 0; i < BLOCK_TEXELS; i++)
+	{
+		uint32_t texel;
+		memcpy(&texel, texels + i * 4, 4);
+		const __m128i widened = _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(static_cast<int>(texel)), zero), zero);
+		texelValues[i] = _mm_and_ps(_mm_cvtepi32_ps(widened), channelMask);
+		sum = _mm_add_ps(sum, texelValues[i]);
+	}
+	const __m128 meanValues = _mm_div_ps(sum, _mm_set1_ps(float(BLOCK_TEXELS)));
+	_mm_storeu_ps(mean, meanValues);
+
+	__m128 rows[4] = {_mm_setzero_ps(), _mm_setzero_ps(), _mm_setzero_ps(), _mm_setzero_ps()};
+	for(uint32_t i = 0; i < BLOCK_TEXELS; i++)
+	{
+		const __m128 offset = _mm_sub_ps(texelValues[i], meanValues);
+		rows[0] = _mm_add_ps(rows[0], _mm_mul_ps(offset, _mm_shuffle_ps(offset, offset, _MM_SHUFFLE(0, 0, 0, 0))));
+		rows[1] = _mm_add_ps(rows[1], _mm_mul_ps(offset, _mm_shuffle_ps(offset, offset, _MM_SHUFFLE(1, 1, 1, 1))));
+		rows[2] = _mm_add_ps(rows[2], _mm_mul_ps(offset, _mm_shuffle_ps(offset, offset, _MM_SHUFFLE(2, 2, 2, 2))));
+		rows[3] = _mm_add_ps(rows[3], _mm_mul_ps(offset, _mm_shuffle_ps(offset, offset, _MM_SHUFFLE(3, 3, 3, 3))));
+	}
+	for(uint32_t r = 0; r < 4; r++)
+	{
+		_mm_storeu_ps(covariance[r], rows[r]);
+	}
+#else
+	for(uint32_t i = 0; i < BLOCK_TEXELS; i++)
+	{
+		for(uint32_t c = 0; c < channelCount; c++)
+		{
+			mean[c] += texels[i * 4 + c];
+		}
+	}
+	for(uint32_t c = 0; c < channelCount; c++)
+	{
+		mean[c] /= BLOCK_TEXELS;
+	}
+
+	for(uint32_t i = 0; i < BLOCK_TEXELS; i++)
+	{
+		float offset[4] = {};
+		for(uint32_t c = 0; c < channelCount; c++)
+		{
+			offset[c] = texels[i * 4 + c] - mean[c];
+		}
+		for(uint32_t r = 0; r < channelCount; r++)
+		{
+			for(uint32_t c = 0; c < channelCount; c++)
+			{
+				covariance[r][c] += offset[r] * offset[c];
+			}
+		}
+	}
+#endif
+
+	//power iteration
+	float axis[4] = {1.f, 1.f, 1.f, 1.f};
+	for(uint32_t iteration = 0; iteration < AXIS_ITERATIONS; iteration++)
+	{
+		float next[4] = {};
+		float length = 0.f;
+		for(uint32_t r = 0; r < channelCount; r++)
+		{
+			for(uint32_t c = 0; c < channelCount; c++)
+			{
+				next[r] += covariance[r][c] * axis[c];
+			}
+			length = std::max(length, std::abs(next[r]));
+		}
+		if(length == 0.f)
+		{
+			break;//flat block, any axis does
+		}
+		for(uint32_t c = 0; c < channelCount; c++)
+		{
+			axis[c] = next[c] / length;
+		}
+	}
+
+	float minProjection = 0.f;
+	float maxProjection = 0.f;
+	float axisLengthSq = 0.f;
+	for(uint32_t c = 0; c < channelCount; c++)
+	{
+		axisLengthSq += axis[c] * axis[c];
+	}
+	for(uint32_t i = 0; i < BLOCK_TEXELS; i++)
+	{
+		float projection = 0.f;
+		for(uint32_t c = 0; c < channelCount; c++)
+		{
+			projection += (texels[i * 4 + c] - mean[c]) * axis[c];
+		}
+		minProjection = std::min(minProjection, projection);
+		maxProjection = std::max(maxProjection, projection);
+	}
+	for(uint32_t c = 0; c < channelCount; c++)
+	{
+		low[c] = mean[c] + axis[c] * minProjection / axisLengthSq;
+		high[c] = mean[c] + axis[c] * maxProjection / axisLengthSq;
+	}
+}
+
+//solves for the two endpoints that fit texels best given their weights towards high endpoint
+static bool fit_endpoints_least_squares(const uint8_t* texels, uint32_t channelCount, const float* weights,
+	float* low, float* high)
+{
+	float aa = 0.f, ab = 0.f, bb = 0.f;
+	float ax[4] = {};
+	float bx[4] = {};
+	for(uint32_t i = 0; i < BLOCK_TEXELS; i++)
+	{
+		const float b = weights[i];
+		const float a = 1.f - b;
+		aa += a * a;
+		ab += a * b;
+		bb += b * b;
+		for(uint32_t c = 0; c < channelCount; c++)
+		{
+			ax[c] += a * texels[i * 4 + c];
+			bx[c] += b * texels[i * 4 + c];
+		}
+	}
+
+	const float determinant = aa * bb - ab * ab;
+	if(std::abs(determinant) < 1e-6f)
+	{
+		return false;
+	}
+	for(uint32_t c = 0; c < channelCount; c++)
+	{
+		low[c] = std::min(std::max((ax[c] * bb - bx[c] * ab) / determinant, 0.f), 255.f);
+		high[c] = std::min(std::max((bx[c] * aa - ax[c] * ab) / determinant, 0.f), 255.f);
+	}
+	return true;
+}
+
+static uint16_t pack_rgb565(const float* color)
+{
+	const uint32_t r = static_cast<uint32_t>(std::min(std::max(color[0] * 31.f / 255.f + 0.5f, 0.f), 31.f));
+	const uint32_t g = static_cast<uint32_t>(std::min(std::max(color[1] * 63.f / 255.f + 0.5f, 0.f), 63.f));
+	const uint32_t b = static_cast<uint32_t>(std::min(std::max(color[2] * 31.f / 255.f + 0.5f, 0.f), 31.f));
+	return static_cast<uint16_t>((r << 11) | (g << 5) | b);
+}
+
+static void unpack_rgb565(uint16_t packed, uint8_t* color)
+{
+	const uint32_t r = (packed >> 11) & 31;
+	const uint32_t g = (packed >> 5) & 63;
+	const uint32_t b = packed & 31;
+	color[0] = static_cast<uint8_t>((r << 3) | (r >> 2));
+	color[1] = static_cast<uint8_t>((g << 2) | (g >> 4));
+	color[2] = static_cast<uint8_t>((b << 3) | (b >> 2));
+	color[3] = 255;
+}
+
+//bc2/bc3 color blocks always interpolate, bc1 switches to 3 colors + black when color0 <= color1
+static void build_bc1_palette(uint16_t color0, uint16_t color1, bool alwaysFourColors, uint8_t palette[4][4])
+{
+	unpack_rgb565(color0, palette[0]);
+	unpack_rgb565(color1, palette[1]);
+	const bool fourColors = alwaysFourColors || color0 > color1;
+	for(uint32_t c = 0; c < 3; c++)
+	{
+		if(fourColors)
+		{
+			palette[2][c] = static_cast<uint8_t>((2 * palette[0][c] + palette[1][c]) / 3);
+			palette[3][c] = static_cast<uint8_t>((palette[0][c] + 2 * palette[1][c]) / 3);
+		}
+		else
+		{
+			palette[2][c] = static_cast<uint8_t>((palette[0][c] + palette[1][c]) / 2);
+			palette[3][c] = 0;
+		}
+	}
+	palette[2][3] = 255;
+	palette[3][3] = 255;
+}
+
+static uint32_t get_color_distance(const uint8_t* a, const uint8_t* b, uint32_t channelCount)
+{
+	uint32_t distance = 0;
+	for(uint32_t c = 0; c < channelCount; c++)
+	{
+		const int32_t difference = int32_t(a[c]) - int32_t(b[c]);
+		distance += difference * difference;
+	}
+	return distance;
+}
+
+//closest palette entry of every texel in the first channelCount (3 or 4) channels, ties go to the lower index.
+//Returns summed squared error
+static uint32_t find_closest_indices(const uint8_t* texels, const uint8_t (*palette)[4], uint32_t paletteSize,
+	uint32_t channelCount, uint8_t* indices)
+{
+	assert(channelCount == 3 || channelCount == 4);
+	uint32_t error = 0;
+#ifdef MAGMA_TEXTURE_COMPRESSION_SSE2
+	//4 texels at a time, distances fit into signed 32 bits
+	const __m128i channelMask = _mm_set1_epi32(channelCount == 4 ? -1 : 0x00ffffff);
+	const __m128i zero = _mm_setzero_si128();
+	for(uint32_t i = 0; i < BLOCK_TEXELS; i += 4)
+	{
+		const __m128i pixels = _mm_and_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(texels + i * 4)), channelMask);
+		const __m128i pixelsLow = _mm_unpacklo_epi8(pixels, zero);
+		const __m128i pixelsHigh = _mm_unpackhi_epi8(pixels, zero);
+		__m128i bestDistance = _mm_set1_epi32(INT32_MAX);
+		__m128i bestIndex = _mm_setzero_si128();
+		for(uint32_t p = 0; p < paletteSize; p++)
+		{
+			uint32_t entry;
+			memcpy(&entry, palette[p], 4);
+			const __m128i color = _mm_unpacklo_epi8(_mm_and_si128(_mm_set1_epi32(static_cast<int>(entry)), channelMask), zero);
+			const __m128i differenceLow = _mm_sub_epi16(pixelsLow, color);
+			const __m128i differenceHigh = _mm_sub_epi16(pixelsHigh, color);
+			//pairs of channel squares per texel, added up across the two halves
+			const __m128 pairsLow = _mm_castsi128_ps(_mm_madd_epi16(differenceLow, differenceLow));
+			const __m128 pairsHigh = _mm_castsi128_ps(_mm_madd_epi16(differenceHigh, differenceHigh));
+			const __m128i distance = _mm_add_epi32(
+				_mm_castps_si128(_mm_shuffle_ps(pairsLow, pairsHigh, _MM_SHUFFLE(2, 0, 2, 0))),
+				_mm_castps_si128(_mm_shuffle_ps(pairsLow, pairsHigh, _MM_SHUFFLE(3, 1, 3, 1))));
+			const __m128i closer = _mm_cmplt_epi32(distance, bestDistance);
+			bestDistance = _mm_or_si128(_mm_and_si128(closer, distance), _mm_andnot_si128(closer, bestDistance));
+			bestIndex = _mm_or_si128(_mm_and_si128(closer, _mm_set1_epi32(static_cast<int>(p))), _mm_andnot_si128(closer, bestIndex));
+		}
+
+		uint32_t distances[4];
+		uint32_t bestIndices[4];
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(distances), bestDistance);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(bestIndices), bestIndex);
+		for(uint32_t k = 0; k < 4; k++)
+		{
+			indices[i + k] = static_cast<uint8_t>(bestIndices[k]);
+			error += distances[k];
+		}
+	}
+#else
+	for(uint32_t i = 0; i < BLOCK_TEXELS; i++)
+	{
+		uint32_t bestDistance = UINT32_MAX;
+		for(uint32_t p = 0; p < paletteSize; p++)
+		{
+			const uint32_t distance = get_color_distance(texels + i * 4, palette[p], channelCount);
+			if(distance < bestDistance)
+			{
+				bestDistance = distance;
+				indices[i] = static_cast<uint8_t>(p);
+			}
+		}
+		error += bestDistance;
+	}
+#endif
+	return error;
+}
+
+//endpoint pair per 8 bit value whose 1/3 interpolant decodes closest to it
+struct SingleColorEntry
+{
+	uint8_t color0;
+	uint8_t color1;
+};
+
+struct SingleColorTables
+{
+	SingleColorEntry channel5[256];
+	SingleColorEntry channel6[256];
+};
+
+//ties prefer close endpoints, so decoders rounding the interpolation differently stay close too
+static void build_single_color_table(uint32_t bits, SingleColorEntry* table)
+{
+	const uint32_t levels = 1u << bits;
+	for(uint32_t value = 0; value < 256; value++)
+	{
+		uint32_t bestError = UINT32_MAX;
+		for(uint32_t c0 = 0; c0 < levels; c0++)
+		{
+			for(uint32_t c1 = 0; c1 < levels; c1++)
+			{
+				const uint32_t e0 = (c0 << (8 - bits)) | (c0 >> (2 * bits - 8));
+				const uint32_t e1 = (c1 << (8 - bits)) | (c1 >> (2 * bits - 8));
+				const int32_t interpolated = (2 * e0 + e1) / 3;
+				const uint32_t error = std::abs(interpolated - int32_t(value)) * 1024 + std::abs(int32_t(e0) - int32_t(e1));
+				if(error < bestError)
+				{
+					bestError = error;
+					table[value] = {static_cast<uint8_t>(c0), static_cast<uint8_t>(c1)};
+				}
+			}
+		}
+	}
+}
+
+static SingleColorTables build_single_color_tables()
+{
+	SingleColorTables tables = {};
+	build_single_color_table(5, tables.channel5);
+	build_single_color_table(6, tables.channel6);
+	return tables;
+}
+
+//every texel uses palette entry 2, which most colors hit exactly unlike the nearest 565 endpoint
+static void encode_bc1_single_color(const uint8_t* color, uint8_t* out)
+{
+	static const SingleColorTables tables = build_single_color_tables();
+	const SingleColorEntry& r = tables.channel5[color[0]];
+	const SingleColorEntry& g = tables.channel6[color[1]];
+	const SingleColorEntry& b = tables.channel5[color[2]];
+	uint16_t color0 = static_cast<uint16_t>((r.color0 << 11) | (g.color0 << 5) | b.color0);
+	uint16_t color1 = static_cast<uint16_t>((r.color1 << 11) | (g.color1 << 5) | b.color1);
+
+	//stay in 4 color mode, swapped endpoints interpolate the same value at entry 3.
+	//Equal endpoints decode exactly at entry 0
+	uint32_t index = 2;
+	if(color0 < color1)
+	{
+		std::swap(color0, color1);
+		index = 3;
+	}
+	else if(color0 == color1)
+	{
+		index = 0;
+	}
+
+	const uint32_t indices = index * 0x55555555u;
+	memcpy(out, &color0, 2);
+	memcpy(out + 2, &color1, 2);
+	memcpy(out + 4, &indices, 4);
+}
+
+//returns error of the resulting block
+static uint32_t pack_bc1_block(const uint8_t* texels, const float* low, const float* high, uint8_t* out)
+{
+	uint16_t color0 = pack_rgb565(high);
+	uint16_t color1 = pack_rgb565(low);
+	if(color0 < color1)
+	{
+		std::swap(color0, color1);
+	}
+
+	uint8_t palette[4][4];
+	build_bc1_palette(color0, color1, true, palette);
+	//equal endpoints would switch decoder into 3 color mode, index 0 is right either way
+	uint8_t texelIndices[BLOCK_TEXELS];
+	const uint32_t error = find_closest_indices(texels, palette, color0 == color1 ? 1 : 4, 3, texelIndices);
+	uint32_t indices = 0;
+	for(uint32_t i = 0; i < BLOCK_TEXELS; i++)
+	{
+		indices |= uint32_t(texelIndices[i]) << (i * 2);
+	}
+
+	memcpy(out, &color0, 2);
+	memcpy(out + 2, &color1, 2);
+	memcpy(out + 4, &indices, 4);
+	return error;
+}
+
+static void encode_bc1_block(const uint8_t* texels, uint8_t* out)
+{
+	bool isSingleColor = true;
+	for(uint32_t i = 1; i < BLOCK_TEXELS && isSingleColor; i++)
+	{
+		isSingleColor = memcmp(texels, texels + i * 4, 3) == 0;
+	}
+	if(isSingleColor)
+	{
+		encode_bc1_single_color(texels, out);
+		return;
+	}
+
+	float low[4], high[4];
+	find_block_endpoints(texels, 3, low, high);
+	uint32_t error = pack_bc1_block(texels, low, high, out);
+
+	//refit endpoints to chosen indices, keep whichever is closer
+	static constexpr float INDEX_WEIGHTS[4] = {1.f, 0.f, 1.f / 3.f, 2.f / 3.f};//towards color0
+	uint32_t indices;
+	memcpy(&indices, out + 4, 4);
+	float weights[BLOCK_TEXELS];
+	for(uint32_t i = 0; i < BLOCK_TEXELS; i++)
+	{
+		weights[i] = INDEX_WEIGHTS[(indices >> (i * 2)) & 3];
+	}
+	if(fit_endpoints_least_squares(texels, 3, weights, low, high))
+	{
+		uint8_t refined[8];
+		if(pack_bc1_block(texels, low, high, refined) < error)
+		{
+			memcpy(out, refined, sizeof(refined));
+		}
+	}
+}
+
+static void build_bc4_palette(uint8_t value0, uint8_t value1, uint8_t palette[8])
+{
+	palette[0] = value0;
+	palette[1] = value1;
+	if(value0 > value1)
+	{
+		for(uint32_t i = 2; i < 8; i++)
+		{
+			palette[i] = static_cast<uint8_t>(((8 - i) * value0 + (i - 1) * value1 + 3) / 7);
+		}
+	}
+	else
+	{
+		for(uint32_t i = 2; i < 6; i++)
+		{
+			palette[i] = static_cast<uint8_t>(((6 - i) * value0 + (i - 1) * value1 + 2) / 5);
+		}
+		palette[6] = 0;
+		palette[7] = 255;
+	}
+}
+
+static uint32_t pack_bc4_block(const uint8_t* values, uint32_t stride, uint8_t value0, uint8_t value1, uint8_t* out)
+{
+	uint8_t palette[8];
+	build_bc4_palette(value0, value1, palette);
+	uint64_t indices = 0;
+	uint32_t error = 0;
+	for(uint32_t i = 0; i < BLOCK_TEXELS; i++)
+	{
+		uint32_t bestIndex = 0;
+		uint32_t bestDistance = UINT32_MAX;
+		for(uint32_t p = 0; p < 8; p++)
+		{
+			const uint32_t distance = get_color_distance(values + i * stride, palette + p, 1);
+			if(distance < bestDistance)
+			{
+				bestDistance = distance;
+				bestIndex = p;
+			}
+		}
+		indices |= uint64_t(bestIndex) << (i * 3);
+		error += bestDistance;
+	}
+
+	out[0] = value0;
+	out[1] = value1;
+	for(uint32_t i = 0; i < 6; i++)
+	{
+		out[2 + i] = static_cast<uint8_t>(indices >> (i * 8));
+	}
+	return error;
+}
+
+//single channel of the texels, stride apart
+static void encode_bc4_block(const uint8_t* values, uint32_t stride, uint8_t* out)
+{
+	uint8_t minValue = 255, maxValue = 0;
+	//6 value mode has exact 0 and 255, interpolates only between the rest
+	uint8_t minInner = 255, maxInner = 0;
+	for(uint32_t i = 0; i < BLOCK_TEXELS; i++)
+	{
+		const uint8_t value = values[i * stride];
+		minValue = std::min(minValue, value);
+		maxValue = std::max(maxValue, value);
+		if(value != 0 && value != 255)
+		{
+			minInner = std::min(minInner, value);
+			maxInner = std::max(maxInner, value);
+		}
+	}
+
+	if(minValue == maxValue)
+	{
+		pack_bc4_block(values, stride, maxValue, minValue, out);
+		return;
+	}
+
+	const uint32_t error = pack_bc4_block(values, stride, maxValue, minValue, out);
+	if(error && (minValue == 0 || maxValue == 255))
+	{
+		if(minInner > maxInner)
+		{
+			minInner = maxInner = minValue == 0 ? maxValue : minValue;
+		}
+		uint8_t sixValues[8];
+		if(pack_bc4_block(values, stride, minInner, maxInner, sixValues) < error)
+		{
+			memcpy(out, sixValues, sizeof(sixValues));
+		}
+	}
+}
+
+//mode 6: single subset, rgba 7 bit endpoints with a shared lsb each, 4 bit indices
+static void quantize_bc7_endpoint(const float* endpoint, uint8_t* quantized, uint32_t* pBit)
+{
+	float bestError = INFINITY;
+	for(uint32_t p = 0; p < 2; p++)
+	{
+		uint8_t candidate[4];
+		float error = 0.f;
+		for(uint32_t c = 0; c < 4; c++)
+		{
+			const float value = std::min(std::max((endpoint[c] - p) * 0.5f + 0.5f, 0.f), 127.f);
+			candidate[c] = static_cast<uint8_t>(value);
+			const float difference = float((candidate[c] << 1) | p) - endpoint[c];
+			error += difference * difference;
+		}
+		if(error < bestError)
+		{
+			bestError = error;
+			memcpy(quantized, candidate, 4);
+			*pBit = p;
+		}
+	}
+}
+
+struct Bc7Mode6Block
+{
+	uint8_t endpoints[2][4];//7 bits
+	uint32_t pBits[2];
+	uint8_t indices[BLOCK_TEXELS];
+};
+
+static void build_bc7_palette(const Bc7Mode6Block& block, uint8_t palette[16][4])
+{
+	for(uint32_t c = 0; c < 4; c++)
+	{
+		const uint32_t e0 = (block.endpoints[0][c] << 1) | block.pBits[0];
+		const uint32_t e1 = (block.endpoints[1][c] << 1) | block.pBits[1];
+		for(uint32_t i = 0; i < 16; i++)
+		{
+			palette[i][c] = static_cast<uint8_t>(((64 - BC7_WEIGHTS[i]) * e0 + BC7_WEIGHTS[i] * e1 + 32) >> 6);
+		}
+	}
+}
+
+static uint32_t fill_bc7_indices(const uint8_t* texels, const float* low, const float* high, Bc7Mode6Block* block)
+{
+	quantize_bc7_endpoint(low, block->endpoints[0], &block->pBits[0]);
+	quantize_bc7_endpoint(high, block->endpoints[1], &block->pBits[1]);
+
+	uint8_t palette[16][4];
+	build_bc7_palette(*block, palette);
+	return find_closest_indices(texels, palette, 16, 4, block->indices);
+}
+
+//little endian bit stream, lsb first
+static void write_bits(uint8_t* block, uint32_t* bitOffset, uint32_t value, uint32_t bitCount)
+{
+	for(uint32_t i = 0; i < bitCount; i++, (*bitOffset)++)
+	{
+		block[*bitOffset >> 3] |= ((value >> i) & 1) << (*bitOffset & 7);
+	}
+}
+
+static uint32_t read_bits(const uint8_t* block, uint32_t* bitOffset, uint32_t bitCount)
+{
+	uint32_t value = 0;
+	for(uint32_t i = 0; i < bitCount; i++, (*bitOffset)++)
+	{
+		value |= ((block[*bitOffset >> 3] >> (*bitOffset & 7)) & 1) << i;
+	}
+	return value;
+}
+
+static void encode_bc7_block(const uint8_t* texels, uint8_t* out)
+{
+	float low[4], high[4];
+	find_block_endpoints(texels, 4, low, high);
+	Bc7Mode6Block block = {};
+	uint32_t error = fill_bc7_indices(texels, low, high, &block);
+
+	float weights[BLOCK_TEXELS];
+	for(uint32_t i = 0; i < BLOCK_TEXELS; i++)
+	{
+		weights[i] = BC7_WEIGHTS[block.indices[i]] / 64.f;
+	}
+	Bc7Mode6Block refined = {};
+	if(fit_endpoints_least_squares(texels, 4, weights, low, high) && fill_bc7_indices(texels, low, high, &refined) < error)
+	{
+		block = refined;
+	}
+
+	//msb of the first index is implied zero
+	if(block.indices[0] & 8)
+	{
+		std::swap(block.endpoints[0], block.endpoints[1]);
+		std::swap(block.pBits[0], block.pBits[1]);
+		for(uint32_t i = 0; i < BLOCK_TEXELS; i++)
+		{
+			block.indices[i] = 15 - block.indices[i];
+		}
+	}
+
+	memset(out, 0, 16);
+	uint32_t bitOffset = 0;
+	write_bits(out, &bitOffset, 1 << 6, 7);
+	for(uint32_t c = 0; c < 4; c++)
+	{
+		write_bits(out, &bitOffset, block.endpoints[0][c], 7);
+		write_bits(out, &bitOffset, block.endpoints[1][c], 7);
+	}
+	write_bits(out, &bitOffset, block.pBits[0], 1);
+	write_bits(out, &bitOffset, block.pBits[1], 1);
+	write_bits(out, &bitOffset, block.indices[0], 3);
+	for(uint32_t i = 1; i < BLOCK_TEXELS; i++)
+	{
+		write_bits(out, &bitOffset, block.indices[i], 4);
+	}
+	assert(bitOffset == 128);
+}
+
+static void decode_bc7_block(const uint8_t* in, uint8_t* texels)
+{
+	if((in[0] & 0x7f) != 0x40)
+	{
+		memset(texels, 0, BLOCK_TEXELS * 4);
+		return;
+	}
+
+	Bc7Mode6Block block = {};
+	uint32_t bitOffset = 7;
+	for(uint32_t c = 0; c < 4; c++)
+	{
+		block.endpoints[0][c] = static_cast<uint8_t>(read_bits(in, &bitOffset, 7));
+		block.endpoints[1][c] = static_cast<uint8_t>(read_bits(in, &bitOffset, 7));
+	}
+	block.pBits[0] = read_bits(in, &bitOffset, 1);
+	block.pBits[1] = read_bits(in, &bitOffset, 1);
+
+	uint8_t palette[16][4];
+	build_bc7_palette(block, palette);
+	for(uint32_t i = 0; i < BLOCK_TEXELS; i++)
+	{
+		memcpy(texels + i * 4, palette[read_bits(in, &bitOffset, i ? 4 : 3)], 4);
+	}
+}
+
+static void decode_bc1_block(const uint8_t* in, bool alwaysFourColors, uint8_t* texels)
+{
+	uint16_t color0, color1;
+	uint32_t indices;
+	memcpy(&color0, in, 2);
+	memcpy(&color1, in + 2, 2);
+	memcpy(&indices, in + 4, 4);
+
+	uint8_t palette[4][4];
+	build_bc1_palette(color0, color1, alwaysFourColors, palette);
+	for(uint32_t i = 0; i < BLOCK_TEXELS; i++)
+	{
+		memcpy(texels + i * 4, palette[(indices >> (i * 2)) & 3], 4);
+	}
+}
+
+static void decode_bc4_block(const uint8_t* in, uint8_t* values, uint32_t stride)
+{
+	uint8_t palette[8];
+	build_bc4_palette(in[0], in[1], palette);
+	uint64_t indices = 0;
+	for(uint32_t i = 0; i < 6; i++)
+	{
+		indices |= uint64_t(in[2 + i]) << (i * 8);
+	}
+	for(uint32_t i = 0; i < BLOCK_TEXELS; i++)
+	{
+		values[i * stride] = palette[(indices >> (i * 3)) & 7];
+	}
+}
+
+static void encode_block(const uint8_t* texels, TextureBlockFormat format, uint8_t* out)
+{
+	switch(format)
+	{
+		case TEXTURE_BLOCK_BC1:
+			encode_bc1_block(texels, out);
+			break;
+		case TEXTURE_BLOCK_BC3:
+			encode_bc4_block(texels + 3, 4, out);
+			encode_bc1_block(texels, out + 8);
+			break;
+		case TEXTURE_BLOCK_BC5:
+			encode_bc4_block(texels, 4, out);
+			encode_bc4_block(texels + 1, 4, out + 8);
+			break;
+		case TEXTURE_BLOCK_BC7:
+			encode_bc7_block(texels, out);
+			break;
+	}
+}
+
+static void decode_block(const uint8_t* in, TextureBlockFormat format, uint8_t* texels)
+{
+	switch(format)
+	{
+		case TEXTURE_BLOCK_BC1:
+			decode_bc1_block(in, false, texels);
+			break;
+		case TEXTURE_BLOCK_BC3:
+			decode_bc1_block(in + 8, true, texels);
+			decode_bc4_block(in, texels + 3, 4);
+			break;
+		case TEXTURE_BLOCK_BC5:
+			for(uint32_t i = 0; i < BLOCK_TEXELS; i++)
+			{
+				texels[i * 4 + 2] = 0;
+				texels[i * 4 + 3] = 255;
+			}
+			decode_bc4_block(in, texels, 4);
+			decode_bc4_block(in + 8, texels + 1, 4);
+			break;
+		case TEXTURE_BLOCK_BC7:
+			decode_bc7_block(in, texels);
+			break;
+	}
+}
+
+void compress_image(const uint8_t* rgba, uint32_t width, uint32_t height, TextureBlockFormat format,
+	JobSystem* jobSystem, uint8_t* out)
+{
+	assert(rgba && out && width && height);
+	const uint32_t blocksWide = (width + TEXTURE_BLOCK_DIM - 1) / TEXTURE_BLOCK_DIM;
+	const uint32_t blocksHigh = (height + TEXTURE_BLOCK_DIM - 1) / TEXTURE_BLOCK_DIM;
+	const uint32_t blockSize = get_block_byte_size(format);
+
+	auto compressRows = [=](uint32_t begin, uint32_t end)
+	{
+		uint8_t texels[BLOCK_TEXELS * 4];
+		for(uint32_t by = begin; by < end; by++)
+		{
+			for(uint32_t bx = 0; bx < blocksWide; bx++)
+			{
+				for(uint32_t y = 0; y < TEXTURE_BLOCK_DIM; y++)
+				{
+					const uint32_t sy = std::min(by * TEXTURE_BLOCK_DIM + y, height - 1);
+					for(uint32_t x = 0; x < TEXTURE_BLOCK_DIM; x++)
+					{
+						const uint32_t sx = std::min(bx * TEXTURE_BLOCK_DIM + x, width - 1);
+						memcpy(texels + (y * TEXTURE_BLOCK_DIM + x) * 4, rgba + (std::size_t(sy) * width + sx) * 4, 4);
+					}
+				}
+				encode_block(texels, format, out + (std::size_t(by) * blocksWide + bx) * blockSize);
+			}
+		}
+	};
+
+	if(jobSystem)
+	{
+		parallel_for(jobSystem, blocksHigh, BLOCK_ROWS_PER_JOB, compressRows);
+	}
+	else
+	{
+		compressRows(0, blocksHigh);
+	}
+}
+
+void decompress_image(const uint8_t* blocks, uint32_t width, uint32_t height, TextureBlockFormat format, uint8_t* rgba)
+{
+	assert(blocks && rgba);
+	const uint32_t blocksWide = (width + TEXTURE_BLOCK_DIM - 1) / TEXTURE_BLOCK_DIM;
+	const uint32_t blocksHigh = (height + TEXTURE_BLOCK_DIM - 1) / TEXTURE_BLOCK_DIM;
+	const uint32_t blockSize = get_block_byte_size(format);
+
+	uint8_t texels[BLOCK_TEXELS * 4];
+	for(uint32_t by = 0; by < blocksHigh; by++)
+	{
+		for(uint32_t bx = 0; bx < blocksWide; bx++)
+		{
+			decode_block(blocks + (std::size_t(by) * blocksWide + bx) * blockSize, format, texels);
+			for(uint32_t y = 0; y < TEXTURE_BLOCK_DIM && by * TEXTURE_BLOCK_DIM + y < height; y++)
+			{
+				for(uint32_t x = 0; x < TEXTURE_BLOCK_DIM && bx * TEXTURE_BLOCK_DIM + x < width; x++)
+				{
+					const std::size_t dst = (std::size_t(by * TEXTURE_BLOCK_DIM + y) * width + bx * TEXTURE_BLOCK_DIM + x) * 4;
+					memcpy(rgba + dst, texels + (y * TEXTURE_BLOCK_DIM + x) * 4, 4);
+				}
+			}
+		}
+	}
+}
@@ -0,0 +1,36 @@
+#ifndef MAGMA_TEXTURE_COMPRESSION_H
+#define MAGMA_TEXTURE_COMPRESSION_H
+
+#include "mipmaps.h"
+#include "job_system.h"
+
+static constexpr uint32_t TEXTURE_BLOCK_DIM = 4;//texels per block side for every format below
+
+enum TextureBlockFormat
+{
+	TEXTURE_BLOCK_BC1,//rgb, 8 bytes per block
+	TEXTURE_BLOCK_BC3,//rgb + smooth alpha, 16 bytes
+	TEXTURE_BLOCK_BC5,//two independent channels (rg), normal maps. 16 bytes
+	TEXTURE_BLOCK_BC7 //rgba at highest quality, 16 bytes
+};
+
+uint32_t get_block_byte_size(TextureBlockFormat format);
+
+//sRGB encoded color maps to _SRGB formats so sampling returns linear values. BC5 is linear only
+VkFormat get_block_vk_format(TextureBlockFormat format, MipColorSpace colorSpace);
+
+//false for formats that are not produced by compress_image
+bool get_texture_block_format(VkFormat vkFormat, TextureBlockFormat* format, MipColorSpace* colorSpace);
+
+std::size_t get_compressed_size(uint32_t width, uint32_t height, TextureBlockFormat format);
+
+//rgba8 in, blocks go row by row. Partial blocks at the edges repeat the last row and column.
+//Block rows are spread over job system workers when one is given
+void compress_image(const uint8_t* rgba, uint32_t width, uint32_t height, TextureBlockFormat format,
+	JobSystem* jobSystem, uint8_t* out);
+
+//rgba8 out, missing channels decode to 0 for color and 255 for alpha.
+//BC7 blocks are only decoded in mode 6, which is the only one compress_image emits, others come out as zeros
+void decompress_image(const uint8_t* blocks, uint32_t width, uint32_t height, TextureBlockFormat format, uint8_t* rgba);
+
+#endif
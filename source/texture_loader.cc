@@ -0,0 +1,138 @@
+#include "texture_loader.h"
+#include "vk_dbg.h"
+#include "vk_resource.h"
+#include "logging.h"
+
+#include <cassert>
+
+void init_texture_loader(JobSystem* jobSystem, TextureLoader* loader)
+{
+	assert(jobSystem && loader);
+	loader->jobSystem = jobSystem;
+	loader->requests.clear();
+}
+
+void destroy_texture_loader(TextureLoader* loader)
+{
+	assert(loader);
+	for(TextureLoadRequest& request : loader->requests)
+	{
+		wait_for_counter(loader->jobSystem, &request.counter);
+		free_texture(&request.texture);
+	}
+	loader->requests.clear();
+	loader->jobSystem = nullptr;
+}
+
+TextureHandle load_texture_async(TextureLoader* loader, const char* path, bool flipImage)
+{
+	assert(loader && loader->jobSystem && path);
+	const TextureHandle handle = static_cast<TextureHandle>(loader->requests.size());
+	loader->requests.emplace_back();
+	TextureLoadRequest* request = &loader->requests.back();
+	request->path = path;
+	request->flipImage = flipImage;
+	request->texture = {};
+
+	submit_job(loader->jobSystem, [request]()
+	{
+		const bool loaded = load_texture(request->path.c_str(), &request->texture, request->flipImage);
+		request->status.store(loaded ? TEXTURE_LOAD_READY : TEXTURE_LOAD_FAILED, std::memory_order_release);
+	}, &request->counter);
+	return handle;
+}
+
+TextureLoadStatus get_texture_status(const TextureLoader& loader, TextureHandle handle)
+{
+	assert(handle < loader.requests.size());
+	return static_cast<TextureLoadStatus>(loader.requests[handle].status.load(std::memory_order_acquire));
+}
+
+bool wait_for_texture(TextureLoader* loader, TextureHandle handle, TextureInfo* out)
+{
+	assert(loader && out);
+	assert(handle < loader->requests.size());
+	TextureLoadRequest& request = loader->requests[handle];
+	wait_for_counter(loader->jobSystem, &request.counter);
+	if(request.status.load(std::memory_order_acquire) != TEXTURE_LOAD_READY)
+	{
+		return false;
+	}
+	*out = request.texture;
+	return true;
+}
+
+bool wait_for_textures(TextureLoader* loader, const TextureHandle* handles, uint32_t count)
+{
+	assert(handles || !count);
+	bool loaded = true;
+	for(uint32_t i = 0; i < count; i++)
+	{
+		TextureInfo texture = {};
+		loaded &= wait_for_texture(loader, handles[i], &texture);
+	}
+	return loaded;
+}
+
+void release_texture(TextureLoader* loader, TextureHandle handle)
+{
+	assert(loader);
+	assert(handle < loader->requests.size());
+	TextureLoadRequest& request = loader->requests[handle];
+	wait_for_counter(loader->jobSystem, &request.counter);
+	free_texture(&request.texture);
+}
+
+bool upload_texture(UploadQueue* uploadQueue, const VulkanGlobalContext& vkCtx, const TextureInfo& texture, TextureMips mips, ImageResource* out)
+{
+	assert(uploadQueue && texture.data && out);
+
+	//single level, or the whole chain built on the cpu
+	MipChain chain = {};
+	const uint8_t* pixels = texture.data;
+	VkDeviceSize byteSize = VkDeviceSize(texture.numc) * texture.extent.width * texture.extent.height;
+	const VkDeviceSize baseLevelOffset = 0;
+	const VkDeviceSize* levelOffsets = &baseLevelOffset;
+	if(mips != TEXTURE_MIPS_NONE)
+	{
+		generate_mip_chain(&texture, 1, MIP_FILTER_KAISER, mips == TEXTURE_MIPS_SRGB ? MIP_COLOR_SRGB : MIP_COLOR_LINEAR, &chain);
+		pixels = chain.data.data();
+		byteSize = chain.data.size();
+		levelOffsets = chain.levelOffsets.data();
+	}
+
+	const uint32_t mipLevels = mips == TEXTURE_MIPS_NONE ? 1 : get_mip_level_count(texture.extent);
+	const VkImageUsageFlags usageFlags = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+	*out = create_image_resource(vkCtx, texture.extent, texture.format, usageFlags, VK_IMAGE_LAYOUT_UNDEFINED, mipLevels);
+
+	std::vector<VkBufferImageCopy> regions;
+	fill_mip_chain_regions(texture.extent, levelOffsets, byteSize, *out, &regions);
+	if(!upload_to_image(uploadQueue, vkCtx, pixels, byteSize, regions.data(), static_cast<uint32_t>(regions.size()), out))
+	{
+		magma::log::error("Failed to upload texture to device local image");
+		//regions staged before the failure may still be copied into the image
+		wait_for_upload(uploadQueue, vkCtx, submit_uploads(uploadQueue, vkCtx));
+		destroy_image_resource(vkCtx.logicalDevice, out);
+		return false;
+	}
+	return true;
+}
+
+TextureLoadStatus upload_texture_when_ready(TextureLoader* loader, TextureHandle handle,
+	UploadQueue* uploadQueue, const VulkanGlobalContext& vkCtx, TextureMips mips, ImageResource* out)
+{
+	assert(loader);
+	const TextureLoadStatus status = get_texture_status(*loader, handle);
+	if(status != TEXTURE_LOAD_READY)
+	{
+		return status;
+	}
+
+	TextureInfo texture = {};
+	if(!wait_for_texture(loader, handle, &texture) || !upload_texture(uploadQueue, vkCtx, texture, mips, out))
+	{
+		return TEXTURE_LOAD_FAILED;
+	}
+	release_texture(loader, handle);
+	return TEXTURE_LOAD_READY;
+}
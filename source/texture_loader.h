@@ -0,0 +1,73 @@
+#ifndef MAGMA_TEXTURE_LOADER_H
+#define MAGMA_TEXTURE_LOADER_H
+
+#include "mesh_loaders.h"
+#include "mipmaps.h"
+#include "job_system.h"
+#include "vk_types.h"
+#include "vk_upload.h"
+
+#include <atomic>
+#include <deque>
+#include <string>
+
+enum TextureLoadStatus
+{
+	TEXTURE_LOAD_PENDING,
+	TEXTURE_LOAD_READY,
+	TEXTURE_LOAD_FAILED
+};
+
+struct TextureLoadRequest
+{
+	std::string path;
+	bool flipImage;
+	TextureInfo texture;
+	JobCounter counter;
+	std::atomic<uint32_t> status = {TEXTURE_LOAD_PENDING};
+};
+
+typedef uint32_t TextureHandle;
+
+enum TextureMips
+{
+	TEXTURE_MIPS_NONE,
+	TEXTURE_MIPS_SRGB,  //kaiser filtered on the cpu in linear space, for color textures
+	TEXTURE_MIPS_LINEAR //kaiser filtered on the cpu as is, for normal maps and masks
+};
+
+//decodes images on job system workers. Requests are made from a single thread,
+//decoded pixels stay alive until released or until the loader is destroyed
+struct TextureLoader
+{
+	JobSystem* jobSystem;
+	std::deque<TextureLoadRequest> requests;//deque keeps requests in place while workers fill them
+};
+
+void init_texture_loader(JobSystem* jobSystem, TextureLoader* loader);
+
+//waits for decodes in flight and frees every texture
+void destroy_texture_loader(TextureLoader* loader);
+
+TextureHandle load_texture_async(TextureLoader* loader, const char* path, bool flipImage = true);
+
+TextureLoadStatus get_texture_status(const TextureLoader& loader, TextureHandle handle);
+
+//calling thread runs queued jobs while waiting, out points to pixels owned by the loader
+bool wait_for_texture(TextureLoader* loader, TextureHandle handle, TextureInfo* out);
+
+//true if every texture has been decoded
+bool wait_for_textures(TextureLoader* loader, const TextureHandle* handles, uint32_t count);
+
+//frees decoded pixels, e.g. once they reached the gpu
+void release_texture(TextureLoader* loader, TextureHandle handle);
+
+//creates sampled image and enqueues its levels on the upload queue, out->mipLevels is what the sampler should cover.
+//Pixels are staged before it returns, the image may be sampled once the token of the next submit_uploads completes
+bool upload_texture(UploadQueue* uploadQueue, const VulkanGlobalContext& vkCtx, const TextureInfo& texture, TextureMips mips, ImageResource* out);
+
+//non blocking, enqueues the upload and releases the texture once it's decoded. Handle is done after it returns ready
+TextureLoadStatus upload_texture_when_ready(TextureLoader* loader, TextureHandle handle,
+	UploadQueue* uploadQueue, const VulkanGlobalContext& vkCtx, TextureMips mips, ImageResource* out);
+
+#endif
@@ -0,0 +1,519 @@
+#include "texture_streaming.h"
+#include "vk_dbg.h"
+#include "vk_resource.h"
+#include "logging.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+static uint32_t get_level_dimension(uint32_t baseDimension, uint32_t level)
+{
+	return std::max(baseDimension >> level, 1u);
+}
+
+static VkExtent3D get_level_extent(const CookedTexture& source, uint32_t level)
+{
+	return {get_level_dimension(source.extent.width, level), get_level_dimension(source.extent.height, level), 1};
+}
+
+static bool is_decoded_on_cpu(const StreamedTexture& texture)
+{
+	return texture.imageFormat != texture.source.format;
+}
+
+//bytes of a single face of a level as it sits in staging memory
+static VkDeviceSize get_staged_face_size(const StreamedTexture& texture, uint32_t level)
+{
+	const VkExtent3D extent = get_level_extent(texture.source, level);
+	return is_decoded_on_cpu(texture) ?
+		VkDeviceSize(extent.width) * extent.height * 4 :
+		get_compressed_size(extent.width, extent.height, texture.source.blockFormat);
+}
+
+//levels [firstLevel, levelCount) of every face
+static VkDeviceSize get_resident_size(const StreamedTexture& texture, uint32_t firstLevel)
+{
+	VkDeviceSize size = 0;
+	for(uint32_t level = firstLevel; level < texture.source.levelCount; level++)
+	{
+		size += get_staged_face_size(texture, level) * texture.source.faceCount;
+	}
+	return size;
+}
+
+//one region per level covering every face, buffer offsets are relative to the lowest level in memory.
+//Returns bytes the regions span
+static VkDeviceSize get_level_regions(const StreamedTexture& texture, uint32_t firstLevel, const VkDeviceSize* levelOffsets,
+	VkBufferImageCopy* regions)
+{
+	VkDeviceSize end = 0;
+	for(uint32_t level = firstLevel; level < texture.source.levelCount; level++)
+	{
+		VkBufferImageCopy& region = regions[level - firstLevel];
+		region = {};
+		region.bufferOffset = levelOffsets[level - firstLevel];
+		region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		region.imageSubresource.mipLevel = level - firstLevel;
+		region.imageSubresource.baseArrayLayer = 0;
+		region.imageSubresource.layerCount = texture.source.faceCount;
+		region.imageExtent = get_level_extent(texture.source, level);
+		end = std::max(end, region.bufferOffset + get_staged_face_size(texture, level) * texture.source.faceCount);
+	}
+	return end;
+}
+
+//compressed levels are uploaded straight from the mapped file, faces of a level already follow each other there
+static const uint8_t* get_file_level_offsets(const CookedTexture& source, uint32_t firstLevel, VkDeviceSize* levelOffsets)
+{
+	const uint8_t* base = source.levels[firstLevel];
+	for(uint32_t level = firstLevel; level < source.levelCount; level++)
+	{
+		base = std::min(base, source.levels[level]);
+	}
+	for(uint32_t level = firstLevel; level < source.levelCount; level++)
+	{
+		levelOffsets[level - firstLevel] = static_cast<VkDeviceSize>(source.levels[level] - base);
+	}
+	return base;
+}
+
+//rgba8 levels one after another, faces of a level together
+static void decode_levels(const CookedTexture& source, uint32_t firstLevel, std::vector<uint8_t>* decoded)
+{
+	std::size_t size = 0;
+	for(uint32_t level = firstLevel; level < source.levelCount; level++)
+	{
+		const VkExtent3D extent = get_level_extent(source, level);
+		size += std::size_t(extent.width) * extent.height * 4 * source.faceCount;
+	}
+	decoded->resize(size);
+
+	uint8_t* dst = decoded->data();
+	for(uint32_t level = firstLevel; level < source.levelCount; level++)
+	{
+		const VkExtent3D extent = get_level_extent(source, level);
+		const std::size_t faceSize = source.levelSizes[level] / source.faceCount;
+		for(uint32_t face = 0; face < source.faceCount; face++)
+		{
+			decompress_image(source.levels[level] + face * faceSize, extent.width, extent.height, source.blockFormat, dst);
+			dst += std::size_t(extent.width) * extent.height * 4;
+		}
+	}
+}
+
+static void get_decoded_level_offsets(const StreamedTexture& texture, uint32_t firstLevel, VkDeviceSize* levelOffsets)
+{
+	VkDeviceSize offset = 0;
+	for(uint32_t level = firstLevel; level < texture.source.levelCount; level++)
+	{
+		levelOffsets[level - firstLevel] = offset;
+		offset += get_staged_face_size(texture, level) * texture.source.faceCount;
+	}
+}
+
+//stages levels [firstLevel, levelCount) through the upload queue, decoded ones come from decodedLevels
+static bool enqueue_level_upload(UploadQueue* uploadQueue, const VulkanGlobalContext& vkCtx, const StreamedTexture& texture,
+	uint32_t firstLevel, const std::vector<uint8_t>& decodedLevels, ImageResource* image)
+{
+	VkDeviceSize levelOffsets[MAX_COOKED_TEXTURE_LEVELS] = {};
+	const uint8_t* data = decodedLevels.data();
+	if(is_decoded_on_cpu(texture))
+	{
+		get_decoded_level_offsets(texture, firstLevel, levelOffsets);
+	}
+	else
+	{
+		data = get_file_level_offsets(texture.source, firstLevel, levelOffsets);
+	}
+
+	VkBufferImageCopy regions[MAX_COOKED_TEXTURE_LEVELS] = {};
+	const VkDeviceSize size = get_level_regions(texture, firstLevel, levelOffsets, regions);
+	return upload_to_image(uploadQueue, vkCtx, data, size, regions, texture.source.levelCount - firstLevel, image);
+}
+
+//image holding levels [firstLevel, levelCount), its level 0 is firstLevel of the source
+static ImageResource create_streamed_image(const VulkanGlobalContext& vkCtx, const StreamedTexture& texture, uint32_t firstLevel)
+{
+	const VkExtent3D extent = get_level_extent(texture.source, firstLevel);
+	const uint32_t mipLevels = texture.source.levelCount - firstLevel;
+	const VkImageUsageFlags usageFlags = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+	return texture.source.faceCount == 6 ?
+		create_cubemap_image(vkCtx, extent, texture.imageFormat, usageFlags, VK_IMAGE_LAYOUT_UNDEFINED, mipLevels) :
+		create_image_resource(vkCtx, extent, texture.imageFormat, usageFlags, VK_IMAGE_LAYOUT_UNDEFINED, mipLevels);
+}
+
+bool init_texture_streamer(const VulkanGlobalContext& vkCtx, JobSystem* jobSystem, const TextureStreamingSettings& settings, TextureStreamer* streamer)
+{
+	assert(jobSystem && streamer);
+	assert(settings.framesInFlight > 0);
+	if(!init_upload_queue(vkCtx, settings.stagingSize, &streamer->uploadQueue))
+	{
+		return false;
+	}
+	streamer->jobSystem = jobSystem;
+	streamer->settings = settings;
+	streamer->textures.clear();
+	streamer->uploads.clear();
+	streamer->retiredImages.clear();
+	streamer->residentBytes = 0;
+	streamer->releasingBytes = 0;
+	streamer->frameIndex = 0;
+	return true;
+}
+
+void destroy_texture_streamer(const VulkanGlobalContext& vkCtx, TextureStreamer* streamer)
+{
+	assert(streamer);
+	for(TextureUpload& upload : streamer->uploads)
+	{
+		wait_for_counter(streamer->jobSystem, &upload.decoded);
+	}
+	//waits for every upload in flight
+	destroy_upload_queue(vkCtx, &streamer->uploadQueue);
+	for(TextureUpload& upload : streamer->uploads)
+	{
+		destroy_image_resource(vkCtx.logicalDevice, &upload.image);
+	}
+	streamer->uploads.clear();
+
+	//retired images may still be read by frames that were submitted last
+	VK_CALL(vkDeviceWaitIdle(vkCtx.logicalDevice));
+	for(RetiredImage& retired : streamer->retiredImages)
+	{
+		destroy_image_resource(vkCtx.logicalDevice, &retired.image);
+	}
+	streamer->retiredImages.clear();
+
+	for(StreamedTexture& texture : streamer->textures)
+	{
+		destroy_image_resource(vkCtx.logicalDevice, &texture.image);
+		close_cooked_texture(&texture.source);
+	}
+	streamer->textures.clear();
+	streamer->residentBytes = 0;
+	streamer->releasingBytes = 0;
+}
+
+bool add_streamed_texture(TextureStreamer* streamer, const VulkanGlobalContext& vkCtx, CookedTexture* source, StreamedTextureHandle* out)
+{
+	assert(streamer && source && out);
+	assert(source->file.data && source->levelCount > 0);
+
+	StreamedTexture texture = {};
+	texture.source = *source;
+	texture.imageFormat = source->format;
+	VkFormatProperties formatProps = {};
+	vkGetPhysicalDeviceFormatProperties(vkCtx.physicalDevice, source->format, &formatProps);
+	if(!(formatProps.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT))
+	{
+		magma::log::warn("Device can't sample format {}, streamed texture is decoded on the cpu", uint32_t(source->format));
+		texture.imageFormat = source->colorSpace == MIP_COLOR_SRGB ? VK_FORMAT_R8G8B8A8_SRGB : VK_FORMAT_R8G8B8A8_UNORM;
+	}
+
+	//finest level that fits into the tail extent, the last level when none does
+	texture.tailLevel = source->levelCount - 1;
+	for(uint32_t level = 0; level < source->levelCount; level++)
+	{
+		const VkExtent3D extent = get_level_extent(*source, level);
+		if(std::max(extent.width, extent.height) <= streamer->settings.residentTailExtent)
+		{
+			texture.tailLevel = level;
+			break;
+		}
+	}
+
+	std::vector<uint8_t> decodedLevels;
+	if(is_decoded_on_cpu(texture))
+	{
+		decode_levels(texture.source, texture.tailLevel, &decodedLevels);
+	}
+	texture.image = create_streamed_image(vkCtx, texture, texture.tailLevel);
+	if(!enqueue_level_upload(&streamer->uploadQueue, vkCtx, texture, texture.tailLevel, decodedLevels, &texture.image))
+	{
+		magma::log::error("Failed to upload resident levels of streamed texture");
+		wait_for_upload(&streamer->uploadQueue, vkCtx, submit_uploads(&streamer->uploadQueue, vkCtx));
+		destroy_image_resource(vkCtx.logicalDevice, &texture.image);
+		return false;
+	}
+	wait_for_upload(&streamer->uploadQueue, vkCtx, submit_uploads(&streamer->uploadQueue, vkCtx));
+
+	texture.residentLevel = texture.tailLevel;
+	texture.requestedLevel = texture.tailLevel;
+	texture.generation = 0;
+	texture.lastUsedFrame = streamer->frameIndex;
+	texture.isStreaming = false;
+	streamer->residentBytes += get_resident_size(texture, texture.residentLevel);
+
+	*source = {};
+	*out = static_cast<StreamedTextureHandle>(streamer->textures.size());
+	streamer->textures.push_back(texture);
+	return true;
+}
+
+void request_texture_level(TextureStreamer* streamer, StreamedTextureHandle handle, uint32_t level)
+{
+	assert(streamer && handle < streamer->textures.size());
+	StreamedTexture& texture = streamer->textures[handle];
+	texture.requestedLevel = std::min(texture.requestedLevel, level);
+	texture.lastUsedFrame = streamer->frameIndex;
+}
+
+uint32_t get_texture_level_for_distance(const StreamedTexture& texture, float objectSize, float distance, float projectionScale)
+{
+	const float projectedPixels = objectSize * projectionScale / std::max(distance, 1e-4f);
+	const float texels = float(std::max(texture.source.extent.width, texture.source.extent.height));
+	if(projectedPixels >= texels)
+	{
+		return 0;
+	}
+	const float level = std::log2(texels / std::max(projectedPixels, 1.0f));
+	return std::min(static_cast<uint32_t>(level), texture.source.levelCount - 1);
+}
+
+const StreamedTexture& get_streamed_texture(const TextureStreamer& streamer, StreamedTextureHandle handle)
+{
+	assert(handle < streamer.textures.size());
+	return streamer.textures[handle];
+}
+
+//new image gets every level from firstLevel down, staged through the upload queue on the next update.
+//Both images stay alive until the old one retires, so both count against the budget right away
+static void start_texture_upload(TextureStreamer* streamer, const VulkanGlobalContext& vkCtx, StreamedTextureHandle handle, uint32_t firstLevel)
+{
+	StreamedTexture& texture = streamer->textures[handle];
+	assert(!texture.isStreaming);
+
+	streamer->uploads.emplace_back();
+	TextureUpload& upload = streamer->uploads.back();
+	upload.handle = handle;
+	upload.level = firstLevel;
+	upload.image = create_streamed_image(vkCtx, texture, firstLevel);
+	upload.token = 0;
+	upload.decodeOnCpu = is_decoded_on_cpu(texture);
+	upload.source = texture.source;
+
+	if(upload.decodeOnCpu)
+	{
+		//list nodes don't move, so the job only carries a pointer to the upload
+		TextureUpload* uploadData = &upload;
+		auto job = [uploadData]()
+		{
+			decode_levels(uploadData->source, uploadData->level, &uploadData->decodedLevels);
+		};
+		if(get_worker_count(*streamer->jobSystem) > 0)
+		{
+			submit_job(streamer->jobSystem, std::move(job), &upload.decoded);
+		}
+		else
+		{
+			job();
+		}
+	}
+
+	streamer->residentBytes += get_resident_size(texture, firstLevel);
+	streamer->releasingBytes += get_resident_size(texture, texture.residentLevel);
+	texture.isStreaming = true;
+}
+
+//old image may still be sampled by frames in flight, it's destroyed a few updates later
+static void land_texture_upload(TextureStreamer* streamer, TextureUpload* upload)
+{
+	StreamedTexture& texture = streamer->textures[upload->handle];
+	streamer->retiredImages.push_back({texture.image, get_resident_size(texture, texture.residentLevel), streamer->frameIndex});
+	texture.image = upload->image;
+	texture.residentLevel = upload->level;
+	texture.generation++;
+	texture.isStreaming = false;
+}
+
+//texture keeps its current image, the new one is destroyed once nothing in flight can reference it
+static void cancel_texture_upload(TextureStreamer* streamer, const VulkanGlobalContext& vkCtx, TextureUpload* upload)
+{
+	StreamedTexture& texture = streamer->textures[upload->handle];
+	wait_for_upload(&streamer->uploadQueue, vkCtx, submit_uploads(&streamer->uploadQueue, vkCtx));
+	destroy_image_resource(vkCtx.logicalDevice, &upload->image);
+	streamer->residentBytes -= get_resident_size(texture, upload->level);
+	streamer->releasingBytes -= get_resident_size(texture, texture.residentLevel);
+	texture.isStreaming = false;
+}
+
+//budget accounting of start_texture_upload, without touching the device
+static void plan_level_change(const StreamedTexture& texture, uint32_t firstLevel, TextureStreamingPlan* plan)
+{
+	plan->residentBytes += get_resident_size(texture, firstLevel);
+	plan->releasingBytes += get_resident_size(texture, texture.residentLevel);
+}
+
+//shrinks least recently used textures that weren't requested this update to their tail,
+//until needed bytes fit once every image being replaced is gone
+static void plan_evictions(const TextureStreamer& streamer, VkDeviceSize neededBytes, std::vector<bool>* isChanging, TextureStreamingPlan* plan)
+{
+	std::vector<StreamedTextureHandle> candidates;
+	for(StreamedTextureHandle handle = 0; handle < streamer.textures.size(); handle++)
+	{
+		const StreamedTexture& texture = streamer.textures[handle];
+		if(!(*isChanging)[handle] && texture.residentLevel < texture.tailLevel && texture.lastUsedFrame < streamer.frameIndex)
+		{
+			candidates.push_back(handle);
+		}
+	}
+	std::sort(candidates.begin(), candidates.end(), [&streamer](StreamedTextureHandle a, StreamedTextureHandle b)
+	{
+		return streamer.textures[a].lastUsedFrame < streamer.textures[b].lastUsedFrame;
+	});
+
+	for(StreamedTextureHandle handle : candidates)
+	{
+		if(plan->residentBytes - plan->releasingBytes + neededBytes <= streamer.settings.budget)
+		{
+			break;
+		}
+		plan_level_change(streamer.textures[handle], streamer.textures[handle].tailLevel, plan);
+		plan->evictions.push_back(handle);
+		(*isChanging)[handle] = true;
+	}
+}
+
+void plan_texture_streaming(const TextureStreamer& streamer, TextureStreamingPlan* plan)
+{
+	assert(plan);
+	plan->evictions.clear();
+	plan->uploads.clear();
+	plan->residentBytes = streamer.residentBytes;
+	plan->releasingBytes = streamer.releasingBytes;
+	std::vector<bool> isChanging(streamer.textures.size());
+	for(StreamedTextureHandle handle = 0; handle < streamer.textures.size(); handle++)
+	{
+		isChanging[handle] = streamer.textures[handle].isStreaming;
+	}
+
+	//most recently used and furthest from what they need first
+	std::vector<StreamedTextureHandle> requests;
+	for(StreamedTextureHandle handle = 0; handle < streamer.textures.size(); handle++)
+	{
+		const StreamedTexture& texture = streamer.textures[handle];
+		if(!texture.isStreaming && texture.requestedLevel < texture.residentLevel)
+		{
+			requests.push_back(handle);
+		}
+	}
+	std::sort(requests.begin(), requests.end(), [&streamer](StreamedTextureHandle a, StreamedTextureHandle b)
+	{
+		const StreamedTexture& textureA = streamer.textures[a];
+		const StreamedTexture& textureB = streamer.textures[b];
+		if(textureA.lastUsedFrame != textureB.lastUsedFrame)
+		{
+			return textureA.lastUsedFrame > textureB.lastUsedFrame;
+		}
+		return textureA.residentLevel - textureA.requestedLevel > textureB.residentLevel - textureB.requestedLevel;
+	});
+
+	VkDeviceSize stagedBytes = 0;
+	for(StreamedTextureHandle handle : requests)
+	{
+		const StreamedTexture& texture = streamer.textures[handle];
+		const VkDeviceSize targetBytes = get_resident_size(texture, texture.requestedLevel);
+		if(stagedBytes > 0 && stagedBytes + targetBytes > streamer.settings.maxUploadBytes)
+		{
+			break;
+		}
+		//the current image stays alive next to the new one until it retires, memory evicted now frees up in later updates
+		if(plan->residentBytes + targetBytes > streamer.settings.budget)
+		{
+			plan_evictions(streamer, targetBytes, &isChanging, plan);
+			if(plan->residentBytes + targetBytes > streamer.settings.budget)
+			{
+				continue;
+			}
+		}
+		plan_level_change(texture, texture.requestedLevel, plan);
+		plan->uploads.push_back(handle);
+		isChanging[handle] = true;
+		stagedBytes += targetBytes;
+	}
+}
+
+void update_texture_streaming(TextureStreamer* streamer, const VulkanGlobalContext& vkCtx)
+{
+	assert(streamer);
+
+	//1.destroy images no frame in flight can reference anymore
+	auto retiredEnd = std::remove_if(streamer->retiredImages.begin(), streamer->retiredImages.end(),
+		[streamer, &vkCtx](RetiredImage& retired)
+		{
+			if(retired.retiredFrame + streamer->settings.framesInFlight > streamer->frameIndex)
+			{
+				return false;
+			}
+			destroy_image_resource(vkCtx.logicalDevice, &retired.image);
+			streamer->residentBytes -= retired.size;
+			streamer->releasingBytes -= retired.size;
+			return true;
+		});
+	streamer->retiredImages.erase(retiredEnd, streamer->retiredImages.end());
+
+	//2.swap in images of uploads the gpu finished
+	for(auto it = streamer->uploads.begin(); it != streamer->uploads.end();)
+	{
+		if(it->token != 0 && is_upload_complete(&streamer->uploadQueue, vkCtx, it->token))
+		{
+			land_texture_upload(streamer, &*it);
+			it = streamer->uploads.erase(it);
+		}
+		else
+		{
+			++it;
+		}
+	}
+
+	//3.shrink textures nobody asked for and stream in finer levels of requested ones
+	TextureStreamingPlan plan = {};
+	plan_texture_streaming(*streamer, &plan);
+	for(StreamedTextureHandle handle : plan.evictions)
+	{
+		start_texture_upload(streamer, vkCtx, handle, streamer->textures[handle].tailLevel);
+	}
+	for(StreamedTextureHandle handle : plan.uploads)
+	{
+		start_texture_upload(streamer, vkCtx, handle, streamer->textures[handle].requestedLevel);
+	}
+	assert(streamer->residentBytes == plan.residentBytes && streamer->releasingBytes == plan.releasingBytes);
+
+	//4.stage levels of uploads that are decoded, one submit covers all of them
+	std::vector<TextureUpload*> enqueued;
+	for(auto it = streamer->uploads.begin(); it != streamer->uploads.end();)
+	{
+		if(it->token != 0 || !is_counter_complete(it->decoded))
+		{
+			++it;
+			continue;
+		}
+		if(!enqueue_level_upload(&streamer->uploadQueue, vkCtx, streamer->textures[it->handle], it->level, it->decodedLevels, &it->image))
+		{
+			magma::log::error("Failed to stage levels {} and below of streamed texture {}", it->level, it->handle);
+			cancel_texture_upload(streamer, vkCtx, &*it);
+			it = streamer->uploads.erase(it);
+			continue;
+		}
+		it->decodedLevels = {};
+		enqueued.push_back(&*it);
+		++it;
+	}
+	//batches finish in order, so the last one stands for uploads that ended in earlier batches too
+	if(!enqueued.empty())
+	{
+		const UploadToken token = submit_uploads(&streamer->uploadQueue, vkCtx);
+		for(TextureUpload* upload : enqueued)
+		{
+			upload->token = token;
+		}
+	}
+
+	//5.requests are per frame
+	for(StreamedTexture& texture : streamer->textures)
+	{
+		texture.requestedLevel = texture.tailLevel;
+	}
+	streamer->frameIndex++;
+}
@@ -0,0 +1,105 @@
+#ifndef MAGMA_TEXTURE_STREAMING_H
+#define MAGMA_TEXTURE_STREAMING_H
+
+#include "texture_cache.h"
+#include "job_system.h"
+#include "vk_types.h"
+#include "vk_upload.h"
+
+#include <list>
+#include <vector>
+
+static constexpr VkDeviceSize DEFAULT_TEXTURE_STREAMING_BUDGET = 256ull << 20;
+
+struct TextureStreamingSettings
+{
+	VkDeviceSize budget = DEFAULT_TEXTURE_STREAMING_BUDGET;//device memory all streamed images may take, retired ones included
+	uint32_t residentTailExtent = 64;//levels this size and below are resident from the start and never evicted
+	VkDeviceSize maxUploadBytes = 32ull << 20;//staged per update, spreads bursts of requests over several frames
+	VkDeviceSize stagingSize = DEFAULT_STAGING_ARENA_SIZE;//upload queue arena, keep it above maxUploadBytes to avoid stalls
+	uint32_t framesInFlight = 2;//replaced images are destroyed this many updates later
+};
+
+typedef uint32_t StreamedTextureHandle;
+
+//image is recreated with more or fewer levels as residency changes, so it always starts at the finest resident level
+struct StreamedTexture
+{
+	CookedTexture source;
+	ImageResource image;//levels [residentLevel, source.levelCount)
+	VkFormat imageFormat;//source format, or rgba8 when the device can't sample it
+	uint32_t residentLevel;
+	uint32_t tailLevel;//coarsest level streaming goes down to
+	uint32_t requestedLevel;//finest level asked for since last update
+	uint32_t generation;//bumped whenever image is replaced, descriptors pointing at it have to be rewritten
+	uint64_t lastUsedFrame;
+	bool isStreaming;
+};
+
+struct TextureUpload
+{
+	StreamedTextureHandle handle;
+	uint32_t level;
+	ImageResource image;
+	UploadToken token;//0 until levels are enqueued on the upload queue
+	//formats the device can't sample are decoded on a worker first
+	bool decodeOnCpu;
+	JobCounter decoded;
+	std::vector<uint8_t> decodedLevels;
+	CookedTexture source;//decode job reads a copy as textures vector may grow while it runs
+};
+
+struct RetiredImage
+{
+	ImageResource image;
+	VkDeviceSize size;
+	uint64_t retiredFrame;
+};
+
+struct TextureStreamer
+{
+	JobSystem* jobSystem;
+	UploadQueue uploadQueue;
+	TextureStreamingSettings settings;
+	std::vector<StreamedTexture> textures;
+	std::list<TextureUpload> uploads;//nodes stay in place while workers decode into them
+	std::vector<RetiredImage> retiredImages;
+	VkDeviceSize residentBytes;//of every image alive, upload targets and retired images frames may still sample included
+	VkDeviceSize releasingBytes;//part of residentBytes freed once uploads in flight land and the images they replace retire
+	uint64_t frameIndex;
+};
+
+//level changes an update starts, decided from residency, requests and budget alone
+struct TextureStreamingPlan
+{
+	std::vector<StreamedTextureHandle> evictions;//shrink to their tail, least recently used first
+	std::vector<StreamedTextureHandle> uploads;//stream in their requested level, most recently used first
+	VkDeviceSize residentBytes;//streamer accounting once every planned change has started
+	VkDeviceSize releasingBytes;
+};
+
+bool init_texture_streamer(const VulkanGlobalContext& vkCtx, JobSystem* jobSystem, const TextureStreamingSettings& settings, TextureStreamer* streamer);
+
+//waits for uploads in flight, destroys every image and closes source files
+void destroy_texture_streamer(const VulkanGlobalContext& vkCtx, TextureStreamer* streamer);
+
+//takes over the mapped file and blocks until the resident tail is uploaded
+bool add_streamed_texture(TextureStreamer* streamer, const VulkanGlobalContext& vkCtx, CookedTexture* source, StreamedTextureHandle* out);
+
+//finest level the texture is going to be sampled at, e.g. from gpu feedback or get_texture_level_for_distance.
+//Call every frame the texture is used, textures that aren't requested become first in line for eviction
+void request_texture_level(TextureStreamer* streamer, StreamedTextureHandle handle, uint32_t level);
+
+//level matching texel density to pixel density of a surface spanning objectSize world units.
+//projectionScale comes from get_lod_projection_scale
+uint32_t get_texture_level_for_distance(const StreamedTexture& texture, float objectSize, float distance, float projectionScale);
+
+//once per frame: lands finished uploads, evicts least recently used levels to stay within budget and starts new uploads
+void update_texture_streaming(TextureStreamer* streamer, const VulkanGlobalContext& vkCtx);
+
+//step of update_texture_streaming that picks evictions and uploads, without touching the device
+void plan_texture_streaming(const TextureStreamer& streamer, TextureStreamingPlan* plan);
+
+const StreamedTexture& get_streamed_texture(const TextureStreamer& streamer, StreamedTextureHandle handle);
+
+#endif
@@ -0,0 +1,265 @@
+#include "vertex_compression.h"
+
+#include <meshoptimizer.h>
+
+#include <cassert>
+#include <cstddef>
+#include <cstring>
+
+static constexpr float UNORM16_STEPS = 65535.f;
+static constexpr float SNORM16_STEPS = 32767.f;
+static constexpr float UNORM8_STEPS = 255.f;
+
+//projects unit vector onto octahedron and unfolds lower hemisphere onto the corners of xy square
+static Vec2 encode_octahedral(const Vec3& normal)
+{
+	const float length = std::abs(normal.x) + std::abs(normal.y) + std::abs(normal.z);
+	if(length == 0.f)
+	{
+		return {0.f, 0.f};
+	}
+
+	Vec2 out = {normal.x / length, normal.y / length};
+	if(normal.z < 0.f)
+	{
+		const Vec2 folded = out;
+		out.x = (1.f - std::abs(folded.y)) * (folded.x >= 0.f ? 1.f : -1.f);
+		out.y = (1.f - std::abs(folded.x)) * (folded.y >= 0.f ? 1.f : -1.f);
+	}
+	return out;
+}
+
+static Vec3 decode_octahedral(Vec2 encoded)
+{
+	Vec3 out = {encoded.x, encoded.y, 1.f - std::abs(encoded.x) - std::abs(encoded.y)};
+	const float fold = std::max(-out.z, 0.f);
+	out.x += out.x >= 0.f ? -fold : fold;
+	out.y += out.y >= 0.f ? -fold : fold;
+	return normaliseVec3(out);
+}
+
+static float half_to_float(uint16_t half)
+{
+	const uint32_t sign = uint32_t(half & 0x8000) << 16;
+	const uint32_t exponent = (half >> 10) & 0x1f;
+	const uint32_t mantissa = half & 0x3ff;
+
+	uint32_t bits = 0;
+	if(exponent == 0x1f)
+	{
+		bits = sign | 0x7f800000 | (mantissa << 13);
+	}
+	else if(exponent != 0)
+	{
+		bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+	}
+	else if(mantissa != 0)
+	{
+		//denormal, value is mantissa * 2^-24
+		float value = float(mantissa) * (1.f / 16777216.f);
+		return sign ? -value : value;
+	}
+	else
+	{
+		bits = sign;
+	}
+
+	float out;
+	memcpy(&out, &bits, sizeof(out));
+	return out;
+}
+
+//rounding is fixed up on the largest weight, so that skinning never loses or gains weight
+static void quantise_weights(const Vec4& weights, uint8_t* out)
+{
+	int sum = 0;
+	uint32_t largest = 0;
+	for(uint32_t i = 0; i < 4; i++)
+	{
+		out[i] = static_cast<uint8_t>(meshopt_quantizeUnorm(clamp(weights.data[i], 0.f, 1.f), 8));
+		sum += out[i];
+		if(weights.data[i] > weights.data[largest])
+		{
+			largest = i;
+		}
+	}
+	if(sum != 0)
+	{
+		out[largest] = static_cast<uint8_t>(clamp(float(out[largest] + 255 - sum), 0.f, 255.f));
+	}
+}
+
+uint32_t get_vertex_stride(VertexFormat format)
+{
+	switch(format)
+	{
+		case VERTEX_FORMAT_FULL:            return sizeof(Vertex);
+		case VERTEX_FORMAT_COMPACT:         return sizeof(CompactVertex);
+		case VERTEX_FORMAT_COMPACT_SKINNED: return sizeof(CompactSkinnedVertex);
+	}
+	assert(!"Unknown vertex format");
+	return 0;
+}
+
+void compress_vertices(const Vertex* vertices, uint32_t vertexCount, VertexFormat format, CompressedVertexBuffer* out)
+{
+	assert(vertices || !vertexCount);
+	assert(out);
+
+	out->format = format;
+	out->stride = get_vertex_stride(format);
+	out->vertexCount = vertexCount;
+	out->data.resize(std::size_t(vertexCount) * out->stride);
+	out->positionDequantisation = loadIdentity();
+	if(format == VERTEX_FORMAT_FULL)
+	{
+		memcpy(out->data.data(), vertices, out->data.size());
+		return;
+	}
+
+	Vec3 boundsMin = vertexCount ? vertices[0].position : Vec3{0.f, 0.f, 0.f};
+	Vec3 boundsMax = boundsMin;
+	for(uint32_t i = 1; i < vertexCount; i++)
+	{
+		for(uint32_t c = 0; c < 3; c++)
+		{
+			boundsMin.data[c] = std::min(boundsMin.data[c], vertices[i].position.data[c]);
+			boundsMax.data[c] = std::max(boundsMax.data[c], vertices[i].position.data[c]);
+		}
+	}
+	Vec3 extent = boundsMax - boundsMin;
+	for(uint32_t c = 0; c < 3; c++)
+	{
+		//flat axis still needs non zero scale to dequantise back
+		extent.data[c] = extent.data[c] > 0.f ? extent.data[c] : 1.f;
+	}
+	out->positionDequantisation = loadScale(extent) * loadTranslation(boundsMin);
+
+	for(uint32_t i = 0; i < vertexCount; i++)
+	{
+		const Vertex& vertex = vertices[i];
+		CompactVertex compact = {};
+		for(uint32_t c = 0; c < 3; c++)
+		{
+			const float normalised = (vertex.position.data[c] - boundsMin.data[c]) / extent.data[c];
+			compact.position[c] = static_cast<uint16_t>(meshopt_quantizeUnorm(normalised, 16));
+		}
+		const Vec2 octahedral = encode_octahedral(vertex.normal);
+		compact.normal[0] = static_cast<int16_t>(meshopt_quantizeSnorm(octahedral.x, 16));
+		compact.normal[1] = static_cast<int16_t>(meshopt_quantizeSnorm(octahedral.y, 16));
+		compact.uv[0] = meshopt_quantizeHalf(vertex.uv.x);
+		compact.uv[1] = meshopt_quantizeHalf(vertex.uv.y);
+
+		uint8_t* dst = out->data.data() + std::size_t(i) * out->stride;
+		if(format == VERTEX_FORMAT_COMPACT)
+		{
+			memcpy(dst, &compact, sizeof(compact));
+			continue;
+		}
+
+		CompactSkinnedVertex skinned = {};
+		skinned.base = compact;
+		for(uint32_t c = 0; c < 4; c++)
+		{
+			assert(vertex.jointIds.data[c] >= 0.f && vertex.jointIds.data[c] < 256.f);
+			skinned.jointIds[c] = static_cast<uint8_t>(vertex.jointIds.data[c]);
+		}
+		quantise_weights(vertex.weights, skinned.weights);
+		memcpy(dst, &skinned, sizeof(skinned));
+	}
+}
+
+void decompress_vertices(const CompressedVertexBuffer& buffer, Vertex* out)
+{
+	assert(out || !buffer.vertexCount);
+	if(buffer.format == VERTEX_FORMAT_FULL)
+	{
+		memcpy(out, buffer.data.data(), buffer.data.size());
+		return;
+	}
+
+	for(uint32_t i = 0; i < buffer.vertexCount; i++)
+	{
+		const uint8_t* src = buffer.data.data() + std::size_t(i) * buffer.stride;
+		CompactSkinnedVertex skinned = {};
+		memcpy(&skinned, src, buffer.stride);
+		const CompactVertex& compact = skinned.base;
+
+		Vertex& vertex = out[i];
+		vertex = {};
+		Vec4 normalised = {
+			compact.position[0] / UNORM16_STEPS,
+			compact.position[1] / UNORM16_STEPS,
+			compact.position[2] / UNORM16_STEPS,
+			1.f
+		};
+		vertex.position = (normalised * buffer.positionDequantisation).xyz;
+		vertex.normal = decode_octahedral({
+			std::max(compact.normal[0] / SNORM16_STEPS, -1.f),
+			std::max(compact.normal[1] / SNORM16_STEPS, -1.f)
+		});
+		vertex.uv = {half_to_float(compact.uv[0]), half_to_float(compact.uv[1])};
+
+		if(buffer.format == VERTEX_FORMAT_COMPACT_SKINNED)
+		{
+			for(uint32_t c = 0; c < 4; c++)
+			{
+				vertex.jointIds.data[c] = skinned.jointIds[c];
+				vertex.weights.data[c] = skinned.weights[c] / UNORM8_STEPS;
+			}
+		}
+	}
+}
+
+VkVertexInputBindingDescription get_vertex_input_binding(VertexFormat format, uint32_t binding)
+{
+	VkVertexInputBindingDescription description = {};
+	description.binding = binding;
+	description.stride = get_vertex_stride(format);
+	description.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+	return description;
+}
+
+uint32_t get_vertex_input_attributes(VertexFormat format, uint32_t binding, VkVertexInputAttributeDescription* out)
+{
+	assert(out);
+	for(uint32_t i = 0; i < VERTEX_MAX_ATTRIBUTES; i++)
+	{
+		out[i] = {};
+		out[i].location = i;
+		out[i].binding = binding;
+	}
+
+	if(format == VERTEX_FORMAT_FULL)
+	{
+		out[0].format = VK_FORMAT_R32G32B32_SFLOAT;
+		out[0].offset = offsetof(Vertex, position);
+		out[1].format = VK_FORMAT_R32G32B32_SFLOAT;
+		out[1].offset = offsetof(Vertex, normal);
+		out[2].format = VK_FORMAT_R32G32_SFLOAT;
+		out[2].offset = offsetof(Vertex, uv);
+		out[3].format = VK_FORMAT_R32G32B32A32_SFLOAT;
+		out[3].offset = offsetof(Vertex, jointIds);
+		out[4].format = VK_FORMAT_R32G32B32A32_SFLOAT;
+		out[4].offset = offsetof(Vertex, weights);
+		return 5;
+	}
+
+	//three component 16 bit formats are rarely supported for vertex input, hence padded positions
+	out[0].format = VK_FORMAT_R16G16B16A16_UNORM;
+	out[0].offset = offsetof(CompactVertex, position);
+	out[1].format = VK_FORMAT_R16G16_SNORM;
+	out[1].offset = offsetof(CompactVertex, normal);
+	out[2].format = VK_FORMAT_R16G16_SFLOAT;
+	out[2].offset = offsetof(CompactVertex, uv);
+	if(format == VERTEX_FORMAT_COMPACT)
+	{
+		return 3;
+	}
+
+	out[3].format = VK_FORMAT_R8G8B8A8_UINT;
+	out[3].offset = offsetof(CompactSkinnedVertex, jointIds);
+	out[4].format = VK_FORMAT_R8G8B8A8_UNORM;
+	out[4].offset = offsetof(CompactSkinnedVertex, weights);
+	return 5;
+}
@@ -0,0 +1,54 @@
+#ifndef MAGMA_VERTEX_COMPRESSION_H
+#define MAGMA_VERTEX_COMPRESSION_H
+
+#include "mesh_loaders.h"
+
+#include <vector>
+
+//attribute locations match Vertex: position 0, normal 1, uv 2, joints 3, weights 4.
+//decoding helpers for shaders live in shaders/vertex_decode.h.glsl
+enum VertexFormat
+{
+	VERTEX_FORMAT_FULL,          //Vertex as is
+	VERTEX_FORMAT_COMPACT,       //CompactVertex, static meshes
+	VERTEX_FORMAT_COMPACT_SKINNED//CompactSkinnedVertex
+};
+
+struct CompactVertex
+{
+	uint16_t position[4];//unorm16 within mesh bounds, w is padding
+	int16_t normal[2];//octahedral snorm16
+	uint16_t uv[2];//half floats
+};
+
+struct CompactSkinnedVertex
+{
+	CompactVertex base;
+	uint8_t jointIds[4];
+	uint8_t weights[4];//unorm8, quantised to sum up to exactly 255
+};
+
+static constexpr uint32_t VERTEX_MAX_ATTRIBUTES = 5;
+
+struct CompressedVertexBuffer
+{
+	VertexFormat format;
+	uint32_t stride;
+	uint32_t vertexCount;
+	std::vector<uint8_t> data;
+	mat4x4 positionDequantisation;//unorm positions back to mesh space
+};
+
+void compress_vertices(const Vertex* vertices, uint32_t vertexCount, VertexFormat format, CompressedVertexBuffer* out);
+
+//out must hold buffer.vertexCount vertices
+void decompress_vertices(const CompressedVertexBuffer& buffer, Vertex* out);
+
+uint32_t get_vertex_stride(VertexFormat format);
+
+VkVertexInputBindingDescription get_vertex_input_binding(VertexFormat format, uint32_t binding);
+
+//out must hold VERTEX_MAX_ATTRIBUTES descriptions, returns number of written ones
+uint32_t get_vertex_input_attributes(VertexFormat format, uint32_t binding, VkVertexInputAttributeDescription* out);
+
+#endif
@@ -0,0 +1,654 @@
+#include "vk_allocator.h"
+#include "vk_dbg.h"
+#include "logging.h"
+
+#include <algorithm>
+#include <cassert>
+
+static constexpr uint32_t INVALID_REGION = ~0u;
+
+//index of the highest set bit, value must not be zero
+static uint32_t find_msb(uint64_t value)
+{
+	assert(value);
+	uint32_t bit = 0;
+	for(uint32_t shift = 32; shift > 0; shift >>= 1)
+	{
+		if(value >> shift)
+		{
+			value >>= shift;
+			bit += shift;
+		}
+	}
+	return bit;
+}
+
+static uint32_t find_lsb(uint64_t value)
+{
+	return find_msb(value & (~value + 1));
+}
+
+static VkDeviceSize align_up(VkDeviceSize value, VkDeviceSize alignment)
+{
+	return (value + alignment - 1) / alignment * alignment;
+}
+
+//sizes below SL_COUNT go to the first class one by one, larger ones to 16 linear steps of their power of two
+static void get_free_list_index(VkDeviceSize size, uint32_t* fl, uint32_t* sl)
+{
+	if(size < MEMORY_BLOCK_SL_COUNT)
+	{
+		*fl = 0;
+		*sl = static_cast<uint32_t>(size);
+		return;
+	}
+	const uint32_t msb = find_msb(size);
+	*fl = msb - MEMORY_BLOCK_SL_LOG2 + 1;
+	*sl = static_cast<uint32_t>(size >> (msb - MEMORY_BLOCK_SL_LOG2)) - MEMORY_BLOCK_SL_COUNT;
+}
+
+//rounds size up to the next list boundary, so any region of the found list is large enough
+static void get_search_list_index(VkDeviceSize size, uint32_t* fl, uint32_t* sl)
+{
+	if(size >= MEMORY_BLOCK_SL_COUNT)
+	{
+		size += (VkDeviceSize(1) << (find_msb(size) - MEMORY_BLOCK_SL_LOG2)) - 1;
+	}
+	get_free_list_index(size, fl, sl);
+}
+
+static uint32_t create_region(MemoryBlock* block, VkDeviceSize offset, VkDeviceSize size)
+{
+	uint32_t index = 0;
+	if(!block->unusedRegions.empty())
+	{
+		index = block->unusedRegions.back();
+		block->unusedRegions.pop_back();
+	}
+	else
+	{
+		index = static_cast<uint32_t>(block->regions.size());
+		block->regions.emplace_back();
+	}
+	MemoryRegion& region = block->regions[index];
+	region = {};
+	region.offset = offset;
+	region.size = size;
+	region.prevPhysical = INVALID_REGION;
+	region.nextPhysical = INVALID_REGION;
+	region.prevFree = INVALID_REGION;
+	region.nextFree = INVALID_REGION;
+	return index;
+}
+
+static void insert_free_region(MemoryBlock* block, uint32_t index)
+{
+	MemoryRegion& region = block->regions[index];
+	uint32_t fl = 0, sl = 0;
+	get_free_list_index(region.size, &fl, &sl);
+
+	const uint32_t head = block->freeHeads[fl][sl];
+	region.isFree = true;
+	region.prevFree = INVALID_REGION;
+	region.nextFree = head;
+	if(head != INVALID_REGION)
+	{
+		block->regions[head].prevFree = index;
+	}
+	block->freeHeads[fl][sl] = index;
+	block->flBitmap |= uint64_t(1) << fl;
+	block->slBitmaps[fl] |= 1u << sl;
+}
+
+static void remove_free_region(MemoryBlock* block, uint32_t index)
+{
+	MemoryRegion& region = block->regions[index];
+	assert(region.isFree);
+	uint32_t fl = 0, sl = 0;
+	get_free_list_index(region.size, &fl, &sl);
+
+	if(region.prevFree != INVALID_REGION)
+	{
+		block->regions[region.prevFree].nextFree = region.nextFree;
+	}
+	else
+	{
+		block->freeHeads[fl][sl] = region.nextFree;
+		if(region.nextFree == INVALID_REGION)
+		{
+			block->slBitmaps[fl] &= ~(1u << sl);
+			if(!block->slBitmaps[fl])
+			{
+				block->flBitmap &= ~(uint64_t(1) << fl);
+			}
+		}
+	}
+	if(region.nextFree != INVALID_REGION)
+	{
+		block->regions[region.nextFree].prevFree = region.prevFree;
+	}
+	region.isFree = false;
+	region.prevFree = INVALID_REGION;
+	region.nextFree = INVALID_REGION;
+}
+
+//first region of the smallest non empty list that fits, INVALID_REGION if there is none
+static uint32_t find_free_region(const MemoryBlock& block, VkDeviceSize size)
+{
+	uint32_t fl = 0, sl = 0;
+	get_search_list_index(size, &fl, &sl);
+	if(fl >= MEMORY_BLOCK_FL_COUNT)
+	{
+		return INVALID_REGION;
+	}
+
+	uint32_t slMap = block.slBitmaps[fl] & (~0u << sl);
+	if(!slMap)
+	{
+		const uint64_t flMap = fl + 1 < MEMORY_BLOCK_FL_COUNT ? block.flBitmap & (~uint64_t(0) << (fl + 1)) : 0;
+		if(!flMap)
+		{
+			return INVALID_REGION;
+		}
+		fl = find_lsb(flMap);
+		slMap = block.slBitmaps[fl];
+	}
+	return block.freeHeads[fl][find_lsb(slMap)];
+}
+
+//new free region after index takes everything past size
+static void split_region(MemoryBlock* block, uint32_t index, VkDeviceSize size)
+{
+	const VkDeviceSize remainder = block->regions[index].size - size;
+	if(!remainder)
+	{
+		return;
+	}
+	const uint32_t tail = create_region(block, block->regions[index].offset + size, remainder);
+	MemoryRegion& region = block->regions[index];
+	MemoryRegion& tailRegion = block->regions[tail];
+	tailRegion.prevPhysical = index;
+	tailRegion.nextPhysical = region.nextPhysical;
+	if(region.nextPhysical != INVALID_REGION)
+	{
+		block->regions[region.nextPhysical].prevPhysical = tail;
+	}
+	region.nextPhysical = tail;
+	region.size = size;
+	insert_free_region(block, tail);
+}
+
+//next is absorbed into index and its slot is recycled
+static void merge_regions(MemoryBlock* block, uint32_t index, uint32_t next)
+{
+	MemoryRegion& region = block->regions[index];
+	MemoryRegion& nextRegion = block->regions[next];
+	region.size += nextRegion.size;
+	region.nextPhysical = nextRegion.nextPhysical;
+	if(nextRegion.nextPhysical != INVALID_REGION)
+	{
+		block->regions[nextRegion.nextPhysical].prevPhysical = index;
+	}
+	block->unusedRegions.push_back(next);
+}
+
+static bool allocate_from_block(MemoryBlock* block, VkDeviceSize size, VkDeviceSize alignment, uint32_t* regionIndex, VkDeviceSize* offset)
+{
+	//worst case padding is included so the aligned range fits whatever region is found
+	uint32_t index = find_free_region(*block, size + alignment - 1);
+	if(index == INVALID_REGION)
+	{
+		return false;
+	}
+	remove_free_region(block, index);
+
+	//leading padding goes back to the free lists as its own region
+	const VkDeviceSize alignedOffset = align_up(block->regions[index].offset, alignment);
+	const VkDeviceSize padding = alignedOffset - block->regions[index].offset;
+	if(padding)
+	{
+		split_region(block, index, padding);
+		const uint32_t aligned = block->regions[index].nextPhysical;
+		remove_free_region(block, aligned);
+		insert_free_region(block, index);
+		index = aligned;
+	}
+	split_region(block, index, size);
+
+	*regionIndex = index;
+	*offset = alignedOffset;
+	block->usedBytes += size;
+	block->allocationCount++;
+	return true;
+}
+
+static void free_from_block(MemoryBlock* block, uint32_t index)
+{
+	assert(!block->regions[index].isFree);
+	block->usedBytes -= block->regions[index].size;
+	block->allocationCount--;
+
+	const uint32_t next = block->regions[index].nextPhysical;
+	if(next != INVALID_REGION && block->regions[next].isFree)
+	{
+		remove_free_region(block, next);
+		merge_regions(block, index, next);
+	}
+	const uint32_t prev = block->regions[index].prevPhysical;
+	if(prev != INVALID_REGION && block->regions[prev].isFree)
+	{
+		remove_free_region(block, prev);
+		merge_regions(block, prev, index);
+		index = prev;
+	}
+	insert_free_region(block, index);
+}
+
+static VkDeviceMemory allocate_memory(DeviceAllocator* allocator, VkDeviceSize size, uint32_t memoryTypeIndex, uint8_t** mappedData)
+{
+	VkMemoryAllocateInfo memAllocInfo = {};
+	memAllocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	memAllocInfo.pNext = nullptr;
+	memAllocInfo.allocationSize = size;
+	memAllocInfo.memoryTypeIndex = memoryTypeIndex;
+
+	VkDeviceMemory memory = VK_NULL_HANDLE;
+	if(vkAllocateMemory(allocator->logicalDevice, &memAllocInfo, nullptr, &memory) != VK_SUCCESS)
+	{
+		return VK_NULL_HANDLE;
+	}
+
+	//memory can only be mapped once, so host visible memory is mapped for its whole lifetime
+	*mappedData = nullptr;
+	if(allocator->memoryProps.memoryTypes[memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+	{
+		void* mapped = nullptr;
+		VK_CALL(vkMapMemory(allocator->logicalDevice, memory, 0, VK_WHOLE_SIZE, VK_FLAGS_NONE, &mapped));
+		*mappedData = static_cast<uint8_t*>(mapped);
+	}
+	return memory;
+}
+
+static void free_memory(DeviceAllocator* allocator, VkDeviceMemory memory, bool isMapped)
+{
+	if(isMapped)
+	{
+		vkUnmapMemory(allocator->logicalDevice, memory);
+	}
+	vkFreeMemory(allocator->logicalDevice, memory, nullptr);
+}
+
+//small heaps, e.g. 256MB of host visible vram, would otherwise be taken by a handful of blocks
+static VkDeviceSize get_block_size(const DeviceAllocator& allocator, uint32_t memoryTypeIndex)
+{
+	const uint32_t heapIndex = allocator.memoryProps.memoryTypes[memoryTypeIndex].heapIndex;
+	return std::min(allocator.settings.blockSize, allocator.memoryProps.memoryHeaps[heapIndex].size / 8);
+}
+
+static MemoryBlock* create_memory_block(DeviceAllocator* allocator, uint32_t memoryTypeIndex, bool isLinear)
+{
+	const VkDeviceSize blockSize = get_block_size(*allocator, memoryTypeIndex);
+	uint8_t* mappedData = nullptr;
+	VkDeviceMemory memory = allocate_memory(allocator, blockSize, memoryTypeIndex, &mappedData);
+	if(memory == VK_NULL_HANDLE)
+	{
+		return nullptr;
+	}
+
+	std::unique_ptr<MemoryBlock> block = std::make_unique<MemoryBlock>();
+	block->memory = memory;
+	block->size = blockSize;
+	block->memoryTypeIndex = memoryTypeIndex;
+	block->isLinear = isLinear;
+	block->mappedData = mappedData;
+	block->flBitmap = 0;
+	std::fill(block->slBitmaps, block->slBitmaps + MEMORY_BLOCK_FL_COUNT, 0u);
+	std::fill(&block->freeHeads[0][0], &block->freeHeads[0][0] + MEMORY_BLOCK_FL_COUNT * MEMORY_BLOCK_SL_COUNT, INVALID_REGION);
+	block->usedBytes = 0;
+	block->allocationCount = 0;
+	insert_free_region(block.get(), create_region(block.get(), 0, blockSize));
+
+	allocator->blocks[memoryTypeIndex].push_back(std::move(block));
+	return allocator->blocks[memoryTypeIndex].back().get();
+}
+
+void init_device_allocator(const VulkanGlobalContext& vkCtx, const DeviceAllocatorSettings& settings, DeviceAllocator* allocator)
+{
+	assert(allocator);
+	allocator->logicalDevice = vkCtx.logicalDevice;
+	allocator->physicalDevice = vkCtx.physicalDevice;
+	allocator->hasMemoryBudget = vkCtx.hasMemoryBudgetExtension;
+	vkGetPhysicalDeviceMemoryProperties(vkCtx.physicalDevice, &allocator->memoryProps);
+	allocator->settings = settings;
+	allocator->bufferImageGranularity = vkCtx.deviceProps.limits.bufferImageGranularity;
+	allocator->nonCoherentAtomSize = vkCtx.deviceProps.limits.nonCoherentAtomSize;
+	for(uint32_t i = 0; i < VK_MAX_MEMORY_TYPES; i++)
+	{
+		allocator->blocks[i].clear();
+		allocator->dedicatedCounts[i] = 0;
+		allocator->dedicatedBytes[i] = 0;
+	}
+}
+
+void destroy_device_allocator(DeviceAllocator* allocator)
+{
+	assert(allocator);
+	for(uint32_t i = 0; i < VK_MAX_MEMORY_TYPES; i++)
+	{
+		for(std::unique_ptr<MemoryBlock>& block : allocator->blocks[i])
+		{
+			if(block->allocationCount)
+			{
+				magma::log::warn("Memory block of type {} freed with {} live allocations", i, block->allocationCount);
+			}
+			free_memory(allocator, block->memory, block->mappedData != nullptr);
+		}
+		allocator->blocks[i].clear();
+		if(allocator->dedicatedCounts[i])
+		{
+			magma::log::warn("{} dedicated allocations of memory type {} were never freed", allocator->dedicatedCounts[i], i);
+		}
+	}
+}
+
+bool allocate_device_memory(DeviceAllocator* allocator, const VkMemoryRequirements& memRequirements, uint32_t memoryTypeIndex,
+	bool isLinear, DeviceAllocation* out)
+{
+	assert(allocator && out);
+	assert(memoryTypeIndex < allocator->memoryProps.memoryTypeCount);
+	std::lock_guard<std::mutex> lock(allocator->mutex);
+
+	*out = {};
+	out->allocator = allocator;
+	out->memoryTypeIndex = memoryTypeIndex;
+	out->size = memRequirements.size;
+
+	const VkDeviceSize dedicatedThreshold = std::min(allocator->settings.dedicatedThreshold, get_block_size(*allocator, memoryTypeIndex) / 2);
+	if(memRequirements.size >= dedicatedThreshold)
+	{
+		uint8_t* mappedData = nullptr;
+		out->memory = allocate_memory(allocator, memRequirements.size, memoryTypeIndex, &mappedData);
+		if(out->memory == VK_NULL_HANDLE)
+		{
+			magma::log::error("Failed to allocate {} bytes of dedicated memory", memRequirements.size);
+			return false;
+		}
+		out->mappedData = mappedData;
+		allocator->dedicatedCounts[memoryTypeIndex]++;
+		allocator->dedicatedBytes[memoryTypeIndex] += memRequirements.size;
+		return true;
+	}
+
+	//non coherent ranges are flushed in whole atoms, which must not spill into neighbouring allocations
+	VkDeviceSize alignment = std::max<VkDeviceSize>(memRequirements.alignment, 1);
+	VkDeviceSize size = memRequirements.size;
+	const VkMemoryPropertyFlags propertyFlags = allocator->memoryProps.memoryTypes[memoryTypeIndex].propertyFlags;
+	if((propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) && !(propertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT))
+	{
+		alignment = std::max(alignment, allocator->nonCoherentAtomSize);
+		size = align_up(size, allocator->nonCoherentAtomSize);
+	}
+
+	//buffers and optimal images sharing a granularity page may alias, keeping them in separate blocks avoids that
+	const bool separateKinds = allocator->bufferImageGranularity > 1;
+	for(std::unique_ptr<MemoryBlock>& block : allocator->blocks[memoryTypeIndex])
+	{
+		if(separateKinds && block->isLinear != isLinear)
+		{
+			continue;
+		}
+		if(allocate_from_block(block.get(), size, alignment, &out->region, &out->offset))
+		{
+			out->block = block.get();
+			break;
+		}
+	}
+
+	if(!out->block)
+	{
+		MemoryBlock* block = create_memory_block(allocator, memoryTypeIndex, isLinear);
+		if(!block || !allocate_from_block(block, size, alignment, &out->region, &out->offset))
+		{
+			magma::log::error("Failed to allocate {} bytes from memory type {}", memRequirements.size, memoryTypeIndex);
+			return false;
+		}
+		out->block = block;
+	}
+
+	out->memory = out->block->memory;
+	out->mappedData = out->block->mappedData ? out->block->mappedData + out->offset : nullptr;
+	return true;
+}
+
+void free_device_memory(DeviceAllocation* allocation)
+{
+	assert(allocation);
+	if(!allocation->allocator)
+	{
+		return;
+	}
+	DeviceAllocator* allocator = allocation->allocator;
+	std::lock_guard<std::mutex> lock(allocator->mutex);
+
+	const uint32_t memoryTypeIndex = allocation->memoryTypeIndex;
+	if(!allocation->block)
+	{
+		free_memory(allocator, allocation->memory, allocation->mappedData != nullptr);
+		allocator->dedicatedCounts[memoryTypeIndex]--;
+		allocator->dedicatedBytes[memoryTypeIndex] -= allocation->size;
+		*allocation = {};
+		return;
+	}
+
+	MemoryBlock* block = allocation->block;
+	free_from_block(block, allocation->region);
+	*allocation = {};
+
+	//one empty block per type is kept around so alternating create and destroy doesn't hit vkAllocateMemory
+	std::vector<std::unique_ptr<MemoryBlock>>& blocks = allocator->blocks[memoryTypeIndex];
+	if(block->allocationCount || blocks.size() == 1)
+	{
+		return;
+	}
+	auto it = std::find_if(blocks.begin(), blocks.end(), [block](const std::unique_ptr<MemoryBlock>& other) { return other.get() == block; });
+	assert(it != blocks.end());
+	free_memory(allocator, block->memory, block->mappedData != nullptr);
+	blocks.erase(it);
+}
+
+bool is_host_coherent(const DeviceAllocation& allocation)
+{
+	assert(allocation.allocator);
+	const VkMemoryPropertyFlags propertyFlags = allocation.allocator->memoryProps.memoryTypes[allocation.memoryTypeIndex].propertyFlags;
+	return propertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+}
+
+VkMappedMemoryRange get_mapped_memory_range(const DeviceAllocation& allocation, VkDeviceSize offset, VkDeviceSize size)
+{
+	assert(allocation.allocator);
+	assert(offset + size <= allocation.size);
+	const VkDeviceSize atomSize = allocation.allocator->nonCoherentAtomSize;
+	const VkDeviceSize begin = (allocation.offset + offset) / atomSize * atomSize;
+	const VkDeviceSize end = align_up(allocation.offset + offset + size, atomSize);
+
+	VkMappedMemoryRange range = {};
+	range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+	range.pNext = nullptr;
+	range.memory = allocation.memory;
+	range.offset = begin;
+	//block ranges of non coherent types are padded to whole atoms, dedicated memory may end mid atom
+	range.size = !allocation.block && end > allocation.size ? VK_WHOLE_SIZE : end - begin;
+	return range;
+}
+
+static uint32_t count_bits(uint32_t value)
+{
+	uint32_t count = 0;
+	for(; value; value &= value - 1)
+	{
+		count++;
+	}
+	return count;
+}
+
+//more than any combination of flags adds up to
+static constexpr uint32_t OVER_BUDGET_COST = 64;
+
+bool select_memory_type(const VkPhysicalDeviceMemoryProperties& memoryProps, const MemoryHeapBudget* budget, uint32_t memoryTypeBits,
+	const MemoryTypeRequest& request, VkDeviceSize size, uint32_t* memoryTypeIndex)
+{
+	assert(memoryTypeIndex);
+	//lazily allocated memory only backs transient attachments
+	const VkMemoryPropertyFlags avoided = request.avoided |
+		(VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT & ~(request.required | request.preferred));
+
+	uint32_t bestCost = UINT32_MAX;
+	for(uint32_t i = 0; i < memoryProps.memoryTypeCount; i++)
+	{
+		const VkMemoryType& memoryType = memoryProps.memoryTypes[i];
+		if(!(memoryTypeBits & (1u << i)) || (memoryType.propertyFlags & request.required) != request.required)
+		{
+			continue;
+		}
+		if((memoryType.propertyFlags & VK_MEMORY_PROPERTY_PROTECTED_BIT) && !(request.required & VK_MEMORY_PROPERTY_PROTECTED_BIT))
+		{
+			continue;
+		}
+
+		uint32_t cost = count_bits(request.preferred & ~memoryType.propertyFlags) + count_bits(avoided & memoryType.propertyFlags);
+		if(budget && budget->usage[memoryType.heapIndex] + size > budget->budget[memoryType.heapIndex])
+		{
+			cost += OVER_BUDGET_COST;
+		}
+		//types are listed fastest first, so ties keep the earlier one
+		if(cost < bestCost)
+		{
+			bestCost = cost;
+			*memoryTypeIndex = i;
+		}
+	}
+	return bestCost != UINT32_MAX;
+}
+
+MemoryTypeRequest get_memory_type_request(VkMemoryPropertyFlags requiredFlags)
+{
+	MemoryTypeRequest request = {};
+	request.required = requiredFlags;
+	if(!(requiredFlags & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT) && (requiredFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT))
+	{
+		request.avoided = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+	}
+	else if((requiredFlags & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT) && !(requiredFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT))
+	{
+		request.avoided = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+	}
+	return request;
+}
+
+void get_memory_heap_budget(DeviceAllocator* allocator, MemoryHeapBudget* out)
+{
+	assert(allocator && out);
+	*out = {};
+	const VkPhysicalDeviceMemoryProperties& memoryProps = allocator->memoryProps;
+	if(allocator->hasMemoryBudget)
+	{
+		VkPhysicalDeviceMemoryBudgetPropertiesEXT budgetProps = {};
+		budgetProps.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+		budgetProps.pNext = nullptr;
+
+		VkPhysicalDeviceMemoryProperties2KHR memoryProps2 = {};
+		memoryProps2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2_KHR;
+		memoryProps2.pNext = &budgetProps;
+		vkGetPhysicalDeviceMemoryProperties2KHR(allocator->physicalDevice, &memoryProps2);
+
+		for(uint32_t i = 0; i < memoryProps.memoryHeapCount; i++)
+		{
+			out->usage[i] = budgetProps.heapUsage[i];
+			out->budget[i] = budgetProps.heapBudget[i];
+		}
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock(allocator->mutex);
+	for(uint32_t i = 0; i < memoryProps.memoryTypeCount; i++)
+	{
+		const uint32_t heapIndex = memoryProps.memoryTypes[i].heapIndex;
+		for(const std::unique_ptr<MemoryBlock>& block : allocator->blocks[i])
+		{
+			out->usage[heapIndex] += block->size;
+		}
+		out->usage[heapIndex] += allocator->dedicatedBytes[i];
+	}
+	for(uint32_t i = 0; i < memoryProps.memoryHeapCount; i++)
+	{
+		out->budget[i] = memoryProps.memoryHeaps[i].size / 10 * 8;
+	}
+}
+
+bool find_memory_type(DeviceAllocator* allocator, uint32_t memoryTypeBits, const MemoryTypeRequest& request, VkDeviceSize size,
+	uint32_t* memoryTypeIndex)
+{
+	assert(allocator);
+	MemoryHeapBudget budget = {};
+	get_memory_heap_budget(allocator, &budget);
+	if(!select_memory_type(allocator->memoryProps, &budget, memoryTypeBits, request, size, memoryTypeIndex))
+	{
+		magma::log::error("No memory type has all of required flags {}", request.required);
+		return false;
+	}
+	return true;
+}
+
+void get_device_allocator_stats(DeviceAllocator* allocator, DeviceAllocatorStats* out)
+{
+	assert(allocator && out);
+	std::lock_guard<std::mutex> lock(allocator->mutex);
+
+	*out = {};
+	for(uint32_t i = 0; i < allocator->memoryProps.memoryTypeCount; i++)
+	{
+		MemoryTypeStats& stats = out->memoryTypes[i];
+		for(const std::unique_ptr<MemoryBlock>& block : allocator->blocks[i])
+		{
+			stats.blockCount++;
+			stats.allocationCount += block->allocationCount;
+			stats.blockBytes += block->size;
+			stats.usedBytes += block->usedBytes;
+		}
+		stats.dedicatedCount = allocator->dedicatedCounts[i];
+		stats.dedicatedBytes = allocator->dedicatedBytes[i];
+
+		out->total.blockCount += stats.blockCount;
+		out->total.allocationCount += stats.allocationCount;
+		out->total.dedicatedCount += stats.dedicatedCount;
+		out->total.blockBytes += stats.blockBytes;
+		out->total.usedBytes += stats.usedBytes;
+		out->total.dedicatedBytes += stats.dedicatedBytes;
+	}
+}
+
+void log_device_allocator_stats(DeviceAllocator* allocator)
+{
+	DeviceAllocatorStats stats = {};
+	get_device_allocator_stats(allocator, &stats);
+	for(uint32_t i = 0; i < allocator->memoryProps.memoryTypeCount; i++)
+	{
+		const MemoryTypeStats& typeStats = stats.memoryTypes[i];
+		if(!typeStats.blockCount && !typeStats.dedicatedCount)
+		{
+			continue;
+		}
+		magma::log::info("Memory type {}: {} allocations using {} of {} bytes in {} blocks, {} dedicated allocations of {} bytes",
+			i, typeStats.allocationCount, typeStats.usedBytes, typeStats.blockBytes, typeStats.blockCount,
+			typeStats.dedicatedCount, typeStats.dedicatedBytes);
+	}
+	MemoryHeapBudget budget = {};
+	get_memory_heap_budget(allocator, &budget);
+	for(uint32_t i = 0; i < allocator->memoryProps.memoryHeapCount; i++)
+	{
+		magma::log::info("Memory heap {}: {} of {} bytes budget in use", i, budget.usage[i], budget.budget[i]);
+	}
+	magma::log::info("Device memory: {} allocations, {} bytes used of {} bytes in blocks, {} bytes dedicated, {} vkAllocateMemory calls alive",
+		stats.total.allocationCount + stats.total.dedicatedCount, stats.total.usedBytes, stats.total.blockBytes,
+		stats.total.dedicatedBytes, stats.total.blockCount + stats.total.dedicatedCount);
+}
@@ -0,0 +1,126 @@
+#ifndef MAGMA_VK_ALLOCATOR_H
+#define MAGMA_VK_ALLOCATOR_H
+
+#include "vk_types.h"
+
+#include <memory>
+#include <mutex>
+#include <vector>
+
+static constexpr VkDeviceSize DEFAULT_MEMORY_BLOCK_SIZE = 64ull << 20;
+static constexpr uint32_t MEMORY_BLOCK_FL_COUNT = 64;//first level: power of two size classes
+static constexpr uint32_t MEMORY_BLOCK_SL_LOG2 = 4;//second level: each class split linearly into 16 lists
+static constexpr uint32_t MEMORY_BLOCK_SL_COUNT = 1u << MEMORY_BLOCK_SL_LOG2;
+
+struct DeviceAllocatorSettings
+{
+	VkDeviceSize blockSize = DEFAULT_MEMORY_BLOCK_SIZE;//clamped to an eighth of the heap for small heaps
+	VkDeviceSize dedicatedThreshold = DEFAULT_MEMORY_BLOCK_SIZE / 2;//resources this large get their own VkDeviceMemory
+};
+
+//free or used range of a block, neighbours by address are linked so freed ranges merge back
+struct MemoryRegion
+{
+	VkDeviceSize offset;
+	VkDeviceSize size;
+	uint32_t prevPhysical;
+	uint32_t nextPhysical;
+	uint32_t prevFree;
+	uint32_t nextFree;
+	bool isFree;
+};
+
+//one VkDeviceMemory sub-allocated with a two level segregated fit (TLSF) free list
+struct MemoryBlock
+{
+	VkDeviceMemory memory;
+	VkDeviceSize size;
+	uint32_t memoryTypeIndex;
+	bool isLinear;//only holds buffers or only images when bufferImageGranularity forces them apart
+	uint8_t* mappedData;//whole block stays mapped for host visible types
+	std::vector<MemoryRegion> regions;
+	std::vector<uint32_t> unusedRegions;//slots of merged regions for reuse
+	uint64_t flBitmap;
+	uint32_t slBitmaps[MEMORY_BLOCK_FL_COUNT];
+	uint32_t freeHeads[MEMORY_BLOCK_FL_COUNT][MEMORY_BLOCK_SL_COUNT];
+	VkDeviceSize usedBytes;
+	uint32_t allocationCount;
+};
+
+struct MemoryTypeStats
+{
+	uint32_t blockCount;
+	uint32_t allocationCount;
+	uint32_t dedicatedCount;
+	VkDeviceSize blockBytes;
+	VkDeviceSize usedBytes;//of block bytes
+	VkDeviceSize dedicatedBytes;
+};
+
+struct DeviceAllocatorStats
+{
+	MemoryTypeStats memoryTypes[VK_MAX_MEMORY_TYPES];
+	MemoryTypeStats total;
+};
+
+//what the process uses of every heap and how much it may use, from VK_EXT_memory_budget when the device has it
+struct MemoryHeapBudget
+{
+	VkDeviceSize usage[VK_MAX_MEMORY_HEAPS];
+	VkDeviceSize budget[VK_MAX_MEMORY_HEAPS];
+};
+
+struct DeviceAllocator
+{
+	VkDevice logicalDevice;
+	VkPhysicalDevice physicalDevice;
+	bool hasMemoryBudget;
+	VkPhysicalDeviceMemoryProperties memoryProps;
+	DeviceAllocatorSettings settings;
+	VkDeviceSize bufferImageGranularity;
+	VkDeviceSize nonCoherentAtomSize;
+	std::mutex mutex;
+	std::vector<std::unique_ptr<MemoryBlock>> blocks[VK_MAX_MEMORY_TYPES];
+	uint32_t dedicatedCounts[VK_MAX_MEMORY_TYPES];
+	VkDeviceSize dedicatedBytes[VK_MAX_MEMORY_TYPES];
+};
+
+void init_device_allocator(const VulkanGlobalContext& vkCtx, const DeviceAllocatorSettings& settings, DeviceAllocator* allocator);
+
+//frees every block, allocations still alive are reported as leaks
+void destroy_device_allocator(DeviceAllocator* allocator);
+
+//isLinear is true for buffers and linear tiled images, false for optimal tiled images
+bool allocate_device_memory(DeviceAllocator* allocator, const VkMemoryRequirements& memRequirements, uint32_t memoryTypeIndex,
+	bool isLinear, DeviceAllocation* out);
+
+void free_device_memory(DeviceAllocation* allocation);
+
+//whether host writes through mappedData are visible to the device without a flush
+bool is_host_coherent(const DeviceAllocation& allocation);
+
+//[offset, offset + size) of the allocation widened to whole nonCoherentAtomSize atoms, ready for vkFlushMappedMemoryRanges
+VkMappedMemoryRange get_mapped_memory_range(const DeviceAllocation& allocation, VkDeviceSize offset, VkDeviceSize size);
+
+//cheapest memory type allowed by memoryTypeBits that has every required flag. Each missing preferred flag and each
+//present avoided flag costs one, a heap without budget left for size costs more than all of them so it's only picked
+//when nothing else fits. Protected types are never picked unless required. budget may be null
+bool select_memory_type(const VkPhysicalDeviceMemoryProperties& memoryProps, const MemoryHeapBudget* budget, uint32_t memoryTypeBits,
+	const MemoryTypeRequest& request, VkDeviceSize size, uint32_t* memoryTypeIndex);
+
+//request for a plain set of required flags. Host visible memory stays out of device local heaps and device local
+//memory avoids host visible types, so small BAR heaps are left for what is written from the cpu directly
+MemoryTypeRequest get_memory_type_request(VkMemoryPropertyFlags requiredFlags);
+
+//without the extension usage is what the allocator holds and budget 80% of every heap
+void get_memory_heap_budget(DeviceAllocator* allocator, MemoryHeapBudget* out);
+
+//select_memory_type against the current budget of the allocator's device
+bool find_memory_type(DeviceAllocator* allocator, uint32_t memoryTypeBits, const MemoryTypeRequest& request, VkDeviceSize size,
+	uint32_t* memoryTypeIndex);
+
+void get_device_allocator_stats(DeviceAllocator* allocator, DeviceAllocatorStats* out);
+
+void log_device_allocator_stats(DeviceAllocator* allocator);
+
+#endif
@@ -1,5 +1,6 @@
 #include "vk_boilerplate.h"
 #include "vk_loader.h"
+#include "vk_allocator.h"
 #include "vk_dbg.h"
 #include "logging.h"
 #include <vector>
@@ -11,6 +12,23 @@ const char *desiredDeviceExtensions[] = {
 };
 const uint32_t deviceExtSize = sizeof(desiredDeviceExtensions)/sizeof(desiredDeviceExtensions[0]);
 
+static bool has_instance_extension(const char* extensionName)
+{
+	uint32_t extCount = {};
+	vkEnumerateInstanceExtensionProperties(nullptr, &extCount, nullptr);
+	std::vector<VkExtensionProperties> extensions = {};
+	extensions.resize(extCount);
+	vkEnumerateInstanceExtensionProperties(nullptr, &extCount, extensions.data());
+	for(auto& extension : extensions)
+	{
+		if(!strcmp(extensionName, extension.extensionName))
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
 static VkBool32 request_layers_and_extensions(const std::vector<const char*>& desiredExtensions, const std::vector<const char*>& desiredLayers)
 {
 	
@@ -195,6 +213,12 @@ static uint32_t get_dedicated_compute_queue(VkPhysicalDevice physicalDevice)
 	return find_queue_family_index(physicalDevice, VK_QUEUE_COMPUTE_BIT, VK_QUEUE_GRAPHICS_BIT);
 }
 
+//copy engine family, runs uploads alongside graphics work
+static uint32_t get_dedicated_transfer_queue(VkPhysicalDevice physicalDevice)
+{
+	return find_queue_family_index(physicalDevice, VK_QUEUE_TRANSFER_BIT, VK_QUEUE_GRAPHICS_BIT|VK_QUEUE_COMPUTE_BIT);
+}
+
 static VkBool32 pick_queue_index_and_physical_device(VkInstance instance, VkQueueFlags queueFlags, VkPhysicalDeviceType preferredGPUType, VkPhysicalDevice* physicalDevice, uint32_t* queueFamIdx)
 {
 	uint32_t physicalDeviceCount = 0;
@@ -241,7 +265,8 @@ static VkBool32 pick_queue_index_and_physical_device(VkInstance instance, VkQueu
 	return VK_FALSE;
 }
 
-static VkDevice create_logical_device(VkPhysicalDevice physicalDevice, VkQueueFlags requestedQueueTypes)
+//memory budget is enabled when both the device and the instance, through get_physical_device_properties2, support it
+static VkDevice create_logical_device(VkPhysicalDevice physicalDevice, VkQueueFlags requestedQueueTypes, bool hasProperties2Ext, bool* hasMemoryBudgetExt)
 {
 	uint32_t deviceExtCount = {};
 	vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &deviceExtCount, nullptr);
@@ -274,6 +299,17 @@ static VkDevice create_logical_device(VkPhysicalDevice physicalDevice, VkQueueFl
 		return VK_NULL_HANDLE;
 	}
 
+	std::vector<const char*> enabledDeviceExtensions(desiredDeviceExtensions, desiredDeviceExtensions + deviceExtSize);
+	*hasMemoryBudgetExt = false;
+	for(auto& availableExt : deviceExt)
+	{
+		if(hasProperties2Ext && !strcmp(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME, availableExt.extensionName))
+		{
+			enabledDeviceExtensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+			*hasMemoryBudgetExt = true;
+		}
+	}
+
 	std::vector<VkDeviceQueueCreateInfo> queueCreateInfos = {};
 	const float queuePriority = 1.f;
 
@@ -310,6 +346,23 @@ static VkDevice create_logical_device(VkPhysicalDevice physicalDevice, VkQueueFl
 			queueCreateInfos.push_back(queueCreateInfo);
 		}
 	}
+
+	if(requestedQueueTypes & VK_QUEUE_TRANSFER_BIT)
+	{
+		//graphics queue takes transfers itself when there is no dedicated family
+		uint32_t transferQueueFamIndex = get_dedicated_transfer_queue(physicalDevice);
+		if(transferQueueFamIndex != VK_QUEUE_FAMILY_IGNORED)
+		{
+			VkDeviceQueueCreateInfo queueCreateInfo = {};
+			queueCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+			queueCreateInfo.pNext = nullptr;
+			queueCreateInfo.flags = VK_FLAGS_NONE;
+			queueCreateInfo.queueFamilyIndex = transferQueueFamIndex;
+			queueCreateInfo.queueCount = 1;
+			queueCreateInfo.pQueuePriorities = &queuePriority;
+			queueCreateInfos.push_back(queueCreateInfo);
+		}
+	}
 	
 	VkPhysicalDeviceFeatures deviceFeatures = {};
 	vkGetPhysicalDeviceFeatures(physicalDevice, &deviceFeatures);
@@ -322,8 +375,8 @@ static VkDevice create_logical_device(VkPhysicalDevice physicalDevice, VkQueueFl
 	deviceCreateInfo.pQueueCreateInfos = queueCreateInfos.data();
 	deviceCreateInfo.enabledLayerCount = 0;
 	deviceCreateInfo.ppEnabledLayerNames = nullptr;
-	deviceCreateInfo.enabledExtensionCount = deviceExtSize;
-	deviceCreateInfo.ppEnabledExtensionNames = desiredDeviceExtensions;
+	deviceCreateInfo.enabledExtensionCount = enabledDeviceExtensions.size();
+	deviceCreateInfo.ppEnabledExtensionNames = enabledDeviceExtensions.data();
 	deviceCreateInfo.pEnabledFeatures = &deviceFeatures;
 
 	VkDevice logicalDevice = VK_NULL_HANDLE;
@@ -383,6 +436,18 @@ bool init_vulkan_context(
 		desiredExtensions.push_back(requiredExtStrings[i]);
 	}
 
+	//memory budget is queried through vkGetPhysicalDeviceMemoryProperties2KHR on a 1.0 instance
+	bool hasProperties2Ext = false;
+	for(auto&& extension : desiredExtensions)
+	{
+		hasProperties2Ext |= !strcmp(extension, VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
+	}
+	if(!hasProperties2Ext && has_instance_extension(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME))
+	{
+		desiredExtensions.push_back(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
+		hasProperties2Ext = true;
+	}
+
 	VK_CHECK(request_layers_and_extensions(desiredExtensions, desiredLayers));
 	
 	VkInstance instance = create_instance(desiredLayers, desiredExtensions, hasDebugUtilsExt);
@@ -407,9 +472,12 @@ bool init_vulkan_context(
 	);
 	assert(graphicsQueueFamilyIdx >= 0);
 
+	bool hasMemoryBudgetExt = false;
 	VkDevice logicalDevice = create_logical_device(
 		physicalDevice,
-		VK_QUEUE_GRAPHICS_BIT|VK_QUEUE_COMPUTE_BIT
+		VK_QUEUE_GRAPHICS_BIT|VK_QUEUE_COMPUTE_BIT|VK_QUEUE_TRANSFER_BIT,
+		hasProperties2Ext,
+		&hasMemoryBudgetExt
 	);
 
 	load_device_function_pointers(logicalDevice);
@@ -429,6 +497,19 @@ bool init_vulkan_context(
 	{
 		computeQueue = graphicsQueue;
 	}
+
+	uint32_t transferQueueFamilyIndex = get_dedicated_transfer_queue(physicalDevice);
+	VkQueue transferQueue = VK_NULL_HANDLE;
+	if(transferQueueFamilyIndex != VK_QUEUE_FAMILY_IGNORED)
+	{
+		vkGetDeviceQueue(logicalDevice, transferQueueFamilyIndex, 0, &transferQueue);
+		assert(transferQueue != VK_NULL_HANDLE);
+	}
+	else
+	{
+		transferQueueFamilyIndex = graphicsQueueFamilyIdx;
+		transferQueue = graphicsQueue;
+	}
 	
 	VkPhysicalDeviceProperties deviceProps = {};
 	vkGetPhysicalDeviceProperties(physicalDevice, &deviceProps);
@@ -441,8 +522,13 @@ bool init_vulkan_context(
 	generalInfo->computeQueueFamIdx = computeQueueFamilyIndex;
 	generalInfo->graphicsQueue = graphicsQueue;
 	generalInfo->computeQueue = computeQueue;
+	generalInfo->transferQueueFamIdx = transferQueueFamilyIndex;
+	generalInfo->transferQueue = transferQueue;
 	generalInfo->deviceProps = deviceProps;
 	generalInfo->hasDebugUtilsExtension = hasDebugUtilsExt;
+	generalInfo->hasMemoryBudgetExtension = hasMemoryBudgetExt;
+	generalInfo->allocator = new DeviceAllocator;
+	init_device_allocator(*generalInfo, {}, generalInfo->allocator);
 	uint32_t pushConstantSize = deviceProps.limits.maxPushConstantsSize;
 	return true;
 }
@@ -454,6 +540,11 @@ void destroy_vulkan_context(VulkanGlobalContext* ctx)
 		vkDestroyDebugUtilsMessengerEXT(ctx->instance, ctx->debugCallback, nullptr);
 	}
 
+	log_device_allocator_stats(ctx->allocator);
+	destroy_device_allocator(ctx->allocator);
+	delete ctx->allocator;
+	ctx->allocator = nullptr;
+
 	vkDestroyDevice(ctx->logicalDevice, nullptr);
 	vkDestroyInstance(ctx->instance, nullptr);
 }
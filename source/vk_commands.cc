@@ -1,13 +1,13 @@
 #include "vk_commands.h"
 
-VkCommandPool create_command_pool(const VulkanGlobalContext& vkCtx, VkCommandPoolCreateFlags commandPoolFlags)
+VkCommandPool create_command_pool(const VulkanGlobalContext& vkCtx, VkCommandPoolCreateFlags commandPoolFlags, uint32_t queueFamilyIndex)
 {
 	//creating command buffer for transfer operation
 	VkCommandPoolCreateInfo cmdPoolCreateInfo = {};
 	cmdPoolCreateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
 	cmdPoolCreateInfo.pNext = nullptr;
 	cmdPoolCreateInfo.flags = commandPoolFlags;
-	cmdPoolCreateInfo.queueFamilyIndex = vkCtx.queueFamIdx;
+	cmdPoolCreateInfo.queueFamilyIndex = queueFamilyIndex == VK_QUEUE_FAMILY_IGNORED ? vkCtx.queueFamIdx : queueFamilyIndex;
 
 	VkCommandPool commandPool = VK_NULL_HANDLE;
 	VK_CALL(vkCreateCommandPool(vkCtx.logicalDevice, &cmdPoolCreateInfo, nullptr, &commandPool));
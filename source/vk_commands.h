@@ -4,7 +4,9 @@
 #include "vk_types.h"
 #include "vk_dbg.h"
 
-VkCommandPool create_command_pool(const VulkanGlobalContext& vkCtx, VkCommandPoolCreateFlags commandPoolFlags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT);
+//pool for the graphics family unless queueFamilyIndex says otherwise
+VkCommandPool create_command_pool(const VulkanGlobalContext& vkCtx, VkCommandPoolCreateFlags commandPoolFlags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
+	uint32_t queueFamilyIndex = VK_QUEUE_FAMILY_IGNORED);
 
 void create_command_buffers(VkDevice logicalDevice, VkCommandPool commandPool, uint32_t count, std::vector<VkCommandBuffer>& out);
 
@@ -1,9 +1,13 @@
 #include "vk_resource.h"
+#include "vk_allocator.h"
 #include "vk_dbg.h"
 #include "vk_boilerplate.h"
 #include "vk_commands.h"
+#include "logging.h"
 
+#include <algorithm>
 #include <array>
+#include <vector>
 
 static VkImageAspectFlags get_image_aspect_from_usage(VkImageUsageFlags usageFlags)
 {
@@ -19,7 +23,43 @@ static VkImageAspectFlags get_image_aspect_from_usage(VkImageUsageFlags usageFla
 	return aspectFlags;
 }
 
-ImageResource create_image_resource(const VulkanGlobalContext& vkCtx, VkExtent3D imageExtent, VkFormat imageFormat, VkImageUsageFlags usageFlags, VkImageLayout initialLayout)
+uint32_t get_mip_level_count(VkExtent3D imageExtent)
+{
+	uint32_t levelCount = 1;
+	for(uint32_t size = std::max(imageExtent.width, imageExtent.height); size > 1; size >>= 1)
+	{
+		levelCount++;
+	}
+	return levelCount;
+}
+
+bool supports_linear_blit(const VulkanGlobalContext& vkCtx, VkFormat imageFormat)
+{
+	VkFormatProperties formatProps = {};
+	vkGetPhysicalDeviceFormatProperties(vkCtx.physicalDevice, imageFormat, &formatProps);
+	const VkFormatFeatureFlags required = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT |
+		VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+	return (formatProps.optimalTilingFeatures & required) == required;
+}
+
+//optimal tiled images are sub-allocated from device local blocks
+static bool bind_image_memory(const VulkanGlobalContext& vkCtx, VkImage image, DeviceAllocation* out)
+{
+	VkMemoryRequirements memRequirements = {};
+	vkGetImageMemoryRequirements(vkCtx.logicalDevice, image, &memRequirements);
+
+	uint32_t preferredMemTypeIndex = -1;
+	if(!find_memory_type(vkCtx.allocator, memRequirements.memoryTypeBits, get_memory_type_request(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT),
+			memRequirements.size, &preferredMemTypeIndex) ||
+		!allocate_device_memory(vkCtx.allocator, memRequirements, preferredMemTypeIndex, false, out))
+	{
+		return false;
+	}
+	VK_CALL(vkBindImageMemory(vkCtx.logicalDevice, image, out->memory, out->offset));
+	return true;
+}
+
+ImageResource create_image_resource(const VulkanGlobalContext& vkCtx, VkExtent3D imageExtent, VkFormat imageFormat, VkImageUsageFlags usageFlags, VkImageLayout initialLayout, uint32_t mipLevels)
 {
 	VkImageCreateInfo imageCreateInfo = {};
 	imageCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
@@ -28,7 +68,7 @@ ImageResource create_image_resource(const VulkanGlobalContext& vkCtx, VkExtent3D
 	imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
 	imageCreateInfo.format = imageFormat;
 	imageCreateInfo.extent = imageExtent;
-	imageCreateInfo.mipLevels = 1;
+	imageCreateInfo.mipLevels = mipLevels;
 	imageCreateInfo.arrayLayers = 1;
 	imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
 	imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
@@ -43,24 +83,8 @@ ImageResource create_image_resource(const VulkanGlobalContext& vkCtx, VkExtent3D
 	VkImage image = VK_NULL_HANDLE;
 	VK_CALL(vkCreateImage(vkCtx.logicalDevice, &imageCreateInfo, nullptr, &image));
 
-	VkMemoryRequirements memRequirements = {};
-	vkGetImageMemoryRequirements(vkCtx.logicalDevice, image, &memRequirements);
-	VkPhysicalDeviceMemoryProperties deviceMemProps = {};
-	vkGetPhysicalDeviceMemoryProperties(vkCtx.physicalDevice, &deviceMemProps);
-
-	uint32_t preferredMemTypeIndex = -1;
-	find_required_memtype_index(vkCtx.physicalDevice, memRequirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &preferredMemTypeIndex);
-
-	VkMemoryAllocateInfo memAllocInfo = {};
-	memAllocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-	memAllocInfo.pNext = nullptr;
-	memAllocInfo.allocationSize = memRequirements.size;
-	memAllocInfo.memoryTypeIndex = preferredMemTypeIndex;
-
-	VkDeviceMemory imageMemory = {};
-	VK_CALL(vkAllocateMemory(vkCtx.logicalDevice, &memAllocInfo, nullptr, &imageMemory));
-
-	VK_CALL(vkBindImageMemory(vkCtx.logicalDevice, image, imageMemory, 0));
+	DeviceAllocation imageMemory = {};
+	VK_CHECK(bind_image_memory(vkCtx, image, &imageMemory));
 
 	VkImageViewCreateInfo imageViewCreateInfo = {};
 	imageViewCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
@@ -71,7 +95,7 @@ ImageResource create_image_resource(const VulkanGlobalContext& vkCtx, VkExtent3D
 	imageViewCreateInfo.format = imageFormat;
 	imageViewCreateInfo.subresourceRange.aspectMask = get_image_aspect_from_usage(usageFlags);
 	imageViewCreateInfo.subresourceRange.baseMipLevel = 0;
-	imageViewCreateInfo.subresourceRange.levelCount = 1;
+	imageViewCreateInfo.subresourceRange.levelCount = mipLevels;
 	imageViewCreateInfo.subresourceRange.baseArrayLayer = 0;
 	imageViewCreateInfo.subresourceRange.layerCount = 1;
 
@@ -82,20 +106,22 @@ ImageResource create_image_resource(const VulkanGlobalContext& vkCtx, VkExtent3D
 	imageResource.image = image;
 	imageResource.view = imageView;
 	imageResource.layout = initialLayout;
-	imageResource.imageSize = memAllocInfo.allocationSize;
-	imageResource.backupMemory = imageMemory;
+	imageResource.imageSize = imageMemory.size;
+	imageResource.allocation = imageMemory;
 	imageResource.format = imageFormat;
+	imageResource.mipLevels = mipLevels;
+	imageResource.layerCount = 1;
 	return imageResource;
 }
 
 
-VkSampler create_default_sampler(VkDevice logicalDevice, bool* status)
+VkSampler create_default_sampler(VkDevice logicalDevice, bool* status, uint32_t mipLevels)
 {
 	VkSamplerCreateInfo samplerCreateInfo = {};
 	samplerCreateInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
 	samplerCreateInfo.magFilter = VK_FILTER_LINEAR;
 	samplerCreateInfo.minFilter = VK_FILTER_LINEAR;
-	samplerCreateInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+	samplerCreateInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
 	samplerCreateInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
 	samplerCreateInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
 	samplerCreateInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
@@ -104,7 +130,7 @@ VkSampler create_default_sampler(VkDevice logicalDevice, bool* status)
 	samplerCreateInfo.compareEnable = VK_FALSE;
 	samplerCreateInfo.compareOp = VK_COMPARE_OP_NEVER;
 	samplerCreateInfo.minLod = 0.f;
-	samplerCreateInfo.maxLod = 1.f;
+	samplerCreateInfo.maxLod = static_cast<float>(mipLevels);
 	samplerCreateInfo.borderColor = VK_BORDER_COLOR_FLOAT_TRANSPARENT_BLACK;
 	samplerCreateInfo.unnormalizedCoordinates = VK_FALSE;
 	
@@ -128,19 +154,11 @@ bool find_required_memtype_index(
 	VkPhysicalDeviceMemoryProperties deviceMemProps = {};
 	vkGetPhysicalDeviceMemoryProperties(physicalDevice, &deviceMemProps);
 
-	uint32_t resourceMemTypeBits = resourceMemoryRequirements.memoryTypeBits;
-	for(uint32_t i = 0; i < deviceMemProps.memoryTypeCount; i++)
+	//every desired flag has to be there, the cheapest type having them wins
+	if(select_memory_type(deviceMemProps, nullptr, resourceMemoryRequirements.memoryTypeBits,
+		get_memory_type_request(desiredMemoryFlags), resourceMemoryRequirements.size, memoryTypeIndex))
 	{
-		//check if device supports resource memory type
-		if(resourceMemTypeBits & (1 << i))
-		{
-			//check if user desired memory properties are supported(eg DEVICE_LOCAL)
-			if(deviceMemProps.memoryTypes[i].propertyFlags & desiredMemoryFlags)
-			{
-				*memoryTypeIndex = i;
-				return true;
-			}
-		}
+		return true;
 	}
 	
 	magma::log::error("Failed to find memory type index!");
@@ -152,6 +170,15 @@ Buffer create_buffer(
 	VkBufferUsageFlags 			usageFlags,
 	VkMemoryPropertyFlags		requiredMemProperties,
 	std::size_t					size)
+{
+	return create_buffer(vkCtx, usageFlags, get_memory_type_request(requiredMemProperties), size);
+}
+
+Buffer create_buffer(
+	const VulkanGlobalContext&	vkCtx,
+	VkBufferUsageFlags 			usageFlags,
+	const MemoryTypeRequest&	memoryRequest,
+	std::size_t					size)
 {
 	Buffer buffer = {};
 
@@ -169,33 +196,27 @@ Buffer create_buffer(
 	VkBuffer bufferHandle = VK_NULL_HANDLE;
 	VK_CALL(vkCreateBuffer(vkCtx.logicalDevice, &bufferCreateInfo, nullptr, &bufferHandle)); 
 
-	VkPhysicalDeviceMemoryProperties memProps = {};
-	vkGetPhysicalDeviceMemoryProperties(vkCtx.physicalDevice, &memProps);
-
 	VkMemoryRequirements memReqs = {};
 	vkGetBufferMemoryRequirements(vkCtx.logicalDevice, bufferHandle, &memReqs);
-	uint32_t memTypeBits = memReqs.memoryTypeBits;
 
 	uint32_t memTypeIdx = {};
-	if(!find_required_memtype_index(vkCtx.physicalDevice, memReqs, requiredMemProperties, &memTypeIdx))
+	if(!find_memory_type(vkCtx.allocator, memReqs.memoryTypeBits, memoryRequest, memReqs.size, &memTypeIdx))
 	{
 		magma::log::error("Failed to find memory type index for required buffer usage!");
+		vkDestroyBuffer(vkCtx.logicalDevice, bufferHandle, nullptr);
 		return buffer;
 	}
 
-	VkMemoryAllocateInfo memAllocInfo = {};
-	memAllocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-	memAllocInfo.pNext = nullptr;
-	memAllocInfo.allocationSize = memReqs.size;
-	memAllocInfo.memoryTypeIndex = memTypeIdx;
-
-	VkDeviceMemory backupMemory = VK_NULL_HANDLE;
-	
-	VK_CALL(vkAllocateMemory(vkCtx.logicalDevice, &memAllocInfo, nullptr, &backupMemory));
-	VK_CALL(vkBindBufferMemory(vkCtx.logicalDevice, bufferHandle, backupMemory, 0));
+	DeviceAllocation allocation = {};
+	if(!allocate_device_memory(vkCtx.allocator, memReqs, memTypeIdx, true, &allocation))
+	{
+		vkDestroyBuffer(vkCtx.logicalDevice, bufferHandle, nullptr);
+		return buffer;
+	}
+	VK_CALL(vkBindBufferMemory(vkCtx.logicalDevice, bufferHandle, allocation.memory, allocation.offset));
 	
 	buffer.buffer = bufferHandle;
-	buffer.backupMemory = backupMemory;
+	buffer.allocation = allocation;
 	buffer.bufferSize = size;
 	buffer.alignedSize = memReqs.size;
 	return buffer;
@@ -203,10 +224,10 @@ Buffer create_buffer(
 
 void destroy_buffer(VkDevice logicalDevice, Buffer* buffer)
 {
+	buffer->mappedData = nullptr;
 	vkDestroyBuffer(logicalDevice, buffer->buffer, nullptr);
-	vkFreeMemory(logicalDevice, buffer->backupMemory, nullptr);
+	free_device_memory(&buffer->allocation);
 	buffer->buffer = VK_NULL_HANDLE;
-	buffer->backupMemory = nullptr;
 	buffer->bufferSize = 0;
 }
 
@@ -225,32 +246,41 @@ bool isPowerOfTwo(std::size_t val)
 	return (val & (val - 1)) == 0;
 }
 
-//TODO: incoherent allocations!
 VkResult copy_data_to_host_visible_buffer(const VulkanGlobalContext& vkCtx, VkDeviceSize offset, const void* copyFrom, std::size_t copyByteSize, Buffer* buffer)
 {
-	void* mappedArea = nullptr;
-
-	VK_CALL_RETURN(vkMapMemory(vkCtx.logicalDevice, buffer->backupMemory, offset, copyByteSize, VK_FLAGS_NONE, &mappedArea));
+	//host visible blocks stay mapped, writes go straight to the buffer's range
+	uint8_t* mappedArea = static_cast<uint8_t*>(buffer->allocation.mappedData);
 	if(!mappedArea)
 		return VK_ERROR_MEMORY_MAP_FAILED;
 
-	memcpy(mappedArea, copyFrom, copyByteSize);
+	memcpy(mappedArea + offset, copyFrom, copyByteSize);
 	
-	// explicitly inform the driver that staging buffer contents were modified
-	// VkMappedMemoryRange mappedMemoryRange = {};
-	// mappedMemoryRange.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
-	// mappedMemoryRange.pNext = nullptr;
-	// mappedMemoryRange.memory = buffer->backupMemory;
-	// mappedMemoryRange.offset = offset;
-	// mappedMemoryRange.size = copyByteSize;
-// 
-	// VK_CALL_RETURN(vkFlushMappedMemoryRanges(vkCtx.logicalDevice, 1, &mappedMemoryRange));
-
-	vkUnmapMemory(vkCtx.logicalDevice, buffer->backupMemory);
+	// explicitly inform the driver that buffer contents were modified
+	if(!is_host_coherent(buffer->allocation))
+	{
+		const VkMappedMemoryRange mappedMemoryRange = get_mapped_memory_range(buffer->allocation, offset, copyByteSize);
+		VK_CALL_RETURN(vkFlushMappedMemoryRanges(vkCtx.logicalDevice, 1, &mappedMemoryRange));
+	}
+
+	return VK_SUCCESS;
+}
+
+VkResult map_host_visible_buffer(const VulkanGlobalContext& vkCtx, Buffer* buffer)
+{
+	assert(buffer);
+	buffer->mappedData = buffer->allocation.mappedData;
+	if(!buffer->mappedData)
+		return VK_ERROR_MEMORY_MAP_FAILED;
 
 	return VK_SUCCESS;
 }
 
+void unmap_host_visible_buffer(const VulkanGlobalContext& vkCtx, Buffer* buffer)
+{
+	assert(buffer);
+	buffer->mappedData = nullptr;
+}
+
 VkBool32 push_data_to_device_local_buffer(VkCommandPool commandPool, const VulkanGlobalContext& vkCtx, const Buffer& stagingBuffer, Buffer* deviceLocalBuffer, VkQueue queue)
 {
 
@@ -303,12 +333,14 @@ VkBool32 push_data_to_device_local_buffer(VkCommandPool commandPool, const Vulka
 	return VK_TRUE;
 }
 
-VkBool32 push_texture_to_device_local_image(VkCommandPool commandPool, const VulkanGlobalContext& vkCtx, const Buffer& stagingBuffer, VkExtent3D imageExtent, ImageResource* textureResource)
+static VkExtent3D get_mip_extent(VkExtent3D imageExtent, uint32_t level)
 {
-	assert(textureResource);
+	return {std::max(imageExtent.width >> level, 1u), std::max(imageExtent.height >> level, 1u), 1};
+}
 
+static VkCommandBuffer begin_image_upload(VkCommandPool commandPool, const VulkanGlobalContext& vkCtx)
+{
 	VkCommandBuffer cmdBuff = VK_NULL_HANDLE;
-	//1.recording transfer commands into command buffer
 	create_command_buffer(vkCtx.logicalDevice, commandPool, &cmdBuff);
 
 	VkCommandBufferBeginInfo cmdBuffBegInfo = {};
@@ -318,90 +350,201 @@ VkBool32 push_texture_to_device_local_image(VkCommandPool commandPool, const Vul
 	cmdBuffBegInfo.pInheritanceInfo = nullptr;
 
 	vkBeginCommandBuffer(cmdBuff, &cmdBuffBegInfo);
+	return cmdBuff;
+}
 
-	VkBufferImageCopy copyRegion = {};
-	copyRegion.bufferOffset = 0;
-	copyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-	copyRegion.imageSubresource.mipLevel = 0;
-	copyRegion.imageSubresource.baseArrayLayer = 0;
-	copyRegion.imageSubresource.layerCount = 1;
-	copyRegion.imageOffset = {0, 0, 0};
-	copyRegion.imageExtent = imageExtent;
+//submits recorded upload and waits for it to finish
+static void submit_image_upload(VkCommandPool commandPool, const VulkanGlobalContext& vkCtx, VkCommandBuffer cmdBuff)
+{
+	vkEndCommandBuffer(cmdBuff);
 
-	//issue a barrier to transition our newly created texture from undefined layout to DST_OPTIMAL
+	VkSubmitInfo submitInfo = {};
+	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submitInfo.pNext = nullptr;
+	submitInfo.waitSemaphoreCount = 0;
+	submitInfo.pWaitSemaphores = nullptr;
+	submitInfo.pWaitDstStageMask = nullptr;
+	submitInfo.commandBufferCount = 1;
+	submitInfo.pCommandBuffers = &cmdBuff;
+	submitInfo.signalSemaphoreCount = 0;
+	submitInfo.pSignalSemaphores = nullptr;
+
+	VkFence textureTransferredFence = create_fence(vkCtx.logicalDevice);
+	VK_CALL(vkQueueSubmit(vkCtx.graphicsQueue, 1, &submitInfo, textureTransferredFence));
+	VK_CALL(vkWaitForFences(vkCtx.logicalDevice, 1, &textureTransferredFence, VK_TRUE, UINT64_MAX));
+
+	vkDestroyFence(vkCtx.logicalDevice, textureTransferredFence, nullptr);
+	vkFreeCommandBuffers(vkCtx.logicalDevice, commandPool, 1, &cmdBuff);
+}
+
+//covers every layer of [baseMipLevel, baseMipLevel + levelCount) levels
+static VkImageMemoryBarrier get_image_upload_barrier(const VulkanGlobalContext& vkCtx, const ImageResource& textureResource,
+	uint32_t baseMipLevel, uint32_t levelCount)
+{
 	VkImageMemoryBarrier imageMemBarrier = {};
 	imageMemBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
 	imageMemBarrier.pNext = nullptr;
-	imageMemBarrier.srcAccessMask = 0;
-	imageMemBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-	imageMemBarrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-	imageMemBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
 	imageMemBarrier.srcQueueFamilyIndex = vkCtx.queueFamIdx;
 	imageMemBarrier.dstQueueFamilyIndex = vkCtx.queueFamIdx;
-	imageMemBarrier.image = textureResource->image;
+	imageMemBarrier.image = textureResource.image;
 	imageMemBarrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-	imageMemBarrier.subresourceRange.baseMipLevel = 0;
-	imageMemBarrier.subresourceRange.levelCount = 1;
+	imageMemBarrier.subresourceRange.baseMipLevel = baseMipLevel;
+	imageMemBarrier.subresourceRange.levelCount = levelCount;
 	imageMemBarrier.subresourceRange.baseArrayLayer = 0;
-	imageMemBarrier.subresourceRange.layerCount = 1;
+	imageMemBarrier.subresourceRange.layerCount = textureResource.layerCount;
+	return imageMemBarrier;
+}
+
+static void record_transition_to_shader_read(VkCommandBuffer cmdBuff, const VulkanGlobalContext& vkCtx, const ImageResource& textureResource,
+	VkImageLayout oldLayout, VkAccessFlags srcAccessMask, uint32_t baseMipLevel, uint32_t levelCount)
+{
+	VkImageMemoryBarrier imageMemBarrier = get_image_upload_barrier(vkCtx, textureResource, baseMipLevel, levelCount);
+	imageMemBarrier.srcAccessMask = srcAccessMask;
+	imageMemBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	imageMemBarrier.oldLayout = oldLayout;
+	imageMemBarrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
 
 	vkCmdPipelineBarrier(
-		cmdBuff, 
-		VK_PIPELINE_STAGE_HOST_BIT,
+		cmdBuff,
 		VK_PIPELINE_STAGE_TRANSFER_BIT,
+		VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
 		0,
 		0, nullptr,
 		0, nullptr,
 		1, &imageMemBarrier
 	);
+}
 
-	vkCmdCopyBufferToImage(cmdBuff, stagingBuffer.buffer, textureResource->image,
-		VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copyRegion);
+//every level but the first one is blitted from the previous level, all of them end up in shader read layout
+static void record_mip_blit_chain(VkCommandBuffer cmdBuff, const VulkanGlobalContext& vkCtx, VkExtent3D imageExtent, const ImageResource& textureResource)
+{
+	for(uint32_t level = 1; level < textureResource.mipLevels; level++)
+	{
+		//wait for the previous level to be written before reading from it
+		VkImageMemoryBarrier imageMemBarrier = get_image_upload_barrier(vkCtx, textureResource, level - 1, 1);
+		imageMemBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		imageMemBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+		imageMemBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		imageMemBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+
+		vkCmdPipelineBarrier(
+			cmdBuff,
+			VK_PIPELINE_STAGE_TRANSFER_BIT,
+			VK_PIPELINE_STAGE_TRANSFER_BIT,
+			0,
+			0, nullptr,
+			0, nullptr,
+			1, &imageMemBarrier
+		);
+
+		const VkExtent3D srcExtent = get_mip_extent(imageExtent, level - 1);
+		const VkExtent3D dstExtent = get_mip_extent(imageExtent, level);
+
+		VkImageBlit blit = {};
+		blit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		blit.srcSubresource.mipLevel = level - 1;
+		blit.srcSubresource.baseArrayLayer = 0;
+		blit.srcSubresource.layerCount = textureResource.layerCount;
+		blit.srcOffsets[0] = {0, 0, 0};
+		blit.srcOffsets[1] = {int32_t(srcExtent.width), int32_t(srcExtent.height), 1};
+		blit.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		blit.dstSubresource.mipLevel = level;
+		blit.dstSubresource.baseArrayLayer = 0;
+		blit.dstSubresource.layerCount = textureResource.layerCount;
+		blit.dstOffsets[0] = {0, 0, 0};
+		blit.dstOffsets[1] = {int32_t(dstExtent.width), int32_t(dstExtent.height), 1};
+
+		vkCmdBlitImage(cmdBuff,
+			textureResource.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+			textureResource.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			1, &blit, VK_FILTER_LINEAR
+		);
+	}
+
+	//last level has only been written to
+	const uint32_t lastLevel = textureResource.mipLevels - 1;
+	if(lastLevel)
+	{
+		record_transition_to_shader_read(cmdBuff, vkCtx, textureResource,
+			VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_ACCESS_TRANSFER_READ_BIT, 0, lastLevel);
+	}
+	record_transition_to_shader_read(cmdBuff, vkCtx, textureResource,
+		VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_ACCESS_TRANSFER_WRITE_BIT, lastLevel, 1);
+}
+
+//records copies of regions into the image, mip levels that have no region are blitted from level 0 if blitMips is set
+static void record_regions_upload(VkCommandBuffer cmdBuff, const VulkanGlobalContext& vkCtx, const Buffer& stagingBuffer,
+	VkExtent3D imageExtent, const VkBufferImageCopy* regions, uint32_t regionCount, bool blitMips, const ImageResource& textureResource)
+{
+	//issue a barrier to transition our newly created texture from undefined layout to DST_OPTIMAL
+	VkImageMemoryBarrier imageMemBarrier = get_image_upload_barrier(vkCtx, textureResource, 0, textureResource.mipLevels);
+	imageMemBarrier.srcAccessMask = 0;
+	imageMemBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	imageMemBarrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	imageMemBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
 
-	//issue another barrier
-	//transfer texture layout to the shader layout so it can be sampled
-	imageMemBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-	imageMemBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-	imageMemBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-	imageMemBarrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-	
 	vkCmdPipelineBarrier(
 		cmdBuff, 
+		VK_PIPELINE_STAGE_HOST_BIT,
 		VK_PIPELINE_STAGE_TRANSFER_BIT,
-		VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
 		0,
 		0, nullptr,
 		0, nullptr,
 		1, &imageMemBarrier
 	);
-	
-	vkEndCommandBuffer(cmdBuff);
 
-	VkSubmitInfo submitInfo = {};
-	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-	submitInfo.pNext = nullptr;
-	submitInfo.waitSemaphoreCount = 0;
-	submitInfo.pWaitSemaphores = nullptr;
-	submitInfo.pWaitDstStageMask = nullptr;
-	submitInfo.commandBufferCount = 1;
-	submitInfo.pCommandBuffers = &cmdBuff;
-	submitInfo.signalSemaphoreCount = 0;
-	submitInfo.pSignalSemaphores = nullptr;
+	vkCmdCopyBufferToImage(cmdBuff, stagingBuffer.buffer, textureResource.image,
+		VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, regionCount, regions);
 
-	//submit transfer command into queue
-	VkFence textureTransferredFence = create_fence(vkCtx.logicalDevice);
-	VK_CALL(vkQueueSubmit(vkCtx.graphicsQueue, 1, &submitInfo, textureTransferredFence));
-	VK_CALL(vkWaitForFences(vkCtx.logicalDevice, 1, &textureTransferredFence, VK_TRUE, UINT64_MAX));
-	
-	//cleanup
-	vkDestroyFence(vkCtx.logicalDevice, textureTransferredFence, nullptr);
-	vkFreeCommandBuffers(vkCtx.logicalDevice, commandPool, 1, &cmdBuff);
+	//transfer texture layout to the shader layout so it can be sampled
+	if(blitMips)
+	{
+		record_mip_blit_chain(cmdBuff, vkCtx, imageExtent, textureResource);
+	}
+	else
+	{
+		record_transition_to_shader_read(cmdBuff, vkCtx, textureResource,
+			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_ACCESS_TRANSFER_WRITE_BIT, 0, textureResource.mipLevels);
+	}
+}
+
+static VkBool32 push_regions_to_device_local_image(VkCommandPool commandPool, const VulkanGlobalContext& vkCtx, const Buffer& stagingBuffer,
+	VkExtent3D imageExtent, const VkBufferImageCopy* regions, uint32_t regionCount, bool blitMips, ImageResource* textureResource)
+{
+	assert(textureResource && regions && regionCount);
+	if(blitMips && !supports_linear_blit(vkCtx, textureResource->format))
+	{
+		magma::log::error("Image format {} can't be linearly blitted, mip levels were not generated", uint32_t(textureResource->format));
+		return VK_FALSE;
+	}
+
+	//1.recording transfer commands into command buffer
+	VkCommandBuffer cmdBuff = begin_image_upload(commandPool, vkCtx);
+	record_regions_upload(cmdBuff, vkCtx, stagingBuffer, imageExtent, regions, regionCount, blitMips, *textureResource);
+	submit_image_upload(commandPool, vkCtx, cmdBuff);
 	
 	textureResource->layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
 	return VK_TRUE;
 }
 
-ImageResource create_cubemap_image(const VulkanGlobalContext& vkCtx, VkExtent3D imageExtent, VkFormat imageFormat, VkImageUsageFlags usageFlags, VkImageLayout initialLayout)
+VkBool32 push_texture_to_device_local_image(VkCommandPool commandPool, const VulkanGlobalContext& vkCtx, const Buffer& stagingBuffer, VkExtent3D imageExtent, ImageResource* textureResource)
+{
+	assert(textureResource);
+
+	VkBufferImageCopy copyRegion = {};
+	copyRegion.bufferOffset = 0;
+	copyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	copyRegion.imageSubresource.mipLevel = 0;
+	copyRegion.imageSubresource.baseArrayLayer = 0;
+	copyRegion.imageSubresource.layerCount = 1;
+	copyRegion.imageOffset = {0, 0, 0};
+	copyRegion.imageExtent = imageExtent;
+
+	return push_regions_to_device_local_image(commandPool, vkCtx, stagingBuffer, imageExtent,
+		&copyRegion, 1, textureResource->mipLevels > 1, textureResource);
+}
+
+ImageResource create_cubemap_image(const VulkanGlobalContext& vkCtx, VkExtent3D imageExtent, VkFormat imageFormat, VkImageUsageFlags usageFlags, VkImageLayout initialLayout, uint32_t mipLevels)
 {
 	VkImageCreateInfo imageCreateInfo = {};
 	imageCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
@@ -410,7 +553,7 @@ ImageResource create_cubemap_image(const VulkanGlobalContext& vkCtx, VkExtent3D
 	imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
 	imageCreateInfo.format = imageFormat;
 	imageCreateInfo.extent = imageExtent;
-	imageCreateInfo.mipLevels = 1;
+	imageCreateInfo.mipLevels = mipLevels;
 	imageCreateInfo.arrayLayers = 6;
 	imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
 	imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
@@ -423,24 +566,8 @@ ImageResource create_cubemap_image(const VulkanGlobalContext& vkCtx, VkExtent3D
 	VkImage image = VK_NULL_HANDLE;
 	VK_CALL(vkCreateImage(vkCtx.logicalDevice, &imageCreateInfo, nullptr, &image));
 
-	VkMemoryRequirements memRequirements = {};
-	vkGetImageMemoryRequirements(vkCtx.logicalDevice, image, &memRequirements);
-	VkPhysicalDeviceMemoryProperties deviceMemProps = {};
-	vkGetPhysicalDeviceMemoryProperties(vkCtx.physicalDevice, &deviceMemProps);
-
-	uint32_t preferredMemTypeIndex = -1;
-	find_required_memtype_index(vkCtx.physicalDevice, memRequirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &preferredMemTypeIndex);
-
-	VkMemoryAllocateInfo memAllocInfo = {};
-	memAllocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-	memAllocInfo.pNext = nullptr;
-	memAllocInfo.allocationSize = memRequirements.size;
-	memAllocInfo.memoryTypeIndex = preferredMemTypeIndex;
-
-	VkDeviceMemory imageMemory = {};
-	VK_CALL(vkAllocateMemory(vkCtx.logicalDevice, &memAllocInfo, nullptr, &imageMemory));
-
-	VK_CALL(vkBindImageMemory(vkCtx.logicalDevice, image, imageMemory, 0));
+	DeviceAllocation imageMemory = {};
+	VK_CHECK(bind_image_memory(vkCtx, image, &imageMemory));
 
 	VkImageViewCreateInfo imageViewCreateInfo = {};
 	imageViewCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
@@ -451,7 +578,7 @@ ImageResource create_cubemap_image(const VulkanGlobalContext& vkCtx, VkExtent3D
 	imageViewCreateInfo.format = imageFormat;
 	imageViewCreateInfo.subresourceRange.aspectMask = get_image_aspect_from_usage(usageFlags);
 	imageViewCreateInfo.subresourceRange.baseMipLevel = 0;
-	imageViewCreateInfo.subresourceRange.levelCount = 1;
+	imageViewCreateInfo.subresourceRange.levelCount = mipLevels;
 	imageViewCreateInfo.subresourceRange.baseArrayLayer = 0;
 	imageViewCreateInfo.subresourceRange.layerCount = 6;
 
@@ -462,8 +589,11 @@ ImageResource create_cubemap_image(const VulkanGlobalContext& vkCtx, VkExtent3D
 	imageResource.image = image;
 	imageResource.view = imageView;
 	imageResource.layout = initialLayout;
-	imageResource.imageSize = memAllocInfo.allocationSize;
-	imageResource.backupMemory = imageMemory;
+	imageResource.imageSize = imageMemory.size;
+	imageResource.allocation = imageMemory;
+	imageResource.format = imageFormat;
+	imageResource.mipLevels = mipLevels;
+	imageResource.layerCount = 6;
 
 	return imageResource;
 }
@@ -472,18 +602,6 @@ VkBool32 push_cubemap_to_device_local_image(VkCommandPool commandPool, const Vul
 {
 	assert(textureResource);
 
-	VkCommandBuffer cmdBuff = VK_NULL_HANDLE;
-	//1.recording transfer commands into command buffer
-	create_command_buffer(vkCtx.logicalDevice, commandPool, &cmdBuff);
-
-	VkCommandBufferBeginInfo cmdBuffBegInfo = {};
-	cmdBuffBegInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-	cmdBuffBegInfo.pNext = nullptr;
-	cmdBuffBegInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-	cmdBuffBegInfo.pInheritanceInfo = nullptr;
-
-	vkBeginCommandBuffer(cmdBuff, &cmdBuffBegInfo);
-
 	std::array<VkBufferImageCopy, 6> copyRegions = {};
 	
 	std::size_t bufferOffset = 0; 
@@ -499,85 +617,59 @@ VkBool32 push_cubemap_to_device_local_image(VkCommandPool commandPool, const Vul
 		bufferOffset += planeStride;
 	}
 
-	//issue a barrier to transition our newly created texture from undefined layout to DST_OPTIMAL
-	VkImageMemoryBarrier imageMemBarrier = {};
-	imageMemBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-	imageMemBarrier.pNext = nullptr;
-	imageMemBarrier.srcAccessMask = 0;
-	imageMemBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-	imageMemBarrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-	imageMemBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-	imageMemBarrier.srcQueueFamilyIndex = vkCtx.queueFamIdx;
-	imageMemBarrier.dstQueueFamilyIndex = vkCtx.queueFamIdx;
-	imageMemBarrier.image = textureResource->image;
-	imageMemBarrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-	imageMemBarrier.subresourceRange.baseMipLevel = 0;
-	imageMemBarrier.subresourceRange.levelCount = 1;
-	imageMemBarrier.subresourceRange.baseArrayLayer = 0;
-	imageMemBarrier.subresourceRange.layerCount = 6;
+	return push_regions_to_device_local_image(commandPool, vkCtx, stagingBuffer, imageExtent,
+		copyRegions.data(), copyRegions.size(), textureResource->mipLevels > 1, textureResource);
+}
 
-	vkCmdPipelineBarrier(
-		cmdBuff, 
-		VK_PIPELINE_STAGE_HOST_BIT,
-		VK_PIPELINE_STAGE_TRANSFER_BIT,
-		0,
-		0, nullptr,
-		0, nullptr,
-		1, &imageMemBarrier
-	);
+void fill_mip_chain_regions(VkExtent3D imageExtent, const VkDeviceSize* levelOffsets, VkDeviceSize layerStride,
+	const ImageResource& textureResource, std::vector<VkBufferImageCopy>* copyRegions)
+{
+	copyRegions->resize(std::size_t(textureResource.layerCount) * textureResource.mipLevels);
+	for(uint32_t layer = 0; layer < textureResource.layerCount; layer++)
+	{
+		for(uint32_t level = 0; level < textureResource.mipLevels; level++)
+		{
+			VkBufferImageCopy& region = (*copyRegions)[layer * textureResource.mipLevels + level];
+			region = {};
+			region.bufferOffset = layer * layerStride + levelOffsets[level];
+			region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			region.imageSubresource.mipLevel = level;
+			region.imageSubresource.baseArrayLayer = layer;
+			region.imageSubresource.layerCount = 1;
+			region.imageOffset = {0, 0, 0};
+			region.imageExtent = get_mip_extent(imageExtent, level);
+		}
+	}
+}
 
-	vkCmdCopyBufferToImage(cmdBuff, stagingBuffer.buffer, textureResource->image,
-		VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, copyRegions.size(), copyRegions.data());
+VkBool32 push_mip_chain_to_device_local_image(VkCommandPool commandPool, const VulkanGlobalContext& vkCtx, const Buffer& stagingBuffer,
+	VkExtent3D imageExtent, const VkDeviceSize* levelOffsets, VkDeviceSize layerStride, ImageResource* textureResource)
+{
+	assert(textureResource && levelOffsets);
 
-	//issue another barrier
-	//transfer texture layout to the shader layout so it can be sampled
-	imageMemBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-	imageMemBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-	imageMemBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-	imageMemBarrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-	
-	vkCmdPipelineBarrier(
-		cmdBuff, 
-		VK_PIPELINE_STAGE_TRANSFER_BIT,
-		VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
-		0,
-		0, nullptr,
-		0, nullptr,
-		1, &imageMemBarrier
-	);
-	
-	vkEndCommandBuffer(cmdBuff);
+	std::vector<VkBufferImageCopy> copyRegions;
+	fill_mip_chain_regions(imageExtent, levelOffsets, layerStride, *textureResource, &copyRegions);
+	return push_regions_to_device_local_image(commandPool, vkCtx, stagingBuffer, imageExtent,
+		copyRegions.data(), static_cast<uint32_t>(copyRegions.size()), false, textureResource);
+}
 
-	VkSubmitInfo submitInfo = {};
-	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-	submitInfo.pNext = nullptr;
-	submitInfo.waitSemaphoreCount = 0;
-	submitInfo.pWaitSemaphores = nullptr;
-	submitInfo.pWaitDstStageMask = nullptr;
-	submitInfo.commandBufferCount = 1;
-	submitInfo.pCommandBuffers = &cmdBuff;
-	submitInfo.signalSemaphoreCount = 0;
-	submitInfo.pSignalSemaphores = nullptr;
+void record_mip_chain_upload(VkCommandBuffer cmdBuff, const VulkanGlobalContext& vkCtx, const Buffer& stagingBuffer,
+	VkExtent3D imageExtent, const VkDeviceSize* levelOffsets, VkDeviceSize layerStride, const ImageResource& textureResource)
+{
+	assert(levelOffsets);
 
-	//submit transfer command into queue
-	VkFence textureTransferredFence = create_fence(vkCtx.logicalDevice);
-	VK_CALL(vkQueueSubmit(vkCtx.graphicsQueue, 1, &submitInfo, textureTransferredFence));
-	VK_CALL(vkWaitForFences(vkCtx.logicalDevice, 1, &textureTransferredFence, VK_TRUE, UINT64_MAX));
-	
-	//cleanup
-	vkDestroyFence(vkCtx.logicalDevice, textureTransferredFence, nullptr);
-	vkFreeCommandBuffers(vkCtx.logicalDevice, commandPool, 1, &cmdBuff);
-	
-	return VK_TRUE;	
+	std::vector<VkBufferImageCopy> copyRegions;
+	fill_mip_chain_regions(imageExtent, levelOffsets, layerStride, textureResource, &copyRegions);
+	record_regions_upload(cmdBuff, vkCtx, stagingBuffer, imageExtent,
+		copyRegions.data(), static_cast<uint32_t>(copyRegions.size()), false, textureResource);
 }
 
 void destroy_image_resource(VkDevice logicalDevice, ImageResource* image)
 {
 	vkDestroyImageView(logicalDevice, image->view, nullptr);
 	vkDestroyImage(logicalDevice, image->image, nullptr);
-	vkFreeMemory(logicalDevice, image->backupMemory, nullptr);
+	free_device_memory(&image->allocation);
 	
 	image->layout = VK_IMAGE_LAYOUT_UNDEFINED;
 	image->imageSize = 0;
-	image->backupMemory = VK_NULL_HANDLE;
 }
\ No newline at end of file
@@ -4,27 +4,61 @@
 #include "vk_types.h"
 
 #include <cstddef>
+#include <vector>
 
-ImageResource create_image_resource(const VulkanGlobalContext& vkCtx, VkExtent3D imageExtent, VkFormat imageFormat, VkImageUsageFlags usageFlags, VkImageLayout initialLayout = VK_IMAGE_LAYOUT_UNDEFINED);
+//full chain down to 1x1
+uint32_t get_mip_level_count(VkExtent3D imageExtent);
 
-VkSampler create_default_sampler(VkDevice logicalDevice, bool* status = nullptr);
+//whether push_*_to_device_local_image can generate mips of the format with linear blits
+bool supports_linear_blit(const VulkanGlobalContext& vkCtx, VkFormat imageFormat);
 
-ImageResource create_cubemap_image(const VulkanGlobalContext& vkCtx, VkExtent3D imageExtent, VkFormat imageFormat, VkImageUsageFlags usageFlags, VkImageLayout initialLayout = VK_IMAGE_LAYOUT_UNDEFINED);
+ImageResource create_image_resource(const VulkanGlobalContext& vkCtx, VkExtent3D imageExtent, VkFormat imageFormat, VkImageUsageFlags usageFlags, VkImageLayout initialLayout = VK_IMAGE_LAYOUT_UNDEFINED, uint32_t mipLevels = 1);
+
+//trilinear, maxLod covers mipLevels
+VkSampler create_default_sampler(VkDevice logicalDevice, bool* status = nullptr, uint32_t mipLevels = 1);
+
+ImageResource create_cubemap_image(const VulkanGlobalContext& vkCtx, VkExtent3D imageExtent, VkFormat imageFormat, VkImageUsageFlags usageFlags, VkImageLayout initialLayout = VK_IMAGE_LAYOUT_UNDEFINED, uint32_t mipLevels = 1);
 
 Buffer create_buffer(const VulkanGlobalContext& vkCtx, VkBufferUsageFlags usageFlags, VkMemoryPropertyFlags requiredMemProperties, std::size_t size);
 
+//e.g. host visible memory preferring device local, written by the cpu and read by the gpu without a staging copy
+Buffer create_buffer(const VulkanGlobalContext& vkCtx, VkBufferUsageFlags usageFlags, const MemoryTypeRequest& memoryRequest, std::size_t size);
+
+//flushes the written range when memory is not host coherent
 VkResult copy_data_to_host_visible_buffer(const VulkanGlobalContext& vkCtx, VkDeviceSize offset, const void* copyFrom, std::size_t copyByteSize, Buffer* buffer);
 
+//keeps whole buffer memory mapped until unmap_host_visible_buffer or destroy_buffer.
+//Writes to non coherent memory have to be flushed, see get_mapped_memory_range
+VkResult map_host_visible_buffer(const VulkanGlobalContext& vkCtx, Buffer* buffer);
+
+void unmap_host_visible_buffer(const VulkanGlobalContext& vkCtx, Buffer* buffer);
+
 VkBool32 push_data_to_device_local_buffer(VkCommandPool commandPool, const VulkanGlobalContext& vkCtx, const Buffer& stagingBuffer, Buffer* deviceLocalBuffer, VkQueue queue = VK_NULL_HANDLE);
 
+//copies level 0, the rest of mip levels is blitted from it. Images with mips need TRANSFER_SRC usage and a format passing supports_linear_blit
 VkBool32 push_texture_to_device_local_image(VkCommandPool commandPool, const VulkanGlobalContext& vkCtx, const Buffer& stagingBuffer, VkExtent3D imageExtent, ImageResource* textureResource);
 
 VkBool32 push_cubemap_to_device_local_image(VkCommandPool commandPool, const VulkanGlobalContext& vkCtx, const Buffer& stagingBuffer, VkExtent3D imageExtent, std::size_t planeStride, ImageResource* textureResource);
 
+//copies every mip level of every layer from the staging buffer, e.g. a chain built with generate_mip_chain.
+//Layers are layerStride bytes apart, levelOffsets are relative to the start of a layer
+VkBool32 push_mip_chain_to_device_local_image(VkCommandPool commandPool, const VulkanGlobalContext& vkCtx, const Buffer& stagingBuffer,
+	VkExtent3D imageExtent, const VkDeviceSize* levelOffsets, VkDeviceSize layerStride, ImageResource* textureResource);
+
+//same copies as push_mip_chain_to_device_local_image recorded into cmdBuff, image goes from undefined to shader read layout.
+//Staging buffer has to outlive execution of the command buffer
+void record_mip_chain_upload(VkCommandBuffer cmdBuff, const VulkanGlobalContext& vkCtx, const Buffer& stagingBuffer,
+	VkExtent3D imageExtent, const VkDeviceSize* levelOffsets, VkDeviceSize layerStride, const ImageResource& textureResource);
+
+//one region per level of every layer, laid out the way push_mip_chain_to_device_local_image expects
+void fill_mip_chain_regions(VkExtent3D imageExtent, const VkDeviceSize* levelOffsets, VkDeviceSize layerStride,
+	const ImageResource& textureResource, std::vector<VkBufferImageCopy>* copyRegions);
+
 void destroy_buffer(VkDevice logicalDevice, Buffer* buffer);
 
 void destroy_image_resource(VkDevice logicalDevice, ImageResource* image);
 
+//type with every one of desiredMemoryFlags, ranked as for get_memory_type_request without looking at heap budgets
 bool find_required_memtype_index(VkPhysicalDevice physicalDevice, VkMemoryRequirements resourceMemoryRequirements, VkMemoryPropertyFlags desiredMemoryFlags, uint32_t* memoryTypeIndex);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,107 @@
+#include "vk_ring_buffer.h"
+#include "vk_allocator.h"
+#include "vk_resource.h"
+#include "vk_dbg.h"
+#include "logging.h"
+
+#include <algorithm>
+#include <cassert>
+
+static VkDeviceSize align_up(VkDeviceSize value, VkDeviceSize alignment)
+{
+	return (value + alignment - 1) / alignment * alignment;
+}
+
+bool create_frame_ring_buffer(const VulkanGlobalContext& vkCtx, VkBufferUsageFlags usageFlags, VkDeviceSize frameSize,
+	uint32_t frameCount, FrameRingBuffer* out)
+{
+	assert(out && frameCount > 0 && frameSize > 0);
+	const VkPhysicalDeviceLimits& limits = vkCtx.deviceProps.limits;
+	VkDeviceSize alignment = 1;
+	if(usageFlags & VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT)
+	{
+		alignment = std::max(alignment, limits.minUniformBufferOffsetAlignment);
+	}
+	if(usageFlags & VK_BUFFER_USAGE_STORAGE_BUFFER_BIT)
+	{
+		alignment = std::max(alignment, limits.minStorageBufferOffsetAlignment);
+	}
+	//flushes start at allocation boundaries, so those have to be whole atoms apart
+	alignment = std::max(alignment, limits.nonCoherentAtomSize);
+
+	*out = {};
+	out->frameSize = align_up(frameSize, alignment);
+	out->alignment = alignment;
+	out->frameCount = frameCount;
+	//first begin_ring_frame lands on partition 0
+	out->frameIndex = frameCount - 1;
+
+	//device local host visible memory (BAR or resizable BAR) lets the gpu read what the cpu wrote without going over the bus,
+	//falls back to system memory when there is none or its heap is out of budget
+	MemoryTypeRequest memoryRequest = {};
+	memoryRequest.required = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+	memoryRequest.preferred = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+	out->buffer = create_buffer(vkCtx, usageFlags, memoryRequest, out->frameSize * frameCount);
+	if(out->buffer.buffer == VK_NULL_HANDLE || map_host_visible_buffer(vkCtx, &out->buffer) != VK_SUCCESS)
+	{
+		magma::log::error("Failed to create {} byte frame ring buffer", out->frameSize * frameCount);
+		destroy_frame_ring_buffer(vkCtx.logicalDevice, out);
+		return false;
+	}
+	//dynamic offsets are 32 bit
+	assert(out->buffer.bufferSize <= UINT32_MAX);
+	return true;
+}
+
+void destroy_frame_ring_buffer(VkDevice logicalDevice, FrameRingBuffer* ring)
+{
+	assert(ring);
+	if(ring->buffer.buffer != VK_NULL_HANDLE)
+	{
+		destroy_buffer(logicalDevice, &ring->buffer);
+	}
+	*ring = {};
+}
+
+void begin_ring_frame(FrameRingBuffer* ring)
+{
+	assert(ring && ring->buffer.mappedData);
+	ring->frameIndex = (ring->frameIndex + 1) % ring->frameCount;
+	ring->head = 0;
+	ring->flushedHead = 0;
+}
+
+bool allocate_from_ring(FrameRingBuffer* ring, VkDeviceSize size, RingAllocation* out)
+{
+	assert(ring && out);
+	const VkDeviceSize alignedSize = align_up(size, ring->alignment);
+	if(ring->head + alignedSize > ring->frameSize)
+	{
+		magma::log::error("Frame ring buffer is out of space, {} of {} bytes used", ring->head, ring->frameSize);
+		return false;
+	}
+
+	const VkDeviceSize offset = ring->frameIndex * ring->frameSize + ring->head;
+	out->data = static_cast<uint8_t*>(ring->buffer.mappedData) + offset;
+	out->buffer = ring->buffer.buffer;
+	out->offset = static_cast<uint32_t>(offset);
+	ring->head += alignedSize;
+	return true;
+}
+
+VkResult flush_ring_frame(const VulkanGlobalContext& vkCtx, FrameRingBuffer* ring)
+{
+	assert(ring);
+	if(ring->flushedHead == ring->head || is_host_coherent(ring->buffer.allocation))
+	{
+		ring->flushedHead = ring->head;
+		return VK_SUCCESS;
+	}
+
+	const VkDeviceSize frameStart = ring->frameIndex * ring->frameSize;
+	const VkMappedMemoryRange range = get_mapped_memory_range(ring->buffer.allocation,
+		frameStart + ring->flushedHead, ring->head - ring->flushedHead);
+	VK_CALL_RETURN(vkFlushMappedMemoryRanges(vkCtx.logicalDevice, 1, &range));
+	ring->flushedHead = ring->head;
+	return VK_SUCCESS;
+}
@@ -0,0 +1,44 @@
+#ifndef MAGMA_VK_RING_BUFFER_H
+#define MAGMA_VK_RING_BUFFER_H
+
+#include "vk_types.h"
+
+//transient per frame data, e.g. uniforms or skinning palettes. offset is what gets passed as a dynamic descriptor offset
+struct RingAllocation
+{
+	void* data;
+	VkBuffer buffer;
+	uint32_t offset;
+};
+
+//persistently mapped buffer split into one partition per frame in flight.
+//Partitions are reused round robin, so a frame has to be finished on the gpu before its partition comes around again
+struct FrameRingBuffer
+{
+	Buffer buffer;
+	VkDeviceSize frameSize;
+	VkDeviceSize alignment;//of every allocation, covers descriptor offset limits and non coherent atoms
+	uint32_t frameCount;
+	uint32_t frameIndex;
+	VkDeviceSize head;//relative to start of current partition
+	VkDeviceSize flushedHead;//everything before it is already flushed
+};
+
+//usage decides which of min uniform or storage buffer offset alignments apply
+bool create_frame_ring_buffer(const VulkanGlobalContext& vkCtx, VkBufferUsageFlags usageFlags, VkDeviceSize frameSize,
+	uint32_t frameCount, FrameRingBuffer* out);
+
+void destroy_frame_ring_buffer(VkDevice logicalDevice, FrameRingBuffer* ring);
+
+//moves to the next partition and discards what was allocated from it frameCount frames ago.
+//Call after waiting on the fence of that frame
+void begin_ring_frame(FrameRingBuffer* ring);
+
+//false when the partition is full
+bool allocate_from_ring(FrameRingBuffer* ring, VkDeviceSize size, RingAllocation* out);
+
+//makes everything written since the last flush visible to the device with a single vkFlushMappedMemoryRanges,
+//nothing to do for coherent memory. Call before submitting work that reads the allocations
+VkResult flush_ring_frame(const VulkanGlobalContext& vkCtx, FrameRingBuffer* ring);
+
+#endif
@@ -4,6 +4,8 @@
 #include <volk.h>
 #include <vector>
 
+struct DeviceAllocator;
+struct MemoryBlock;
 
 struct VulkanGlobalContext
 {
@@ -14,9 +16,13 @@ struct VulkanGlobalContext
 	VkDebugUtilsMessengerEXT debugCallback;
 	uint32_t queueFamIdx;
 	uint32_t computeQueueFamIdx;
+	uint32_t transferQueueFamIdx;//same as queueFamIdx when the device has no transfer only family
 	VkQueue graphicsQueue;
 	VkQueue computeQueue;
+	VkQueue transferQueue;
 	bool hasDebugUtilsExtension = false;
+	bool hasMemoryBudgetExtension = false;
+	DeviceAllocator* allocator = nullptr;//buffers and images are sub-allocated from its blocks
 };
 
 struct WindowInfo
@@ -61,12 +67,34 @@ struct PipelineState
 	VkViewport viewport;
 };
 
+//flags a memory type must have, should have and should rather not have, see select_memory_type
+struct MemoryTypeRequest
+{
+	VkMemoryPropertyFlags required;
+	VkMemoryPropertyFlags preferred;
+	VkMemoryPropertyFlags avoided;
+};
+
+//range of a MemoryBlock a resource is bound to, or a dedicated VkDeviceMemory when block is null
+struct DeviceAllocation
+{
+	DeviceAllocator* allocator;
+	MemoryBlock* block;
+	uint32_t region;
+	VkDeviceMemory memory;
+	VkDeviceSize offset;
+	VkDeviceSize size;
+	uint32_t memoryTypeIndex;
+	void* mappedData;//start of the range for host visible types
+};
+
 struct Buffer
 {
 	VkBuffer buffer;
 	VkDeviceSize bufferSize;
 	VkDeviceSize alignedSize;
-	VkDeviceMemory backupMemory;
+	DeviceAllocation allocation;
+	void* mappedData;//non null while persistently mapped
 };
 
 struct ImageResource
@@ -76,7 +104,9 @@ struct ImageResource
 	VkImageLayout layout;
 	VkFormat format;
 	VkDeviceSize imageSize;
-	VkDeviceMemory backupMemory;
+	DeviceAllocation allocation;
+	uint32_t mipLevels;
+	uint32_t layerCount;
 };
 
 struct Texture
@@ -0,0 +1,644 @@
+#include "vk_upload.h"
+#include "vk_boilerplate.h"
+#include "vk_commands.h"
+#include "vk_resource.h"
+#include "vk_dbg.h"
+#include "logging.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <numeric>
+
+static void create_upload_batch(const UploadQueue& queue, const VulkanGlobalContext& vkCtx, UploadBatch* out)
+{
+	*out = {};
+	create_command_buffer(vkCtx.logicalDevice, queue.transferPool, &out->transferCmd);
+	if(queue.ownershipTransfer)
+	{
+		create_command_buffer(vkCtx.logicalDevice, queue.acquirePool, &out->acquireCmd);
+		out->transferDone = create_semaphore(vkCtx.logicalDevice);
+	}
+	out->fence = create_fence(vkCtx.logicalDevice);
+}
+
+static void begin_commands(VkCommandBuffer cmdBuff)
+{
+	VkCommandBufferBeginInfo cmdBuffBegInfo = {};
+	cmdBuffBegInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	cmdBuffBegInfo.pNext = nullptr;
+	cmdBuffBegInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	cmdBuffBegInfo.pInheritanceInfo = nullptr;
+	VK_CALL(vkBeginCommandBuffer(cmdBuff, &cmdBuffBegInfo));
+}
+
+//opens a batch on first upload after a submit
+static void begin_recording(UploadQueue* queue, const VulkanGlobalContext& vkCtx)
+{
+	if(queue->isRecording)
+		return;
+
+	if(queue->freeBatches.empty())
+	{
+		create_upload_batch(*queue, vkCtx, &queue->recording);
+	}
+	else
+	{
+		queue->recording = std::move(queue->freeBatches.back());
+		queue->freeBatches.pop_back();
+	}
+	queue->recording.token = queue->nextToken;
+	queue->recording.dstStages = 0;
+	begin_commands(queue->recording.transferCmd);
+	queue->isRecording = true;
+}
+
+static VkDeviceSize align_up(VkDeviceSize value, VkDeviceSize alignment)
+{
+	return (value + alignment - 1) / alignment * alignment;
+}
+
+static bool try_allocate_staging(StagingArena* arena, VkDeviceSize size, VkDeviceSize* offset)
+{
+	//nothing in flight, start over from the beginning to keep allocations contiguous
+	if(arena->head == arena->tail)
+	{
+		arena->head = 0;
+		arena->tail = 0;
+	}
+
+	VkDeviceSize start = align_up(arena->head, arena->alignment);
+	//allocations never straddle the end of the buffer, the rest of it is skipped
+	if(start % arena->capacity + size > arena->capacity)
+	{
+		start = align_up(start, arena->capacity);
+	}
+	if(start + size - arena->tail > arena->capacity)
+		return false;
+
+	arena->head = start + size;
+	*offset = start % arena->capacity;
+	return true;
+}
+
+UploadToken submit_uploads(UploadQueue* queue, const VulkanGlobalContext& vkCtx);
+
+//waits for the oldest batches to release their staging when the arena is full
+static bool allocate_staging(UploadQueue* queue, const VulkanGlobalContext& vkCtx, VkDeviceSize size, VkDeviceSize* offset)
+{
+	assert(size <= queue->staging.capacity);
+	while(!try_allocate_staging(&queue->staging, size, offset))
+	{
+		if(queue->isRecording)
+		{
+			submit_uploads(queue, vkCtx);
+		}
+		if(queue->pendingBatches.empty())
+		{
+			magma::log::error("Staging arena can't fit {} bytes with nothing in flight", size);
+			return false;
+		}
+		wait_for_upload(queue, vkCtx, queue->pendingBatches.front().token);
+	}
+	return true;
+}
+
+//release half on the transfer family, acquire half on graphics, or a plain barrier when both are the same family
+static void set_barrier_queue_families(const UploadQueue& queue, const VulkanGlobalContext& vkCtx,
+	uint32_t* srcQueueFamilyIndex, uint32_t* dstQueueFamilyIndex)
+{
+	*srcQueueFamilyIndex = queue.ownershipTransfer ? vkCtx.transferQueueFamIdx : VK_QUEUE_FAMILY_IGNORED;
+	*dstQueueFamilyIndex = queue.ownershipTransfer ? vkCtx.queueFamIdx : VK_QUEUE_FAMILY_IGNORED;
+}
+
+bool init_upload_queue(const VulkanGlobalContext& vkCtx, VkDeviceSize stagingSize, UploadQueue* queue)
+{
+	assert(queue && stagingSize);
+	*queue = {};
+
+	const VkPhysicalDeviceLimits& limits = vkCtx.deviceProps.limits;
+	StagingArena& staging = queue->staging;
+	//16 covers texel blocks of compressed formats and the 4 byte minimum of buffer to image copies
+	staging.alignment = std::max<VkDeviceSize>(16, limits.optimalBufferCopyOffsetAlignment);
+	staging.capacity = align_up(stagingSize, staging.alignment);
+	staging.buffer = create_buffer(vkCtx,
+		VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT|VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+		staging.capacity);
+	if(staging.buffer.buffer == VK_NULL_HANDLE)
+	{
+		magma::log::error("Failed to create {} byte staging arena", staging.capacity);
+		return false;
+	}
+	VK_CALL_RETURN_BOOL(map_host_visible_buffer(vkCtx, &staging.buffer));
+	staging.mappedData = static_cast<uint8_t*>(staging.buffer.mappedData);
+
+	//transfer only families may not copy single texels, e.g. (16, 16, 8)
+	uint32_t queueFamPropsCount = 0;
+	vkGetPhysicalDeviceQueueFamilyProperties(vkCtx.physicalDevice, &queueFamPropsCount, nullptr);
+	std::vector<VkQueueFamilyProperties> queueFamProps(queueFamPropsCount);
+	vkGetPhysicalDeviceQueueFamilyProperties(vkCtx.physicalDevice, &queueFamPropsCount, queueFamProps.data());
+	assert(vkCtx.transferQueueFamIdx < queueFamPropsCount);
+	queue->imageGranularity = queueFamProps[vkCtx.transferQueueFamIdx].minImageTransferGranularity;
+
+	queue->ownershipTransfer = vkCtx.transferQueueFamIdx != vkCtx.queueFamIdx;
+	queue->transferPool = create_command_pool(vkCtx, VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT, vkCtx.transferQueueFamIdx);
+	if(queue->ownershipTransfer)
+	{
+		queue->acquirePool = create_command_pool(vkCtx, VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT, vkCtx.queueFamIdx);
+	}
+	queue->nextToken = 1;
+	queue->completedToken = 0;
+	return true;
+}
+
+//staging memory goes back to the arena, command buffers and sync objects to the free list
+static void retire_batch(UploadQueue* queue, const VulkanGlobalContext& vkCtx, UploadBatch* batch)
+{
+	queue->staging.tail = batch->stagingEnd;
+	batch->bufferBarriers.clear();
+	batch->imageBarriers.clear();
+
+	VK_CALL(vkResetFences(vkCtx.logicalDevice, 1, &batch->fence));
+	VK_CALL(vkResetCommandBuffer(batch->transferCmd, 0));
+	if(batch->acquireCmd != VK_NULL_HANDLE)
+	{
+		VK_CALL(vkResetCommandBuffer(batch->acquireCmd, 0));
+	}
+	queue->freeBatches.push_back(std::move(*batch));
+}
+
+void destroy_upload_queue(const VulkanGlobalContext& vkCtx, UploadQueue* queue)
+{
+	assert(queue);
+	if(queue->isRecording)
+	{
+		magma::log::warn("Dropping {} uploads that were never submitted",
+			queue->recording.bufferBarriers.size() + queue->recording.imageBarriers.size());
+		VK_CALL(vkEndCommandBuffer(queue->recording.transferCmd));
+		queue->recording.stagingEnd = queue->staging.head;
+		retire_batch(queue, vkCtx, &queue->recording);
+		queue->isRecording = false;
+	}
+	wait_for_upload(queue, vkCtx, queue->nextToken - 1);
+
+	for(auto& batch : queue->freeBatches)
+	{
+		vkDestroyFence(vkCtx.logicalDevice, batch.fence, nullptr);
+		vkDestroySemaphore(vkCtx.logicalDevice, batch.transferDone, nullptr);
+	}
+	queue->freeBatches.clear();
+
+	destroy_buffer(vkCtx.logicalDevice, &queue->staging.buffer);
+
+	//frees the command buffers too
+	destroy_command_pool(vkCtx.logicalDevice, queue->transferPool);
+	if(queue->acquirePool != VK_NULL_HANDLE)
+	{
+		destroy_command_pool(vkCtx.logicalDevice, queue->acquirePool);
+	}
+	*queue = {};
+}
+
+bool upload_to_buffer(UploadQueue* queue, const VulkanGlobalContext& vkCtx, const void* data, VkDeviceSize size,
+	const Buffer& dst, VkDeviceSize dstOffset, VkPipelineStageFlags dstStages, VkAccessFlags dstAccess)
+{
+	assert(queue && data && size && dstStages);
+	assert(dstOffset + size <= dst.bufferSize);
+
+	const uint8_t* bytes = static_cast<const uint8_t*>(data);
+	for(VkDeviceSize copied = 0; copied < size;)
+	{
+		const VkDeviceSize chunkSize = std::min(size - copied, queue->staging.capacity);
+		VkDeviceSize stagingOffset = 0;
+		if(!allocate_staging(queue, vkCtx, chunkSize, &stagingOffset))
+			return false;
+		std::memcpy(queue->staging.mappedData + stagingOffset, bytes + copied, chunkSize);
+
+		begin_recording(queue, vkCtx);
+		UploadBatch& batch = queue->recording;
+
+		VkBufferCopy bufferCopy = {};
+		bufferCopy.srcOffset = stagingOffset;
+		bufferCopy.dstOffset = dstOffset + copied;
+		bufferCopy.size = chunkSize;
+		vkCmdCopyBuffer(batch.transferCmd, queue->staging.buffer.buffer, dst.buffer, 1, &bufferCopy);
+
+		//every batch hands over the range it copied
+		VkBufferMemoryBarrier bufferMemBarrier = {};
+		bufferMemBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+		bufferMemBarrier.pNext = nullptr;
+		bufferMemBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		bufferMemBarrier.dstAccessMask = dstAccess;
+		set_barrier_queue_families(*queue, vkCtx, &bufferMemBarrier.srcQueueFamilyIndex, &bufferMemBarrier.dstQueueFamilyIndex);
+		bufferMemBarrier.buffer = dst.buffer;
+		bufferMemBarrier.offset = bufferCopy.dstOffset;
+		bufferMemBarrier.size = chunkSize;
+
+		batch.bufferBarriers.push_back(bufferMemBarrier);
+		batch.dstStages |= dstStages;
+		copied += chunkSize;
+	}
+	return true;
+}
+
+//bytes of data each region reads, up to the next region's offset or the end of data
+static void get_region_sizes(const VkBufferImageCopy* regions, uint32_t regionCount, VkDeviceSize size, std::vector<VkDeviceSize>* out)
+{
+	std::vector<uint32_t> order(regionCount);
+	std::iota(order.begin(), order.end(), 0);
+	std::sort(order.begin(), order.end(), [regions](uint32_t a, uint32_t b)
+	{
+		return regions[a].bufferOffset < regions[b].bufferOffset;
+	});
+
+	out->resize(regionCount);
+	for(uint32_t i = 0; i < regionCount; i++)
+	{
+		const VkDeviceSize offset = regions[order[i]].bufferOffset;
+		VkDeviceSize end = size;
+		for(uint32_t next = i + 1; next < regionCount; next++)
+		{
+			if(regions[order[next]].bufferOffset > offset)
+			{
+				end = regions[order[next]].bufferOffset;
+				break;
+			}
+		}
+		(*out)[order[i]] = end - offset;
+	}
+}
+
+//texel block of formats images get uploaded with, blockDim is 4 for block compressed ones
+static bool get_texel_block(VkFormat format, uint32_t* blockDim, uint32_t* blockBytes)
+{
+	*blockDim = 1;
+	switch(format)
+	{
+		case VK_FORMAT_R8_UNORM: *blockBytes = 1; return true;
+		case VK_FORMAT_R8G8_UNORM: *blockBytes = 2; return true;
+		case VK_FORMAT_R8G8B8A8_UNORM:
+		case VK_FORMAT_R8G8B8A8_SRGB:
+		case VK_FORMAT_R8G8B8A8_UINT:
+		case VK_FORMAT_B8G8R8A8_UNORM:
+		case VK_FORMAT_B8G8R8A8_SRGB:
+		case VK_FORMAT_R16G16_SFLOAT:
+		case VK_FORMAT_R16G16_SNORM:
+		case VK_FORMAT_R32_SFLOAT: *blockBytes = 4; return true;
+		case VK_FORMAT_R16G16B16A16_UNORM:
+		case VK_FORMAT_R16G16B16A16_SFLOAT:
+		case VK_FORMAT_R32G32_SFLOAT: *blockBytes = 8; return true;
+		case VK_FORMAT_R32G32B32A32_SFLOAT: *blockBytes = 16; return true;
+		default: break;
+	}
+
+	*blockDim = 4;
+	switch(format)
+	{
+		case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+		case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+		case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+		case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+		case VK_FORMAT_BC4_UNORM_BLOCK:
+		case VK_FORMAT_BC4_SNORM_BLOCK: *blockBytes = 8; return true;
+		case VK_FORMAT_BC2_UNORM_BLOCK:
+		case VK_FORMAT_BC2_SRGB_BLOCK:
+		case VK_FORMAT_BC3_UNORM_BLOCK:
+		case VK_FORMAT_BC3_SRGB_BLOCK:
+		case VK_FORMAT_BC5_UNORM_BLOCK:
+		case VK_FORMAT_BC5_SNORM_BLOCK:
+		case VK_FORMAT_BC6H_UFLOAT_BLOCK:
+		case VK_FORMAT_BC6H_SFLOAT_BLOCK:
+		case VK_FORMAT_BC7_UNORM_BLOCK:
+		case VK_FORMAT_BC7_SRGB_BLOCK: *blockBytes = 16; return true;
+		default: return false;
+	}
+}
+
+//a copy with its offset relative to the caller's data and the bytes it reads from there
+struct StagedRegion
+{
+	VkBufferImageCopy copy;
+	VkDeviceSize size;
+};
+
+static uint32_t round_down_to_granularity(uint32_t count, uint32_t granularity)
+{
+	return granularity ? count / granularity * granularity : 0;
+}
+
+//splits a region larger than the arena into runs of whole layers or depth slices,
+//and a single slice that is still too large into runs of block rows.
+//Runs of a region covering a whole level start and end on multiples of the transfer granularity, which is
+//in blocks for compressed formats, apart from the last one ending at the edge. A granularity of 0 allows whole levels only
+static bool split_image_region(const VkBufferImageCopy& region, VkFormat format, VkExtent3D granularity, VkDeviceSize capacity,
+	std::vector<StagedRegion>* out)
+{
+	uint32_t blockDim = 1;
+	uint32_t blockBytes = 0;
+	if(!get_texel_block(format, &blockDim, &blockBytes))
+	{
+		magma::log::error("Image region of format {} doesn't fit into {} byte staging arena and can't be split", uint32_t(format), capacity);
+		return false;
+	}
+
+	const uint32_t rowLength = region.bufferRowLength ? region.bufferRowLength : region.imageExtent.width;
+	const uint32_t imageHeight = region.bufferImageHeight ? region.bufferImageHeight : region.imageExtent.height;
+	const VkDeviceSize rowPitch = VkDeviceSize((rowLength + blockDim - 1) / blockDim) * blockBytes;
+	const VkDeviceSize slicePitch = VkDeviceSize((imageHeight + blockDim - 1) / blockDim) * rowPitch;
+	const VkDeviceSize rowBytes = VkDeviceSize((region.imageExtent.width + blockDim - 1) / blockDim) * blockBytes;
+	const uint32_t blockRows = (region.imageExtent.height + blockDim - 1) / blockDim;
+
+	//array layers and depth slices of 3d images are laid out the same way, an image has only one of them
+	const bool layered = region.imageSubresource.layerCount > 1;
+	const uint32_t sliceCount = layered ? region.imageSubresource.layerCount : region.imageExtent.depth;
+	auto get_size = [=](uint32_t slices, uint32_t rows)
+	{
+		return (slices - 1) * slicePitch + (rows - 1) * rowPitch + rowBytes;
+	};
+
+	//layers are separate subresources, only depth slices are bound by the granularity
+	const uint32_t sliceGranularity = layered ? 1 : granularity.depth;
+	if(get_size(1, blockRows) <= capacity)
+	{
+		const uint32_t slicesPerCopy = round_down_to_granularity(
+			std::max<uint32_t>(1, uint32_t(std::min<VkDeviceSize>(capacity / slicePitch, sliceCount))), sliceGranularity);
+		if(slicesPerCopy == 0)
+		{
+			magma::log::error("Depth slices can't be split by transfer granularity {} within {} byte staging arena", granularity.depth, capacity);
+			return false;
+		}
+		for(uint32_t slice = 0; slice < sliceCount; slice += slicesPerCopy)
+		{
+			const uint32_t slices = std::min(slicesPerCopy, sliceCount - slice);
+			StagedRegion staged = {region, get_size(slices, blockRows)};
+			staged.copy.bufferOffset += slice * slicePitch;
+			if(layered)
+			{
+				staged.copy.imageSubresource.baseArrayLayer += slice;
+				staged.copy.imageSubresource.layerCount = slices;
+			}
+			else
+			{
+				staged.copy.imageOffset.z += slice;
+				staged.copy.imageExtent.depth = slices;
+			}
+			out->push_back(staged);
+		}
+		return true;
+	}
+
+	if(rowBytes > capacity)
+	{
+		magma::log::error("Row of {} bytes doesn't fit into {} byte staging arena", rowBytes, capacity);
+		return false;
+	}
+	//offsets and heights stay multiples of the block, only the last run may end at the image edge
+	const uint32_t rowsPerCopy = round_down_to_granularity(
+		std::max<uint32_t>(1, uint32_t((capacity - rowBytes) / rowPitch + 1)), granularity.height);
+	if(rowsPerCopy == 0 || (sliceCount > 1 && sliceGranularity != 1))
+	{
+		magma::log::error("Rows of {} bytes can't be split by transfer granularity {}x{} within {} byte staging arena",
+			rowBytes, granularity.height, granularity.depth, capacity);
+		return false;
+	}
+	for(uint32_t slice = 0; slice < sliceCount; slice++)
+	{
+		for(uint32_t row = 0; row < blockRows; row += rowsPerCopy)
+		{
+			const uint32_t rows = std::min(rowsPerCopy, blockRows - row);
+			StagedRegion staged = {region, get_size(1, rows)};
+			staged.copy.bufferOffset += slice * slicePitch + row * rowPitch;
+			staged.copy.bufferImageHeight = 0;
+			if(layered)
+			{
+				staged.copy.imageSubresource.baseArrayLayer += slice;
+				staged.copy.imageSubresource.layerCount = 1;
+			}
+			else
+			{
+				staged.copy.imageOffset.z += slice;
+				staged.copy.imageExtent.depth = 1;
+			}
+			staged.copy.imageOffset.y += row * blockDim;
+			staged.copy.imageExtent.height = std::min(rows * blockDim, region.imageExtent.height - row * blockDim);
+			out->push_back(staged);
+		}
+	}
+	return true;
+}
+
+bool upload_to_image(UploadQueue* queue, const VulkanGlobalContext& vkCtx, const void* data, VkDeviceSize size,
+	const VkBufferImageCopy* regions, uint32_t regionCount, ImageResource* image)
+{
+	assert(queue && data && size && regions && regionCount && image);
+
+	std::vector<VkDeviceSize> regionSizes;
+	get_region_sizes(regions, regionCount, size, &regionSizes);
+	std::vector<StagedRegion> stagedRegions;
+	stagedRegions.reserve(regionCount);
+	for(uint32_t i = 0; i < regionCount; i++)
+	{
+		if(regionSizes[i] <= queue->staging.capacity)
+		{
+			stagedRegions.push_back({regions[i], regionSizes[i]});
+		}
+		else if(!split_image_region(regions[i], image->format, queue->imageGranularity, queue->staging.capacity, &stagedRegions))
+		{
+			return false;
+		}
+	}
+
+	VkImageMemoryBarrier imageMemBarrier = {};
+	imageMemBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	imageMemBarrier.pNext = nullptr;
+	imageMemBarrier.srcAccessMask = 0;
+	imageMemBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	imageMemBarrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	imageMemBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	imageMemBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	imageMemBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	imageMemBarrier.image = image->image;
+	imageMemBarrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	imageMemBarrier.subresourceRange.baseMipLevel = 0;
+	imageMemBarrier.subresourceRange.levelCount = image->mipLevels;
+	imageMemBarrier.subresourceRange.baseArrayLayer = 0;
+	imageMemBarrier.subresourceRange.layerCount = image->layerCount;
+
+	const uint8_t* bytes = static_cast<const uint8_t*>(data);
+	for(uint32_t i = 0; i < stagedRegions.size(); i++)
+	{
+		const StagedRegion& staged = stagedRegions[i];
+		VkDeviceSize stagingOffset = 0;
+		if(!allocate_staging(queue, vkCtx, staged.size, &stagingOffset))
+			return false;
+		std::memcpy(queue->staging.mappedData + stagingOffset, bytes + staged.copy.bufferOffset, staged.size);
+
+		begin_recording(queue, vkCtx);
+		if(i == 0)
+		{
+			vkCmdPipelineBarrier(
+				queue->recording.transferCmd,
+				VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+				VK_PIPELINE_STAGE_TRANSFER_BIT,
+				0,
+				0, nullptr,
+				0, nullptr,
+				1, &imageMemBarrier
+			);
+		}
+
+		//batches on one queue execute in order, so regions staged by later batches still find the image in transfer layout
+		VkBufferImageCopy region = staged.copy;
+		region.bufferOffset = stagingOffset;
+		vkCmdCopyBufferToImage(queue->recording.transferCmd, queue->staging.buffer.buffer, image->image,
+			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+	}
+
+	//layout transition to shader read is part of the ownership transfer, done by the batch with the last region
+	imageMemBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	imageMemBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	imageMemBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	imageMemBarrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	set_barrier_queue_families(*queue, vkCtx, &imageMemBarrier.srcQueueFamilyIndex, &imageMemBarrier.dstQueueFamilyIndex);
+
+	UploadBatch& batch = queue->recording;
+	batch.imageBarriers.push_back(imageMemBarrier);
+	batch.dstStages |= VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+	image->layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	return true;
+}
+
+static void submit_commands(VkQueue submitQueue, VkCommandBuffer cmdBuff, VkSemaphore waitSemaphore, VkPipelineStageFlags waitStages,
+	VkSemaphore signalSemaphore, VkFence fence)
+{
+	VkSubmitInfo submitInfo = {};
+	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submitInfo.pNext = nullptr;
+	submitInfo.waitSemaphoreCount = waitSemaphore != VK_NULL_HANDLE ? 1 : 0;
+	submitInfo.pWaitSemaphores = &waitSemaphore;
+	submitInfo.pWaitDstStageMask = &waitStages;
+	submitInfo.commandBufferCount = 1;
+	submitInfo.pCommandBuffers = &cmdBuff;
+	submitInfo.signalSemaphoreCount = signalSemaphore != VK_NULL_HANDLE ? 1 : 0;
+	submitInfo.pSignalSemaphores = &signalSemaphore;
+	VK_CALL(vkQueueSubmit(submitQueue, 1, &submitInfo, fence));
+}
+
+UploadToken submit_uploads(UploadQueue* queue, const VulkanGlobalContext& vkCtx)
+{
+	assert(queue);
+	if(!queue->isRecording)
+		return queue->nextToken - 1;
+
+	UploadBatch& batch = queue->recording;
+	const uint32_t bufferBarrierCount = static_cast<uint32_t>(batch.bufferBarriers.size());
+	const uint32_t imageBarrierCount = static_cast<uint32_t>(batch.imageBarriers.size());
+
+	if(bufferBarrierCount + imageBarrierCount == 0)
+	{
+		//arena filled up in the middle of an image, the batch finishing it hands over these copies too
+		VK_CALL(vkEndCommandBuffer(batch.transferCmd));
+		submit_commands(vkCtx.transferQueue, batch.transferCmd, VK_NULL_HANDLE, 0, VK_NULL_HANDLE, batch.fence);
+	}
+	else if(queue->ownershipTransfer)
+	{
+		//release: destination access belongs to the acquire, the semaphore orders the two queues
+		std::vector<VkBufferMemoryBarrier> releaseBufferBarriers = batch.bufferBarriers;
+		std::vector<VkImageMemoryBarrier> releaseImageBarriers = batch.imageBarriers;
+		for(auto& barrier : releaseBufferBarriers)
+		{
+			barrier.dstAccessMask = 0;
+		}
+		for(auto& barrier : releaseImageBarriers)
+		{
+			barrier.dstAccessMask = 0;
+		}
+
+		vkCmdPipelineBarrier(
+			batch.transferCmd,
+			VK_PIPELINE_STAGE_TRANSFER_BIT,
+			VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+			0,
+			0, nullptr,
+			bufferBarrierCount, releaseBufferBarriers.data(),
+			imageBarrierCount, releaseImageBarriers.data()
+		);
+		VK_CALL(vkEndCommandBuffer(batch.transferCmd));
+		submit_commands(vkCtx.transferQueue, batch.transferCmd, VK_NULL_HANDLE, 0, batch.transferDone, VK_NULL_HANDLE);
+
+		//acquire: same barriers without the source access, chained to the semaphore wait through dstStages
+		for(auto& barrier : batch.bufferBarriers)
+		{
+			barrier.srcAccessMask = 0;
+		}
+		for(auto& barrier : batch.imageBarriers)
+		{
+			barrier.srcAccessMask = 0;
+		}
+
+		begin_commands(batch.acquireCmd);
+		vkCmdPipelineBarrier(
+			batch.acquireCmd,
+			batch.dstStages,
+			batch.dstStages,
+			0,
+			0, nullptr,
+			bufferBarrierCount, batch.bufferBarriers.data(),
+			imageBarrierCount, batch.imageBarriers.data()
+		);
+		VK_CALL(vkEndCommandBuffer(batch.acquireCmd));
+		submit_commands(vkCtx.graphicsQueue, batch.acquireCmd, batch.transferDone, batch.dstStages, VK_NULL_HANDLE, batch.fence);
+	}
+	else
+	{
+		vkCmdPipelineBarrier(
+			batch.transferCmd,
+			VK_PIPELINE_STAGE_TRANSFER_BIT,
+			batch.dstStages,
+			0,
+			0, nullptr,
+			bufferBarrierCount, batch.bufferBarriers.data(),
+			imageBarrierCount, batch.imageBarriers.data()
+		);
+		VK_CALL(vkEndCommandBuffer(batch.transferCmd));
+		submit_commands(vkCtx.transferQueue, batch.transferCmd, VK_NULL_HANDLE, 0, VK_NULL_HANDLE, batch.fence);
+	}
+
+	batch.stagingEnd = queue->staging.head;
+	const UploadToken token = batch.token;
+	queue->pendingBatches.push_back(std::move(batch));
+	queue->isRecording = false;
+	queue->nextToken++;
+	return token;
+}
+
+bool is_upload_complete(UploadQueue* queue, const VulkanGlobalContext& vkCtx, UploadToken token)
+{
+	assert(queue);
+	while(!queue->pendingBatches.empty() && vkGetFenceStatus(vkCtx.logicalDevice, queue->pendingBatches.front().fence) == VK_SUCCESS)
+	{
+		queue->completedToken = queue->pendingBatches.front().token;
+		retire_batch(queue, vkCtx, &queue->pendingBatches.front());
+		queue->pendingBatches.pop_front();
+	}
+	return token <= queue->completedToken;
+}
+
+void wait_for_upload(UploadQueue* queue, const VulkanGlobalContext& vkCtx, UploadToken token)
+{
+	assert(queue);
+	if(queue->isRecording && token >= queue->recording.token)
+	{
+		submit_uploads(queue, vkCtx);
+	}
+
+	while(!queue->pendingBatches.empty() && queue->pendingBatches.front().token <= token)
+	{
+		UploadBatch& batch = queue->pendingBatches.front();
+		VK_CALL(vkWaitForFences(vkCtx.logicalDevice, 1, &batch.fence, VK_TRUE, UINT64_MAX));
+		queue->completedToken = batch.token;
+		retire_batch(queue, vkCtx, &batch);
+		queue->pendingBatches.pop_front();
+	}
+}
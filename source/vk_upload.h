@@ -0,0 +1,85 @@
+#ifndef MAGMA_VK_UPLOAD_H
+#define MAGMA_VK_UPLOAD_H
+
+#include "vk_types.h"
+
+#include <deque>
+#include <vector>
+
+static constexpr VkDeviceSize DEFAULT_STAGING_ARENA_SIZE = 64ull << 20;
+
+//batches finish in submission order, so a token is complete once every token before it is
+typedef uint64_t UploadToken;
+
+//one persistently mapped host buffer every upload is staged through, allocated linearly and wrapping around.
+//Offsets only grow, the place in the buffer is offset % capacity
+struct StagingArena
+{
+	Buffer buffer;
+	uint8_t* mappedData;
+	VkDeviceSize capacity;
+	VkDeviceSize alignment;//of every allocation, covers buffer to image copy offsets
+	VkDeviceSize head;
+	VkDeviceSize tail;//start of the oldest staging still read by a batch in flight
+};
+
+//copies recorded into one transfer command buffer and submitted together.
+//With separate families the graphics queue gets a second command buffer acquiring ownership of the destinations
+struct UploadBatch
+{
+	VkCommandBuffer transferCmd;
+	VkCommandBuffer acquireCmd;
+	VkSemaphore transferDone;//acquire submission waits on it
+	VkFence fence;//signalled once destinations are usable on the graphics queue
+	VkDeviceSize stagingEnd;//arena tail moves here when the batch retires
+	std::vector<VkBufferMemoryBarrier> bufferBarriers;//recorded as release and again as acquire
+	std::vector<VkImageMemoryBarrier> imageBarriers;
+	VkPipelineStageFlags dstStages;//where destinations are first used
+	UploadToken token;
+};
+
+//not thread safe, enqueue, submit and wait from the thread owning it
+struct UploadQueue
+{
+	VkCommandPool transferPool;
+	VkCommandPool acquirePool;//graphics family, only used when transfer family differs
+	bool ownershipTransfer;
+	StagingArena staging;
+	VkExtent3D imageGranularity;//minImageTransferGranularity of the transfer family, image regions are split by it
+	UploadBatch recording;
+	bool isRecording;
+	std::deque<UploadBatch> pendingBatches;//submitted, oldest first
+	std::vector<UploadBatch> freeBatches;//retired, command buffers and fences get reused
+	UploadToken nextToken;//token the recording batch gets
+	UploadToken completedToken;
+};
+
+//stagingSize bounds host memory used for uploads no matter how large they are
+bool init_upload_queue(const VulkanGlobalContext& vkCtx, VkDeviceSize stagingSize, UploadQueue* queue);
+
+//waits for every submitted batch, uploads still being recorded are dropped
+void destroy_upload_queue(const VulkanGlobalContext& vkCtx, UploadQueue* queue);
+
+//copies data to [dstOffset, dstOffset + size) of dst, which needs TRANSFER_DST usage.
+//dstStages and dstAccess describe the first use of the data after the upload, e.g. vertex input and attribute reads.
+//Data larger than the staging arena is split into chunks, when the arena is full the oldest batch is waited on and recycled
+bool upload_to_buffer(UploadQueue* queue, const VulkanGlobalContext& vkCtx, const void* data, VkDeviceSize size,
+	const Buffer& dst, VkDeviceSize dstOffset, VkPipelineStageFlags dstStages, VkAccessFlags dstAccess);
+
+//copies regions, with buffer offsets relative to data, into every level of the image and leaves it in shader read layout.
+//Mips have to be in data already, a transfer only queue can't blit them.
+//Regions are staged one by one and may end up in different batches, ones larger than the arena are split by layers or rows
+bool upload_to_image(UploadQueue* queue, const VulkanGlobalContext& vkCtx, const void* data, VkDeviceSize size,
+	const VkBufferImageCopy* regions, uint32_t regionCount, ImageResource* image);
+
+//submits everything enqueued since the last submit, returns the token to wait on.
+//Returns the last submitted token when nothing was enqueued
+UploadToken submit_uploads(UploadQueue* queue, const VulkanGlobalContext& vkCtx);
+
+//polls without blocking and frees staging memory of finished batches
+bool is_upload_complete(UploadQueue* queue, const VulkanGlobalContext& vkCtx, UploadToken token);
+
+//submits the recording batch first if token belongs to it
+void wait_for_upload(UploadQueue* queue, const VulkanGlobalContext& vkCtx, UploadToken token);
+
+#endif
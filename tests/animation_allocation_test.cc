@@ -0,0 +1,279 @@
+#include "animation.h"
+#include "animation_compression.h"
+#include "blend_tree.h"
+#include "job_system.h"
+#include "test_animation.h"
+#include "test_utils.h"
+
+#include <atomic>
+#include <cmath>
+#include <cstdlib>
+#include <new>
+#include <vector>
+
+static std::atomic<uint64_t> allocationCount = {0};
+
+//every form of new goes through malloc and every form of delete through free, so the pairs always match
+static void* counted_malloc(std::size_t size)
+{
+	allocationCount.fetch_add(1, std::memory_order_relaxed);
+	void* memory = std::malloc(size ? size : 1);
+	if(!memory)
+	{
+		throw std::bad_alloc();
+	}
+	return memory;
+}
+
+void* operator new(std::size_t size)
+{
+	return counted_malloc(size);
+}
+
+void* operator new[](std::size_t size)
+{
+	return counted_malloc(size);
+}
+
+void operator delete(void* memory) noexcept
+{
+	std::free(memory);
+}
+
+void operator delete[](void* memory) noexcept
+{
+	std::free(memory);
+}
+
+void operator delete(void* memory, std::size_t) noexcept
+{
+	std::free(memory);
+}
+
+void operator delete[](void* memory, std::size_t) noexcept
+{
+	std::free(memory);
+}
+
+static constexpr uint32_t JOINT_COUNT = 32;
+static constexpr uint32_t INSTANCE_COUNT = 256;
+static constexpr uint32_t WARMUP_FRAMES = 4;
+static constexpr uint32_t MEASURED_FRAMES = 200;
+
+//the way fishVertDQ skins a position: into root space, blended dual quaternion, back out by the post transform
+static Vec3 skin_dual_quat(const DualQuatSkinningSpace& space, const DualQuat* jointDualQuats, const uint32_t* jointIds, const float* weights,
+	uint32_t influenceCount, const Vec3& position)
+{
+	const DualQuat& first = jointDualQuats[jointIds[0]];
+	Quat real = {};
+	Quat dual = {};
+	for(uint32_t i = 0; i < influenceCount; i++)
+	{
+		const DualQuat& dq = jointDualQuats[jointIds[i]];
+		const float weight = dotVec4(first.real.xyzw, dq.real.xyzw) < 0.f ? -weights[i] : weights[i];
+		real.xyzw = real.xyzw + dq.real.xyzw * weight;
+		dual.xyzw = dual.xyzw + dq.dual.xyzw * weight;
+	}
+	const float invLength = 1.f / lengthQuat(real);
+	real = real * invLength;
+	dual = dual * invLength;
+
+	const Vec4 rootSpace = Vec4{position.x, position.y, position.z, 1.f} * space.preTransform;
+	const Vec3 point = Vec3{rootSpace.x, rootSpace.y, rootSpace.z};
+	const Vec3 translation = 2.f * (real.scalar * dual.complex - dual.scalar * real.complex + cross(real.complex, dual.complex));
+	const Vec3 rotated = point + 2.f * cross(real.complex, cross(real.complex, point) + real.scalar * point);
+	const Vec3 skinned = rotated + translation;
+	const Vec4 out = Vec4{skinned.x, skinned.y, skinned.z, 1.f} * space.postTransform;
+	return Vec3{out.x, out.y, out.z};
+}
+
+static Vec3 skin_linear(const mat4x4* jointMatrices, const uint32_t* jointIds, const float* weights, uint32_t influenceCount, const Vec3& position)
+{
+	Vec3 out = {};
+	for(uint32_t i = 0; i < influenceCount; i++)
+	{
+		const Vec4 skinned = Vec4{position.x, position.y, position.z, 1.f} * jointMatrices[jointIds[i]];
+		out = out + Vec3{skinned.x, skinned.y, skinned.z} * weights[i];
+	}
+	return out;
+}
+
+//rigid unit scale joints skin the same with either palette
+static void test_dual_quat_matches_linear(const Animation& animation)
+{
+	AnimationInstance instance = {};
+	init_animation_instance(animation, 0, 1.f, &instance);
+	std::vector<mat4x4> jointMatrices(JOINT_COUNT);
+	std::vector<DualQuat> jointDualQuats(JOINT_COUNT);
+	DualQuatSkinningSpace space = {};
+	TEST_CHECK(supports_dual_quat_skinning(animation));
+
+	const Vec3 positions[] = {{0.f, 0.f, 0.f}, {1.f, 0.5f, -0.25f}, {-0.3f, 2.f, 0.7f}};
+	float maxError = 0.f;
+	for(uint32_t frame = 0; frame < 20; frame++)
+	{
+		update_animation(&instance, 1.f / 30.f, jointMatrices.data());
+		convert_palette_to_dual_quats(animation, jointMatrices.data(), &space, jointDualQuats.data());
+		for(uint32_t joint = 0; joint < JOINT_COUNT; joint++)
+		{
+			const float weight = 1.f;
+			for(const Vec3& position : positions)
+			{
+				const Vec3 linear = skin_linear(jointMatrices.data(), &joint, &weight, 1, position);
+				const Vec3 dualQuat = skin_dual_quat(space, jointDualQuats.data(), &joint, &weight, 1, position);
+				maxError = std::max(maxError, lengthVec3(linear - dualQuat));
+			}
+		}
+	}
+	TEST_CHECK(maxError <= 1e-4f);
+}
+
+//vertices halfway between a joint and its child twisted by 90 degrees keep their distance from the twist axis,
+//where linear blending collapses them to cos(45) of it
+static void test_dual_quat_twist_volume()
+{
+	Animation animation = {};
+	animation.bindPose.resize(2);
+	for(uint32_t i = 0; i < 2; i++)
+	{
+		Joint& joint = animation.bindPose[i];
+		joint.parentId = i == 0 ? -1 : 0;
+		joint.restTransform.rotation = identityQuat();
+		joint.restTransform.translation = Vec3{i == 0 ? 0.f : 1.f, 0.f, 0.f};
+		joint.restTransform.scale = Vec3{1.f, 1.f, 1.f};
+		joint.restTransform.channelBits = CHANNEL_ROTATE_BIT|CHANNEL_SCALE_BIT|CHANNEL_TRANSLATE_BIT;
+		joint.invBindTransform = loadIdentity();
+	}
+	animation.bindPose[1].invBindTransform = inverse(loadTranslation(Vec3{1.f, 0.f, 0.f}));
+	build_joint_order(&animation);
+
+	AnimationClip clip = {};
+	clip.name = "twist";
+	clip.duration = 1.f;
+	clip.isAdditive = false;
+	AnimationTrack track = {};
+	track.jointId = 1;
+	track.channel = CHANNEL_ROTATE_BIT;
+	track.interpolation = INTERPOLATION_LINEAR;
+	const Quat twist = quatFromAxisAndAngle(Vec3{1.f, 0.f, 0.f}, 90.f);
+	track.timeCodes = {0.f, 1.f};
+	track.values = {twist.x, twist.y, twist.z, twist.w, twist.x, twist.y, twist.z, twist.w};
+	clip.tracks.push_back(track);
+	animation.clips.push_back(clip);
+
+	AnimationInstance instance = {};
+	init_animation_instance(animation, 0, 1.f, &instance);
+	mat4x4 jointMatrices[2] = {};
+	DualQuat jointDualQuats[2] = {};
+	DualQuatSkinningSpace space = {};
+	update_animation(&instance, 0.f, jointMatrices);
+	convert_palette_to_dual_quats(animation, jointMatrices, &space, jointDualQuats);
+
+	const uint32_t jointIds[2] = {0, 1};
+	const float weights[2] = {0.5f, 0.5f};
+	float minLinearRadius = 1.f;
+	float maxDualQuatRadiusError = 0.f;
+	for(uint32_t i = 0; i < 16; i++)
+	{
+		const float angle = 2.f * float(M_PI) * i / 16;
+		const Vec3 position = Vec3{1.f, std::cos(angle), std::sin(angle)};
+		const Vec3 linear = skin_linear(jointMatrices, jointIds, weights, 2, position);
+		const Vec3 dualQuat = skin_dual_quat(space, jointDualQuats, jointIds, weights, 2, position);
+		minLinearRadius = std::min(minLinearRadius, std::sqrt(linear.y * linear.y + linear.z * linear.z));
+		maxDualQuatRadiusError = std::max(maxDualQuatRadiusError, std::fabs(std::sqrt(dualQuat.y * dualQuat.y + dualQuat.z * dualQuat.z) - 1.f));
+		TEST_CHECK(std::fabs(dualQuat.x - 1.f) <= 1e-4f);
+	}
+	TEST_CHECK(maxDualQuatRadiusError <= 1e-4f);
+	TEST_CHECK(minLinearRadius <= 0.75f);
+}
+
+//frames after warm up must not touch the heap, whatever the update rate, worker count or blend tree
+int main()
+{
+	magma::log::set_severity_mask(magma::log::MASK_INFO);
+
+	Animation animation = {};
+	build_test_animation(JOINT_COUNT, 1.f, 30, &animation);
+	test_dual_quat_matches_linear(animation);
+	test_dual_quat_twist_volume();
+
+	std::vector<AnimationInstance> instances(INSTANCE_COUNT);
+	for(uint32_t i = 0; i < INSTANCE_COUNT; i++)
+	{
+		init_animation_instance(animation, 0, 0.5f + (i % 8) / 8.f, &instances[i]);
+		instances[i].updateInterval = 1u << (i % 4);
+		instances[i].extrapolatePalette = i % 2 == 0;
+	}
+	std::vector<mat4x4> palette(std::size_t(INSTANCE_COUNT) * JOINT_COUNT);
+	Animation compressed = animation;
+	compress_animation_clips(&compressed, AnimationCompressionSettings{});
+	AnimationInstance compressedInstance = {};
+	init_animation_instance(compressed, 0, 1.f, &compressedInstance);
+	std::vector<DualQuat> dualQuats(JOINT_COUNT);
+	DualQuatSkinningSpace skinningSpace = {};
+
+	//single instance paths, sampling raw and compressed clips
+	for(uint32_t frame = 0; frame < WARMUP_FRAMES + MEASURED_FRAMES; frame++)
+	{
+		if(frame == WARMUP_FRAMES)
+		{
+			allocationCount = 0;
+		}
+		for(uint32_t i = 0; i < INSTANCE_COUNT; i++)
+		{
+			update_animation(&instances[i], 1.f / 60.f, &palette[std::size_t(i) * JOINT_COUNT]);
+		}
+		update_animation_dual_quat(&instances[0], 1.f / 60.f, &skinningSpace, dualQuats.data());
+		update_animation(&compressedInstance, 1.f / 60.f, palette.data());
+	}
+	TEST_CHECK(allocationCount == 0);
+
+	//batch update with the calling thread alone and with workers helping
+	const uint32_t workerCounts[] = {0, 1, 3};
+	for(uint32_t workerCount : workerCounts)
+	{
+		JobSystem jobSystem = {};
+		init_job_system(workerCount, &jobSystem);
+		for(uint32_t frame = 0; frame < WARMUP_FRAMES + MEASURED_FRAMES; frame++)
+		{
+			if(frame == WARMUP_FRAMES)
+			{
+				allocationCount = 0;
+			}
+			update_animations_batch(&jobSystem, instances.data(), INSTANCE_COUNT, 1.f / 60.f, palette.data(), JOINT_COUNT);
+		}
+		const uint64_t batchAllocations = allocationCount;
+		destroy_job_system(&jobSystem);
+		TEST_CHECK(batchAllocations == 0);
+	}
+
+	//blend trees cross-fading the clip against itself at another rate, and one sampling compressed clips
+	std::vector<BlendTreeInstance> blendInstances(INSTANCE_COUNT);
+	for(uint32_t i = 0; i < INSTANCE_COUNT; i++)
+	{
+		BlendTree& tree = blendInstances[i].tree;
+		const uint32_t walk = add_clip_node(&tree, 0);
+		const uint32_t run = add_clip_node(&tree, 0, 1.5f);
+		const uint32_t blend = add_lerp_node(&tree, walk, run, 0.f);
+		fade_blend_node(&tree, blend, 1.f, 1.f);
+		init_blend_tree_scratch(animation, tree, &blendInstances[i].scratch);
+	}
+	BlendTreeInstance compressedTree = blendInstances[0];
+	init_blend_tree_scratch(compressed, compressedTree.tree, &compressedTree.scratch);
+	JobSystem blendJobSystem = {};
+	init_job_system(2, &blendJobSystem);
+	for(uint32_t frame = 0; frame < WARMUP_FRAMES + MEASURED_FRAMES; frame++)
+	{
+		if(frame == WARMUP_FRAMES)
+		{
+			allocationCount = 0;
+		}
+		update_blend_trees_batch(&blendJobSystem, animation, blendInstances.data(), INSTANCE_COUNT, 1.f / 60.f, palette.data(), JOINT_COUNT);
+		update_blend_tree(compressed, &compressedTree.tree, &compressedTree.scratch, 1.f / 60.f, palette.data());
+	}
+	const uint64_t blendAllocations = allocationCount;
+	destroy_job_system(&blendJobSystem);
+	TEST_CHECK(blendAllocations == 0);
+
+	return finish_test("animation_allocation_test");
+}
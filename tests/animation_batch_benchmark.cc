@@ -0,0 +1,82 @@
+#include "animation.h"
+#include "blend_tree.h"
+#include "job_system.h"
+#include "logging.h"
+#include "test_animation.h"
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+static constexpr uint32_t INSTANCE_COUNT = 4096;
+static constexpr uint32_t JOINT_COUNT = 64;
+static constexpr uint32_t WARMUP_FRAMES = 10;
+static constexpr uint32_t MEASURED_FRAMES = 100;
+static constexpr uint32_t MIN_REPORTED_THREADS = 4;
+
+//updates the same crowd, playing single clips and then blend trees, with every thread count up to hardware threads.
+//Scaling is always reported up to MIN_REPORTED_THREADS, counts past hardware threads are marked oversubscribed
+int main()
+{
+	magma::log::set_severity_mask(magma::log::MASK_INFO);
+
+	Animation animation = {};
+	build_test_animation(JOINT_COUNT, 2.f, 30, &animation);
+
+	std::vector<AnimationInstance> instances(INSTANCE_COUNT);
+	for(uint32_t i = 0; i < INSTANCE_COUNT; i++)
+	{
+		init_animation_instance(animation, 0, 0.5f + (i % 16) / 16.f, &instances[i]);
+	}
+	std::vector<mat4x4> palette(std::size_t(INSTANCE_COUNT) * JOINT_COUNT);
+
+	std::vector<BlendTreeInstance> blendInstances(INSTANCE_COUNT);
+	for(uint32_t i = 0; i < INSTANCE_COUNT; i++)
+	{
+		BlendTree& tree = blendInstances[i].tree;
+		const uint32_t walk = add_clip_node(&tree, 0, 0.5f + (i % 16) / 16.f);
+		const uint32_t run = add_clip_node(&tree, 0, 1.5f);
+		add_lerp_node(&tree, walk, run, 0.5f);
+		init_blend_tree_scratch(animation, tree, &blendInstances[i].scratch);
+	}
+
+	const uint32_t hardwareThreads = std::max(1u, std::thread::hardware_concurrency());
+	const uint32_t threadCount = std::max(MIN_REPORTED_THREADS, hardwareThreads);
+	float singleThreadRate = 0.f;
+	float singleThreadBlendRate = 0.f;
+	for(uint32_t threads = 1; threads <= threadCount; threads++)
+	{
+		JobSystem jobSystem = {};
+		init_job_system(threads - 1, &jobSystem);
+
+		for(uint32_t frame = 0; frame < WARMUP_FRAMES; frame++)
+		{
+			update_animations_batch(&jobSystem, instances.data(), INSTANCE_COUNT, 1.f / 60.f, palette.data(), JOINT_COUNT);
+		}
+
+		auto start = std::chrono::steady_clock::now();
+		for(uint32_t frame = 0; frame < MEASURED_FRAMES; frame++)
+		{
+			update_animations_batch(&jobSystem, instances.data(), INSTANCE_COUNT, 1.f / 60.f, palette.data(), JOINT_COUNT);
+		}
+		const std::chrono::duration<float, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+
+		start = std::chrono::steady_clock::now();
+		for(uint32_t frame = 0; frame < MEASURED_FRAMES; frame++)
+		{
+			update_blend_trees_batch(&jobSystem, animation, blendInstances.data(), INSTANCE_COUNT, 1.f / 60.f, palette.data(), JOINT_COUNT);
+		}
+		const std::chrono::duration<float, std::milli> blendElapsed = std::chrono::steady_clock::now() - start;
+		destroy_job_system(&jobSystem);
+
+		const float instancesPerMs = INSTANCE_COUNT * MEASURED_FRAMES / elapsed.count();
+		const float blendInstancesPerMs = INSTANCE_COUNT * MEASURED_FRAMES / blendElapsed.count();
+		singleThreadRate = threads == 1 ? instancesPerMs : singleThreadRate;
+		singleThreadBlendRate = threads == 1 ? blendInstancesPerMs : singleThreadBlendRate;
+		magma::log::info("{} threads{}: {:.1f} instances/ms, {:.2f}x speedup; {:.1f} blend trees/ms, {:.2f}x speedup", threads,
+			threads > hardwareThreads ? " (oversubscribed)" : "",
+			instancesPerMs, instancesPerMs / singleThreadRate, blendInstancesPerMs, blendInstancesPerMs / singleThreadBlendRate);
+	}
+	return 0;
+}
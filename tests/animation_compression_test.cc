@@ -0,0 +1,123 @@
+#include "animation.h"
+#include "animation_compression.h"
+#include "blend_tree.h"
+#include "test_animation.h"
+#include "test_utils.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <vector>
+
+static constexpr uint32_t JOINT_COUNT = 64;
+static constexpr uint32_t DECODE_ITERATIONS = 2000;
+static constexpr float MIN_COMPRESSION_RATIO = 5.f;
+static constexpr float MAX_PALETTE_ERROR = 0.01f;
+
+//average time of sampling the whole clip, spread over the clip duration
+template<typename Sample>
+static float measure_ns_per_joint(float duration, Sample sample)
+{
+	const auto start = std::chrono::steady_clock::now();
+	for(uint32_t i = 0; i < DECODE_ITERATIONS; i++)
+	{
+		sample(duration * i / DECODE_ITERATIONS);
+	}
+	const std::chrono::duration<float, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+	return elapsed.count() / (DECODE_ITERATIONS * JOINT_COUNT);
+}
+
+int main()
+{
+	magma::log::set_severity_mask(magma::log::MASK_INFO);
+
+	Animation raw = {};
+	build_test_animation(JOINT_COUNT, 2.f, 30, &raw);
+	Animation compressed = raw;
+	const AnimationCompressionSettings settings = {};
+	AnimationCompressionStats stats = {};
+	compress_animation_clips(&compressed, settings, &stats);
+
+	//size and error bounds, key removal accounts for quantisation so tolerance holds for decoded clips
+	const float ratio = static_cast<float>(stats.rawBytes) / stats.compressedBytes;
+	magma::log::info("{} bytes compressed to {}, {:.1f}x", stats.rawBytes, stats.compressedBytes, ratio);
+	magma::log::info("max errors: rotation {}, translation {}, scale {}", stats.maxRotationError, stats.maxTranslationError, stats.maxScaleError);
+	TEST_CHECK(ratio >= MIN_COMPRESSION_RATIO);
+	TEST_CHECK(stats.maxRotationError <= settings.rotationTolerance);
+	TEST_CHECK(stats.maxTranslationError <= settings.translationTolerance);
+	TEST_CHECK(stats.maxScaleError <= settings.scaleTolerance);
+
+	//raw tracks are dropped unless settings keep them
+	TEST_CHECK(compressed.clips[0].tracks.empty());
+	TEST_CHECK(get_animation_memory_footprint(compressed) * MIN_COMPRESSION_RATIO <= get_animation_memory_footprint(raw));
+	AnimationCompressionSettings keepSettings = settings;
+	keepSettings.keepRawTracks = true;
+	Animation kept = raw;
+	compress_animation_clips(&kept, keepSettings, nullptr);
+	TEST_CHECK(kept.clips[0].tracks.size() == raw.clips[0].tracks.size());
+
+	//instances of the compressed animation decode it and stay close to the raw palette
+	AnimationInstance rawInstance = {};
+	AnimationInstance compressedInstance = {};
+	init_animation_instance(raw, 0, 1.f, &rawInstance);
+	init_animation_instance(compressed, 0, 1.f, &compressedInstance);
+	std::vector<mat4x4> rawPalette(JOINT_COUNT);
+	std::vector<mat4x4> compressedPalette(JOINT_COUNT);
+	float maxPaletteError = 0.f;
+	for(uint32_t frame = 0; frame < 240; frame++)
+	{
+		update_animation(&rawInstance, 1.f / 60.f, rawPalette.data());
+		update_animation(&compressedInstance, 1.f / 60.f, compressedPalette.data());
+		for(uint32_t joint = 0; joint < JOINT_COUNT; joint++)
+		{
+			for(uint32_t i = 0; i < 16; i++)
+			{
+				maxPaletteError = std::max(maxPaletteError, std::fabs(rawPalette[joint].p[i] - compressedPalette[joint].p[i]));
+			}
+		}
+	}
+	magma::log::info("max palette difference {}", maxPaletteError);
+	TEST_CHECK(maxPaletteError <= MAX_PALETTE_ERROR);
+
+	//blend tree clip nodes decode compressed clips the same way instances do
+	BlendTree tree = {};
+	add_clip_node(&tree, 0);
+	BlendTreeScratch treeScratch = {};
+	init_blend_tree_scratch(compressed, tree, &treeScratch);
+	AnimationInstance treeReference = {};
+	init_animation_instance(compressed, 0, 1.f, &treeReference);
+	float maxTreeError = 0.f;
+	for(uint32_t frame = 0; frame < 60; frame++)
+	{
+		update_blend_tree(compressed, &tree, &treeScratch, 1.f / 60.f, rawPalette.data());
+		update_animation(&treeReference, 1.f / 60.f, compressedPalette.data());
+		for(uint32_t joint = 0; joint < JOINT_COUNT; joint++)
+		{
+			for(uint32_t i = 0; i < 16; i++)
+			{
+				maxTreeError = std::max(maxTreeError, std::fabs(rawPalette[joint].p[i] - compressedPalette[joint].p[i]));
+			}
+		}
+	}
+	TEST_CHECK(maxTreeError <= 1e-5f);
+
+	//decode cost per joint against sampling raw tracks
+	std::vector<JointTransform> localTransforms(JOINT_COUNT);
+	for(uint32_t joint = 0; joint < JOINT_COUNT; joint++)
+	{
+		localTransforms[joint] = raw.bindPose[joint].restTransform;
+	}
+	CompressedAnimationScratch scratch = {};
+	init_compressed_animation_scratch(compressed.compressedClips[0], &scratch);
+	std::vector<uint32_t> trackCursors(raw.clips[0].tracks.size(), 0);
+	const float duration = raw.clips[0].duration;
+	const float compressedTime = measure_ns_per_joint(duration, [&](float time) {
+		sample_compressed_animation(compressed.compressedClips[0], time, &scratch, localTransforms.data());
+	});
+	const float rawTime = measure_ns_per_joint(duration, [&](float time) {
+		sample_animation(raw, 0, time, trackCursors.data(), localTransforms.data());
+	});
+	magma::log::info("decode {:.1f} ns per joint, raw sampling {:.1f} ns per joint", compressedTime, rawTime);
+
+	return finish_test("animation_compression_test");
+}
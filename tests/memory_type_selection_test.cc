@@ -0,0 +1,157 @@
+#include "vk_allocator.h"
+#include "test_utils.h"
+
+static constexpr VkMemoryPropertyFlags DEVICE_LOCAL = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+static constexpr VkMemoryPropertyFlags HOST_VISIBLE = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+static constexpr VkMemoryPropertyFlags HOST_COHERENT = VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+static constexpr VkMemoryPropertyFlags HOST_CACHED = VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+static constexpr VkMemoryPropertyFlags LAZILY_ALLOCATED = VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT;
+static constexpr VkMemoryPropertyFlags PROTECTED = VK_MEMORY_PROPERTY_PROTECTED_BIT;
+
+static constexpr VkDeviceSize MiB = 1ull << 20;
+static constexpr VkDeviceSize GiB = 1ull << 30;
+static constexpr uint32_t NO_TYPE = UINT32_MAX;
+
+//the way the renderer asks for memory
+static const MemoryTypeRequest GPU_ONLY = get_memory_type_request(DEVICE_LOCAL);
+static const MemoryTypeRequest STAGING = get_memory_type_request(HOST_VISIBLE | HOST_COHERENT);
+static const MemoryTypeRequest FRAME_RING = {HOST_VISIBLE, DEVICE_LOCAL, 0};
+static const MemoryTypeRequest READBACK = {HOST_VISIBLE, HOST_CACHED, DEVICE_LOCAL};
+
+static void add_heap(VkPhysicalDeviceMemoryProperties* props, VkDeviceSize size, bool deviceLocal)
+{
+	props->memoryHeaps[props->memoryHeapCount].size = size;
+	props->memoryHeaps[props->memoryHeapCount].flags = deviceLocal ? VK_MEMORY_HEAP_DEVICE_LOCAL_BIT : 0;
+	props->memoryHeapCount++;
+}
+
+static void add_type(VkPhysicalDeviceMemoryProperties* props, VkMemoryPropertyFlags flags, uint32_t heapIndex)
+{
+	props->memoryTypes[props->memoryTypeCount].propertyFlags = flags;
+	props->memoryTypes[props->memoryTypeCount].heapIndex = heapIndex;
+	props->memoryTypeCount++;
+}
+
+//every heap gets its full size as budget and nothing used
+static MemoryHeapBudget get_full_budget(const VkPhysicalDeviceMemoryProperties& props)
+{
+	MemoryHeapBudget budget = {};
+	for(uint32_t i = 0; i < props.memoryHeapCount; i++)
+	{
+		budget.budget[i] = props.memoryHeaps[i].size;
+	}
+	return budget;
+}
+
+static uint32_t select(const VkPhysicalDeviceMemoryProperties& props, const MemoryHeapBudget* budget, const MemoryTypeRequest& request,
+	VkDeviceSize size = 0, uint32_t memoryTypeBits = UINT32_MAX)
+{
+	uint32_t memoryTypeIndex = NO_TYPE;
+	if(!select_memory_type(props, budget, memoryTypeBits, request, size, &memoryTypeIndex))
+	{
+		return NO_TYPE;
+	}
+	return memoryTypeIndex;
+}
+
+//vram, system memory with an uncached and a cached type, a 256 MiB BAR window and a protected type
+static void test_discrete()
+{
+	VkPhysicalDeviceMemoryProperties props = {};
+	add_heap(&props, 8 * GiB, true);
+	add_heap(&props, 16 * GiB, false);
+	add_heap(&props, 256 * MiB, true);
+	add_type(&props, DEVICE_LOCAL, 0);
+	add_type(&props, HOST_VISIBLE | HOST_COHERENT, 1);
+	add_type(&props, HOST_VISIBLE | HOST_COHERENT | HOST_CACHED, 1);
+	add_type(&props, DEVICE_LOCAL | HOST_VISIBLE | HOST_COHERENT, 2);
+	add_type(&props, DEVICE_LOCAL | PROTECTED, 0);
+
+	TEST_CHECK(select(props, nullptr, GPU_ONLY) == 0);
+	TEST_CHECK(select(props, nullptr, STAGING) == 1);
+	TEST_CHECK(select(props, nullptr, FRAME_RING) == 3);
+	TEST_CHECK(select(props, nullptr, READBACK) == 2);
+
+	//required flags win over preferences, protected memory is only handed out on request
+	TEST_CHECK(select(props, nullptr, GPU_ONLY, 0, 1u << 3) == 3);
+	TEST_CHECK(select(props, nullptr, GPU_ONLY, 0, 1u << 4) == NO_TYPE);
+	TEST_CHECK(select(props, nullptr, get_memory_type_request(DEVICE_LOCAL | PROTECTED)) == 4);
+	TEST_CHECK(select(props, nullptr, STAGING, 0, 1u << 0) == NO_TYPE);
+
+	const MemoryHeapBudget budget = get_full_budget(props);
+	TEST_CHECK(select(props, &budget, GPU_ONLY, 64 * MiB) == 0);
+	TEST_CHECK(select(props, &budget, FRAME_RING, 64 * MiB) == 3);
+}
+
+//integrated gpus have one heap and every type is device local
+static void test_uma()
+{
+	VkPhysicalDeviceMemoryProperties props = {};
+	add_heap(&props, 4 * GiB, true);
+	add_type(&props, DEVICE_LOCAL | LAZILY_ALLOCATED, 0);
+	add_type(&props, DEVICE_LOCAL, 0);
+	add_type(&props, DEVICE_LOCAL | HOST_VISIBLE | HOST_COHERENT, 0);
+	add_type(&props, DEVICE_LOCAL | HOST_VISIBLE | HOST_COHERENT | HOST_CACHED, 0);
+
+	//lazily allocated memory is listed first but only backs transient attachments that ask for it
+	TEST_CHECK(select(props, nullptr, GPU_ONLY) == 1);
+	TEST_CHECK(select(props, nullptr, {DEVICE_LOCAL, LAZILY_ALLOCATED, 0}) == 0);
+	TEST_CHECK(select(props, nullptr, STAGING) == 2);
+	TEST_CHECK(select(props, nullptr, FRAME_RING) == 2);
+	TEST_CHECK(select(props, nullptr, READBACK) == 3);
+}
+
+//host visible memory exists only as a device local BAR window, uploads have nowhere else to go
+static void test_bar_only()
+{
+	VkPhysicalDeviceMemoryProperties props = {};
+	add_heap(&props, 8 * GiB, true);
+	add_heap(&props, 256 * MiB, true);
+	add_type(&props, DEVICE_LOCAL, 0);
+	add_type(&props, DEVICE_LOCAL | HOST_VISIBLE | HOST_COHERENT, 1);
+
+	TEST_CHECK(select(props, nullptr, GPU_ONLY) == 0);
+	TEST_CHECK(select(props, nullptr, STAGING) == 1);
+	TEST_CHECK(select(props, nullptr, FRAME_RING) == 1);
+	TEST_CHECK(select(props, nullptr, READBACK) == 1);
+	TEST_CHECK(select(props, nullptr, get_memory_type_request(HOST_CACHED)) == NO_TYPE);
+}
+
+//heaps out of budget are left for the next best type, and only picked again once every candidate is out
+static void test_budget_exhausted()
+{
+	VkPhysicalDeviceMemoryProperties props = {};
+	add_heap(&props, 8 * GiB, true);
+	add_heap(&props, 16 * GiB, false);
+	add_heap(&props, 256 * MiB, true);
+	add_type(&props, DEVICE_LOCAL, 0);
+	add_type(&props, HOST_VISIBLE | HOST_COHERENT, 1);
+	add_type(&props, DEVICE_LOCAL | HOST_VISIBLE | HOST_COHERENT, 2);
+
+	MemoryHeapBudget budget = get_full_budget(props);
+	budget.budget[2] = 200 * MiB;
+	budget.usage[2] = 190 * MiB;
+	TEST_CHECK(select(props, &budget, FRAME_RING, 1 * MiB) == 2);
+	TEST_CHECK(select(props, &budget, FRAME_RING, 64 * MiB) == 1);
+
+	budget.usage[0] = 8 * GiB;
+	TEST_CHECK(select(props, &budget, GPU_ONLY, 1 * MiB) == 2);
+	TEST_CHECK(select(props, &budget, GPU_ONLY, 64 * MiB) == 0);
+
+	budget.usage[1] = 16 * GiB;
+	budget.usage[2] = 200 * MiB;
+	TEST_CHECK(select(props, &budget, GPU_ONLY, 1 * MiB) == 0);
+	TEST_CHECK(select(props, &budget, STAGING, 1 * MiB) == 1);
+	TEST_CHECK(select(props, &budget, FRAME_RING, 1 * MiB) == 2);
+}
+
+int main()
+{
+	magma::log::set_severity_mask(magma::log::MASK_INFO);
+
+	test_discrete();
+	test_uma();
+	test_bar_only();
+	test_budget_exhausted();
+	return finish_test("memory_type_selection_test");
+}
@@ -0,0 +1,219 @@
+#include "mesh_lod.h"
+#include "test_utils.h"
+
+#include <cmath>
+#include <vector>
+
+static constexpr uint32_t GRID_QUADS = 16;
+static constexpr uint32_t SEAM_COLUMN = GRID_QUADS / 2;
+static constexpr float POSITION_EPSILON = 1e-6f;
+
+//unit square gently bent along z, the middle column is split into two vertices with
+//different uvs like a texture seam, and the outline of the square is an open border
+static void build_seamed_grid(std::vector<Vertex>* vertices, std::vector<unsigned int>* indices)
+{
+	auto addVertex = [&](uint32_t column, uint32_t row, float uOffset)
+	{
+		const float x = static_cast<float>(column) / GRID_QUADS;
+		const float y = static_cast<float>(row) / GRID_QUADS;
+		Vertex vertex = {};
+		vertex.position = Vec3{x, y, 0.05f * std::sin(float(M_PI) * x) * std::sin(float(M_PI) * y)};
+		vertex.normal = Vec3{0.f, 0.f, 1.f};
+		vertex.uv = Vec2{x + uOffset, y};
+		vertex.weights = Vec4{1.f, 0.f, 0.f, 0.f};
+		vertices->push_back(vertex);
+		return static_cast<unsigned int>(vertices->size() - 1);
+	};
+
+	//left half uses uvs as they are, right half is shifted into the next tile
+	std::vector<unsigned int> left((GRID_QUADS + 1) * (GRID_QUADS + 1));
+	std::vector<unsigned int> right((GRID_QUADS + 1) * (GRID_QUADS + 1));
+	for(uint32_t row = 0; row <= GRID_QUADS; row++)
+	{
+		for(uint32_t column = 0; column <= GRID_QUADS; column++)
+		{
+			const uint32_t id = row * (GRID_QUADS + 1) + column;
+			left[id] = column <= SEAM_COLUMN ? addVertex(column, row, 0.f) : 0;
+			right[id] = column < SEAM_COLUMN ? left[id] : addVertex(column, row, 1.f);
+		}
+	}
+
+	for(uint32_t row = 0; row < GRID_QUADS; row++)
+	{
+		for(uint32_t column = 0; column < GRID_QUADS; column++)
+		{
+			const std::vector<unsigned int>& side = column < SEAM_COLUMN ? left : right;
+			const unsigned int a = side[row * (GRID_QUADS + 1) + column];
+			const unsigned int b = side[row * (GRID_QUADS + 1) + column + 1];
+			const unsigned int c = side[(row + 1) * (GRID_QUADS + 1) + column + 1];
+			const unsigned int d = side[(row + 1) * (GRID_QUADS + 1) + column];
+			indices->insert(indices->end(), {a, b, c, a, c, d});
+		}
+	}
+}
+
+//area of the projection onto the xy plane, exactly 1 while the outline holds and no triangle folds over
+static float get_projected_area(const std::vector<Vertex>& vertices, const unsigned int* indices, uint32_t indexCount)
+{
+	float area = 0.f;
+	for(uint32_t i = 0; i < indexCount; i += 3)
+	{
+		const Vec3& a = vertices[indices[i]].position;
+		const Vec3& b = vertices[indices[i + 1]].position;
+		const Vec3& c = vertices[indices[i + 2]].position;
+		area += 0.5f * ((b.x - a.x) * (c.y - a.y) - (c.x - a.x) * (b.y - a.y));
+	}
+	return area;
+}
+
+static bool is_on_line(float value, float line)
+{
+	return std::fabs(value - line) <= POSITION_EPSILON;
+}
+
+//open edges only run along the border or the seam, and triangles never mix vertices of both seam sides
+static bool keeps_border_and_seam(const std::vector<Vertex>& vertices, const unsigned int* indices, uint32_t indexCount)
+{
+	const float seamX = static_cast<float>(SEAM_COLUMN) / GRID_QUADS;
+	auto hasEdge = [&](unsigned int from, unsigned int to)
+	{
+		for(uint32_t i = 0; i < indexCount; i += 3)
+		{
+			for(uint32_t e = 0; e < 3; e++)
+			{
+				if(indices[i + e] == from && indices[i + (e + 1) % 3] == to)
+				{
+					return true;
+				}
+			}
+		}
+		return false;
+	};
+
+	for(uint32_t i = 0; i < indexCount; i += 3)
+	{
+		const bool rightSide = vertices[indices[i]].uv.x >= 1.f || vertices[indices[i]].position.x > seamX + POSITION_EPSILON;
+		for(uint32_t e = 0; e < 3; e++)
+		{
+			const Vertex& from = vertices[indices[i + e]];
+			const Vertex& to = vertices[indices[i + (e + 1) % 3]];
+			const bool fromRight = from.uv.x >= 1.f || from.position.x > seamX + POSITION_EPSILON;
+			if(fromRight != rightSide)
+			{
+				return false;
+			}
+			if(hasEdge(indices[i + (e + 1) % 3], indices[i + e]))
+			{
+				continue;
+			}
+			const float lines[] = {0.f, 1.f, seamX};
+			bool alongLine = false;
+			for(float line : lines)
+			{
+				alongLine |= is_on_line(from.position.x, line) && is_on_line(to.position.x, line);
+				alongLine |= line != seamX && is_on_line(from.position.y, line) && is_on_line(to.position.y, line);
+			}
+			if(!alongLine)
+			{
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+//corners of the square and ends of the seam on both sides can't go anywhere
+static bool keeps_corners(const std::vector<Vertex>& vertices, const unsigned int* indices, uint32_t indexCount)
+{
+	const float seamX = static_cast<float>(SEAM_COLUMN) / GRID_QUADS;
+	const Vec3 corners[] = {{0.f, 0.f, 0.f}, {1.f, 0.f, 0.f}, {1.f, 1.f, 0.f}, {0.f, 1.f, 0.f}, {seamX, 0.f, 0.f}, {seamX, 1.f, 0.f}};
+	const uint32_t expectedUses[] = {1, 1, 1, 1, 2, 2};
+	for(uint32_t c = 0; c < 6; c++)
+	{
+		uint32_t uses = 0;
+		for(uint32_t v = 0; v < vertices.size(); v++)
+		{
+			const Vec3& position = vertices[v].position;
+			if(!is_on_line(position.x, corners[c].x) || !is_on_line(position.y, corners[c].y))
+			{
+				continue;
+			}
+			for(uint32_t i = 0; i < indexCount; i++)
+			{
+				if(indices[i] == v)
+				{
+					uses++;
+					break;
+				}
+			}
+		}
+		if(uses != expectedUses[c])
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+int main()
+{
+	magma::log::set_severity_mask(magma::log::MASK_INFO);
+
+	std::vector<Vertex> vertices;
+	std::vector<unsigned int> indices;
+	build_seamed_grid(&vertices, &indices);
+	const uint32_t vertexCount = static_cast<uint32_t>(vertices.size());
+	const uint32_t indexCount = static_cast<uint32_t>(indices.size());
+	TEST_CHECK(std::fabs(get_projected_area(vertices, indices.data(), indexCount) - 1.f) <= 1e-4f);
+	TEST_CHECK(keeps_border_and_seam(vertices, indices.data(), indexCount));
+
+	//a single simplification within the error limit
+	std::vector<unsigned int> simplified(indexCount);
+	float error = 0.f;
+	const uint32_t simplifiedCount = simplify_mesh(vertices.data(), vertexCount, indices.data(), indexCount,
+		indexCount / 4, 0.05f, 1.f, simplified.data(), &error);
+	magma::log::info("simplified {} to {} triangles with error {}", indexCount / 3, simplifiedCount / 3, error);
+	TEST_CHECK(simplifiedCount < indexCount);
+	TEST_CHECK(error <= 0.05f);
+	TEST_CHECK(std::fabs(get_projected_area(vertices, simplified.data(), simplifiedCount) - 1.f) <= 1e-4f);
+	TEST_CHECK(keeps_border_and_seam(vertices, simplified.data(), simplifiedCount));
+	TEST_CHECK(keeps_corners(vertices, simplified.data(), simplifiedCount));
+
+	//chain of levels, each coarser and less accurate than the previous one
+	MeshLodSettings settings = {};
+	settings.maxError = 0.05f;
+	MeshLodChain chain = {};
+	const uint32_t lodCount = generate_mesh_lods(vertices.data(), vertexCount, indices.data(), indexCount, settings, &chain);
+	TEST_CHECK(lodCount >= 3 && lodCount == chain.lods.size());
+	TEST_CHECK(chain.lods[0].indexCount == indexCount && chain.lods[0].error == 0.f);
+	for(uint32_t i = 0; i < lodCount; i++)
+	{
+		const MeshLod& lod = chain.lods[i];
+		const unsigned int* lodIndices = &chain.indexBuffer[lod.firstIndex];
+		magma::log::info("lod {}: {} triangles, error {}", i, lod.indexCount / 3, lod.error);
+		TEST_CHECK(std::fabs(get_projected_area(vertices, lodIndices, lod.indexCount) - 1.f) <= 1e-4f);
+		TEST_CHECK(keeps_border_and_seam(vertices, lodIndices, lod.indexCount));
+		TEST_CHECK(keeps_corners(vertices, lodIndices, lod.indexCount));
+		if(i > 0)
+		{
+			TEST_CHECK(lod.indexCount < chain.lods[i - 1].indexCount);
+			TEST_CHECK(lod.error >= chain.lods[i - 1].error);
+		}
+	}
+
+	//farther away selects coarser levels, inside the bounds always full detail
+	const float projectionScale = get_lod_projection_scale(60.f, 1080.f);
+	TEST_CHECK(select_mesh_lod(chain.lods.data(), lodCount, 1.f, 0.f, projectionScale, 1.f) == 0);
+	TEST_CHECK(select_mesh_lod(chain.lods.data(), lodCount, 1.f, 1e6f, projectionScale, 1.f) == lodCount - 1);
+	uint32_t previousLod = 0;
+	for(float distance = 0.25f; distance < 1e4f; distance *= 2.f)
+	{
+		const uint32_t lod = select_mesh_lod(chain.lods.data(), lodCount, 1.f, distance, projectionScale, 1.f);
+		const float pixelError = chain.lods[lod].error * projectionScale / distance;
+		TEST_CHECK(lod >= previousLod);
+		TEST_CHECK(lod == 0 || pixelError <= 1.f);
+		previousLod = lod;
+	}
+
+	return finish_test("mesh_lod_test");
+}
@@ -0,0 +1,84 @@
+#include "animation.h"
+#include "job_system.h"
+#include "test_animation.h"
+#include "test_utils.h"
+
+#include <cmath>
+#include <vector>
+
+static constexpr uint32_t JOINT_COUNT = 16;
+static constexpr uint32_t INSTANCE_COUNT = 512;
+static constexpr uint32_t POSE_COUNT = 8;//distinct start times, instances sharing one stay in lockstep
+static constexpr float TIME_QUANTUM = 1.f / 30.f;
+
+static bool palettes_match(const mat4x4* first, const mat4x4* second)
+{
+	for(uint32_t joint = 0; joint < JOINT_COUNT; joint++)
+	{
+		for(uint32_t i = 0; i < 16; i++)
+		{
+			if(std::fabs(first[joint].p[i] - second[joint].p[i]) > 1e-5f)
+			{
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+int main()
+{
+	magma::log::set_severity_mask(magma::log::MASK_INFO);
+
+	Animation animation = {};
+	build_test_animation(JOINT_COUNT, 1.f, 30, &animation);
+	const float duration = animation.clips[0].duration;
+
+	std::vector<AnimationInstance> instances(INSTANCE_COUNT);
+	for(uint32_t i = 0; i < INSTANCE_COUNT; i++)
+	{
+		init_animation_instance(animation, 0, 1.f, &instances[i]);
+		instances[i].currentAnimTime = (i % POSE_COUNT) * 3.f * TIME_QUANTUM;
+	}
+	std::vector<mat4x4> palette(std::size_t(INSTANCE_COUNT) * JOINT_COUNT);
+
+	//lookups from several workers at once evaluate each pose once and hand it to every instance sharing it
+	PaletteCache cache = {};
+	init_palette_cache(animation, TIME_QUANTUM, POSE_COUNT, &cache);
+	JobSystem jobSystem = {};
+	init_job_system(3, &jobSystem);
+	for(uint32_t frame = 0; frame < 60; frame++)
+	{
+		begin_palette_cache_frame(&cache);
+		update_animations_batch(&jobSystem, instances.data(), INSTANCE_COUNT, 1.f / 60.f, palette.data(), JOINT_COUNT, &cache);
+		TEST_CHECK(cache.misses == POSE_COUNT);
+		TEST_CHECK(cache.hits == INSTANCE_COUNT - POSE_COUNT);
+
+		AnimationInstance reference = {};
+		init_animation_instance(animation, 0, 1.f, &reference);
+		std::vector<mat4x4> expected(JOINT_COUNT);
+		for(uint32_t i = 0; i < POSE_COUNT; i++)
+		{
+			//cache samples at quantised time
+			const float time = std::round(instances[i].currentAnimTime / TIME_QUANTUM) * TIME_QUANTUM;
+			reference.currentAnimTime = std::fmin(time, duration);
+			update_animation(&reference, 0.f, expected.data());
+			TEST_CHECK(palettes_match(expected.data(), &palette[std::size_t(i) * JOINT_COUNT]));
+		}
+	}
+	destroy_job_system(&jobSystem);
+
+	//a full cache still counts lookups it turns away as misses
+	PaletteCache smallCache = {};
+	init_palette_cache(animation, TIME_QUANTUM, 2, &smallCache);
+	begin_palette_cache_frame(&smallCache);
+	AnimationScratch& scratch = instances[0].scratch;
+	TEST_CHECK(get_cached_palette(&smallCache, 0, 0.f, &scratch) != nullptr);
+	TEST_CHECK(get_cached_palette(&smallCache, 0, 0.5f, &scratch) != nullptr);
+	TEST_CHECK(get_cached_palette(&smallCache, 0, 0.25f, &scratch) == nullptr);
+	TEST_CHECK(get_cached_palette(&smallCache, 0, 0.f, &scratch) != nullptr);
+	TEST_CHECK(smallCache.misses == 3);
+	TEST_CHECK(smallCache.hits == 1);
+
+	return finish_test("palette_cache_test");
+}
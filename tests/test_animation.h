@@ -0,0 +1,79 @@
+#ifndef MAGMA_TEST_ANIMATION_H
+#define MAGMA_TEST_ANIMATION_H
+
+#include "animation.h"
+
+#include <cmath>
+#include <vector>
+
+//binary tree of joints swaying up to 10 degrees around alternating axes, the root also bobs up and down.
+//Like baked mocap every joint gets a track per channel, even when translation and scale stay constant
+static void build_test_animation(uint32_t jointCount, float duration, uint32_t keysPerSecond, Animation* out)
+{
+	out->bindPose.resize(jointCount);
+	for(uint32_t i = 0; i < jointCount; i++)
+	{
+		Joint& joint = out->bindPose[i];
+		joint.parentId = i == 0 ? -1 : static_cast<int>(i - 1) / 2;
+		joint.restTransform.rotation = identityQuat();
+		joint.restTransform.translation = Vec3{i % 2 == 0 ? 0.1f : -0.1f, i == 0 ? 0.f : 0.5f, 0.f};
+		joint.restTransform.scale = Vec3{1.f, 1.f, 1.f};
+		joint.restTransform.channelBits = CHANNEL_ROTATE_BIT|CHANNEL_SCALE_BIT|CHANNEL_TRANSLATE_BIT;
+	}
+	build_joint_order(out);
+
+	std::vector<JointTransform> restPose(jointCount);
+	std::vector<mat4x4> bindTransforms(jointCount);
+	for(uint32_t i = 0; i < jointCount; i++)
+	{
+		restPose[i] = out->bindPose[i].restTransform;
+	}
+	generate_global_joint_transforms(*out, restPose.data(), bindTransforms.data());
+	for(uint32_t i = 0; i < jointCount; i++)
+	{
+		out->bindPose[i].invBindTransform = inverse(bindTransforms[i]);
+	}
+
+	const uint32_t keyCount = static_cast<uint32_t>(duration * keysPerSecond) + 1;
+	AnimationClip clip = {};
+	clip.name = "sway";
+	clip.duration = duration;
+	clip.isAdditive = false;
+	for(uint32_t i = 0; i < jointCount; i++)
+	{
+		const Vec3 axis = i % 2 == 0 ? Vec3{0.f, 0.f, 1.f} : Vec3{1.f, 0.f, 0.f};
+		const float phase = 0.3f * i;
+		const AnimChannel channels[] = {CHANNEL_ROTATE_BIT, CHANNEL_TRANSLATE_BIT, CHANNEL_SCALE_BIT};
+		for(AnimChannel channel : channels)
+		{
+			AnimationTrack track = {};
+			track.jointId = i;
+			track.channel = channel;
+			track.interpolation = INTERPOLATION_LINEAR;
+			for(uint32_t key = 0; key < keyCount; key++)
+			{
+				const float time = duration * key / (keyCount - 1);
+				const float wave = std::sin(2.f * float(M_PI) * time / duration + phase);
+				track.timeCodes.push_back(time);
+				if(channel == CHANNEL_ROTATE_BIT)
+				{
+					const Quat rotation = quatFromAxisAndAngle(axis, 10.f * wave);
+					track.values.insert(track.values.end(), {rotation.x, rotation.y, rotation.z, rotation.w});
+				}
+				else if(channel == CHANNEL_TRANSLATE_BIT)
+				{
+					const Vec3 translation = out->bindPose[i].restTransform.translation;
+					track.values.insert(track.values.end(), {translation.x, translation.y + (i == 0 ? 0.05f * wave : 0.f), translation.z});
+				}
+				else
+				{
+					track.values.insert(track.values.end(), {1.f, 1.f, 1.f});
+				}
+			}
+			clip.tracks.push_back(std::move(track));
+		}
+	}
+	out->clips.push_back(std::move(clip));
+}
+
+#endif
@@ -0,0 +1,32 @@
+#ifndef MAGMA_TEST_UTILS_H
+#define MAGMA_TEST_UTILS_H
+
+#include "logging.h"
+
+#include <cstdint>
+
+static uint32_t testFailures = 0;
+
+//logs failed condition and keeps going, so a single run reports every broken check
+#define TEST_CHECK(condition) \
+	do \
+	{ \
+		if(!(condition)) \
+		{ \
+			magma::log::error("{}:{}: check failed: {}", __FILE__, __LINE__, #condition); \
+			testFailures++; \
+		} \
+	} while(0)
+
+static int finish_test(const char* name)
+{
+	if(testFailures > 0)
+	{
+		magma::log::error("{}: {} checks failed", name, testFailures);
+		return 1;
+	}
+	magma::log::info("{}: passed", name);
+	return 0;
+}
+
+#endif
@@ -0,0 +1,132 @@
+#include "texture_compression.h"
+#include "test_utils.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+static constexpr uint32_t IMAGE_SIZE = 128;
+static constexpr uint32_t WORKER_COUNT = 3;
+
+//smooth gradients with noise on top and a few hard edges, alpha ramps across
+static std::vector<uint8_t> build_test_image(uint32_t width, uint32_t height)
+{
+	std::vector<uint8_t> rgba(std::size_t(width) * height * 4);
+	uint32_t seed = 12345;
+	for(uint32_t y = 0; y < height; y++)
+	{
+		for(uint32_t x = 0; x < width; x++)
+		{
+			seed = seed * 1664525u + 1013904223u;
+			const int32_t noise = int32_t(seed >> 28) - 8;
+			const bool stripe = (x / 16 + y / 24) % 3 == 0;
+			const int32_t values[4] = {
+				int32_t(x * 255 / width) + noise,
+				stripe ? 220 : int32_t(y * 255 / height) - noise,
+				int32_t(128 + 100 * sinf(x * 0.1f + y * 0.05f)),
+				int32_t((x + y) * 255 / (width + height))
+			};
+			for(uint32_t c = 0; c < 4; c++)
+			{
+				rgba[(std::size_t(y) * width + x) * 4 + c] = static_cast<uint8_t>(std::min(std::max(values[c], 0), 255));
+			}
+		}
+	}
+	return rgba;
+}
+
+static float compute_psnr(const std::vector<uint8_t>& reference, const std::vector<uint8_t>& decoded, uint32_t channelCount)
+{
+	double squaredError = 0.0;
+	for(std::size_t i = 0; i < reference.size(); i += 4)
+	{
+		for(uint32_t c = 0; c < channelCount; c++)
+		{
+			const double difference = double(reference[i + c]) - double(decoded[i + c]);
+			squaredError += difference * difference;
+		}
+	}
+	const double meanError = squaredError / (reference.size() / 4 * channelCount);
+	return meanError == 0.0 ? INFINITY : float(10.0 * log10(255.0 * 255.0 / meanError));
+}
+
+struct FormatCase
+{
+	TextureBlockFormat format;
+	const char* name;
+	uint32_t channelCount;//compared channels, starting at red
+	float minPsnr;
+};
+
+//every texel of the block gets the same color, which has to come back within a step of 565 precision
+static uint32_t get_single_color_error(TextureBlockFormat format, const uint8_t* color)
+{
+	std::vector<uint8_t> rgba(TEXTURE_BLOCK_DIM * TEXTURE_BLOCK_DIM * 4);
+	for(std::size_t i = 0; i < rgba.size(); i += 4)
+	{
+		memcpy(&rgba[i], color, 4);
+	}
+	uint8_t block[16];
+	uint8_t decoded[TEXTURE_BLOCK_DIM * TEXTURE_BLOCK_DIM * 4];
+	compress_image(rgba.data(), TEXTURE_BLOCK_DIM, TEXTURE_BLOCK_DIM, format, nullptr, block);
+	decompress_image(block, TEXTURE_BLOCK_DIM, TEXTURE_BLOCK_DIM, format, decoded);
+
+	uint32_t maxError = 0;
+	for(uint32_t i = 0; i < TEXTURE_BLOCK_DIM * TEXTURE_BLOCK_DIM; i++)
+	{
+		for(uint32_t c = 0; c < 3; c++)
+		{
+			maxError = std::max(maxError, uint32_t(std::abs(int32_t(decoded[i * 4 + c]) - int32_t(color[c]))));
+		}
+	}
+	return maxError;
+}
+
+int main()
+{
+	magma::log::set_severity_mask(magma::log::MASK_INFO);
+
+	const std::vector<uint8_t> image = build_test_image(IMAGE_SIZE, IMAGE_SIZE);
+	JobSystem jobSystem = {};
+	init_job_system(WORKER_COUNT, &jobSystem);
+
+	const FormatCase cases[] = {
+		{TEXTURE_BLOCK_BC1, "BC1", 3, 34.f},
+		{TEXTURE_BLOCK_BC3, "BC3", 4, 35.f},
+		{TEXTURE_BLOCK_BC5, "BC5", 2, 48.f},
+		{TEXTURE_BLOCK_BC7, "BC7", 4, 38.f},
+	};
+	for(const FormatCase& formatCase : cases)
+	{
+		const std::size_t compressedSize = get_compressed_size(IMAGE_SIZE, IMAGE_SIZE, formatCase.format);
+		std::vector<uint8_t> blocks(compressedSize);
+		std::vector<uint8_t> parallelBlocks(compressedSize);
+		std::vector<uint8_t> decoded(image.size());
+		compress_image(image.data(), IMAGE_SIZE, IMAGE_SIZE, formatCase.format, nullptr, blocks.data());
+		compress_image(image.data(), IMAGE_SIZE, IMAGE_SIZE, formatCase.format, &jobSystem, parallelBlocks.data());
+		decompress_image(blocks.data(), IMAGE_SIZE, IMAGE_SIZE, formatCase.format, decoded.data());
+
+		const float psnr = compute_psnr(image, decoded, formatCase.channelCount);
+		magma::log::info("{}: {:.2f} dB", formatCase.name, psnr);
+		TEST_CHECK(psnr >= formatCase.minPsnr);
+		TEST_CHECK(blocks == parallelBlocks);
+	}
+
+	//single color blocks hit optimal endpoints, in 4 color mode for bc1 and bc3 alike
+	const uint8_t exactColor[4] = {10, 200, 77, 255};
+	TEST_CHECK(get_single_color_error(TEXTURE_BLOCK_BC1, exactColor) == 0);
+	TEST_CHECK(get_single_color_error(TEXTURE_BLOCK_BC3, exactColor) == 0);
+	uint32_t maxSingleColorError = 0;
+	for(uint32_t value = 0; value < 256; value++)
+	{
+		const uint8_t color[4] = {uint8_t(value), uint8_t(255 - value), uint8_t(value * 7), 255};
+		maxSingleColorError = std::max(maxSingleColorError, get_single_color_error(TEXTURE_BLOCK_BC1, color));
+		maxSingleColorError = std::max(maxSingleColorError, get_single_color_error(TEXTURE_BLOCK_BC3, color));
+	}
+	TEST_CHECK(maxSingleColorError <= 1);
+
+	destroy_job_system(&jobSystem);
+	return finish_test("texture_compression_test");
+}
@@ -0,0 +1,189 @@
+#include "texture_streaming.h"
+#include "test_utils.h"
+
+#include <cmath>
+
+static constexpr uint32_t TEXTURE_EXTENT = 256;
+static constexpr uint32_t TEXTURE_LEVELS = 9;
+static constexpr uint32_t TAIL_LEVEL = 2;//64 texels, the default resident tail extent
+static constexpr uint64_t CURRENT_FRAME = 10;
+
+static VkDeviceSize get_size(uint32_t firstLevel)
+{
+	VkDeviceSize size = 0;
+	for(uint32_t level = firstLevel; level < TEXTURE_LEVELS; level++)
+	{
+		const uint32_t dimension = std::max(TEXTURE_EXTENT >> level, 1u);
+		size += get_compressed_size(dimension, dimension, TEXTURE_BLOCK_BC1);
+	}
+	return size;
+}
+
+//stands in for add_streamed_texture, the planner only looks at extents and residency
+static StreamedTextureHandle add_texture(TextureStreamer* streamer, uint32_t residentLevel, uint64_t lastUsedFrame)
+{
+	StreamedTexture texture = {};
+	texture.source.format = get_block_vk_format(TEXTURE_BLOCK_BC1, MIP_COLOR_SRGB);
+	texture.source.blockFormat = TEXTURE_BLOCK_BC1;
+	texture.source.colorSpace = MIP_COLOR_SRGB;
+	texture.source.extent = {TEXTURE_EXTENT, TEXTURE_EXTENT, 1};
+	texture.source.levelCount = TEXTURE_LEVELS;
+	texture.source.faceCount = 1;
+	texture.imageFormat = texture.source.format;
+	texture.residentLevel = residentLevel;
+	texture.tailLevel = TAIL_LEVEL;
+	texture.requestedLevel = TAIL_LEVEL;
+	texture.lastUsedFrame = lastUsedFrame;
+	streamer->textures.push_back(texture);
+	streamer->residentBytes += get_size(residentLevel);
+	return static_cast<StreamedTextureHandle>(streamer->textures.size() - 1);
+}
+
+static void init_streamer(VkDeviceSize budget, TextureStreamer* streamer)
+{
+	streamer->settings = {};
+	streamer->settings.budget = budget;
+	streamer->textures.clear();
+	streamer->residentBytes = 0;
+	streamer->releasingBytes = 0;
+	streamer->frameIndex = CURRENT_FRAME;
+}
+
+//what update_texture_streaming does to the accounting once the plan started and replaced images retired
+static void finish_plan(const TextureStreamingPlan& plan, TextureStreamer* streamer)
+{
+	for(StreamedTextureHandle handle : plan.evictions)
+	{
+		streamer->textures[handle].residentLevel = TAIL_LEVEL;
+	}
+	for(StreamedTextureHandle handle : plan.uploads)
+	{
+		streamer->textures[handle].residentLevel = streamer->textures[handle].requestedLevel;
+	}
+	streamer->residentBytes = plan.residentBytes - plan.releasingBytes;
+	streamer->releasingBytes = 0;
+	for(StreamedTexture& texture : streamer->textures)
+	{
+		texture.requestedLevel = texture.tailLevel;
+	}
+	streamer->frameIndex++;
+}
+
+//every request fits, the most recently used and furthest from its request go first
+static void test_within_budget()
+{
+	TextureStreamer streamer = {};
+	init_streamer(DEFAULT_TEXTURE_STREAMING_BUDGET, &streamer);
+	add_texture(&streamer, TAIL_LEVEL, 5);
+	const StreamedTextureHandle near = add_texture(&streamer, TAIL_LEVEL, 5);
+	add_texture(&streamer, TAIL_LEVEL, 5);
+	const StreamedTextureHandle far = add_texture(&streamer, TAIL_LEVEL, 5);
+	const VkDeviceSize residentBytes = streamer.residentBytes;
+	TEST_CHECK(residentBytes == 4 * get_size(TAIL_LEVEL));
+
+	request_texture_level(&streamer, far, 1);
+	request_texture_level(&streamer, near, 0);
+	request_texture_level(&streamer, near, 1);//finest level of the frame wins
+	TEST_CHECK(streamer.textures[near].requestedLevel == 0 && streamer.textures[near].lastUsedFrame == CURRENT_FRAME);
+
+	TextureStreamingPlan plan = {};
+	plan_texture_streaming(streamer, &plan);
+	TEST_CHECK(plan.evictions.empty());
+	TEST_CHECK(plan.uploads.size() == 2 && plan.uploads[0] == near && plan.uploads[1] == far);
+	TEST_CHECK(plan.residentBytes == residentBytes + get_size(0) + get_size(1));
+	TEST_CHECK(plan.releasingBytes == 2 * get_size(TAIL_LEVEL));
+
+	//only the first upload of an update may go over the staging limit
+	streamer.settings.maxUploadBytes = 1;
+	plan_texture_streaming(streamer, &plan);
+	TEST_CHECK(plan.uploads.size() == 1 && plan.uploads[0] == near);
+}
+
+//unrequested textures shrink to their tail least recently used first, and only as many as the request needs
+static void test_eviction_order()
+{
+	TextureStreamer streamer = {};
+	init_streamer(0, &streamer);
+	const StreamedTextureHandle recent = add_texture(&streamer, 0, 3);
+	const StreamedTextureHandle oldest = add_texture(&streamer, 0, 1);
+	const StreamedTextureHandle old = add_texture(&streamer, 0, 2);
+	const StreamedTextureHandle visible = add_texture(&streamer, 0, 0);
+	const StreamedTextureHandle tail = add_texture(&streamer, TAIL_LEVEL, 0);
+	const StreamedTextureHandle requested = add_texture(&streamer, TAIL_LEVEL, 0);
+	request_texture_level(&streamer, visible, 0);
+	request_texture_level(&streamer, requested, 0);
+
+	//the request fits once two textures went down to their tail
+	const VkDeviceSize neededBytes = get_size(0);
+	const VkDeviceSize evictedBytes = get_size(0) - get_size(TAIL_LEVEL);
+	streamer.settings.budget = streamer.residentBytes + neededBytes - 2 * evictedBytes;
+	const VkDeviceSize residentBytes = streamer.residentBytes;
+
+	TextureStreamingPlan plan = {};
+	plan_texture_streaming(streamer, &plan);
+	TEST_CHECK(plan.evictions.size() == 2 && plan.evictions[0] == oldest && plan.evictions[1] == old);
+	TEST_CHECK(plan.residentBytes == residentBytes + 2 * get_size(TAIL_LEVEL));
+	TEST_CHECK(plan.releasingBytes == 2 * get_size(0));
+	TEST_CHECK(plan.residentBytes - plan.releasingBytes + neededBytes <= streamer.settings.budget);
+	//old images stay alive until they retire, so the request waits for a later update
+	TEST_CHECK(plan.uploads.empty());
+	for(StreamedTextureHandle handle : plan.evictions)
+	{
+		TEST_CHECK(handle != recent && handle != visible && handle != tail && handle != requested);
+	}
+
+	finish_plan(plan, &streamer);
+	TEST_CHECK(streamer.residentBytes == residentBytes - 2 * evictedBytes);
+	request_texture_level(&streamer, visible, 0);
+	request_texture_level(&streamer, requested, 0);
+	plan_texture_streaming(streamer, &plan);
+	TEST_CHECK(plan.evictions.empty());
+	TEST_CHECK(plan.uploads.size() == 1 && plan.uploads[0] == requested);
+	TEST_CHECK(plan.residentBytes <= streamer.settings.budget);
+}
+
+//requests that don't fit even with every candidate evicted are skipped, textures in flight are left alone
+static void test_budget_exhausted()
+{
+	TextureStreamer streamer = {};
+	init_streamer(0, &streamer);
+	const StreamedTextureHandle streaming = add_texture(&streamer, 0, 1);
+	streamer.textures[streaming].isStreaming = true;
+	const StreamedTextureHandle unused = add_texture(&streamer, 1, 2);
+	const StreamedTextureHandle requested = add_texture(&streamer, TAIL_LEVEL, 0);
+	const StreamedTextureHandle small = add_texture(&streamer, TAIL_LEVEL, 0);
+	request_texture_level(&streamer, requested, 0);
+	request_texture_level(&streamer, small, TAIL_LEVEL - 1);
+	streamer.settings.budget = streamer.residentBytes + get_size(TAIL_LEVEL) + get_size(TAIL_LEVEL - 1);
+
+	TextureStreamingPlan plan = {};
+	plan_texture_streaming(streamer, &plan);
+	TEST_CHECK(plan.evictions.size() == 1 && plan.evictions[0] == unused);
+	TEST_CHECK(plan.uploads.size() == 1 && plan.uploads[0] == small);
+	TEST_CHECK(plan.residentBytes <= streamer.settings.budget);
+}
+
+//one texel per pixel picks level 0, every halving of the projected size one level coarser
+static void test_level_for_distance()
+{
+	TextureStreamer streamer = {};
+	init_streamer(0, &streamer);
+	const StreamedTexture& texture = streamer.textures[add_texture(&streamer, TAIL_LEVEL, 0)];
+	const float projectionScale = float(TEXTURE_EXTENT);
+	TEST_CHECK(get_texture_level_for_distance(texture, 1.f, 0.5f, projectionScale) == 0);
+	TEST_CHECK(get_texture_level_for_distance(texture, 1.f, 1.f, projectionScale) == 0);
+	TEST_CHECK(get_texture_level_for_distance(texture, 1.f, 2.f, projectionScale) == 1);
+	TEST_CHECK(get_texture_level_for_distance(texture, 1.f, 16.f, projectionScale) == 4);
+	TEST_CHECK(get_texture_level_for_distance(texture, 1.f, 1e6f, projectionScale) == TEXTURE_LEVELS - 1);
+}
+
+int main()
+{
+	magma::log::set_severity_mask(magma::log::MASK_INFO);
+
+	test_within_budget();
+	test_eviction_order();
+	test_budget_exhausted();
+	test_level_for_distance();
+	return finish_test("texture_streaming_test");
+}